@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+  Minimal benchmark harness for the native environment.
+
+  Times an operation until enough samples have been collected, counts heap allocations made
+  during the timed section, and prints one JSON object per benchmark so results can be diffed
+  between releases.
+
+  Replaces the global operator new/delete, so include it from exactly one file per program.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <new>
+
+namespace Bench {
+
+  struct Counters {
+    unsigned long long allocations = 0;
+    unsigned long long bytes = 0;
+  };
+
+  inline Counters& counters() {
+    static Counters counters;
+    return counters;
+  }
+
+  /// @brief Counts and makes every allocation, the only caller of malloc
+  __attribute__((noinline)) inline void* allocate(size_t size) {
+    counters().allocations++;
+    counters().bytes += size;
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+  }
+
+  /// @brief Frees what allocate made, the only caller of free.  Never inlined, so the compiler
+  /// doesn't see free called on a pointer from operator new.
+  __attribute__((noinline)) inline void release(void* ptr) noexcept { free(ptr); }
+
+  /// @brief Prevents the compiler optimizing away a result
+  template <typename T>
+  inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+  }
+
+  /// @brief Only runs benchmarks whose name contains this, if set
+  inline const char*& filter() {
+    static const char* filter = NULL;
+    return filter;
+  }
+
+  /// @brief Parses the command line, --filter <substring>
+  inline void init(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i++) {
+      if (!strcmp(argv[i], "--filter")) filter() = argv[i + 1];
+    }
+  }
+
+  /// @brief Runs a benchmark, timing op in batches until minMs has elapsed
+  /// @param name Name to report
+  /// @param setup Called (untimed) before each batch
+  /// @param op Operation to time, called batch times per setup
+  /// @param batch Operations per setup, use 1 when op consumes the state setup creates
+  template <typename Setup, typename Op>
+  void run(const char* name, Setup setup, Op op, unsigned long batch = 1000,
+           unsigned long minMs = 200) {
+    if (filter() && !strstr(name, filter())) return;
+
+    unsigned long long iterations = 0;
+    std::chrono::nanoseconds elapsed(0);
+    Counters before = counters();
+
+    // Warm up caches and branch predictors
+    setup();
+    for (unsigned long i = 0; i < batch; i++) op();
+
+    before = counters();
+    while (elapsed < std::chrono::milliseconds(minMs)) {
+      Counters paused = counters();
+      setup();
+      // Allocations made by setup don't count
+      before.allocations += counters().allocations - paused.allocations;
+      before.bytes += counters().bytes - paused.bytes;
+
+      auto start = std::chrono::steady_clock::now();
+      for (unsigned long i = 0; i < batch; i++) op();
+      elapsed += std::chrono::steady_clock::now() - start;
+      iterations += batch;
+    }
+
+    Counters after = counters();
+    printf(
+        "{\"name\": \"%s\", \"ns_per_op\": %.2f, \"allocs_per_op\": %.3f, "
+        "\"bytes_per_op\": %.1f, \"iterations\": %llu}\n",
+        name, (double)elapsed.count() / iterations,
+        (double)(after.allocations - before.allocations) / iterations,
+        (double)(after.bytes - before.bytes) / iterations, iterations);
+    fflush(stdout);
+  }
+
+  /// @brief Runs a benchmark with no setup
+  template <typename Op>
+  void run(const char* name, Op op, unsigned long batch = 1000) {
+    run(name, []() {}, op, batch);
+  }
+
+}  // namespace Bench
+
+void* operator new(size_t size) { return Bench::allocate(size); }
+void* operator new[](size_t size) { return Bench::allocate(size); }
+void operator delete(void* ptr) noexcept { Bench::release(ptr); }
+void operator delete[](void* ptr) noexcept { Bench::release(ptr); }
+void operator delete(void* ptr, size_t) noexcept { Bench::release(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { Bench::release(ptr); }
@@ -0,0 +1,176 @@
+/*
+  Counts the bytes of packets copied on the rx and tx paths.
+
+  A manager is built with a payload that counts its copies and moves, (each one copies or moves
+  a whole packet's worth of payload), then frames are received, queued to forward and
+  transmitted, (into the caller's packet, or the manager's packet pool), and our own packets
+  sent.  Prints one JSON object per path with the packet
+  copies, (and moves), per frame and the bytes they come to, then the RAM the tx queue and packet
+  pool take.
+
+  pio run -e bench_copies && .pio/build/bench_copies/program
+*/
+#include <stdio.h>
+
+#include <utility>
+
+#include "etl/array.h"
+#include "fanetManager.h"
+#include "fanetManagerImpl.h"
+#include "fanetPacketImpl.h"
+
+using namespace Fanet;
+
+// Named rather than anonymous, as the manager is explicitly instantiated with these below, (an
+// anonymous namespace would leave the members nothing calls unused, and warned about)
+namespace Bench {
+  unsigned long long copies = 0;
+
+  /// @brief Every payload type, counting each time one is copied or moved
+  struct CountedPayload : PacketPayload {
+    using PacketPayload::PacketPayload;
+    using PacketPayload::operator=;
+
+    CountedPayload() {}
+    CountedPayload(const CountedPayload& other) : PacketPayload(other) { copies++; }
+    CountedPayload(CountedPayload&& other) : PacketPayload(std::move(other)) { copies++; }
+    CountedPayload& operator=(const CountedPayload& other) {
+      PacketPayload::operator=(other);
+      copies++;
+      return *this;
+    }
+    CountedPayload& operator=(CountedPayload&& other) {
+      PacketPayload::operator=(std::move(other));
+      copies++;
+      return *this;
+    }
+  };
+
+  struct CountingConfig : DefaultConfig {
+    using Payload = CountedPayload;
+  };
+}  // namespace Bench
+
+using namespace Bench;
+
+namespace Fanet {
+  template <typename T>
+  struct PayloadSupports<T, CountedPayload> : PayloadSupports<T, PacketPayload> {};
+}  // namespace Fanet
+
+template class Fanet::BasicPacket<CountedPayload>;
+template class Fanet::BasicFanetManager<CountingConfig>;
+
+namespace {
+  using Manager = BasicFanetManager<CountingConfig>;
+  using Buffer = etl::array<uint8_t, FANET_MAX_PACKET_SIZE>;
+
+  bool transmit(const Buffer*, const size_t&) { return true; }
+
+  /// @brief A tracking frame from one of a few neighbors, asking to be forwarded
+  size_t trackingFrame(const size_t& i, Buffer& bytes) {
+    Packet packet;
+    packet.header.type = PacketType::Tracking;
+    packet.header.srcMac = Mac{0x07, (uint16_t)(100 + i % 8)};
+    packet.header.shouldForward = true;
+    packet.header.hasExtensionHeader = false;
+    Tracking tracking;
+    tracking.location = {46.5f + i * 0.001f, 8.0f};
+    tracking.altitude = 1500;
+    tracking.aircraftType = AircraftType::Paraglider;
+    tracking.onlineTracking = true;
+    tracking.speed = 35;
+    tracking.climbRate = 0.5f;
+    tracking.heading = 90;
+    packet.payload = tracking;
+    return packet.encode(bytes);
+  }
+
+  void report(const char* name, const unsigned long long& count, const size_t& frames) {
+    double perFrame = (double)count / frames;
+    printf(
+        "{\"name\": \"%s\", \"packet_copies_per_frame\": %.2f, \"bytes_per_frame\": %.0f, "
+        "\"packet_bytes\": %zu}\n",
+        name, perFrame, perFrame * sizeof(Manager::Packet), sizeof(Manager::Packet));
+  }
+
+  /// @brief Receives batches of frames asking to be forwarded, forwarding each batch
+  /// @param pooled Receive into the packet pool, rather than a packet of our own
+  void forwardFrames(const char* name, const size_t& batch, const bool& pooled) {
+    static Manager manager;
+    manager.Begin(Mac{0xFB, 0x0001}, 1);
+    LegacyForwardPolicy policy;
+    manager.setForwardPolicy(policy);
+    auto send = etl::delegate<bool(const Buffer*, const size_t&)>::create<transmit>();
+
+    const size_t kFrames = 4000;
+    Buffer bytes;
+    Manager::Packet packet;
+    Manager::PacketRef ref;
+    unsigned long ms = 1000;
+    unsigned long long counted = 0;
+    size_t forwarded = manager.getStats().forwarded;
+    for (size_t i = 0; i < kFrames; i += batch) {
+      for (size_t j = 0; j < batch; j++) {
+        size_t size = trackingFrame(i + j, bytes);
+        auto before = copies;
+        if (pooled) {
+          manager.handleRx(bytes, size, ms, -110.0f, 2.0f, ref);
+        } else {
+          manager.handleRx(bytes, size, ms, -110.0f, 2.0f, packet);
+        }
+        counted += copies - before;
+      }
+      // Transmit them all once they're due
+      ms += 2000;
+      while (manager.nextTxTime(ms).has_value()) {
+        auto before = copies;
+        manager.doTx(ms, send);
+        counted += copies - before;
+        ms += 100;
+      }
+    }
+    report(name, counted, manager.getStats().forwarded - forwarded);
+  }
+
+  /// @brief Sends our own frames, transmitting each
+  void sendFrames() {
+    static Manager manager;
+    manager.Begin(Mac{0xFB, 0x0001}, 1);
+    auto send = etl::delegate<bool(const Buffer*, const size_t&)>::create<transmit>();
+
+    const size_t kFrames = 1000;
+    Name name;
+    name.name = "Scott O'Brien";
+    unsigned long ms = 1000;
+    unsigned long long counted = 0;
+    for (size_t i = 0; i < kFrames; i++) {
+      auto before = copies;
+      manager.sendPacket(name, ms);
+      manager.doTx(ms, send);
+      counted += copies - before;
+      ms += 1000;
+    }
+    report("sendPacket+doTx/name", counted, kFrames);
+  }
+
+  /// @brief RAM for queued packets, against a queue holding whole packets
+  void reportMemory() {
+    const size_t depth = CountingConfig::txQueueDepth;
+    printf(
+        "{\"name\": \"tx_queue_ram\", \"queue_depth\": %zu, \"pool_slots\": %zu, "
+        "\"pool_bytes\": %zu, \"queue_entry_bytes\": %zu, \"whole_packets_bytes\": %zu}\n",
+        depth, CountingConfig::packetPoolSize, sizeof(Manager::Pool), sizeof(Manager::TxPacket),
+        depth * sizeof(Manager::Packet));
+  }
+}  // namespace
+
+int main() {
+  forwardFrames("handleRx+doTx/forward", 1, false);
+  forwardFrames("handleRx+doTx/forward_4_queued", 4, false);
+  forwardFrames("handleRx(PacketRef)+doTx/forward", 1, true);
+  forwardFrames("handleRx(PacketRef)+doTx/forward_4_queued", 4, true);
+  sendFrames();
+  reportMemory();
+  return 0;
+}
@@ -0,0 +1,152 @@
+/*
+  Dead reckoning simulation benchmark.
+
+  Flies a scripted cross country flight (glides, thermals, turns) through a FanetManager with
+  a 1Hz GPS, decodes every tracking frame it transmits as a receiver would, and measures how
+  far the receiver's extrapolated position is from the truth.  Compares frames sent against
+  position error for a range of dead reckoning thresholds.
+
+  pio run -e bench_dead_reckoning && .pio/build/bench_dead_reckoning/program
+*/
+#include <math.h>
+#include <stdio.h>
+
+#include "etl/algorithm.h"
+#include "etl/delegate.h"
+#include "etl/vector.h"
+#include "fanetDeadReckoning.h"
+#include "fanetManager.h"
+
+using namespace Fanet;
+
+const unsigned long kFlightMs = 1000UL * 60 * 60;  // One hour flight
+const unsigned long kGpsIntervalMs = 1000;
+const unsigned long kTickMs = 10;
+
+/// @brief A leg of the scripted flight
+struct Leg {
+  unsigned long durationMs;
+  float speed;      // km/h
+  float turnRate;   // deg/s, 0 for straight flight
+  float climbRate;  // m/s
+};
+
+// Repeated glide, thermal, glide with a turn, and a gentle S-turn
+const Leg kLegs[] = {
+    {1000UL * 240, 38.0f, 0.0f, -1.1f},   // Straight glide
+    {1000UL * 180, 28.0f, 18.0f, 2.2f},   // Thermalling, ~20s circles
+    {1000UL * 20, 34.0f, 4.5f, -1.0f},    // Leave the thermal on a new heading
+    {1000UL * 200, 40.0f, 0.0f, -1.3f},   // Straight glide
+    {1000UL * 60, 36.0f, -3.0f, -1.0f},   // Gentle S-turn
+    {1000UL * 60, 36.0f, 3.0f, -1.0f},
+};
+
+struct Result {
+  float maxError;
+  uint32_t framesSent;
+  float meanError;
+  float p95Error;
+  float worstError;
+};
+
+Result simulate(float maxError, float maxAltError, unsigned long maxInterval) {
+  FanetManager manager(Mac{0xFB, 0x1234}, 1);
+  manager.aircraftType = AircraftType::Paraglider;
+  manager.setDeadReckoningThresholds(maxError, maxAltError, maxInterval);
+
+  // Truth
+  MotionState truth;
+  truth.location.latitude = 46.5f;
+  truth.location.longitude = 8.0f;
+  truth.altitude = 2500.0f;
+
+  // What the receiver has decoded from the air
+  etl::optional<MotionState> received;
+  uint32_t framesSent = 0;
+  auto transmit = [&](const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                      const size_t& size) {
+    auto packet = Packet::parse(*bytes, size);
+    if (packet.header.type != PacketType::Tracking) return true;
+    auto& tracking = etl::get<Tracking>(packet.payload);
+    MotionState rx;
+    rx.location = tracking.location;
+    rx.altitude = tracking.altitude;
+    rx.speed = tracking.speed;
+    rx.heading = tracking.heading;
+    rx.climbRate = tracking.climbRate;
+    rx.ms = truth.ms;
+    received = rx;
+    framesSent++;
+    return true;
+  };
+  etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&)> tx(
+      transmit);
+
+  static float errors[kFlightMs / kGpsIntervalMs];
+  size_t errorCount = 0;
+  size_t leg = 0;
+  unsigned long legStart = 0;
+  float heading = 45.0f;
+
+  for (unsigned long ms = 0; ms < kFlightMs; ms += kTickMs) {
+    truth.ms = ms;
+    if (ms % kGpsIntervalMs == 0) {
+      // Advance the truth by one GPS interval
+      const Leg& l = kLegs[leg % (sizeof(kLegs) / sizeof(kLegs[0]))];
+      if (ms - legStart >= l.durationMs) {
+        leg++;
+        legStart = ms;
+      }
+      heading = fmodf(heading + l.turnRate * kGpsIntervalMs / 1000.0f + 360.0f, 360.0f);
+      truth.heading = lroundf(heading) % 360;
+      truth.speed = l.speed;
+      truth.climbRate = l.climbRate;
+      auto next = DeadReckoning::predict(truth, ms + kGpsIntervalMs);
+      truth.location = next.location;
+      truth.altitude = next.altitude;
+
+      // Measure the receiver's error before it's had a chance to hear the new fix
+      if (received.has_value()) {
+        auto estimate = DeadReckoning::predict(received.value(), ms);
+        errors[errorCount++] = estimate.location.distanceTo(truth.location);
+      }
+
+      manager.setPos(truth.location.latitude, truth.location.longitude, truth.altitude, ms,
+                     truth.heading, truth.climbRate, truth.speed);
+    }
+
+    auto next = manager.nextTxTime(ms);
+    if (next.has_value() && next.value() <= ms) {
+      manager.doTx(ms, tx);
+    }
+  }
+
+  Result result = {maxError, framesSent, 0, 0, 0};
+  float sum = 0;
+  for (size_t i = 0; i < errorCount; i++) sum += errors[i];
+  etl::sort(errors, errors + errorCount);
+  result.meanError = errorCount ? sum / errorCount : 0;
+  result.p95Error = errorCount ? errors[(size_t)(errorCount * 0.95f)] : 0;
+  result.worstError = errorCount ? errors[errorCount - 1] : 0;
+  return result;
+}
+
+int main(int argc, char** argv) {
+  printf("%-22s %8s %8s %10s %10s %10s\n", "policy", "frames", "frames/h", "mean (m)",
+         "p95 (m)", "max (m)");
+
+  const float thresholds[] = {0.0f, 10.0f, 20.0f, 30.0f, 50.0f, 100.0f};
+  for (auto threshold : thresholds) {
+    auto result = simulate(threshold, threshold / 2, FANET_DR_MAX_INTERVAL);
+    char name[32];
+    if (threshold == 0.0f) {
+      snprintf(name, sizeof(name), "every update");
+    } else {
+      snprintf(name, sizeof(name), "dead reckoning %3.0fm", threshold);
+    }
+    printf("%-22s %8u %8.0f %10.1f %10.1f %10.1f\n", name, result.framesSent,
+           result.framesSent * (3600000.0f / kFlightMs), result.meanError, result.p95Error,
+           result.worstError);
+  }
+  return 0;
+}
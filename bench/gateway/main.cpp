@@ -0,0 +1,284 @@
+/*
+  Ground station daemon load generator.
+
+  Runs the gateway daemon on its own thread with a UDP frame source, sends it tracking frames
+  from a crowd of neighbors at a fixed rate, and connects hundreds of subscribers to its Unix
+  socket.  Most subscribers read everything as it arrives, measuring how long after a frame
+  was sent its neighbor's update reached them; a few never read at all, to load the daemon's
+  back-pressure.  Reports throughput, update latency and the daemon's counters.
+
+  With --receivers, the daemon fuses a UDP source per receiver, and each frame is sent to 3 to
+  6 of them with different RSSI, as stations around a valley would report it.
+
+  pio run -e bench_gateway && .pio/build/bench_gateway/program --clients 500
+
+  Options:
+    --clients N     Subscribers that keep up (default 500)
+    --slow N        Subscribers that never read (default 10)
+    --neighbors N   Neighbors sending frames (default 100)
+    --rate R        Frames per second, across all neighbors (default 500)
+    --seconds S     How long to send for (default 10)
+    --batch MS      Daemon batch interval (default 100)
+    --receivers N   Receivers reporting each frame, up to 32 (default 1)
+*/
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fanetGateway.h"
+
+using namespace Fanet;
+
+namespace {
+  double nowMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+  }
+
+  double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  }
+
+  /// @brief A subscriber reading the daemon's updates
+  struct Subscriber {
+    int fd = -1;
+    std::string pending;  // Part of a line read so far
+    uint64_t updates = 0;
+    uint64_t bytes = 0;
+  };
+
+  int connectTo(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+      if (fd >= 0) close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  double percentile(std::vector<float>& values, const double& p) {
+    if (values.empty()) return 0;
+    size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t clientCount = 500, slowCount = 10, neighbors = 100;
+  double rate = 500, seconds = 10;
+  unsigned long batchMs = 100;
+  size_t receiverCount = 1;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* arg = argv[i];
+    const char* value = argv[i + 1];
+    if (!strcmp(arg, "--clients")) {
+      clientCount = strtoul(value, NULL, 10);
+    } else if (!strcmp(arg, "--slow")) {
+      slowCount = strtoul(value, NULL, 10);
+    } else if (!strcmp(arg, "--neighbors")) {
+      neighbors = std::max(1UL, strtoul(value, NULL, 10));
+    } else if (!strcmp(arg, "--rate")) {
+      rate = std::max(1.0, atof(value));
+    } else if (!strcmp(arg, "--seconds")) {
+      seconds = atof(value);
+    } else if (!strcmp(arg, "--batch")) {
+      batchMs = strtoul(value, NULL, 10);
+    } else if (!strcmp(arg, "--receivers")) {
+      receiverCount = std::min(32UL, std::max(1UL, strtoul(value, NULL, 10)));
+    } else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+
+  // Each subscriber is a descriptor, and so is the daemon's end of it
+  struct rlimit files;
+  getrlimit(RLIMIT_NOFILE, &files);
+  files.rlim_cur = std::min<rlim_t>(files.rlim_max, 2 * (clientCount + slowCount) + 64);
+  setrlimit(RLIMIT_NOFILE, &files);
+
+  std::vector<Gateway::UdpFrameSource> receivers(receiverCount);
+  std::vector<Gateway::FrameSource*> sources;
+  for (auto& receiver : receivers) {
+    if (!receiver.open(0)) {
+      perror("udp");
+      return 1;
+    }
+    sources.push_back(&receiver);
+  }
+  Gateway::Options options;
+  options.socketPath = "/tmp/fanet-bench-" + std::to_string(getpid()) + ".sock";
+  options.batchMs = batchMs;
+  options.slowClientMs = (unsigned long)(seconds * 1000 / 2);
+  Gateway::Daemon daemon(sources, options);
+  if (!daemon.open()) {
+    perror("gateway");
+    return 1;
+  }
+  double cpuBefore = cpuSeconds();
+  std::thread loop([&]() { daemon.run(); });
+
+  // Subscribers, the slow ones never read
+  int epoll = epoll_create1(EPOLL_CLOEXEC);
+  std::vector<Subscriber> subscribers(clientCount);
+  std::vector<int> slow;
+  for (size_t i = 0; i < clientCount + slowCount; i++) {
+    int fd = connectTo(options.socketPath);
+    if (fd < 0) {
+      perror("connect");
+      return 1;
+    }
+    if (i >= clientCount) {
+      slow.push_back(fd);
+      continue;
+    }
+    subscribers[i].fd = fd;
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = i;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+  }
+
+  // Neighbors circling over a valley, each frame's send time kept to measure latency
+  int sender = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  std::vector<struct sockaddr_in> addresses(receiverCount);
+  for (size_t i = 0; i < receiverCount; i++) {
+    addresses[i] = {};
+    addresses[i].sin_family = AF_INET;
+    addresses[i].sin_port = htons(receivers[i].port());
+    addresses[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  }
+  std::vector<double> sentAt(neighbors, 0);
+  std::vector<float> latencies;
+  latencies.reserve(1 << 20);
+  Location center = {46.5f, 8.0f};
+
+  uint64_t framesSent = 0, datagramsSent = 0;
+  double start = nowMs();
+  double end = start + seconds * 1000;
+  double nextFrame = start;
+  struct epoll_event events[256];
+  char buffer[65536];
+  while (true) {
+    double now = nowMs();
+    if (now >= end) break;
+
+    // Send the frames that are due
+    while (nextFrame <= now) {
+      size_t n = framesSent % neighbors;
+      Packet packet;
+      packet.header.type = PacketType::Tracking;
+      packet.header.srcMac = Mac{0x07, (uint16_t)(n + 1)};
+      Tracking tracking;
+      tracking.aircraftType = AircraftType::Paraglider;
+      tracking.onlineTracking = false;
+      tracking.climbRate = 0.5f;
+      float angle = (float)(framesSent / neighbors) * 0.05f + n;
+      tracking.location = center.offsetBy(2000 * cosf(angle) + n * 10, 2000 * sinf(angle));
+      tracking.altitude = 1000 + n;
+      tracking.speed = 36;
+      tracking.heading = (int)(angle * 57.3f) % 360;
+      packet.payload = tracking;
+      etl::array<uint8_t, FANET_MAX_PACKET_SIZE> frame;
+      size_t size = packet.encode(frame);
+      // Reported by a few receivers, (or the only one), each hearing it differently
+      size_t copies = receiverCount == 1 ? 1 : std::min(receiverCount, 3 + framesSent % 4);
+      for (size_t copy = 0; copy < copies; copy++) {
+        size_t receiver = (framesSent + copy) % receiverCount;
+        uint8_t datagram[4 + FANET_MAX_PACKET_SIZE];
+        size_t length = Gateway::UdpFrameSource::encode(
+            frame.data(), size, -100.0f - (n + 7 * copy) % 20, 2.0f - copy, datagram);
+        sendto(sender, datagram, length, 0, (struct sockaddr*)&addresses[receiver],
+               sizeof(addresses[receiver]));
+        datagramsSent++;
+      }
+      sentAt[n] = now;
+      framesSent++;
+      nextFrame += 1000.0 / rate;
+    }
+
+    // Read what subscribers have been sent
+    int timeout = std::max(0, (int)(std::min(nextFrame, end) - nowMs()));
+    int count = epoll_wait(epoll, events, 256, timeout);
+    now = nowMs();
+    for (int i = 0; i < count; i++) {
+      auto& subscriber = subscribers[events[i].data.u64];
+      ssize_t read = recv(subscriber.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (read <= 0) continue;
+      subscriber.bytes += read;
+      subscriber.pending.append(buffer, read);
+      size_t from = 0, newline;
+      while ((newline = subscriber.pending.find('\n', from)) != std::string::npos) {
+        // {"addr":"07:xxxx",... lines are updates, (the address is the neighbor's number)
+        const char* line = subscriber.pending.c_str() + from;
+        if (!strncmp(line, "{\"addr\":\"07:", 12)) {
+          size_t n = strtoul(line + 12, NULL, 16) - 1;
+          if (n < neighbors) latencies.push_back(now - sentAt[n]);
+          subscriber.updates++;
+        }
+        from = newline + 1;
+      }
+      subscriber.pending.erase(0, from);
+    }
+  }
+
+  daemon.stop();
+  loop.join();
+  double wall = (nowMs() - start) / 1000;
+  double cpu = cpuSeconds() - cpuBefore;
+  auto stats = daemon.getStats();
+
+  uint64_t updates = 0, bytes = 0;
+  for (auto& subscriber : subscribers) {
+    updates += subscriber.updates;
+    bytes += subscriber.bytes;
+    close(subscriber.fd);
+  }
+  for (int fd : slow) close(fd);
+  close(sender);
+  close(epoll);
+
+  printf("%zu subscribers (+%zu not reading), %zu neighbors, %.0f frames/s for %.1f s\n",
+         clientCount, slowCount, neighbors, rate, wall);
+  printf("frames sent %llu, received by daemon %llu", (unsigned long long)framesSent,
+         (unsigned long long)stats.frames);
+  if (receiverCount > 1) {
+    printf(" from %zu receivers (%llu sent, %.0f/s), duplicates %llu", receiverCount,
+           (unsigned long long)datagramsSent, datagramsSent / wall,
+           (unsigned long long)stats.duplicates);
+  }
+  printf("\n");
+  printf("updates delivered %llu (%.0f/s), %.1f MB (%.1f MB/s)\n", (unsigned long long)updates,
+         updates / wall, bytes / 1e6, bytes / 1e6 / wall);
+  printf("update latency ms: p50 %.1f, p99 %.1f, max %.1f\n", percentile(latencies, 0.5),
+         percentile(latencies, 0.99), percentile(latencies, 1.0));
+  printf("daemon: %llu wakeups, %llu batches, %llu lines, skipped %llu, resyncs %llu, "
+         "slow disconnects %llu\n",
+         (unsigned long long)stats.wakeups, (unsigned long long)stats.batches,
+         (unsigned long long)stats.updates, (unsigned long long)stats.batchesSkipped,
+         (unsigned long long)stats.resyncs, (unsigned long long)stats.slowDisconnects);
+  printf("cpu %.2f s (daemon and load generator), %.0f%% of one core\n", cpu, cpu / wall * 100);
+  return 0;
+}
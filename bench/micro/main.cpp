@@ -0,0 +1,390 @@
+/*
+  Microbenchmarks for the codec and FanetManager hot paths.
+
+  Prints one JSON object per benchmark with ns/op and heap allocations per op.
+
+  pio run -e bench_micro && .pio/build/bench_micro/program [--filter handleRx]
+*/
+#include <string.h>
+#include <new>
+
+#include "../benchmark.h"
+#include "etl/array.h"
+#include "etl/vector.h"
+#include "fanetFusion.h"
+#include "fanetManager.h"
+#include "fanetProximity.h"
+#include "fanetTrafficFeed.h"
+
+using namespace Fanet;
+
+typedef etl::array<uint8_t, FANET_MAX_PACKET_SIZE> Buffer;
+
+/// @brief Exposes the protected internals we want to time
+class BenchManager : public FanetManager {
+ public:
+  BenchManager() : FanetManager(Mac{0xFB, 0x0001}, 1) {}
+
+  /// @brief Starts over with an empty manager
+  void reset() {
+    this->~BenchManager();
+    new (this) BenchManager();
+    setForwardPolicy(policy);
+  }
+
+  using FanetManager::queueForwardFrame;
+  using FanetManager::txQueue;
+
+  // Deterministic, forwards anything weak enough
+  LegacyForwardPolicy policy;
+};
+
+Packet makePacket(const PacketPayload& payload, uint16_t device, bool forward = false) {
+  Packet packet;
+  packet.header.srcMac = Mac{0x07, device};
+  packet.header.shouldForward = forward;
+  packet.header.hasExtensionHeader = false;
+  packet.header.type = ((PacketPayloadBase*)&payload)->getType();
+  packet.payload = payload;
+  return packet;
+}
+
+Tracking makeTracking(float offset = 0) {
+  Tracking tracking;
+  tracking.location.latitude = 46.5f + offset;
+  tracking.location.longitude = 8.0f + offset;
+  tracking.altitude = 1500;
+  tracking.aircraftType = AircraftType::Paraglider;
+  tracking.onlineTracking = true;
+  tracking.speed = 35;
+  tracking.climbRate = -1.2f;
+  tracking.heading = 90;
+  return tracking;
+}
+
+struct Sample {
+  const char* name;
+  Packet packet;
+};
+
+/// @brief One packet of each supported payload type
+etl::array<Sample, 6> makeSamples() {
+  Name name;
+  name.name = "Scott O'Brien";
+  Message message;
+  strcpy(message.message, "Landed safely at the bottom of the valley, heading to the pub");
+  GroundTracking ground;
+  ground.location.latitude = 46.5f;
+  ground.location.longitude = 8.0f;
+  ground.type = GroundTrackingType::LandedWell;
+  ground.shouldTrackOnline = true;
+
+  Packet unicast = makePacket(makeTracking(), 2, true);
+  unicast.header.hasExtensionHeader = true;
+  ExtendedHeader ext;
+  ext.ackType = ExtendedHeaderAckType::Requested;
+  ext.includesSignature = false;
+  ext.destinationMac = Mac{0x07, 3};
+  unicast.extHeader = ext;
+
+  return {{{"ack", makePacket(Ack(), 1)},
+           {"tracking", makePacket(makeTracking(), 1)},
+           {"name", makePacket(name, 1)},
+           {"message", makePacket(message, 1)},
+           {"ground_tracking", makePacket(ground, 1)},
+           {"tracking_unicast", unicast}}};
+}
+
+void codecBenchmarks() {
+  char name[64];
+  for (auto& sample : makeSamples()) {
+    Buffer buffer = {0};
+    size_t size = sample.packet.encode(buffer);
+
+    snprintf(name, sizeof(name), "Packet::parse/%s", sample.name);
+    Bench::run(name, [&]() { Bench::doNotOptimize(Packet::parse(buffer, size)); });
+
+    snprintf(name, sizeof(name), "Packet::encode/%s", sample.name);
+    Buffer out;
+    Bench::run(name, [&]() { Bench::doNotOptimize(sample.packet.encode(out)); });
+  }
+}
+
+/// @brief Fills the neighbor table with a number of neighbors
+void addNeighbors(BenchManager& manager, size_t count, unsigned long ms) {
+  Buffer buffer = {0};
+  for (size_t i = 0; i < count; i++) {
+    size_t size = makePacket(makeTracking(i * 0.001f), 100 + i).encode(buffer);
+    manager.handleRx(buffer, size, ms, -100.0f, 5.0f);
+  }
+}
+
+void managerBenchmarks() {
+  char name[64];
+  const size_t occupancies[] = {1, 10, 60, FANET_MAX_NEIGHBORS};
+
+  for (auto occupancy : occupancies) {
+    // Tracking update from a neighbor we already know
+    static BenchManager manager;
+    manager.reset();
+    addNeighbors(manager, occupancy, 0);
+
+    etl::array<Buffer, 16> frames;
+    etl::array<size_t, 16> sizes;
+    for (size_t i = 0; i < frames.size(); i++) {
+      sizes[i] = makePacket(makeTracking(), 100 + i % occupancy).encode(frames[i]);
+    }
+
+    size_t next = 0;
+    snprintf(name, sizeof(name), "handleRx/known_neighbor/%zu", occupancy);
+    Bench::run(name, [&]() {
+      next = (next + 1) % frames.size();
+      Bench::doNotOptimize(manager.handleRx(frames[next], sizes[next], 1000, -100.0f, 5.0f));
+    });
+
+    // Forwarded frame, which is also queued for forwarding
+    for (size_t i = 0; i < frames.size(); i++) {
+      sizes[i] = makePacket(makeTracking(), 100 + i % occupancy, true).encode(frames[i]);
+    }
+    snprintf(name, sizeof(name), "handleRx/forward/%zu", occupancy);
+    Bench::run(
+        name, [&]() { manager.txQueue.clear(); },
+        [&]() {
+          next = (next + 1) % frames.size();
+          Bench::doNotOptimize(manager.handleRx(frames[next], sizes[next], 1000, -110.0f, 5.0f));
+        },
+        1);
+  }
+
+  // Tracking the application's interest filters turn away, on their position and type
+  {
+    static BenchManager manager;
+    manager.reset();
+    Location elsewhere = {47.5f, 8.0f};
+    manager.addInterest(InterestFilter::within(elsewhere, 5000.0f));
+    Buffer frame;
+    size_t size = makePacket(makeTracking(), 100).encode(frame);
+    Bench::run("handleRx/filtered/position", [&]() {
+      Bench::doNotOptimize(manager.handleRx(frame, size, 1000, -100.0f, 5.0f));
+    });
+    manager.clearInterests();
+    InterestFilter ground;
+    ground.types = InterestFilter::bit(PacketType::GroundTracking);
+    manager.addInterest(ground);
+    Bench::run("handleRx/filtered/type", [&]() {
+      Bench::doNotOptimize(manager.handleRx(frame, size, 1000, -100.0f, 5.0f));
+    });
+  }
+
+  // Positions shed under load, every frame taking far longer than the budget
+  {
+    static BenchManager manager;
+    manager.reset();
+    unsigned long micros = 0;
+    auto clock = [&micros]() { return micros += 1000; };
+    etl::delegate<unsigned long()> loadClock(clock);
+    manager.setLoadClock(loadClock);
+    manager.setLoadBudget(1, 1);
+    Buffer frame;
+    size_t size = makePacket(makeTracking(), 100).encode(frame);
+    for (unsigned long ms = 1; ms <= 4; ms++) manager.handleRx(frame, size, ms, -100.0f, 5.0f);
+    Bench::run("handleRx/shed/sampled", [&]() {
+      Bench::doNotOptimize(manager.handleRx(frame, size, 5, -100.0f, 5.0f));
+    });
+  }
+
+  // A stream of new neighbors into a full table, each evicting the least relevant
+  {
+    static BenchManager manager;
+    manager.reset();
+    addNeighbors(manager, FANET_MAX_NEIGHBORS, 0);
+    Buffer buffer = {0};
+    uint16_t device = 1000;
+    Bench::run("handleRx/new_neighbor/full", [&]() {
+      size_t size = makePacket(makeTracking(), device++).encode(buffer);
+      Bench::doNotOptimize(manager.handleRx(buffer, size, 1000, -100.0f, 5.0f));
+    });
+  }
+
+  // Flushing a full table
+  {
+    static BenchManager manager;
+    Bench::run(
+        "flushOldNeighborEntries/full_none_expired",
+        [&]() {
+          manager.reset();
+          addNeighbors(manager, FANET_MAX_NEIGHBORS, 0);
+        },
+        [&]() { manager.flushOldNeighborEntries(1000); }, 1);
+    Bench::run(
+        "flushOldNeighborEntries/full_all_expired",
+        [&]() {
+          manager.reset();
+          addNeighbors(manager, FANET_MAX_NEIGHBORS, 0);
+        },
+        [&]() { manager.flushOldNeighborEntries(FANET_NEIGHBOR_MAX_TIMEOUT + 1000); }, 1);
+  }
+
+  // Ranking a full table again, as when our position changes
+  {
+    static BenchManager manager;
+    manager.reset();
+    addNeighbors(manager, FANET_MAX_NEIGHBORS, 0);
+    RecencyEvictionPolicy recency;
+    RelevanceEvictionPolicy relevance;
+    bool flip = false;
+    Bench::run("setEvictionPolicy/full", [&]() {
+      flip = !flip;
+      if (flip) {
+        manager.setEvictionPolicy(recency);
+      } else {
+        manager.setEvictionPolicy(relevance);
+      }
+    });
+  }
+
+  // Forwarding with the tx queue, (or the packet pool it holds its frames in), already full
+  {
+    static BenchManager manager;
+    manager.reset();
+    addNeighbors(manager, 10, 0);
+    for (size_t i = 0; i < FANET_TX_QUEUE_DEPTH; i++) {
+      manager.queueForwardFrame(makePacket(makeTracking(i), 100, true), -110.0f, 1);
+    }
+
+    etl::vector<Packet, 16> forwards;
+    while (!forwards.full()) {
+      float offset = -1.0f - forwards.size();
+      forwards.push_back(makePacket(makeTracking(offset), 101, true));
+    }
+    size_t next = 0;
+    Bench::run("queueForwardFrame/full_queue", [&]() {
+      next = (next + 1) % forwards.size();
+      manager.queueForwardFrame(forwards[next], -110.0f, 1);
+    });
+
+    Bench::run("nextTxTime/full_queue",
+               [&]() { Bench::doNotOptimize(manager.nextTxTime(1)); });
+  }
+}
+
+void proximityBenchmarks() {
+  char name[64];
+  const size_t occupancies[] = {10, FANET_MAX_NEIGHBORS, 256};
+
+  for (auto occupancy : occupancies) {
+    // Aircraft scattered over a few km, flying in every direction, re-evaluated on each fix
+    static ProximityEngine<256> engine;
+    engine.clear();
+    MotionState own;
+    own.location = {46.5f, 8.0f};
+    own.altitude = 1500;
+    own.speed = 35;
+    for (size_t i = 0; i < occupancy; i++) {
+      MotionState state;
+      state.location = own.location.offsetBy((float)(i % 17) * 300 - 2400, (float)(i % 13) * 400);
+      state.altitude = 1000 + (i % 7) * 150;
+      state.speed = 25 + i % 30;
+      state.heading = (i * 37) % 360;
+      state.climbRate = (float)(i % 5) - 2;
+      engine.update(kNoProximity, 100 + i, state);
+    }
+
+    unsigned long ms = 0;
+    snprintf(name, sizeof(name), "ProximityEngine::evaluate/%zu", occupancy);
+    Bench::run(name, [&]() {
+      ms += 250;
+      Bench::doNotOptimize(engine.evaluate(own, ms % 20000));
+    });
+  }
+}
+
+void distanceBenchmarks() {
+  // Distances from us to a full neighbor table, one at a time and as a batch
+  static float latitudes[FANET_MAX_NEIGHBORS];
+  static float longitudes[FANET_MAX_NEIGHBORS];
+  static float distances[FANET_MAX_NEIGHBORS];
+  static Location locations[FANET_MAX_NEIGHBORS];
+  Location here = {46.5f, 8.0f};
+  for (size_t i = 0; i < FANET_MAX_NEIGHBORS; i++) {
+    locations[i] = here.offsetBy((float)(i % 17) * 900 - 7200, (float)(i % 13) * 1200 - 7200);
+    latitudes[i] = locations[i].latitude;
+    longitudes[i] = locations[i].longitude;
+  }
+
+  Bench::run("Location::distanceTo/table", [&]() {
+    for (size_t i = 0; i < FANET_MAX_NEIGHBORS; i++) distances[i] = here.distanceTo(locations[i]);
+    Bench::doNotOptimize(distances[0]);
+  });
+  Bench::run("squaredDistances/table", [&]() {
+    squaredDistances(here, latitudes, longitudes, FANET_MAX_NEIGHBORS, distances);
+    Bench::doNotOptimize(distances[0]);
+  });
+}
+
+void fusionBenchmarks() {
+  // Each frame reported by four receivers, a frame every 0.1ms, popped as their windows close
+  static FrameFusion<8192> fusion;
+  Buffer bytes;
+  size_t size = makePacket(Tracking(), 1).encode(bytes);
+  unsigned long tick = 0;
+  FusedFrame frame;
+  Bench::run("FrameFusion::add+pop/4 receivers", [&]() {
+    tick++;
+    memcpy(bytes.data() + 4, &tick, sizeof(tick));
+    for (uint8_t receiver = 0; receiver < 4; receiver++) {
+      fusion.add(receiver, bytes.data(), size, tick / 10, -100.0f - receiver, 2.0f);
+    }
+    while (fusion.pop(tick / 10, frame)) Bench::doNotOptimize(frame.rssi);
+  });
+}
+
+void trafficFeedBenchmarks() {
+  // A full table of aircraft each sending its position once a second, polled at 5 Hz over 115200
+  // baud: an op is a fifth of them moving and the poll that reports them
+  static Neighbor neighbors[FANET_MAX_NEIGHBORS];
+  Location here = {46.5f, 8.0f};
+  for (size_t i = 0; i < FANET_MAX_NEIGHBORS; i++) {
+    neighbors[i].address = Mac{0x0B, (uint16_t)i};
+    neighbors[i].location =
+        here.offsetBy((float)(i % 17) * 900 - 7200, (float)(i % 13) * 1200 - 7200);
+    neighbors[i].altitude = 1000 + i;
+    neighbors[i].speed = 35.0f;
+  }
+  MotionState own;
+  own.location = here;
+  own.altitude = 1200.0f;
+  static uint8_t buffer[4096];
+
+  static TrafficFeed<> feeds[] = {TrafficFeed<>(TrafficFormat::Nmea),
+                                  TrafficFeed<>(TrafficFormat::Gdl90)};
+  const char* names[] = {"TrafficFeed::poll/nmea", "TrafficFeed::poll/gdl90"};
+  for (size_t f = 0; f < 2; f++) {
+    auto& feed = feeds[f];
+    feed.setOwnship(own);
+    unsigned long ms = 0;
+    Bench::run(names[f], [&]() {
+      ms += 200;
+      for (size_t i = ms / 200 % 5; i < FANET_MAX_NEIGHBORS; i += 5) {
+        neighbors[i].locationMs = ms;
+        feed.neighborChanged(neighbors[i], false);
+      }
+      Bench::doNotOptimize(feed.poll(ms, buffer, sizeof(buffer)));
+    });
+    // Falling behind would show as reports put off for bandwidth
+    if (feed.getStats().deferred) {
+      fprintf(stderr, "%s: %u reports deferred\n", names[f], feed.getStats().deferred);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  Bench::init(argc, argv);
+  codecBenchmarks();
+  managerBenchmarks();
+  proximityBenchmarks();
+  distanceBenchmarks();
+  fusionBenchmarks();
+  trafficFeedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,429 @@
+#include "fanetSimulator.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace Fanet;
+using namespace Fanet::Sim;
+
+/// @brief A simulated device, a FanetManager with a radio flying a path
+struct Simulator::Node {
+  FanetManager manager;
+  LegacyForwardPolicy legacyPolicy;
+  FlightPath path;
+  Mac mac;
+  std::vector<size_t> ongoing;  // Receptions currently on the air at this node
+  unsigned long txUntil = 0;    // Transmitting until
+  uint32_t wakeGeneration = 0;
+  unsigned long wakeAt = 0;
+  bool wakeScheduled = false;
+
+  Node(const Mac& mac, uint32_t seed, const FlightPath& path) : path(path), mac(mac) {
+    manager.Begin(mac, seed);
+  }
+};
+
+unsigned long Fanet::Sim::RadioModel::airtimeMs(const size_t& length) const {
+  // Semtech LoRa time on air, explicit header with CRC
+  float symbol = (1 << spreadingFactor) / bandwidthKhz;
+  bool lowDataRate = symbol > 16.0f;
+  float preamble = (preambleSymbols + 4.25f) * symbol;
+  float payloadBits = 8.0f * length - 4.0f * spreadingFactor + 28 + 16;
+  float symbols = ceilf(payloadBits / (4.0f * (spreadingFactor - (lowDataRate ? 2 : 0))));
+  symbols = 8 + etl::max(symbols * (codingRate + 4), 0.0f);
+  return (unsigned long)ceilf(preamble + symbols * symbol);
+}
+
+float Fanet::Sim::RadioModel::meanRssi(const float& meters) const {
+  return txPowerDbm - pathLossAt1m - 10.0f * pathLossExponent * log10f(etl::max(meters, 1.0f));
+}
+
+Fanet::Sim::FlightPath::FlightPath(const MotionState& start, bool onGround, uint32_t seed,
+                                   const Location& center, const float& radiusMeters)
+    : current(start), ground(onGround), random(seed), center(center), radius(radiusMeters) {
+  heading = std::uniform_real_distribution<float>(0, 360)(random);
+  nextLeg();
+}
+
+void Fanet::Sim::FlightPath::nextLeg() {
+  std::uniform_int_distribution<unsigned long> duration(1000UL * 60, 1000UL * 300);
+  if (ground) {
+    leg = {duration(random), 0.0f, 0.0f, 0.0f};
+  } else if (std::uniform_int_distribution<int>(0, 1)(random)) {
+    // Thermal, circling either way
+    float turn = std::uniform_int_distribution<int>(0, 1)(random) ? 18.0f : -18.0f;
+    leg = {duration(random), 28.0f, turn, 2.0f};
+  } else {
+    // Glide, heading back towards the middle if we've drifted too far
+    if (current.location.distanceTo(center) > radius) {
+      float north = (center.latitude - current.location.latitude) * 111319.5f;
+      float east = (center.longitude - current.location.longitude) * 111319.5f *
+                   cosf(current.location.latitude * 0.01745329252f);
+      heading = fmodf(atan2f(east, north) / 0.01745329252f + 360.0f, 360.0f);
+    } else {
+      heading = fmodf(heading + std::uniform_real_distribution<float>(-60, 60)(random) + 360.0f,
+                      360.0f);
+    }
+    leg = {duration(random), 38.0f, 0.0f, -1.2f};
+  }
+  legEnd = current.ms + leg.durationMs;
+}
+
+void Fanet::Sim::FlightPath::advance(const unsigned long& ms) {
+  while (ms > current.ms) {
+    unsigned long step = etl::min(ms, legEnd) - current.ms;
+    heading = fmodf(heading + leg.turnRate * step / 1000.0f + 360.0f, 360.0f);
+    current.heading = lroundf(heading) % 360;
+    current.speed = leg.speed;
+    current.climbRate = leg.climbRate;
+    auto next = DeadReckoning::predict(current, current.ms + step);
+    current.location = next.location;
+    current.altitude = etl::max(next.altitude, 0.0f);
+    current.ms += step;
+    if (current.ms >= legEnd) nextLeg();
+  }
+}
+
+Fanet::Sim::Simulator::Simulator(const Scenario& scenario)
+    : scenario(scenario), random(scenario.seed), shadowing(0.0f, scenario.radio.shadowingDb) {
+  result.scenario = scenario;
+  latency.resize(scenario.deliveryWindowMs + 1);
+
+  std::uniform_real_distribution<float> offset(-scenario.areaMeters / 2, scenario.areaMeters / 2);
+  std::uniform_real_distribution<float> unit(0, 1);
+  nodes.reserve(scenario.nodes);
+  for (size_t i = 0; i < scenario.nodes; i++) {
+    bool ground = unit(random) < scenario.groundFraction;
+    MotionState start;
+    start.location = scenario.origin.offsetBy(offset(random), offset(random));
+    start.altitude = ground ? 500.0f : 1500.0f + unit(random) * 1500.0f;
+    FlightPath path(start, ground, scenario.seed * 7919 + i, scenario.origin,
+                    scenario.areaMeters / 2);
+
+    Mac mac;
+    mac.manufacturer = 0xFB - i / 0xFFFF;
+    mac.device = i % 0xFFFF + 1;
+    nodes.emplace_back(new Node(mac, scenario.seed ^ (uint32_t)(i * 2654435761u), path));
+    auto& node = *nodes.back();
+    node.manager.aircraftType = AircraftType::Paraglider;
+    if (ground) node.manager.setGroundType(GroundTrackingType::LandedWell);
+    if (scenario.policy == PolicyKind::Legacy) node.manager.setForwardPolicy(node.legacyPolicy);
+    node.manager.setCsmaMode(scenario.csma);
+    if (i == 0 && scenario.capturePath) {
+      captureFile = fopen(scenario.capturePath, "wb");
+      if (captureFile) {
+        capture = CaptureWriter(
+            CaptureWriter::Sink::create<Simulator, &Simulator::writeCapture>(*this));
+        node.manager.setCapture(&capture, 0);
+      }
+    }
+
+    // Spread out the GPS fixes, so not everyone is in lock step
+    schedule(std::uniform_int_distribution<unsigned long>(0, scenario.gpsIntervalMs - 1)(random),
+             EventType::Gps, i);
+  }
+}
+
+Fanet::Sim::Simulator::~Simulator() {
+  if (captureFile) fclose(captureFile);
+}
+
+void Fanet::Sim::Simulator::writeCapture(const uint8_t* data, const size_t& length) {
+  fwrite(data, 1, length, captureFile);
+}
+
+void Fanet::Sim::Simulator::schedule(const unsigned long& ms, const EventType& type,
+                                     const uint32_t& id, const uint32_t& generation) {
+  events.push_back({ms, seq++, type, id, generation});
+  std::push_heap(events.begin(), events.end(), std::greater<Event>());
+}
+
+RunResult Fanet::Sim::Simulator::run() {
+  auto started = std::chrono::steady_clock::now();
+
+  while (!events.empty()) {
+    std::pop_heap(events.begin(), events.end(), std::greater<Event>());
+    Event event = events.back();
+    events.pop_back();
+    if (event.ms > scenario.durationMs) break;
+    result.events++;
+
+    switch (event.type) {
+      case EventType::Gps:
+        gps(event.id, event.ms);
+        break;
+      case EventType::Wake:
+        if (event.generation == nodes[event.id]->wakeGeneration) {
+          nodes[event.id]->wakeScheduled = false;
+          wake(event.id, event.ms);
+        }
+        break;
+      case EventType::FrameEnd:
+        endFrame(event.id, event.ms);
+        break;
+    }
+
+    // Stop tracking deliveries of old frames
+    while (originExpired < originOrder.size() &&
+           originOrder[originExpired].first + scenario.deliveryWindowMs < event.ms) {
+      auto& expired = originOrder[originExpired++];
+      auto it = origins.find(expired.second);
+      if (it != origins.end() && it->second.ms == expired.first) origins.erase(it);
+    }
+    if (originExpired > 4096) {
+      originOrder.erase(originOrder.begin(), originOrder.begin() + originExpired);
+      originExpired = 0;
+    }
+  }
+
+  for (auto& node : nodes) result.totals += node->manager.getStats();
+  if (captureFile) nodes.front()->manager.captureStats(scenario.durationMs);
+
+  // Latency percentiles from the histogram
+  uint64_t count = 0;
+  double sum = 0;
+  for (size_t i = 0; i < latency.size(); i++) {
+    count += latency[i];
+    sum += (double)i * latency[i];
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < latency.size(); i++) {
+    seen += latency[i];
+    if (!result.latencyP50Ms && seen * 2 >= count) result.latencyP50Ms = i;
+    if (!result.latencyP95Ms && seen * 100 >= count * 95) result.latencyP95Ms = i;
+    if (!result.latencyP99Ms && seen * 100 >= count * 99) result.latencyP99Ms = i;
+  }
+  result.latencyMeanMs = count ? sum / count : 0;
+
+  result.wallSeconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  return result;
+}
+
+void Fanet::Sim::Simulator::gps(const uint32_t& id, const unsigned long& ms) {
+  auto& node = *nodes[id];
+  node.path.advance(ms);
+  auto& state = node.path.state();
+  node.manager.setPos(state.location.latitude, state.location.longitude,
+                      (uint32_t)state.altitude, ms, state.heading, state.climbRate, state.speed);
+  reschedule(id, ms);
+  schedule(ms + scenario.gpsIntervalMs, EventType::Gps, id);
+}
+
+void Fanet::Sim::Simulator::reschedule(const uint32_t& id, const unsigned long& ms) {
+  auto& node = *nodes[id];
+  auto next = node.manager.nextTxTime(ms);
+  if (!next.has_value()) return;
+
+  // Can't do anything until we've finished transmitting
+  unsigned long at = etl::max(etl::max(next.value(), ms), node.txUntil);
+  if (node.wakeScheduled && node.wakeAt <= at) return;
+  node.wakeGeneration++;
+  node.wakeScheduled = true;
+  node.wakeAt = at;
+  schedule(at, EventType::Wake, id, node.wakeGeneration);
+}
+
+void Fanet::Sim::Simulator::wake(const uint32_t& id, const unsigned long& ms) {
+  auto& node = *nodes[id];
+  auto next = node.manager.nextTxTime(ms);
+  if (next.has_value() && next.value() <= ms && node.txUntil <= ms) {
+    auto transmit = [&](const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                        const size_t& size) {
+      if (channelBusy(id)) return false;
+      startFrame(id, bytes, size, ms);
+      return true;
+    };
+    etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&)> tx(
+        transmit);
+    node.manager.doTx(ms, tx);
+  }
+  reschedule(id, ms);
+}
+
+bool Fanet::Sim::Simulator::channelBusy(const uint32_t& id) const {
+  for (auto reception : nodes[id]->ongoing) {
+    if (receptions[reception].rssi >= scenario.radio.carrierSenseDbm) return true;
+  }
+  return false;
+}
+
+uint64_t Fanet::Sim::Simulator::fingerprint(
+    const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes, const size_t& length) {
+  // FNV-1a, ignoring the forward bit so forwarded copies match the original
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= i == 0 ? (bytes[i] & ~0x40) : bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+void Fanet::Sim::Simulator::startFrame(const uint32_t& id,
+                                       const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                                       const size_t& length,
+                                       const unsigned long& ms) {
+  auto& node = *nodes[id];
+  auto& radio = scenario.radio;
+  unsigned long airtime = radio.airtimeMs(length);
+
+  uint32_t frameId;
+  if (freeFrames.empty()) {
+    frameId = frames.size();
+    frames.emplace_back();
+  } else {
+    frameId = freeFrames.back();
+    freeFrames.pop_back();
+  }
+  Frame& frame = frames[frameId];
+  frame.bytes = *bytes;
+  frame.length = length;
+  frame.sender = id;
+  frame.start = ms;
+  frame.end = ms + airtime;
+  frame.receptions.clear();
+
+  result.transmissions++;
+  result.airtimeMs += airtime;
+
+  // Half duplex, we can't hear anything while we're transmitting
+  node.txUntil = frame.end;
+  for (auto reception : node.ongoing) {
+    if (!receptions[reception].lost) {
+      receptions[reception].lost = true;
+      result.halfDuplexLosses++;
+    }
+  }
+
+  // Frames we originate are tracked to see who they get delivered to
+  Origin* origin = nullptr;
+  uint32_t src = ((uint32_t)(*bytes)[1] << 16) | (*bytes)[2] | ((uint32_t)(*bytes)[3] << 8);
+  if (length >= kHeaderLength && src == node.mac.toInt32()) {
+    result.originated++;
+    uint64_t fp = fingerprint(*bytes, length);
+    origin = &origins[fp];
+    *origin = Origin();
+    origin->ms = ms;
+    originOrder.push_back({ms, fp});
+  }
+
+  auto& from = node.path.state().location;
+  for (uint32_t i = 0; i < nodes.size(); i++) {
+    if (i == id) continue;
+    auto& receiver = *nodes[i];
+    float mean = radio.meanRssi(from.distanceTo(receiver.path.state().location));
+    if (origin && mean >= radio.sensitivityDbm) origin->intended.push_back(i);
+
+    float rssi = mean + shadowing(random);
+    if (rssi < radio.sensitivityDbm) continue;
+
+    size_t receptionId;
+    if (freeReceptions.empty()) {
+      receptionId = receptions.size();
+      receptions.emplace_back();
+    } else {
+      receptionId = freeReceptions.back();
+      freeReceptions.pop_back();
+    }
+    Reception& reception = receptions[receptionId];
+    reception = {frameId, i, rssi, false};
+
+    if (receiver.txUntil > ms) {
+      reception.lost = true;
+      result.halfDuplexLosses++;
+    }
+
+    // Overlapping frames collide, unless one is strong enough to capture the receiver
+    for (auto otherId : receiver.ongoing) {
+      auto& other = receptions[otherId];
+      if (!reception.lost && rssi < other.rssi + radio.captureDb) {
+        reception.lost = true;
+        result.collisions++;
+      }
+      if (!other.lost && other.rssi < rssi + radio.captureDb) {
+        other.lost = true;
+        result.collisions++;
+      }
+    }
+
+    receiver.ongoing.push_back(receptionId);
+    frame.receptions.push_back(receptionId);
+  }
+
+  if (origin) {
+    result.intended += origin->intended.size();
+    origin->delivered.resize(origin->intended.size());
+  }
+  schedule(frame.end, EventType::FrameEnd, frameId);
+}
+
+void Fanet::Sim::Simulator::endFrame(const uint32_t& frameId, const unsigned long& ms) {
+  Frame& frame = frames[frameId];
+  Packet packet;  // Each receiver parses into the same packet
+  for (auto receptionId : frame.receptions) {
+    Reception reception = receptions[receptionId];
+    auto& receiver = *nodes[reception.receiver];
+    auto& ongoing = receiver.ongoing;
+    ongoing.erase(std::find(ongoing.begin(), ongoing.end(), receptionId));
+    freeReceptions.push_back(receptionId);
+
+    if (reception.lost) continue;
+    result.receptions++;
+    // Radios report rssi in whole dBm and snr in quarter dB steps
+    float rssi = roundf(reception.rssi);
+    float snr = roundf((reception.rssi - scenario.radio.noiseFloorDbm) * 4) / 4;
+    if (receiver.manager.handleRx(frame.bytes, frame.length, ms, rssi, snr, packet)) {
+      delivered(reception.receiver, frame, ms);
+    }
+    reschedule(reception.receiver, ms);
+  }
+  freeFrames.push_back(frameId);
+}
+
+void Fanet::Sim::Simulator::delivered(const uint32_t& receiver, const Frame& frame,
+                                      const unsigned long& ms) {
+  auto it = origins.find(fingerprint(frame.bytes, frame.length));
+  if (it == origins.end()) return;
+  Origin& origin = it->second;
+
+  auto intended = std::lower_bound(origin.intended.begin(), origin.intended.end(), receiver);
+  if (intended != origin.intended.end() && *intended == receiver) {
+    size_t index = intended - origin.intended.begin();
+    if (origin.delivered[index]) return;
+    origin.delivered[index] = true;
+  } else {
+    if (std::find(origin.extended.begin(), origin.extended.end(), receiver) !=
+        origin.extended.end())
+      return;
+    origin.extended.push_back(receiver);
+    result.extended++;
+    return;
+  }
+
+  result.delivered++;
+  latency[etl::min(ms - origin.ms, (unsigned long)latency.size() - 1)]++;
+}
+
+std::vector<RunResult> Fanet::Sim::runParallel(const std::vector<Scenario>& scenarios,
+                                                unsigned threads) {
+  if (!threads) threads = etl::max(1U, std::thread::hardware_concurrency());
+  threads = etl::min(threads, (unsigned)scenarios.size());
+
+  std::vector<RunResult> results(scenarios.size());
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < scenarios.size(); i = next++) {
+      Simulator simulator(scenarios[i]);
+      results[i] = simulator.run();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < threads; i++) pool.emplace_back(worker);
+  for (auto& thread : pool) thread.join();
+  return results;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+/*
+  Deterministic discrete event network simulator for the native environment.
+
+  Runs many FanetManager nodes against a virtual clock, flying scripted paths, talking over a
+  shared LoRa channel with path loss, shadowing, half duplex radios and collisions between
+  frames whose time on air overlaps.  Runs are fully determined by their Scenario (including
+  the seed), so independent runs can be spread across cores.
+
+  Unlike the library itself, this is host tooling and uses the standard library freely.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "fanetDeadReckoning.h"
+#include "fanetManager.h"
+
+namespace Fanet {
+  namespace Sim {
+
+    /// @brief Radio and propagation model shared by all nodes
+    struct RadioModel {
+      float txPowerDbm = 14.0f;        // Transmit power
+      float pathLossAt1m = 31.2f;      // Free space path loss at 1m, 868MHz
+      float pathLossExponent = 2.6f;   // Log distance path loss exponent
+      float shadowingDb = 4.0f;        // Std deviation of per frame, per link fading
+      float sensitivityDbm = -121.0f;  // Weakest frame that can be decoded
+      float noiseFloorDbm = -114.0f;   // Noise floor, used to derive SNR
+      float captureDb = 6.0f;          // A frame this much stronger survives a collision
+      float carrierSenseDbm = -115.0f; // Channel is considered busy above this
+      uint8_t spreadingFactor = 7;
+      float bandwidthKhz = 250.0f;
+      uint8_t codingRate = 1;  // 4/5
+      uint8_t preambleSymbols = 8;
+
+      /// @brief LoRa time on air of a frame
+      /// @param length frame length in bytes
+      /// @return time on air in ms
+      unsigned long airtimeMs(const size_t& length) const;
+
+      /// @brief Mean received power at a distance
+      /// @param meters distance between nodes
+      /// @return rssi in dBm
+      float meanRssi(const float& meters) const;
+    };
+
+    /// @brief Forwarding policy the nodes use
+    enum class PolicyKind : uint8_t { Density, Legacy };
+
+    /// @brief Everything needed to reproduce a run
+    struct Scenario {
+      uint32_t seed = 1;
+      size_t nodes = 100;
+      unsigned long durationMs = 1000UL * 60 * 10;
+      float areaMeters = 20000.0f;        // Side of the square the nodes start in
+      float groundFraction = 0.1f;        // Fraction of nodes on the ground
+      unsigned long gpsIntervalMs = 1000;
+      unsigned long deliveryWindowMs = 5000;  // Deliveries later than this aren't counted
+      Location origin = {46.5f, 8.0f};
+      PolicyKind policy = PolicyKind::Density;
+      CsmaMode csma = CsmaMode::Exponential;
+      RadioModel radio;
+      const char* capturePath = nullptr;  // If set, the first node's capture is written here
+    };
+
+    /// @brief A leg of a scripted flight path
+    struct FlightLeg {
+      unsigned long durationMs;
+      float speed;      // km/h
+      float turnRate;   // deg/s, 0 for straight
+      float climbRate;  // m/s
+    };
+
+    /// @brief Scripted flight path, alternating glides and thermals.  Ground nodes stay put.
+    class FlightPath {
+     public:
+      FlightPath(const MotionState& start, bool onGround, uint32_t seed, const Location& center,
+                 const float& radiusMeters);
+
+      /// @brief Advances the path to a time
+      void advance(const unsigned long& ms);
+
+      const MotionState& state() const { return current; }
+      bool onGround() const { return ground; }
+
+     private:
+      void nextLeg();
+
+      MotionState current;
+      FlightLeg leg;
+      unsigned long legEnd = 0;
+      float heading = 0;
+      bool ground;
+      std::mt19937 random;
+      Location center;
+      float radius;
+    };
+
+    /// @brief Results of a single run
+    struct RunResult {
+      Scenario scenario;
+      double wallSeconds = 0;
+      uint64_t events = 0;
+      uint64_t transmissions = 0;     // Frames put on the air
+      uint64_t originated = 0;        // Frames put on the air by their source
+      uint64_t receptions = 0;        // Frames decoded by a receiver
+      uint64_t collisions = 0;        // Receptions lost to overlapping frames
+      uint64_t halfDuplexLosses = 0;  // Receptions lost as the receiver was transmitting
+      uint64_t intended = 0;          // Originated frames x nodes in range of the source
+      uint64_t delivered = 0;         // ...of which were delivered (directly or forwarded)
+      uint64_t extended = 0;          // Deliveries to nodes out of range, via forwards
+      double airtimeMs = 0;           // Total time on air of all transmissions
+      double latencyMeanMs = 0;
+      unsigned long latencyP50Ms = 0;
+      unsigned long latencyP95Ms = 0;
+      unsigned long latencyP99Ms = 0;
+      Stats totals;  // All nodes' stats, added up
+
+      double deliveryRatio() const { return intended ? (double)delivered / intended : 0; }
+      double speedup() const {
+        return wallSeconds > 0 ? scenario.durationMs / 1000.0 / wallSeconds : 0;
+      }
+      /// @brief Average fraction of time each node spends transmitting
+      double airtimePerNode() const {
+        return scenario.nodes ? airtimeMs / scenario.nodes / scenario.durationMs : 0;
+      }
+    };
+
+    /*
+    @brief Runs a single scenario
+    */
+    class Simulator {
+     public:
+      explicit Simulator(const Scenario& scenario);
+      ~Simulator();
+
+      /// @brief Runs the scenario to completion
+      RunResult run();
+
+     private:
+      enum class EventType : uint8_t { Gps, Wake, FrameEnd };
+
+      struct Event {
+        unsigned long ms;
+        uint64_t seq;
+        EventType type;
+        uint32_t id;          // Node, or frame for FrameEnd
+        uint32_t generation;  // Wake events are ignored if stale
+
+        bool operator>(const Event& other) const {
+          return ms != other.ms ? ms > other.ms : seq > other.seq;
+        }
+      };
+
+      struct Reception {
+        uint32_t frame;
+        uint32_t receiver;
+        float rssi;
+        bool lost;
+      };
+
+      struct Frame {
+        etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+        size_t length;
+        uint32_t sender;
+        unsigned long start;
+        unsigned long end;
+        std::vector<size_t> receptions;  // Index into receptions
+      };
+
+      struct Origin {
+        unsigned long ms;
+        std::vector<uint32_t> intended;  // Sorted receivers in range
+        std::vector<bool> delivered;
+        std::vector<uint32_t> extended;  // Receivers out of range reached by forwards
+      };
+
+      struct Node;
+
+      void schedule(const unsigned long& ms, const EventType& type, const uint32_t& id,
+                    const uint32_t& generation = 0);
+      void gps(const uint32_t& node, const unsigned long& ms);
+      void wake(const uint32_t& node, const unsigned long& ms);
+      void reschedule(const uint32_t& node, const unsigned long& ms);
+      bool channelBusy(const uint32_t& node) const;
+      void startFrame(const uint32_t& node,
+                      const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                      const size_t& length,
+                      const unsigned long& ms);
+      void endFrame(const uint32_t& frame, const unsigned long& ms);
+      void delivered(const uint32_t& receiver, const Frame& frame, const unsigned long& ms);
+      static uint64_t fingerprint(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+                                  const size_t& length);
+
+      Scenario scenario;
+      std::vector<std::unique_ptr<Node>> nodes;
+      std::vector<Event> events;  // Min heap
+      uint64_t seq = 0;
+      std::vector<Frame> frames;
+      std::vector<uint32_t> freeFrames;
+      std::vector<Reception> receptions;
+      std::vector<size_t> freeReceptions;
+      std::unordered_map<uint64_t, Origin> origins;
+      std::vector<std::pair<unsigned long, uint64_t>> originOrder;
+      size_t originExpired = 0;
+      std::vector<uint64_t> latency;  // Histogram, 1ms buckets
+      std::mt19937 random;
+      std::normal_distribution<float> shadowing;
+      RunResult result;
+      FILE* captureFile = nullptr;
+      CaptureWriter capture;
+      void writeCapture(const uint8_t* data, const size_t& length);
+    };
+
+    /// @brief Runs independent scenarios across a number of threads
+    /// @param scenarios scenarios to run
+    /// @param threads number of threads, 0 for one per core
+    /// @return results, in the same order as the scenarios
+    std::vector<RunResult> runParallel(const std::vector<Scenario>& scenarios,
+                                       unsigned threads = 0);
+
+  }  // namespace Sim
+}  // namespace Fanet
@@ -0,0 +1,128 @@
+/*
+  Runs the network simulator from the command line.
+
+  pio run -e sim && .pio/build/sim/program --nodes 1000 --seconds 600 --runs 8
+
+  Options:
+    --nodes N      Nodes per run (default 100)
+    --seconds S    Simulated seconds per run (default 600)
+    --area M       Side of the square the nodes start in, meters (default 20000)
+    --ground F     Fraction of nodes on the ground (default 0.1)
+    --runs R       Independent runs, each with its own seed (default 1)
+    --seed X       Seed of the first run (default 1)
+    --threads T    Threads to spread runs across (default one per core)
+    --policy P     Forwarding policy, density or legacy (default density)
+    --csma C       Back-off on a busy channel, exponential, persistent or fixed (default
+                   exponential)
+    --capture FILE Write the first node of the first run's capture to FILE, (see tools/replay)
+    --csv          Print results as csv
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fanetSimulator.h"
+
+using namespace Fanet;
+using namespace Fanet::Sim;
+
+static bool parseCsmaMode(const char* value, CsmaMode& mode) {
+  if (!strcmp(value, "exponential")) {
+    mode = CsmaMode::Exponential;
+  } else if (!strcmp(value, "persistent")) {
+    mode = CsmaMode::Persistent;
+  } else if (!strcmp(value, "fixed")) {
+    mode = CsmaMode::Fixed;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Scenario base;
+  size_t runs = 1;
+  unsigned threads = 0;
+  bool csv = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (!strcmp(arg, "--csv")) {
+      csv = true;
+      continue;
+    }
+    if (!strcmp(arg, "--nodes")) {
+      base.nodes = strtoul(value, NULL, 10);
+    } else if (!strcmp(arg, "--seconds")) {
+      base.durationMs = strtoul(value, NULL, 10) * 1000;
+    } else if (!strcmp(arg, "--area")) {
+      base.areaMeters = strtof(value, NULL);
+    } else if (!strcmp(arg, "--ground")) {
+      base.groundFraction = strtof(value, NULL);
+    } else if (!strcmp(arg, "--runs")) {
+      runs = strtoul(value, NULL, 10);
+    } else if (!strcmp(arg, "--seed")) {
+      base.seed = strtoul(value, NULL, 10);
+    } else if (!strcmp(arg, "--threads")) {
+      threads = strtoul(value, NULL, 10);
+    } else if (!strcmp(arg, "--policy")) {
+      base.policy = !strcmp(value, "legacy") ? PolicyKind::Legacy : PolicyKind::Density;
+    } else if (!strcmp(arg, "--csma")) {
+      if (!parseCsmaMode(value, base.csma)) {
+        fprintf(stderr, "Unknown --csma %s\n", value);
+        return 1;
+      }
+    } else if (!strcmp(arg, "--capture")) {
+      base.capturePath = value;
+    } else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+    i++;
+  }
+
+  std::vector<Scenario> scenarios;
+  for (size_t i = 0; i < runs; i++) {
+    scenarios.push_back(base);
+    scenarios.back().seed = base.seed + i;
+    if (i) scenarios.back().capturePath = nullptr;
+  }
+
+  auto results = runParallel(scenarios, threads);
+
+  if (csv) {
+    printf(
+        "seed,nodes,seconds,wall_s,speedup,events,tx,originated,forwarded,rx,collisions,"
+        "half_duplex,delivery_ratio,extended,latency_mean_ms,latency_p50_ms,latency_p95_ms,"
+        "latency_p99_ms,airtime_per_node,tx_failed,fwd_suppressed,fwd_min_rssi,"
+        "tracking_suppressed,pool_dropped,pool_peak\n");
+  } else {
+    printf("%6s %6s %8s %8s %8s %9s %9s %9s %8s %8s %9s %9s\n", "seed", "nodes", "speedup",
+           "tx", "fwd", "rx", "collide", "delivery", "lat p50", "lat p95", "airtime%",
+           "txFailed");
+  }
+
+  for (auto& r : results) {
+    auto& t = r.totals;
+    if (csv) {
+      printf("%u,%zu,%lu,%.3f,%.1f,%llu,%llu,%llu,%u,%llu,%llu,%llu,%.4f,%llu,%.1f,%lu,%lu,%lu,"
+             "%.5f,%u,%u,%u,%u,%u,%u\n",
+             r.scenario.seed, r.scenario.nodes, r.scenario.durationMs / 1000, r.wallSeconds,
+             r.speedup(), (unsigned long long)r.events, (unsigned long long)r.transmissions,
+             (unsigned long long)r.originated, t.forwarded, (unsigned long long)r.receptions,
+             (unsigned long long)r.collisions, (unsigned long long)r.halfDuplexLosses,
+             r.deliveryRatio(), (unsigned long long)r.extended, r.latencyMeanMs, r.latencyP50Ms,
+             r.latencyP95Ms, r.latencyP99Ms, r.airtimePerNode(), t.txFailed, t.fwdSuppressedDrp,
+             t.fwdMinRssiDrp, t.trackingSuppressed, t.rxPoolDrp + t.fwdPoolDrp + t.txPoolDrp,
+             t.packetPoolPeak);
+    } else {
+      printf("%6u %6zu %7.0fx %8llu %8u %9llu %9llu %8.1f%% %6lums %6lums %8.3f%% %9u\n",
+             r.scenario.seed, r.scenario.nodes, r.speedup(), (unsigned long long)r.transmissions,
+             t.forwarded, (unsigned long long)r.receptions, (unsigned long long)r.collisions,
+             r.deliveryRatio() * 100, r.latencyP50Ms, r.latencyP95Ms, r.airtimePerNode() * 100,
+             t.txFailed);
+    }
+  }
+  return 0;
+}
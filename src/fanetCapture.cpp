@@ -0,0 +1,154 @@
+#include "fanetCapture.h"
+#include <string.h>
+#include "etl/crc8_ccitt.h"
+
+using namespace Fanet;
+
+namespace {
+  void put16(uint8_t* to, const uint16_t& value) {
+    to[0] = value;
+    to[1] = value >> 8;
+  }
+
+  void put32(uint8_t* to, const uint32_t& value) {
+    put16(to, value);
+    put16(to + 2, value >> 16);
+  }
+
+  uint16_t get16(const uint8_t* from) { return from[0] | (from[1] << 8); }
+
+  uint32_t get32(const uint8_t* from) { return get16(from) | ((uint32_t)get16(from + 2) << 16); }
+
+  void putFloat(uint8_t* to, const float& value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put32(to, bits);
+  }
+
+  float getFloat(const uint8_t* from) {
+    uint32_t bits = get32(from);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+}  // namespace
+
+const int16_t Fanet::CaptureWriter::kTxDeferred;
+
+void Fanet::CaptureBegin::encode(uint8_t* to) const {
+  to[0] = version;
+  put32(to + 1, mac);
+  put32(to + 5, seed);
+}
+
+bool Fanet::CaptureBegin::parse(const uint8_t* from, const uint16_t& length, CaptureBegin& begin) {
+  if (length < kSize) return false;
+  begin.version = from[0];
+  begin.mac = get32(from + 1);
+  begin.seed = get32(from + 5);
+  return true;
+}
+
+void Fanet::CapturePosition::encode(uint8_t* to) const {
+  putFloat(to, lat);
+  putFloat(to + 4, lng);
+  put32(to + 8, alt);
+  put16(to + 12, heading);
+  putFloat(to + 14, climbRate);
+  putFloat(to + 18, speed);
+  to[22] = groundType;
+  to[23] = aircraftType;
+}
+
+bool Fanet::CapturePosition::parse(const uint8_t* from,
+                                   const uint16_t& length,
+                                   CapturePosition& position) {
+  if (length < kSize) return false;
+  position.lat = getFloat(from);
+  position.lng = getFloat(from + 4);
+  position.alt = get32(from + 8);
+  position.heading = get16(from + 12);
+  position.climbRate = getFloat(from + 14);
+  position.speed = getFloat(from + 18);
+  position.groundType = from[22];
+  position.aircraftType = from[23];
+  return true;
+}
+
+void Fanet::CaptureStats::encode(const uint32_t* counters, const size_t& count, uint8_t* to) {
+  for (size_t i = 0; i < count; i++) put32(to + i * 4, counters[i]);
+}
+
+uint32_t Fanet::CaptureStats::counter(const uint8_t* from, const size_t& index) {
+  return get32(from + index * 4);
+}
+
+bool Fanet::CaptureWriter::write(const CaptureRecordType& type,
+                                 const uint32_t& ms,
+                                 const int16_t& a,
+                                 const int16_t& b,
+                                 const uint8_t* body,
+                                 const uint16_t& length) {
+  if (!sink.is_valid()) return false;
+
+  uint8_t header[FANET_CAPTURE_HEADER_SIZE];
+  header[0] = FANET_CAPTURE_SYNC;
+  header[1] = (uint8_t)type;
+  put16(header + 2, length);
+  put32(header + 4, ms);
+  put16(header + 8, a);
+  put16(header + 10, b);
+
+  etl::crc8_ccitt crc(header + 1, header + 12);
+  crc.add(body, body + length);
+  header[12] = crc.value();
+
+  sink(header, sizeof(header));
+  if (length) sink(body, length);
+  records++;
+  bytes += sizeof(header) + length;
+  return true;
+}
+
+size_t Fanet::CaptureReader::validAt(const uint8_t* data,
+                                     const size_t& size,
+                                     const size_t& offset) {
+  if (offset + FANET_CAPTURE_HEADER_SIZE > size || data[offset] != FANET_CAPTURE_SYNC) return 0;
+
+  const uint8_t* header = data + offset;
+  size_t total = FANET_CAPTURE_HEADER_SIZE + get16(header + 2);
+  if (offset + total > size) return 0;
+
+  etl::crc8_ccitt crc(header + 1, header + 12);
+  crc.add(header + FANET_CAPTURE_HEADER_SIZE, header + total);
+  return crc.value() == header[12] ? total : 0;
+}
+
+size_t Fanet::CaptureReader::find(const uint8_t* data, const size_t& size, size_t from) {
+  for (; from < size; from++) {
+    if (validAt(data, size, from)) return from;
+  }
+  return size;
+}
+
+bool Fanet::CaptureReader::next(CaptureRecord& record) {
+  auto total = validAt(data, size, offset);
+  if (!total) {
+    // Resync on the next valid record
+    auto found = find(data, size, offset + 1);
+    skipped += (found < size ? found : size) - offset;
+    offset = found;
+    total = validAt(data, size, offset);
+    if (!total) return false;
+  }
+
+  const uint8_t* header = data + offset;
+  record.type = (CaptureRecordType)header[1];
+  record.length = get16(header + 2);
+  record.ms = get32(header + 4);
+  record.a = get16(header + 8);
+  record.b = get16(header + 10);
+  record.body = header + FANET_CAPTURE_HEADER_SIZE;
+  offset += total;
+  return true;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "etl/delegate.h"
+
+#define FANET_CAPTURE_VERSION 1
+#define FANET_CAPTURE_SYNC 0xFA
+#define FANET_CAPTURE_HEADER_SIZE 13
+
+namespace Fanet {
+
+  /*
+  A capture is an append-only stream of records, each a 13 byte header followed by a body:
+
+    0      sync (0xFA)
+    1      record type
+    2..3   body length (little endian)
+    4..7   ms the record was made at (little endian)
+    8..9   a, record specific (little endian)
+    10..11 b, record specific (little endian)
+    12     crc8 (ccitt) of bytes 1..11 and the body
+
+  The sync byte and crc let a reader find the next record boundary from any offset, so a
+  truncated or corrupt capture can still be read, and large captures can be split up.
+  Multi-byte values in bodies are little endian.
+  */
+  enum class CaptureRecordType : uint8_t {
+    Begin = 1,     // body: version (1), mac (4), random seed (4)
+    Rx = 2,        // a: rssi (0.01 dBm), b: snr (0.01 dB), body: raw frame
+    Tx = 3,        // a: 1 if sent, 0 if the channel was busy, body: raw frame.  Or a: 2 and
+                   // no body if the attempt was put off without trying the channel
+                   // (p-persistent CSMA)
+    Position = 4,  // body: lat, lng (float), alt (4), heading (2), climb, speed (float), ground
+                   // type, aircraft type
+    Send = 5,      // body: frame the application asked to send (sendPacket)
+    Stats = 6,     // body: counters (4 each), see CaptureStats
+  };
+
+  /// @brief Body of a Begin record, written when capturing starts
+  struct CaptureBegin {
+    uint8_t version = FANET_CAPTURE_VERSION;
+    uint32_t mac = 0;   // Our address
+    uint32_t seed = 0;  // What the random number generator was seeded with
+
+    static const uint16_t kSize = 9;
+    void encode(uint8_t* to) const;
+    static bool parse(const uint8_t* from, const uint16_t& length, CaptureBegin& begin);
+  };
+
+  /// @brief Body of a Position record, our position as given to the manager
+  struct CapturePosition {
+    float lat = 0.0f;
+    float lng = 0.0f;
+    uint32_t alt = 0;
+    int16_t heading = 0;
+    float climbRate = 0.0f;
+    float speed = 0.0f;
+    uint8_t groundType = kNotGround;  // Ground tracking type, or kNotGround
+    uint8_t aircraftType = 0;
+
+    static const uint8_t kNotGround = 0xFF;
+    static const uint16_t kSize = 24;
+    void encode(uint8_t* to) const;
+    static bool parse(const uint8_t* from, const uint16_t& length, CapturePosition& position);
+  };
+
+  /*
+  @brief Body of a Stats record, each of the manager's counters in kStatFields order, (see
+  fanetManager.h).  Counters are only ever added to the end of kStatFields, so a reader compares
+  those both versions have, and a body's length says how many it holds.
+  */
+  struct CaptureStats {
+    static void encode(const uint32_t* counters, const size_t& count, uint8_t* to);
+    static uint32_t counter(const uint8_t* from, const size_t& index);
+  };
+
+  /// @brief A record read from a capture.  The body points into the capture buffer.
+  struct CaptureRecord {
+    CaptureRecordType type;
+    uint32_t ms;
+    int16_t a;
+    int16_t b;
+    const uint8_t* body;
+    uint16_t length;
+  };
+
+  /*
+  @brief Writes capture records to a sink, (a file, flash log, serial port...)
+
+  The header and body of each record are handed to the sink in two calls, nothing is buffered.
+  */
+  class CaptureWriter {
+   public:
+    using Sink = etl::delegate<void(const uint8_t* data, const size_t& length)>;
+
+    CaptureWriter() {}
+    CaptureWriter(Sink sink) : sink(sink) {}
+
+    /// @brief Writes a record
+    /// @return false if there's no sink
+    bool write(const CaptureRecordType& type,
+               const uint32_t& ms,
+               const int16_t& a,
+               const int16_t& b,
+               const uint8_t* body,
+               const uint16_t& length);
+
+    /// @brief Records the start of a capture
+    void begin(const uint32_t& ms, const CaptureBegin& begin) {
+      uint8_t body[CaptureBegin::kSize];
+      begin.encode(body);
+      write(CaptureRecordType::Begin, ms, 0, 0, body, sizeof(body));
+    }
+
+    /// @brief Records a position update
+    void position(const uint32_t& ms, const CapturePosition& position) {
+      uint8_t body[CapturePosition::kSize];
+      position.encode(body);
+      write(CaptureRecordType::Position, ms, 0, 0, body, sizeof(body));
+    }
+
+    /// @brief Records a received frame
+    void rx(const uint32_t& ms,
+            const float& rssi,
+            const float& snr,
+            const uint8_t* frame,
+            const uint16_t& length) {
+      write(CaptureRecordType::Rx, ms, toHundredths(rssi), toHundredths(snr), frame, length);
+    }
+
+    /// @brief Records a transmit attempt and its outcome
+    void tx(const uint32_t& ms, const bool& sent, const uint8_t* frame, const uint16_t& length) {
+      write(CaptureRecordType::Tx, ms, sent ? 1 : 0, 0, frame, length);
+    }
+
+    /// @brief Records a transmit attempt put off without trying the channel, (it still took a
+    /// random choice, so replay has to make it too)
+    void deferred(const uint32_t& ms) {
+      write(CaptureRecordType::Tx, ms, kTxDeferred, 0, nullptr, 0);
+    }
+
+    /// @brief Records written, and their total size in bytes
+    uint32_t getRecords() const { return records; }
+    uint32_t getBytes() const { return bytes; }
+
+    static const int16_t kTxDeferred = 2;  // Tx record a, for deferred
+
+    static int16_t toHundredths(const float& value) {
+      return (int16_t)(value * 100.0f + (value < 0 ? -0.5f : 0.5f));
+    }
+
+   protected:
+    Sink sink;
+    uint32_t records = 0;
+    uint32_t bytes = 0;
+  };
+
+  /*
+  @brief Reads records from a capture held in memory (or mmap'd)
+
+  Bytes that aren't a valid record are skipped until the next one is found.
+  */
+  class CaptureReader {
+   public:
+    CaptureReader(const uint8_t* data, const size_t& size) : data(data), size(size) {}
+
+    /// @brief Reads the next record
+    /// @return false at the end of the capture
+    bool next(CaptureRecord& record);
+
+    /// @brief Offset of the next record in the capture
+    size_t getOffset() const { return offset; }
+
+    /// @brief Bytes that were skipped looking for a valid record
+    size_t getSkipped() const { return skipped; }
+
+    /// @brief Offset of the first valid record at or after from, or size if there are none
+    static size_t find(const uint8_t* data, const size_t& size, size_t from);
+
+    /// @brief If a valid record starts at offset, its total size (header and body), otherwise 0
+    static size_t validAt(const uint8_t* data, const size_t& size, const size_t& offset);
+
+   protected:
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+    size_t skipped = 0;
+  };
+}  // namespace Fanet
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include "fanetLinkQuality.h"
+#include "fanetPacket.h"
+
+// we keep the neighbors around for 5 minutes before timing them out.
+#ifndef FANET_NEIGHBOR_MAX_TIMEOUT
+#define FANET_NEIGHBOR_MAX_TIMEOUT 1000 * 60 * 5
+#endif
+
+#ifndef FANET_MAX_NEIGHBORS
+#define FANET_MAX_NEIGHBORS 120  // How many maximum neighbors we'll keep around
+#endif
+
+#ifndef FANET_TX_QUEUE_DEPTH
+#define FANET_TX_QUEUE_DEPTH 20  // How many packets can be sitting in the egress queue at one time
+#endif
+
+#ifndef FANET_PACKET_POOL_SIZE
+#define FANET_PACKET_POOL_SIZE \
+  10  // Packets queued to send, or held by the application, at once.  Up to 255
+#endif
+
+#ifndef FANET_CSMA_MIN
+#define FANET_CSMA_MIN \
+  20  // Wait a min of 20ms before trying to transmit again if the channel is busy
+#endif
+
+#ifndef FANET_CSMA_MAX
+#define FANET_CSMA_MAX \
+  40  // Wait a max of ms before trying to transmit again if the channel is busy
+#endif
+
+#ifndef FANET_MAX_SEND_AGE
+#define FANET_MAX_SEND_AGE \
+  800  // If a packet is older than this many ms, don't try and send it.  Assume too old.
+#endif
+
+#ifndef FANET_NEIGHBOR_EXPIRY_SLACK
+#define FANET_NEIGHBOR_EXPIRY_SLACK \
+  1000 * 10  // Neighbors may be kept this much longer, so expiries are done in fewer wake-ups
+#endif
+
+#ifndef FANET_FORWARD_MIN_DISTANCE_M
+#define FANET_FORWARD_MIN_DISTANCE_M \
+  1000.0f  // Senders nearer than this (m) have already reached nearly everyone our forward would
+#endif
+
+#ifndef FANET_FORWARD_MAX_LOCATION_AGE
+#define FANET_FORWARD_MAX_LOCATION_AGE \
+  1000 * 60  // Positions older than this (ms) aren't used to decide whether to forward
+#endif
+
+namespace Fanet {
+
+  /*
+  @brief Sizes and timing of a BasicFanetManager, and the payload types it handles
+
+  The defines above set the defaults.  To size a manager differently, (or drop payload types
+  it'll never see), derive from DefaultConfig and override what's needed:
+
+    struct TrackerConfig : Fanet::DefaultConfig {
+      static const size_t maxNeighbors = 16;
+      static const size_t txQueueDepth = 4;
+      static const size_t packetPoolSize = 4;
+      using Payload = etl::variant<Fanet::Ack, Fanet::Tracking, Fanet::GroundTracking>;
+    };
+    Fanet::BasicFanetManager<TrackerConfig> manager;
+
+  Managers with other configs need fanetManagerImpl.h included in (at least) one source file.
+  Frames of payload types a config leaves out still update the neighbor table, but their
+  payloads aren't parsed or forwarded, (the application only gets their headers).
+  */
+  struct DefaultConfig {
+    static const size_t maxNeighbors = FANET_MAX_NEIGHBORS;
+    static const size_t txQueueDepth = FANET_TX_QUEUE_DEPTH;
+    static const size_t packetPoolSize = FANET_PACKET_POOL_SIZE;
+    static const unsigned long neighborMaxTimeout = FANET_NEIGHBOR_MAX_TIMEOUT;
+    static const unsigned long neighborExpirySlack = FANET_NEIGHBOR_EXPIRY_SLACK;
+    static const unsigned long csmaMin = FANET_CSMA_MIN;
+    static const unsigned long csmaMax = FANET_CSMA_MAX;
+    static const unsigned long maxSendAge = FANET_MAX_SEND_AGE;
+    static constexpr float forwardMinDistance = FANET_FORWARD_MIN_DISTANCE_M;  // 0 to disable
+    static const unsigned long forwardMaxLocationAge = FANET_FORWARD_MAX_LOCATION_AGE;
+    static constexpr float linkMinScore = FANET_LINK_MIN_SCORE;  // 0 to forward to any neighbor
+    using Payload = PacketPayload;
+  };
+}  // namespace Fanet
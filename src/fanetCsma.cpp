@@ -0,0 +1,86 @@
+#include "fanetCsma.h"
+#include "etl/algorithm.h"
+
+using namespace Fanet;
+
+namespace {
+  const float kSmoothing = 0.25f;  // Weight of the latest window in the busy estimate
+  const uint8_t kMaxDoublings = 5;  // Exponential back-off windows stop growing after this
+}  // namespace
+
+void Fanet::Csma::heard(const unsigned long& ms, const size_t& size) {
+  roll(ms);
+  windowBusyMs += airtime(size);
+}
+
+void Fanet::Csma::attempted(const unsigned long& ms, const bool& busy) {
+  roll(ms);
+  stats.attempts++;
+  if (windowAttempts < UINT16_MAX) windowAttempts++;
+  if (busy) {
+    stats.busy++;
+    if (windowBusy < UINT16_MAX) windowBusy++;
+  }
+}
+
+void Fanet::Csma::sent(const uint8_t& retries) {
+  stats.retries[etl::min<size_t>(retries, stats.retries.size() - 1)]++;
+}
+
+bool Fanet::Csma::defer(etl::random_xorshift& random) {
+  if (mode != CsmaMode::Persistent) return false;
+
+  // Try the channel with probability p, which falls as it gets busier
+  float p = etl::max(FANET_CSMA_MIN_PERSISTENCE, 1.0f - ratio);
+  if (random.range(0, 999) < p * 1000) return false;
+  stats.deferred++;
+  return true;
+}
+
+unsigned long Fanet::Csma::backoff(const uint8_t& retries, etl::random_xorshift& random) const {
+  switch (mode) {
+    case CsmaMode::Fixed:
+      return random.range(min, max);
+
+    case CsmaMode::Exponential: {
+      // Double the window with every retry, and widen it by up to 4 times as the channel fills
+      unsigned long window = (max - min) << etl::min(retries, kMaxDoublings);
+      window = (unsigned long)(window * (1.0f + 3.0f * ratio));
+      return etl::min<unsigned long>(min + random.range(0, window), FANET_CSMA_MAX_BACKOFF);
+    }
+
+    case CsmaMode::Persistent:
+    default:
+      // A slot, (how often we try again is left to defer)
+      return random.range(min, max);
+  }
+}
+
+unsigned long Fanet::Csma::airtime(const size_t& size) {
+  // Semtech LoRa time on air, explicit header with CRC: 0.512 ms symbols, 12.25 symbol preamble,
+  // and 5 symbols for every 28 bits of payload, header and CRC
+  const unsigned long kSymbolUs = 512;
+  const unsigned long kPreambleUs = 6272;
+  unsigned long symbols = 8 + (8 * size + 16 + 27) / 28 * 5;
+  return (kPreambleUs + symbols * kSymbolUs + 999) / 1000;
+}
+
+void Fanet::Csma::roll(const unsigned long& ms) {
+  if (ms - windowStart < FANET_CSMA_WINDOW_MS) return;
+
+  // How busy the window was, judging by what we heard, or how often we found the channel busy,
+  // whichever is more
+  float heard = etl::min(1.0f, (float)windowBusyMs / FANET_CSMA_WINDOW_MS);
+  float found = windowAttempts ? (float)windowBusy / windowAttempts : 0.0f;
+  ratio += kSmoothing * (etl::max(heard, found) - ratio);
+
+  // Windows since, where nothing was heard or tried, were idle
+  unsigned long windows = (ms - windowStart) / FANET_CSMA_WINDOW_MS;
+  for (unsigned long i = 1; i < windows && ratio > 0.001f; i++) ratio -= kSmoothing * ratio;
+  if (windows > 1 && ratio <= 0.001f) ratio = 0.0f;
+
+  windowStart += windows * FANET_CSMA_WINDOW_MS;
+  windowBusyMs = 0;
+  windowAttempts = 0;
+  windowBusy = 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "etl/array.h"
+#include "etl/random.h"
+
+#ifndef FANET_CSMA_WINDOW_MS
+#define FANET_CSMA_WINDOW_MS \
+  1000  // How busy the channel is, is measured over windows this long (ms), then averaged
+#endif
+
+#ifndef FANET_CSMA_MAX_BACKOFF
+#define FANET_CSMA_MAX_BACKOFF \
+  1000  // Longest we'll wait (ms) after finding the channel busy, however many times we have
+#endif
+
+#ifndef FANET_CSMA_MIN_PERSISTENCE
+#define FANET_CSMA_MIN_PERSISTENCE \
+  0.1f  // p-persistent CSMA tries the channel with at least this probability, however busy
+#endif
+
+#ifndef FANET_CSMA_RETRY_BUCKETS
+#define FANET_CSMA_RETRY_BUCKETS 8  // Retry distribution buckets, the last counts anything more
+#endif
+
+namespace Fanet {
+
+  /// @brief How long to wait before trying the channel again, once it's been found busy
+  enum class CsmaMode : uint8_t {
+    Fixed,        // A uniform FANET_CSMA_MIN to FANET_CSMA_MAX, as the stm32 implementation does
+    Exponential,  // Binary exponential, the window doubling with each retry and widened the
+                  // busier the channel
+    Persistent,   // p-persistent, each attempt put off a slot with a probability that rises the
+                  // busier the channel
+  };
+
+  /// @brief Counters, read with Csma::getStats
+  struct CsmaStats {
+    uint32_t attempts = 0;  // Times the channel was tried
+    uint32_t busy = 0;      // Of those, found busy
+    uint32_t deferred = 0;  // Attempts put off without trying the channel, (p-persistent)
+    // Frames sent after finding the channel busy 0, 1, 2... times, the last counting any more
+    etl::array<uint32_t, FANET_CSMA_RETRY_BUCKETS> retries = {};
+  };
+
+  /*
+  @brief Carrier sense back-off, adapting to how busy the channel is
+
+  Nodes circling the same thermal hear the channel go quiet at the same moment, and with a fixed
+  20 to 40 ms retry window, pick retry times close enough to collide again.  Here the fraction
+  of time the channel is busy is estimated from the airtime of every frame we receive and the
+  fraction of our attempts that found it busy, (catching frames too weak to decode), averaged
+  over FANET_CSMA_WINDOW_MS windows.  The busier it is, the further apart retries are spread.
+
+  The FanetManager tells it of every frame it receives and every transmit attempt, and asks it
+  how long to wait.  Fixed makes the same random choices as before it was added.
+  */
+  class Csma {
+   public:
+    /// @param min Shortest back-off (ms), (Config::csmaMin)
+    /// @param max Longest back-off (ms) the first time the channel's found busy, (Config::csmaMax)
+    Csma(unsigned long min, unsigned long max) : min(min), max(max) {}
+
+    void setMode(const CsmaMode& mode) { this->mode = mode; }
+    CsmaMode getMode() const { return mode; }
+
+    /// @brief A frame was received, so the channel was busy while it was sent
+    void heard(const unsigned long& ms, const size_t& size);
+
+    /// @brief The channel was tried, to send a frame
+    /// @param busy If it was found busy
+    void attempted(const unsigned long& ms, const bool& busy);
+
+    /// @brief A frame was sent
+    /// @param retries Times the channel was found busy first
+    void sent(const uint8_t& retries);
+
+    /// @brief p-persistent CSMA puts some attempts off without trying the channel, (the others
+    /// never do)
+    /// @return true if this attempt should wait backoff() instead
+    bool defer(etl::random_xorshift& random);
+
+    /// @brief How long to wait (ms) before trying again
+    /// @param retries Times the frame has already found the channel busy
+    unsigned long backoff(const uint8_t& retries, etl::random_xorshift& random) const;
+
+    /// @brief Estimated fraction of the time the channel is busy, 0 to 1
+    float busyRatio() const { return ratio; }
+
+    /// @brief LoRa time on air (ms) of a frame, at FANET's SF7, 250 kHz and coding rate 4/5
+    static unsigned long airtime(const size_t& size);
+
+    const CsmaStats& getStats() const { return stats; }
+    void resetStats() { stats = CsmaStats(); }
+
+   protected:
+    /// @brief Folds the windows that have ended into the estimate
+    void roll(const unsigned long& ms);
+
+    unsigned long min;
+    unsigned long max;
+    CsmaMode mode = CsmaMode::Exponential;
+    float ratio = 0.0f;
+    unsigned long windowStart = 0;
+    unsigned long windowBusyMs = 0;
+    uint16_t windowAttempts = 0;
+    uint16_t windowBusy = 0;
+    CsmaStats stats;
+  };
+}  // namespace Fanet
@@ -0,0 +1,40 @@
+#include "fanetDeadReckoning.h"
+#include <math.h>
+
+using namespace Fanet;
+
+MotionState Fanet::DeadReckoning::predict(const MotionState& state, const unsigned long& ms) {
+  MotionState ret = state;
+  ret.ms = ms;
+  // Signed, so this still works when the clock wraps
+  long elapsed = (long)(ms - state.ms);
+  if (elapsed <= 0) {
+    return ret;
+  }
+
+  float seconds = elapsed / 1000.0f;
+  float distance = state.speed / 3.6f * seconds;
+  float heading = state.heading * kDegreesToRadians;
+  ret.location = state.location.offsetBy(distance * cosf(heading), distance * sinf(heading));
+  ret.altitude = state.altitude + state.climbRate * seconds;
+  return ret;
+}
+
+bool Fanet::DeadReckoning::shouldSend(const MotionState& current) const {
+  // Nothing sent yet, or we're configured to send everything
+  if (!lastSent.has_value() || maxError <= 0.0f) {
+    return true;
+  }
+
+  // Been quiet for too long, receivers will start to time us out
+  if (current.ms - lastSent.value().ms >= maxInterval) {
+    return true;
+  }
+
+  // Would a receiver's estimate of us be too far off?
+  auto estimate = predict(lastSent.value(), current.ms);
+  if (fabsf(estimate.altitude - current.altitude) > maxAltError) {
+    return true;
+  }
+  return estimate.location.distanceTo(current.location) > maxError;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include "etl/optional.h"
+#include "fanetLocation.h"
+
+#ifndef FANET_DR_MAX_ERROR_M
+#define FANET_DR_MAX_ERROR_M \
+  30.0f  // Send a new position if receivers' extrapolation is this many meters off
+#endif
+
+#ifndef FANET_DR_MAX_ALT_ERROR_M
+#define FANET_DR_MAX_ALT_ERROR_M \
+  15.0f  // Send a new position if receivers' extrapolated altitude is this many meters off
+#endif
+
+#ifndef FANET_DR_MAX_INTERVAL
+#define FANET_DR_MAX_INTERVAL \
+  1000 * 20  // Always send a position at least this often (ms), even if perfectly predicted
+#endif
+
+namespace Fanet {
+
+  /// @brief A position and the motion a receiver would extrapolate it with
+  struct MotionState {
+    Location location;
+    float altitude = 0.0f;   // meters
+    float speed = 0.0f;      // km/h
+    int heading = 0;         // degrees
+    float climbRate = 0.0f;  // m/s
+    unsigned long ms = 0;    // Time of the fix
+  };
+
+  /*
+  @brief Models what receivers estimate our position to be from our last sent tracking frame
+
+  Receivers can extrapolate our position from the last speed, heading and climb rate we sent.
+  Rather than sending on every GPS fix, we only need to send when that extrapolation drifts
+  too far from where we really are, or we've been quiet for too long.
+  */
+  class DeadReckoning {
+   public:
+    /// @brief Extrapolates a motion state forward in time
+    /// @param state last known state
+    /// @param ms time to extrapolate to
+    /// @return the estimated state at ms
+    static MotionState predict(const MotionState& state, const unsigned long& ms);
+
+    /// @brief Checks if our current state differs enough from what receivers estimate
+    /// @param current our current state
+    /// @return true if a new position should be sent
+    bool shouldSend(const MotionState& current) const;
+
+    /// @brief Records the state we have just sent, receivers will extrapolate from here
+    void sent(const MotionState& state) { lastSent = state; }
+
+    /// @brief Forgets the last sent state, forcing the next update to be sent
+    void reset() { lastSent = etl::nullopt; }
+
+    /// @brief Sets the thresholds to send position updates.  An error of 0 sends every update
+    /// @param maxError Max horizontal error in meters
+    /// @param maxAltError Max vertical error in meters
+    /// @param maxInterval Max time between position updates (ms)
+    void setThresholds(float maxError, float maxAltError, unsigned long maxInterval) {
+      this->maxError = maxError;
+      this->maxAltError = maxAltError;
+      this->maxInterval = maxInterval;
+    }
+
+    /// @brief Last state sent, if any
+    const etl::optional<MotionState>& getLastSent() const { return lastSent; }
+
+    /// @brief Max time between position updates (ms)
+    unsigned long getMaxInterval() const { return maxInterval; }
+
+   protected:
+    etl::optional<MotionState> lastSent;
+    float maxError = FANET_DR_MAX_ERROR_M;
+    float maxAltError = FANET_DR_MAX_ALT_ERROR_M;
+    unsigned long maxInterval = FANET_DR_MAX_INTERVAL;
+  };
+
+}  // namespace Fanet
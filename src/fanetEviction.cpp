@@ -0,0 +1,40 @@
+#include "fanetEviction.h"
+#include <math.h>
+#include "fanetNeighbor.h"
+
+using namespace Fanet;
+
+namespace {
+  /// @brief When a neighbor was last seen, in seconds since the epoch
+  float recency(const Neighbor& neighbor, const EvictionContext& us) {
+    return (int32_t)(neighbor.lastSeen - us.epoch) / 1000.0f;
+  }
+}  // namespace
+
+float Fanet::RecencyEvictionPolicy::score(const Neighbor& neighbor,
+                                          const EvictionContext& us) const {
+  return recency(neighbor, us);
+}
+
+float Fanet::RelevanceEvictionPolicy::score(const Neighbor& neighbor,
+                                            const EvictionContext& us) const {
+  float score = recency(neighbor, us);
+
+  // Closer, and nearer our height, is more relevant
+  float distance = neighbor.distance >= 0.0f ? neighbor.distance : FANET_EVICT_UNKNOWN_DISTANCE_M;
+  score -= distance / FANET_EVICT_METERS_PER_SECOND;
+  if (us.hasPosition && neighbor.altitude.has_value()) {
+    float separation = fabsf(neighbor.altitude.value() - us.altitude);
+    score -= separation / FANET_EVICT_VERTICAL_METERS_PER_SECOND;
+  }
+
+  // As is a neighbor we hear well, (so can reach with unicasts)
+  score += neighbor.link.score() * FANET_EVICT_LINK_SECONDS;
+
+  // And anyone calling for help
+  auto& groundType = neighbor.groundTrackingType;
+  if (groundType.has_value() && callsForHelp(groundType.value())) {
+    score += FANET_EVICT_EMERGENCY_SECONDS;
+  }
+  return score;
+}
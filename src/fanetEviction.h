@@ -0,0 +1,201 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "etl/array.h"
+
+#ifndef FANET_EVICT_METERS_PER_SECOND
+#define FANET_EVICT_METERS_PER_SECOND \
+  100.0f  // Each this many meters away counts against a neighbor as much as a second's silence
+#endif
+
+#ifndef FANET_EVICT_VERTICAL_METERS_PER_SECOND
+#define FANET_EVICT_VERTICAL_METERS_PER_SECOND \
+  25.0f  // Each this many meters above or below us counts as much as a second's silence
+#endif
+
+#ifndef FANET_EVICT_UNKNOWN_DISTANCE_M
+#define FANET_EVICT_UNKNOWN_DISTANCE_M \
+  10000.0f  // Neighbors whose distance we don't know are ranked as if this far away
+#endif
+
+#ifndef FANET_EVICT_LINK_SECONDS
+#define FANET_EVICT_LINK_SECONDS 60.0f  // A perfect link is worth this many seconds' recency
+#endif
+
+#ifndef FANET_EVICT_EMERGENCY_SECONDS
+#define FANET_EVICT_EMERGENCY_SECONDS \
+  1000000.0f  // Distress and medical calls are worth this much, (kept while anyone else can go)
+#endif
+
+namespace Fanet {
+
+  struct Neighbor;
+
+  const uint16_t kNoEviction = 0xFFFF;  // Not ranked in an EvictionQueue
+  // Scores are rebased once a neighbor's heard this long (ms) after the epoch they count from
+  const unsigned long kEvictionEpochSpan = 1000UL * 60 * 60 * 24;
+
+  /// @brief What a neighbor is ranked against
+  struct EvictionContext {
+    bool hasPosition = false;  // If we know where we are, (neighbors' distances are only known
+                               // if we do)
+    float altitude = 0.0f;     // Ours, meters
+    unsigned long epoch = 0;   // Recency is counted from this time (ms), so scores compare
+                               // across millis() wrapping
+  };
+
+  /*
+  @brief Ranks neighbors for eviction, when the neighbor table is full and another is heard
+
+  The neighbor with the lowest score is evicted.  Scores are kept in an EvictionQueue, and only
+  recalculated when a neighbor is heard from or our position changes, so they mustn't depend on
+  the time otherwise: rank recency by when a neighbor was last seen, not how long ago that was.
+  Count that from the context's epoch, (as a signed difference), not from when millis() began,
+  which it may have wrapped past, or which a restored neighbor may have been seen before.
+  */
+  class EvictionPolicy {
+   public:
+    virtual float score(const Neighbor& neighbor, const EvictionContext& us) const = 0;
+  };
+
+  /// @brief Evicts whoever we've heard from least recently
+  class RecencyEvictionPolicy : public EvictionPolicy {
+   public:
+    float score(const Neighbor& neighbor, const EvictionContext& us) const override;
+  };
+
+  /*
+  @brief Keeps the aircraft that matter most: those near us, at our height, well heard and heard
+  recently, and anyone calling for help
+
+  Scores are in seconds of recency: a neighbor heard a second later scores a point more, one
+  FANET_EVICT_METERS_PER_SECOND further away a point less.  So a quiet glider nearby outlasts a
+  ground station beaconing from far away.
+  */
+  class RelevanceEvictionPolicy : public EvictionPolicy {
+   public:
+    float score(const Neighbor& neighbor, const EvictionContext& us) const override;
+  };
+
+  /*
+  @brief Neighbors ordered by their eviction score, lowest first, in fixed memory
+
+  A binary heap of handles into SIZE entries.  Each neighbor keeps its handle, (as it does for
+  its track history), so changing its score or removing it is O(log n) with no lookup, and the
+  next to evict is found in O(1).
+  */
+  template <size_t SIZE>
+  class EvictionQueue {
+    static_assert(SIZE < kNoEviction, "Eviction handles are 16 bits");
+
+   public:
+    EvictionQueue() { clear(); }
+
+    /// @brief Sets an entry's score and puts it in order, O(log n)
+    /// @param handle Entry to change, or kNoEviction to add one
+    /// @param key What the entry is for, (a Mac::toInt32)
+    /// @return The entry's handle, kNoEviction if there was no room to add it
+    uint16_t update(uint16_t handle, const uint32_t& key, const float& score) {
+      handle = set(handle, key, score);
+      if (handle == kNoEviction) return handle;
+      size_t position = entries[handle].position;
+      if (!siftUp(position)) siftDown(position);
+      return handle;
+    }
+
+    /// @brief Sets an entry's score without putting it in order, for when every score changes.
+    /// Call reorder once they're set.
+    /// @return The entry's handle, kNoEviction if there was no room to add it
+    uint16_t set(uint16_t handle, const uint32_t& key, const float& score) {
+      if (handle == kNoEviction) {
+        if (!freeCount) return kNoEviction;
+        handle = free[--freeCount];
+        place(count++, handle);
+      }
+      entries[handle].key = key;
+      entries[handle].score = score;
+      return handle;
+    }
+
+    /// @brief Puts every entry back in order, O(n)
+    void reorder() {
+      for (size_t i = count / 2; i-- > 0;) siftDown(i);
+    }
+
+    /// @brief Removes an entry, O(log n)
+    void release(const uint16_t& handle) {
+      if (handle == kNoEviction) return;
+      size_t position = entries[handle].position;
+      free[freeCount++] = handle;
+      if (position == --count) return;
+      place(position, heap[count]);
+      if (!siftUp(position)) siftDown(position);
+    }
+
+    /// @brief The entry with the lowest score, O(1)
+    /// @return false if there are none
+    bool lowest(uint32_t& key) const {
+      if (!count) return false;
+      key = entries[heap[0]].key;
+      return true;
+    }
+
+    size_t size() const { return count; }
+
+    void clear() {
+      count = 0;
+      freeCount = SIZE;
+      for (size_t i = 0; i < SIZE; i++) free[i] = SIZE - 1 - i;
+    }
+
+   private:
+    struct Entry {
+      float score;
+      uint32_t key;
+      uint16_t position;  // In the heap
+    };
+
+    void place(const size_t& position, const uint16_t& handle) {
+      heap[position] = handle;
+      entries[handle].position = position;
+    }
+
+    bool before(const size_t& a, const size_t& b) const {
+      return entries[heap[a]].score < entries[heap[b]].score;
+    }
+
+    /// @return true if it moved
+    bool siftUp(size_t position) {
+      size_t start = position;
+      uint16_t handle = heap[position];
+      while (position > 0) {
+        size_t parent = (position - 1) / 2;
+        if (!(entries[handle].score < entries[heap[parent]].score)) break;
+        place(position, heap[parent]);
+        position = parent;
+      }
+      place(position, handle);
+      return position != start;
+    }
+
+    void siftDown(size_t position) {
+      uint16_t handle = heap[position];
+      while (true) {
+        size_t child = 2 * position + 1;
+        if (child >= count) break;
+        if (child + 1 < count && before(child + 1, child)) child++;
+        if (!(entries[heap[child]].score < entries[handle].score)) break;
+        place(position, heap[child]);
+        position = child;
+      }
+      place(position, handle);
+    }
+
+    etl::array<Entry, SIZE> entries;
+    etl::array<uint16_t, SIZE> heap;  // Handles, a min-heap on score
+    etl::array<uint16_t, SIZE> free;  // Free handles, the next to use last
+    size_t count = 0;
+    size_t freeCount = SIZE;
+  };
+}  // namespace Fanet
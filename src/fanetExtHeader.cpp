@@ -10,6 +10,7 @@ size_t ExtendedHeader::parse(etl::bit_stream_reader &reader)
     auto hasDestinationMac = reader.read_unchecked<uint8_t>(1U);
     auto hasSignature = reader.read_unchecked<uint8_t>(1U);
     reader.skip(4U); // Reserved bits
+    includesSignature = hasSignature;
 
     size_t size = 1;
 
@@ -35,8 +36,8 @@ size_t ExtendedHeader::encode(etl::bit_stream_writer &writer) const
     writer.write_unchecked<bool>((bool)destinationMac.has_value(), 1U);
     // Write signature flag.  Library does not support it, so will always be 0
     writer.write<uint8_t>(0, 1U);
-    writer.skip(4U); // Reserved bits
-    size_t size = 8;
+    writer.write_unchecked<uint8_t>(0, 4U); // Reserved bits
+    size_t size = 1;
 
     if (destinationMac.has_value())
     {
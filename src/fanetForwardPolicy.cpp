@@ -0,0 +1,100 @@
+#include "fanetForwardPolicy.h"
+#include "etl/algorithm.h"
+
+using namespace Fanet;
+
+ForwardVerdict Fanet::LegacyForwardPolicy::admit(TxSchedule& frame,
+                                                 [[maybe_unused]] const size_t& neighbors,
+                                                 etl::random_xorshift& random) {
+  if (frame.rssi > FANET_FORWARD_MAX_RSSI_DBM) {
+    // If this frame is significantly strong, assume little good we will be done
+    // forwarding it and drop it here.
+
+    // TODO:
+    // There could be a case where we have a lot more altitude than the sender, so,
+    // this is something to consider at a later time.  Perhaps if a message or ground
+    // based tracking message is received, we should still forward it anyway?
+    stats.rssiDrop++;
+    return ForwardVerdict::RssiDrop;
+  }
+
+  frame.sendAt = frame.rxTime + random.range(FANET_RXMIT_MIN, FANET_RXMIT_MAX);
+  stats.admitted++;
+  return ForwardVerdict::Forward;
+}
+
+ForwardVerdict Fanet::LegacyForwardPolicy::copyHeard(TxSchedule& queued,
+                                                     const float& rssi,
+                                                     const unsigned long& ms,
+                                                     etl::random_xorshift& random) {
+  stats.copiesHeard++;
+
+  // If this frame is 20dB stronger, assume it has been re-broadcast
+  // to our general direction and can be removed from the tx queue
+  if (rssi > queued.rssi + FANET_FORWARD_MIN_DB_BOOST) {
+    stats.boostCancel++;
+    return ForwardVerdict::RssiDrop;
+  }
+
+  // Adjust the new tx time in the hope that we'll still get a new one
+  // come in even stronger
+  queued.sendAt = ms + random.range(FANET_RXMIT_MIN, FANET_RXMIT_MAX);
+  return ForwardVerdict::Forward;
+}
+
+ForwardVerdict Fanet::DensityForwardPolicy::admit(TxSchedule& frame,
+                                                  const size_t& neighbors,
+                                                  etl::random_xorshift& random) {
+  if (frame.rssi > FANET_FORWARD_MAX_RSSI_DBM) {
+    // Heard strongly, the sender is close and everyone around us will have heard it too
+    stats.rssiDrop++;
+    return ForwardVerdict::RssiDrop;
+  }
+
+  // How far away the sender seems, from 0 (just under the max rssi) to 1 (very weak)
+  float weakness = etl::clamp(
+      (FANET_FORWARD_MAX_RSSI_DBM - frame.rssi) / FANET_FORWARD_RSSI_SPAN, 0.0f, 1.0f);
+
+  // How many times more neighbors we have than is needed to relay frames around us
+  float crowding = etl::max(1.0f, (float)neighbors / FANET_FORWARD_DENSITY_NEIGHBORS);
+
+  // With a lot of relays around, only a few of us need to forward this frame
+  float probability =
+      etl::clamp((0.5f + weakness) / crowding, FANET_FORWARD_MIN_PROBABILITY, 1.0f);
+  if (random.range(0, 999) >= probability * 1000) {
+    stats.randomDrop++;
+    return ForwardVerdict::Suppressed;
+  }
+
+  // Weak frames go first as forwarding them extends coverage the most.  When crowded, wait
+  // longer to give us a chance to hear others forward it before we do.
+  float window = (FANET_RXMIT_MAX - FANET_RXMIT_MIN) * (1.0f - weakness * 0.5f) *
+                 etl::min(crowding, FANET_FORWARD_MAX_BACKOFF_SCALE);
+  frame.sendAt = frame.rxTime + FANET_RXMIT_MIN + random.range(0, (uint32_t)window);
+  stats.admitted++;
+  return ForwardVerdict::Forward;
+}
+
+ForwardVerdict Fanet::DensityForwardPolicy::copyHeard(
+    TxSchedule& queued,
+    const float& rssi,
+    [[maybe_unused]] const unsigned long& ms,
+    [[maybe_unused]] etl::random_xorshift& random) {
+  stats.copiesHeard++;
+  if (queued.copiesHeard < UINT8_MAX) queued.copiesHeard++;
+
+  // A much stronger copy, someone closer to us has already forwarded it our way
+  if (rssi > queued.rssi + FANET_FORWARD_MIN_DB_BOOST) {
+    stats.boostCancel++;
+    return ForwardVerdict::RssiDrop;
+  }
+
+  // Enough relays have forwarded this around us, we'd only be adding to the noise
+  if (queued.copiesHeard >= FANET_FORWARD_MAX_COPIES) {
+    stats.copiesCancel++;
+    return ForwardVerdict::Suppressed;
+  }
+
+  // Keep our original slot and keep counting
+  return ForwardVerdict::Forward;
+}
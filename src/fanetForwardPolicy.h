@@ -0,0 +1,138 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "etl/random.h"
+#include "fanetTxPacket.h"
+
+#ifndef FANET_RXMIT_MIN
+#define FANET_RXMIT_MIN 10  // Min time (in ms) we should wait before rxmit'ing a packet
+#endif
+
+#ifndef FANET_RXMIT_MAX
+#define FANET_RXMIT_MAX 500  // Maximum time (in ms) we should wait before rxmit'ing a packet
+#endif
+
+#ifndef FANET_FORWARD_MIN_DB_BOOST
+#define FANET_FORWARD_MIN_DB_BOOST \
+  20.0f  // If a forwarded packet is boosted by this amount, don't rxmit
+#endif
+
+#ifndef FANET_FORWARD_MAX_RSSI_DBM
+#define FANET_FORWARD_MAX_RSSI_DBM -90.0f  // If a packet is received with this RSSI, don't forward
+#endif
+
+#ifndef FANET_FORWARD_DENSITY_NEIGHBORS
+#define FANET_FORWARD_DENSITY_NEIGHBORS \
+  10  // With more neighbors than this, forward less often and listen longer for copies
+#endif
+
+#ifndef FANET_FORWARD_MIN_PROBABILITY
+#define FANET_FORWARD_MIN_PROBABILITY \
+  0.1f  // No matter how crowded, forward at least this fraction of frames
+#endif
+
+#ifndef FANET_FORWARD_RSSI_SPAN
+#define FANET_FORWARD_RSSI_SPAN \
+  30.0f  // dB below FANET_FORWARD_MAX_RSSI_DBM at which a frame is considered far away
+#endif
+
+#ifndef FANET_FORWARD_MAX_COPIES
+#define FANET_FORWARD_MAX_COPIES \
+  2  // Cancel a queued forward once this many copies have been heard from other relays
+#endif
+
+#ifndef FANET_FORWARD_MAX_BACKOFF_SCALE
+#define FANET_FORWARD_MAX_BACKOFF_SCALE \
+  1.5f  // In crowded areas, stretch the rxmit window by up to this much to hear more copies
+#endif
+
+namespace Fanet {
+
+  /// @brief Outcome of a forwarding decision
+  enum class ForwardVerdict : uint8_t {
+    Forward,     // Forward the frame (or keep it queued)
+    RssiDrop,    // Don't forward, a strong enough signal means others have heard it
+    Suppressed,  // Don't forward, enough relays around already have, or will
+  };
+
+  /// @brief Counters kept by each forwarding policy
+  struct ForwardPolicyStats {
+    uint32_t admitted = 0;      // Frames queued to be forwarded
+    uint32_t rssiDrop = 0;      // Frames not forwarded as they were received too strongly
+    uint32_t randomDrop = 0;    // Frames not forwarded by chance, due to neighbor density
+    uint32_t copiesHeard = 0;   // Copies heard of frames we had queued to forward
+    uint32_t boostCancel = 0;   // Queued forwards cancelled on hearing a much stronger copy
+    uint32_t copiesCancel = 0;  // Queued forwards cancelled on hearing enough copies
+  };
+
+  /*
+  @brief Decides which received frames get forwarded, and when
+
+  The FanetManager asks its policy whether to forward each frame with the forward bit set,
+  and tells it whenever a copy of a frame it has queued to forward is overheard.
+  */
+  class ForwardPolicy {
+   public:
+    /// @brief Decides if a received frame should be forwarded.
+    /// @param frame Frame to forward.  sendAt should be set if it is to be forwarded
+    /// @param neighbors Number of neighbors currently in the neighbor table
+    /// @param random Random number generator
+    virtual ForwardVerdict admit(TxSchedule& frame,
+                                 const size_t& neighbors,
+                                 etl::random_xorshift& random) = 0;
+
+    /// @brief A copy of a frame we have queued to forward has been heard
+    /// @param queued Queued frame, sendAt may be adjusted
+    /// @param rssi Rssi of the copy
+    /// @param ms Current time
+    /// @param random Random number generator
+    /// @return Forward to keep the frame queued, otherwise the reason to cancel it
+    virtual ForwardVerdict copyHeard(TxSchedule& queued,
+                                     const float& rssi,
+                                     const unsigned long& ms,
+                                     etl::random_xorshift& random) = 0;
+
+    /// @brief Gets the counters for this policy
+    const ForwardPolicyStats& getStats() const { return stats; }
+
+    /// @brief Resets the counters for this policy
+    void resetStats() { stats = ForwardPolicyStats(); }
+
+   protected:
+    ForwardPolicyStats stats;
+  };
+
+  /// @brief Forwards anything not received too strongly, after a random delay.  Only cancels a
+  /// queued forward if a much stronger copy is heard.
+  class LegacyForwardPolicy : public ForwardPolicy {
+   public:
+    ForwardVerdict admit(TxSchedule& frame,
+                         const size_t& neighbors,
+                         etl::random_xorshift& random) override;
+    ForwardVerdict copyHeard(TxSchedule& queued,
+                             const float& rssi,
+                             const unsigned long& ms,
+                             etl::random_xorshift& random) override;
+  };
+
+  /*
+  @brief Forwards less the more neighbors there are, and cancels forwards others have made.
+
+  Each frame is forwarded with a probability that shrinks with the number of neighbors, and
+  grows the weaker (further away) the frame was heard, as that's where a forward extends
+  coverage the most.  Weak frames are also forwarded sooner.  Copies heard from other relays
+  during the back-off are counted, and the forward cancelled once enough have been heard.
+  */
+  class DensityForwardPolicy : public ForwardPolicy {
+   public:
+    ForwardVerdict admit(TxSchedule& frame,
+                         const size_t& neighbors,
+                         etl::random_xorshift& random) override;
+    ForwardVerdict copyHeard(TxSchedule& queued,
+                             const float& rssi,
+                             const unsigned long& ms,
+                             etl::random_xorshift& random) override;
+  };
+
+}  // namespace Fanet
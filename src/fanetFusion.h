@@ -0,0 +1,226 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "etl/array.h"
+#include "fanetPacket.h"
+
+#ifndef FANET_FUSION_WINDOW_MS
+#define FANET_FUSION_WINDOW_MS 200  // Wait this long (ms) for other receivers to report a frame
+#endif
+
+#ifndef FANET_FUSION_HOLD_MS
+#define FANET_FUSION_HOLD_MS \
+  2000  // Copies of a frame this long (ms) after it was first heard are still duplicates
+#endif
+
+namespace Fanet {
+
+  /// @brief A frame as heard by every receiver that reported it
+  struct FusedFrame {
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;  // As first reported
+    size_t size = 0;
+    unsigned long ms = 0;     // When it was first reported
+    float rssi = 0.0f;        // Best RSSI of any receiver
+    float snr = 0.0f;         // Best SNR of any receiver
+    uint8_t bestReceiver = 0; // Receiver with the best RSSI
+    uint8_t copies = 0;       // Copies reported, up to 255
+    uint32_t receivers = 0;   // Bit per receiver that reported it
+  };
+
+  /// @brief Counters, read with FrameFusion::getStats
+  struct FusionStats {
+    uint32_t frames = 0;      // Frames added, from every receiver
+    uint32_t fused = 0;       // Distinct frames popped
+    uint32_t duplicates = 0;  // Copies merged into a frame still in its window
+    uint32_t late = 0;        // Copies dropped as their frame had already been popped
+    uint32_t overflows = 0;   // Frames dropped as every slot held a frame still in its window
+  };
+
+  /*
+  @brief Merges the frames reported by a number of receivers into one stream
+
+  Receive only stations around a valley each hear most frames, so the same frame reaches a
+  central server several times with different RSSI and SNR.  Each copy is looked up by a
+  fingerprint of its bytes, (less the forward bit, so a repeat matches the frame it repeats),
+  and merged into the first: keeping the best RSSI and SNR and the set of receivers that heard
+  it.  A frame is popped once it's been FANET_FUSION_WINDOW_MS since it was first reported, and
+  copies up to FANET_FUSION_HOLD_MS after that are still recognised and dropped.
+
+  Frames are kept in a ring of FRAMES slots, in the order they were first reported, and found
+  through an open addressed index, so adding and popping are O(1).  FRAMES needs to hold
+  FANET_FUSION_HOLD_MS of distinct frames, (past that, the oldest are forgotten early).  Up to
+  32 receivers, numbered from 0.
+
+    fusion.add(receiver, bytes, size, ms, rssi, snr);
+    while (fusion.pop(ms, frame)) manager.handleRx(frame.bytes, frame.size, ms, frame.rssi,
+                                                   frame.snr);
+  */
+  template <size_t FRAMES>
+  class FrameFusion {
+   public:
+    /// @brief Adds a frame reported by a receiver
+    /// @param receiver Receiver that heard it, 0 to 31
+    /// @return true if it's a frame we didn't have, false if it was a copy, (or dropped)
+    bool add(const uint8_t& receiver,
+             const uint8_t* bytes,
+             const size_t& size,
+             const unsigned long& ms,
+             const float& rssi,
+             const float& snr) {
+      stats.frames++;
+      if (!size || size > FANET_MAX_PACKET_SIZE) return false;
+      forget(ms);
+
+      uint32_t hash = fingerprint(bytes, size);
+      size_t index = hash & kIndexMask;
+      for (; slots[index]; index = (index + 1) & kIndexMask) {
+        auto& entry = ring[slots[index] - 1];
+        if (entry.hash != hash || !same(entry.frame, bytes, size)) continue;
+        if (entry.popped) {
+          stats.late++;
+          return false;
+        }
+        merge(entry.frame, receiver, rssi, snr);
+        stats.duplicates++;
+        return false;
+      }
+
+      if (count == FRAMES) {
+        // Only frames already popped can be forgotten early
+        if (!ring[head].popped) {
+          stats.overflows++;
+          return false;
+        }
+        release();
+        // The slot found may have been moved up by the release, so find it again
+        for (index = hash & kIndexMask; slots[index]; index = (index + 1) & kIndexMask) {
+        }
+      }
+
+      size_t position = (head + count) % FRAMES;
+      auto& entry = ring[position];
+      entry.hash = hash;
+      entry.popped = false;
+      entry.home = hash & kIndexMask;
+      memcpy(entry.frame.bytes.data(), bytes, size);
+      entry.frame.size = size;
+      entry.frame.ms = ms;
+      entry.frame.rssi = rssi;
+      entry.frame.snr = snr;
+      entry.frame.bestReceiver = receiver;
+      entry.frame.copies = 1;
+      entry.frame.receivers = receiver < 32 ? 1UL << receiver : 0;
+      slots[index] = position + 1;
+      count++;
+      return true;
+    }
+
+    /// @brief Gets the next frame whose window has closed
+    /// @param ms Current time
+    /// @param frame Set to the frame, and its copies merged
+    /// @return false if no frame is due
+    bool pop(const unsigned long& ms, FusedFrame& frame) {
+      if (done == count) return false;
+      auto& entry = ring[(head + done) % FRAMES];
+      // Slots full of frames still in their window are popped early rather than dropped
+      if (ms - entry.frame.ms < FANET_FUSION_WINDOW_MS && count < FRAMES) return false;
+      entry.popped = true;
+      done++;
+      stats.fused++;
+      frame = entry.frame;
+      return true;
+    }
+
+    /// @brief When the next frame's window closes, so the caller can sleep until then
+    /// @return false if there are no frames waiting
+    bool nextPopTime(unsigned long& ms) const {
+      if (done == count) return false;
+      ms = ring[(head + done) % FRAMES].frame.ms + FANET_FUSION_WINDOW_MS;
+      return true;
+    }
+
+    /// @brief Frames waiting for their window to close
+    size_t waiting() const { return count - done; }
+
+    /// @brief Gets the counters
+    const FusionStats& getStats() const { return stats; }
+
+    /// @brief Fingerprint of a frame, (FNV-1a, less the forward bit)
+    static uint32_t fingerprint(const uint8_t* bytes, const size_t& size) {
+      uint32_t hash = (2166136261UL ^ (bytes[0] & ~kForwardBit)) * 16777619UL;
+      for (size_t i = 1; i < size; i++) hash = (hash ^ bytes[i]) * 16777619UL;
+      return hash;
+    }
+
+   protected:
+    static const uint8_t kForwardBit = 0x40;  // In the first byte of the header
+
+    /// @brief Smallest power of two at least twice FRAMES, so probes stay short
+    static constexpr size_t indexSize(size_t size = 1) {
+      return size >= 2 * FRAMES ? size : indexSize(size * 2);
+    }
+    static const size_t kIndexSize = indexSize();
+    static const size_t kIndexMask = kIndexSize - 1;
+
+    struct Entry {
+      FusedFrame frame;
+      uint32_t hash;
+      uint32_t home;  // Index slot the hash maps to
+      bool popped;
+    };
+
+    static bool same(const FusedFrame& frame, const uint8_t* bytes, const size_t& size) {
+      return frame.size == size && (frame.bytes[0] & ~kForwardBit) == (bytes[0] & ~kForwardBit) &&
+             !memcmp(frame.bytes.data() + 1, bytes + 1, size - 1);
+    }
+
+    static void merge(FusedFrame& frame,
+                      const uint8_t& receiver,
+                      const float& rssi,
+                      const float& snr) {
+      if (rssi > frame.rssi) {
+        frame.rssi = rssi;
+        frame.bestReceiver = receiver;
+      }
+      if (snr > frame.snr) frame.snr = snr;
+      if (frame.copies < UINT8_MAX) frame.copies++;
+      if (receiver < 32) frame.receivers |= 1UL << receiver;
+    }
+
+    /// @brief Forgets popped frames past their hold time
+    void forget(const unsigned long& ms) {
+      while (done && ms - ring[head].frame.ms >= FANET_FUSION_HOLD_MS) release();
+    }
+
+    /// @brief Removes the oldest frame, which must have been popped
+    void release() {
+      auto& entry = ring[head];
+      size_t index = entry.home;
+      while (slots[index] != head + 1) index = (index + 1) & kIndexMask;
+
+      // Move later entries of the probe sequence back into the gap, so lookups still find them
+      size_t gap = index;
+      for (index = (index + 1) & kIndexMask; slots[index]; index = (index + 1) & kIndexMask) {
+        size_t home = ring[slots[index] - 1].home;
+        if (((index - home) & kIndexMask) >= ((index - gap) & kIndexMask)) {
+          slots[gap] = slots[index];
+          gap = index;
+        }
+      }
+      slots[gap] = 0;
+
+      head = (head + 1) % FRAMES;
+      count--;
+      done--;
+    }
+
+    etl::array<Entry, FRAMES> ring;
+    etl::array<uint32_t, kIndexSize> slots = {};  // Ring position + 1 of each frame, 0 if free
+    size_t head = 0;     // Oldest frame
+    size_t count = 0;    // Frames in the ring
+    size_t done = 0;  // Of those, already popped, (the oldest ones)
+    FusionStats stats;
+  };
+}  // namespace Fanet
@@ -8,7 +8,7 @@ size_t Fanet::GroundTracking::parse(etl::bit_stream_reader& reader) {
   reader.skip(3U);  // Unused
   shouldTrackOnline = reader.read_unchecked<uint8_t>(1U);
 
-  return 56;
+  return 7;
 }
 
 size_t Fanet::GroundTracking::encode(etl::bit_stream_writer& writer) const {
@@ -17,9 +17,9 @@ size_t Fanet::GroundTracking::encode(etl::bit_stream_writer& writer) const {
 
   // Write the ground type
   writer.write_unchecked<uint8_t>((int)type, 4U);
-  writer.skip(3U);  // Unused
+  writer.write_unchecked<uint8_t>(0, 3U);  // Unused
   writer.write_unchecked<uint8_t>(shouldTrackOnline, 1U);
-  return 56;
+  return 7;
 }
 
 bool Fanet::GroundTracking::operator==(const PacketPayloadBase& other) const {
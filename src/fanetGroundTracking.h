@@ -37,6 +37,18 @@ namespace Fanet {
     ETL_END_ENUM_TYPE
   };
 
+  /// @brief If someone on the ground is calling for help, (medical help or distress)
+  inline bool callsForHelp(const GroundTrackingType& type) {
+    switch (type) {
+      case GroundTrackingType::NeedMedicalHelp:
+      case GroundTrackingType::DistressCall:
+      case GroundTrackingType::DistressCallAutomatically:
+        return true;
+      default:
+        return false;
+    }
+  }
+
   /*
                                                                  0
          7       6       5       4       3       2       1       0
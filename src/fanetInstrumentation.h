@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "etl/array.h"
+
+// Set to 1 to collect latency histograms and per type / per neighbor counters.  When 0, none
+// of the instrumentation is compiled in.
+#ifndef FANET_INSTRUMENTATION
+#define FANET_INSTRUMENTATION 0
+#endif
+
+#ifndef FANET_HISTOGRAM_SUB_BUCKET_BITS
+#define FANET_HISTOGRAM_SUB_BUCKET_BITS \
+  2  // Each power of two is split into 2^n buckets, (worst case error of 1/2^n)
+#endif
+
+#ifndef FANET_HISTOGRAM_MAX_BITS
+#define FANET_HISTOGRAM_MAX_BITS 24  // Values at or above 2^n are counted in the last bucket
+#endif
+
+#ifndef FANET_MAX_PENDING_ACKS
+#define FANET_MAX_PENDING_ACKS 4  // How many ack round trips we'll time at once
+#endif
+
+#ifndef FANET_ACK_TIMEOUT
+#define FANET_ACK_TIMEOUT 1000 * 10  // Stop waiting for an ack after this many ms
+#endif
+
+namespace Fanet {
+
+  /*
+  @brief Fixed memory histogram with log-linear buckets
+
+  Small values get a bucket each, then every power of two is split into a fixed number of
+  linear buckets, so the relative error is bounded no matter the magnitude.  Recording is a
+  couple of shifts and an increment.
+  */
+  class Histogram {
+   public:
+    static const uint8_t kSubBucketBits = FANET_HISTOGRAM_SUB_BUCKET_BITS;
+    static const uint32_t kSubBuckets = 1UL << kSubBucketBits;
+    static const size_t kBuckets =
+        kSubBuckets + (FANET_HISTOGRAM_MAX_BITS - kSubBucketBits) * kSubBuckets;
+
+    /// @brief Records a value
+    void record(uint32_t value) {
+      buckets[bucketOf(value)]++;
+      count++;
+      sum += value;
+      if (value > max) max = value;
+      if (value < min) min = value;
+    }
+
+    /// @brief Bucket a value is counted in
+    static size_t bucketOf(const uint32_t& value) {
+      if (value < kSubBuckets) return value;
+      uint8_t magnitude = 31 - __builtin_clz(value);
+      uint8_t shift = magnitude - kSubBucketBits;
+      size_t bucket = kSubBuckets + shift * kSubBuckets + ((value >> shift) - kSubBuckets);
+      return bucket < kBuckets ? bucket : kBuckets - 1;
+    }
+
+    /// @brief Smallest value counted in a bucket
+    static uint32_t lowerBound(const size_t& bucket) {
+      if (bucket < kSubBuckets * 2) return bucket;
+      uint8_t shift = bucket / kSubBuckets - 1;
+      return (uint32_t)(kSubBuckets + bucket % kSubBuckets) << shift;
+    }
+
+    /// @brief Value below which a fraction of the recorded values fall (an upper bound)
+    /// @param fraction from 0 to 1, (0.99 for the 99th percentile)
+    uint32_t percentile(const float& fraction) const {
+      if (!count) return 0;
+      uint32_t target = fraction * count;
+      uint32_t seen = 0;
+      for (size_t i = 0; i < kBuckets; i++) {
+        seen += buckets[i];
+        if (seen > target) {
+          uint32_t upper = i + 1 < kBuckets ? lowerBound(i + 1) - 1 : max;
+          return upper < max ? upper : max;
+        }
+      }
+      return max;
+    }
+
+    float mean() const { return count ? (float)sum / count : 0.0f; }
+
+    void reset() { *this = Histogram(); }
+
+    etl::array<uint32_t, kBuckets> buckets = {0};
+    uint32_t count = 0;
+    uint64_t sum = 0;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+  };
+
+  /// @brief Snapshot of what the FanetManager has been up to, when FANET_INSTRUMENTATION is set
+  struct Instrumentation {
+    Histogram rxProcessingUs;  // Time spent in handleRx, needs setInstrumentationClock
+    Histogram txDwellMs;       // Time from being queued (or received, if forwarded) until sent
+    Histogram txLatenessMs;    // How long after its sendAt time a frame went out
+    Histogram csmaRetries;     // Failed transmit attempts before a frame was sent
+    Histogram ackRoundTripMs;  // Time from sending a frame requesting an ack to the ack arriving
+    uint32_t ackTimeouts = 0;  // Acks we gave up waiting for
+    etl::array<uint32_t, 8> rxByType = {0};  // Frames received, indexed by PacketType
+    etl::array<uint32_t, 8> txByType = {0};  // Frames sent, indexed by PacketType
+  };
+
+}  // namespace Fanet
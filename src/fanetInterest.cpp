@@ -0,0 +1,110 @@
+#include "fanetInterest.h"
+#include <math.h>
+#include "etl/bit_stream.h"
+
+using namespace Fanet;
+
+bool Fanet::InterestPosition::peek(const PacketType& type,
+                                   const uint8_t* payload,
+                                   const size_t& length,
+                                   InterestPosition& position) {
+  // Both start with the location, (6 bytes), tracking then has its altitude and ground tracking
+  // its type
+  const size_t kLocationBytes = 6;
+  if (type != PacketType::Tracking && type != PacketType::GroundTracking) return false;
+  if (length < kLocationBytes + (type == PacketType::Tracking ? 2 : 1)) return false;
+
+  etl::bit_stream_reader reader((void*)payload, kLocationBytes, etl::endian::big);
+  position.location = Location::fromBitStream(reader);
+  if (type == PacketType::Tracking) {
+    // 11 bits, the 3 most significant in the low bits of the next byte, which also flags scaling
+    const uint8_t kScaled = 0x08;
+    int32_t altitude = payload[kLocationBytes] | (payload[kLocationBytes + 1] & 0x07) << 8;
+    if (payload[kLocationBytes + 1] & kScaled) altitude *= 4;
+    position.altitude = altitude;
+    position.groundType = etl::nullopt;
+  } else {
+    position.altitude = etl::nullopt;
+    position.groundType = (GroundTrackingType::enum_type)(payload[kLocationBytes] >> 4);
+  }
+  return true;
+}
+
+InterestFilter Fanet::InterestFilter::within(const Location& center, const float& radius) {
+  InterestFilter filter;
+  filter.area = InterestArea::Radius;
+  filter.center = center;
+  filter.radius = radius;
+  return filter;
+}
+
+InterestFilter Fanet::InterestFilter::inside(const Location& southWest,
+                                             const Location& northEast) {
+  InterestFilter filter;
+  filter.area = InterestArea::Box;
+  filter.southWest = southWest;
+  filter.northEast = northEast;
+  return filter;
+}
+
+bool Fanet::InterestFilter::matchesHeader(const PacketType& type, const uint32_t& source) const {
+  if (!(types & bit(type))) return false;
+  if (sources.empty()) return true;
+  for (auto address : sources) {
+    if (address == source) return true;
+  }
+  return false;
+}
+
+bool Fanet::InterestFilter::matchesPosition(const InterestPosition& position) const {
+  if (position.groundType.has_value() && !(groundTypes & bit(position.groundType.value()))) {
+    return false;
+  }
+
+  if ((minAltitude.has_value() || maxAltitude.has_value()) && !position.altitude.has_value()) {
+    return false;
+  }
+  if (minAltitude.has_value() && position.altitude.value() < minAltitude.value()) return false;
+  if (maxAltitude.has_value() && position.altitude.value() > maxAltitude.value()) return false;
+
+  if (area == InterestArea::Anywhere) return true;
+  if (!position.location.has_value()) return false;
+  auto& location = position.location.value();
+  if (area == InterestArea::Box) {
+    return location.latitude >= southWest.latitude && location.latitude <= northEast.latitude &&
+           location.longitude >= southWest.longitude && location.longitude <= northEast.longitude;
+  }
+  // Most traffic out of range is further north or south than the radius, which needs no trig
+  if (fabsf(location.latitude - center.latitude) * kMetersPerDegree > radius) return false;
+  return center.distanceTo(location) <= radius;
+}
+
+bool Fanet::Interests::add(const InterestFilter& filter) {
+  if (filters.full()) return false;
+  filters.push_back(filter);
+  return true;
+}
+
+uint8_t Fanet::Interests::matchHeader(const PacketType& type, const uint32_t& source) const {
+  uint8_t candidates = 0;
+  for (size_t i = 0; i < filters.size(); i++) {
+    if (filters[i].matchesHeader(type, source)) candidates |= 1 << i;
+  }
+  return candidates;
+}
+
+bool Fanet::Interests::needPosition(const uint8_t& candidates) const {
+  // A candidate that doesn't care where the frame's from matches it already
+  for (size_t i = 0; i < filters.size(); i++) {
+    if ((candidates & 1 << i) && !filters[i].needsPosition()) return false;
+  }
+  return candidates != 0;
+}
+
+bool Fanet::Interests::matchPosition(const uint8_t& candidates,
+                                     const InterestPosition& position) const {
+  for (size_t i = 0; i < filters.size(); i++) {
+    if ((candidates & 1 << i) && filters[i].matchesPosition(position)) return true;
+  }
+  return false;
+}
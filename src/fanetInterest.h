@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "etl/optional.h"
+#include "etl/vector.h"
+#include "fanetGroundTracking.h"
+#include "fanetHeader.h"
+#include "fanetLocation.h"
+
+#ifndef FANET_MAX_INTEREST_FILTERS
+#define FANET_MAX_INTEREST_FILTERS 4  // Interest filters a manager holds, (at most 8)
+#endif
+
+#ifndef FANET_INTEREST_MAX_SOURCES
+#define FANET_INTEREST_MAX_SOURCES 8  // Addresses an interest filter can be limited to
+#endif
+
+namespace Fanet {
+
+  /// @brief Where an interest filter's traffic can be
+  enum class InterestArea : uint8_t {
+    Anywhere,
+    Radius,  // Within radius meters of center
+    Box,     // Between southWest and northEast, (not crossing the antimeridian)
+  };
+
+  /// @brief What a frame says about where its sender is, read without parsing it
+  struct InterestPosition {
+    etl::optional<Location> location;
+    etl::optional<int32_t> altitude;  // meters
+    etl::optional<GroundTrackingType> groundType;
+
+    /// @brief Reads the location, (and altitude or ground tracking type), straight from the
+    /// payload bytes of a tracking or ground tracking frame
+    /// @return false if the frame has no position, (or is too short)
+    static bool peek(const PacketType& type,
+                     const uint8_t* payload,
+                     const size_t& length,
+                     InterestPosition& position);
+  };
+
+  /*
+  @brief Traffic the application wants to hear about
+
+  Every criterion set must match, and those left as they are match anything:
+
+    auto filter = Fanet::InterestFilter::within(here, 20000.0f);
+    filter.maxAltitude = 4000;
+    filter.types = Fanet::InterestFilter::bit(Fanet::PacketType::Tracking);
+    manager.addInterest(filter);
+
+  Area and altitude are judged from the frame's own position for tracking and ground tracking
+  frames, and from where its sender last was for other frames.  Traffic whose position isn't
+  known doesn't match a filter with an area or altitude band.  groundTypes only applies to ground
+  tracking frames, and to other frames from senders last heard on the ground.
+  */
+  struct InterestFilter {
+    static const uint8_t kAllTypes = 0xFF;
+    static const uint16_t kAllGroundTypes = 0xFFFF;
+
+    uint8_t types = kAllTypes;                                  // A bit for each PacketType
+    uint16_t groundTypes = kAllGroundTypes;                     // A bit for each GroundTrackingType
+    etl::vector<uint32_t, FANET_INTEREST_MAX_SOURCES> sources;  // Mac::toInt32, empty for any
+    InterestArea area = InterestArea::Anywhere;
+    Location center = {0.0f, 0.0f};
+    float radius = 0.0f;  // meters
+    Location southWest = {0.0f, 0.0f};
+    Location northEast = {0.0f, 0.0f};
+    etl::optional<int32_t> minAltitude;  // meters
+    etl::optional<int32_t> maxAltitude;
+
+    static uint8_t bit(const PacketType& type) { return 1 << (uint8_t)type; }
+    static uint16_t bit(const GroundTrackingType& type) { return 1 << (uint8_t)type; }
+
+    /// @brief Traffic within radius meters of center
+    static InterestFilter within(const Location& center, const float& radius);
+
+    /// @brief Traffic inside a latitude and longitude box
+    static InterestFilter inside(const Location& southWest, const Location& northEast);
+
+    /// @brief Checks what the header says: the frame's type and sender
+    bool matchesHeader(const PacketType& type, const uint32_t& source) const;
+
+    /// @brief If matching needs more than the header
+    bool needsPosition() const {
+      return area != InterestArea::Anywhere || minAltitude.has_value() ||
+             maxAltitude.has_value() || groundTypes != kAllGroundTypes;
+    }
+
+    /// @brief Checks where the frame's sender is
+    bool matchesPosition(const InterestPosition& position) const;
+  };
+
+  /*
+  @brief The interest filters a FanetManager checks received frames against
+
+  A frame is interesting if it matches any filter, (or there are none).  Filters are checked in
+  stages, so most frames are turned away as cheaply as possible: matchHeader right after the
+  header is read, and only the filters left are checked against the position.
+  */
+  class Interests {
+   public:
+    static_assert(FANET_MAX_INTEREST_FILTERS <= 8, "Candidate filters are tracked in a byte");
+
+    /// @return false if there's no room for another filter
+    bool add(const InterestFilter& filter);
+    void clear() { filters.clear(); }
+    bool empty() const { return filters.empty(); }
+    size_t size() const { return filters.size(); }
+
+    /// @brief Filters the header matches
+    /// @return A bit for each
+    uint8_t matchHeader(const PacketType& type, const uint32_t& source) const;
+
+    /// @brief If any of the candidate filters need the frame's position
+    bool needPosition(const uint8_t& candidates) const;
+
+    /// @brief If any of the candidate filters match the frame's position
+    bool matchPosition(const uint8_t& candidates, const InterestPosition& position) const;
+
+   protected:
+    etl::vector<InterestFilter, FANET_MAX_INTEREST_FILTERS> filters;
+  };
+}  // namespace Fanet
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifndef FANET_LINK_ALPHA
+#define FANET_LINK_ALPHA 0.25f  // Weight of each new sample in the link quality averages
+#endif
+
+#ifndef FANET_LINK_SNR_MIN
+#define FANET_LINK_SNR_MIN -10.0f  // SNR (dB) at or below which a link scores 0
+#endif
+
+#ifndef FANET_LINK_SNR_MAX
+#define FANET_LINK_SNR_MAX 10.0f  // SNR (dB) at or above which a link scores 1, less any loss
+#endif
+
+#ifndef FANET_LINK_MAX_GAP_LOSS
+#define FANET_LINK_MAX_GAP_LOSS \
+  4  // Most beacons a single gap is counted as missing, (the sender may just have gone quiet)
+#endif
+
+#ifndef FANET_LINK_MIN_SCORE
+#define FANET_LINK_MIN_SCORE 0.2f  // Only forward unicasts to neighbors with at least this score
+#endif
+
+namespace Fanet {
+
+  /*
+  @brief Estimates how well we hear a neighbor
+
+  RSSI and SNR are exponentially weighted averages, so a single faded frame doesn't swing them.
+  Fanet frames carry no sequence numbers, so losses are estimated from the gaps between a
+  neighbor's beacons, (its tracking frames): a gap of several usual intervals counts the beacons
+  that should have been in it as lost.  Senders that only send when their position can't be
+  predicted beacon irregularly, so each gap counts at most FANET_LINK_MAX_GAP_LOSS losses.
+  */
+  struct LinkQuality {
+    float rssi = 0.0f;            // Average RSSI (dBm)
+    float snr = 0.0f;             // Average SNR (dB)
+    float loss = 0.0f;            // Estimated fraction of beacons lost, 0 to 1
+    uint32_t beaconInterval = 0;  // Usual time between beacons (ms), 0 until we've heard two
+    uint8_t samples = 0;          // Frames heard, up to 255
+
+    /// @brief Adds the RSSI and SNR of a frame from the neighbor
+    void heard(const float& frameRssi, const float& frameSnr) {
+      if (!samples) {
+        rssi = frameRssi;
+        snr = frameSnr;
+      } else {
+        rssi += (frameRssi - rssi) * FANET_LINK_ALPHA;
+        snr += (frameSnr - snr) * FANET_LINK_ALPHA;
+      }
+      if (samples < UINT8_MAX) samples++;
+    }
+
+    /// @brief Adds a beacon from the neighbor
+    /// @param gap Time since its last beacon (ms)
+    void beacon(const unsigned long& gap) {
+      if (!gap) return;
+      if (!beaconInterval) {
+        beaconInterval = gap;
+        return;
+      }
+
+      // A gap of a couple of intervals or more had beacons in it we didn't hear
+      uint32_t missed = (gap + beaconInterval / 2) / beaconInterval;
+      missed = missed > 1 ? missed - 1 : 0;
+      if (missed > FANET_LINK_MAX_GAP_LOSS) missed = FANET_LINK_MAX_GAP_LOSS;
+      for (uint32_t i = 0; i < missed; i++) loss += (1.0f - loss) * FANET_LINK_ALPHA;
+      loss -= loss * FANET_LINK_ALPHA;
+
+      // Learn the interval from what the gap would have been without the losses
+      long interval = gap / (missed + 1);
+      beaconInterval += (long)((interval - (long)beaconInterval) * FANET_LINK_ALPHA);
+      if (!beaconInterval) beaconInterval = 1;
+    }
+
+    /// @brief How good the link is, from 0 (unusable) to 1, by SNR less the fraction lost
+    float score() const {
+      if (!samples) return 0.0f;
+      float quality = (snr - FANET_LINK_SNR_MIN) / (FANET_LINK_SNR_MAX - FANET_LINK_SNR_MIN);
+      quality = quality < 0.0f ? 0.0f : (quality > 1.0f ? 1.0f : quality);
+      return quality * (1.0f - loss);
+    }
+  };
+}  // namespace Fanet
@@ -0,0 +1,64 @@
+#include "fanetLoad.h"
+#include <string.h>
+
+using namespace Fanet;
+
+void Fanet::LoadController::setBudget(const unsigned long& budgetUs,
+                                      const unsigned long& windowMs) {
+  this->budgetUs = budgetUs;
+  this->windowMs = windowMs ? windowMs : 1;
+  reset();
+}
+
+void Fanet::LoadController::roll(const unsigned long& ms) {
+  if (!started) {
+    started = true;
+    windowStart = ms;
+    return;
+  }
+  if (ms < windowStart + windowMs) return;
+  unsigned long windows = (ms - windowStart) / windowMs;
+  windowStart += windows * windowMs;
+
+  // The window that's just ended
+  if (budgetUs && used > budgetUs) {
+    if (level != LoadLevel::SampleTracking) level = (LoadLevel)((uint8_t)level + 1);
+    calm = 0;
+  } else if (used * 100 < budgetUs * FANET_LOAD_RELEASE_PERCENT) {
+    calm++;
+  } else {
+    calm = 0;
+  }
+  used = 0;
+
+  // And any since, that nothing was received in
+  calm += windows - 1;
+  while (calm >= FANET_LOAD_HOLD_WINDOWS && level != LoadLevel::Normal) {
+    level = (LoadLevel)((uint8_t)level - 1);
+    calm -= FANET_LOAD_HOLD_WINDOWS;
+  }
+  if (level == LoadLevel::Normal) calm = 0;
+}
+
+bool Fanet::LoadController::defer(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+                                  const size_t& size,
+                                  const float& rssi,
+                                  const float& snr) {
+  bool room = !deferred.full();
+  if (!room) deferred.pop_front();
+  deferred.emplace_back();
+  auto& frame = deferred.back();
+  memcpy(frame.bytes.data(), bytes.data(), size);
+  frame.size = size;
+  frame.rssi = rssi;
+  frame.snr = snr;
+  return room;
+}
+
+void Fanet::LoadController::reset() {
+  level = LoadLevel::Normal;
+  started = false;
+  used = 0;
+  calm = 0;
+  deferred.clear();
+}
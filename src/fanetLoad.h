@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "etl/array.h"
+#include "etl/deque.h"
+#include "etl/delegate.h"
+#include "fanetHeader.h"
+#include "fanetPacket.h"
+
+#ifndef FANET_LOAD_BUDGET_US
+#define FANET_LOAD_BUDGET_US 20000  // Time (us) rx processing may take in each window
+#endif
+
+#ifndef FANET_LOAD_WINDOW_MS
+#define FANET_LOAD_WINDOW_MS 100  // The loop period (ms) the budget is measured over
+#endif
+
+#ifndef FANET_LOAD_RELEASE_PERCENT
+#define FANET_LOAD_RELEASE_PERCENT \
+  50  // Shedding eases a step once rx processing takes less than this much of the budget...
+#endif
+
+#ifndef FANET_LOAD_HOLD_WINDOWS
+#define FANET_LOAD_HOLD_WINDOWS 5  // ... for this many windows in a row
+#endif
+
+#ifndef FANET_LOAD_SAMPLE_MS
+#define FANET_LOAD_SAMPLE_MS \
+  5000  // When sampling, each neighbor's position is handled no more often than this (ms)
+#endif
+
+#ifndef FANET_LOAD_DEFER_DEPTH
+#define FANET_LOAD_DEFER_DEPTH 4  // Name and message frames kept to parse once the load eases
+#endif
+
+namespace Fanet {
+
+  /// @brief How much received traffic is being shed, each level shedding what those before it do
+  enum class LoadLevel : uint8_t {
+    Normal,          // Everything handled
+    ShedForwards,    // Names, services, landmarks and remote config aren't forwarded
+    DeferParsing,    // Names and messages, (unless to forward), are kept, unparsed, to handle
+                     // once the load eases
+    SampleTracking,  // Each neighbor's position is only handled every FANET_LOAD_SAMPLE_MS
+  };
+
+  /// @brief A frame kept, as it was received, to handle once the load eases
+  struct DeferredFrame {
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    size_t size;
+    float rssi;
+    float snr;
+  };
+
+  /*
+  @brief Measures the time spent handling received frames against a budget, and sheds load in
+  steps when it runs over
+
+  With a hundred aircraft in range, a slow MCU can spend its whole loop in handleRx and still
+  fall behind, sending its own position late and dropping frames in the radio's ISR.  Each
+  window of FANET_LOAD_WINDOW_MS that rx processing takes more than its budget, the level rises a
+  step.  It eases a step each FANET_LOAD_HOLD_WINDOWS windows in a row it takes under
+  FANET_LOAD_RELEASE_PERCENT of the budget, so it doesn't flap as shedding brings the cost down.
+
+  Nothing's measured, (or shed), without a microsecond clock.  Frames addressed to us, acks and
+  calls for help are never shed, and neither is anything we send.
+  */
+  class LoadController {
+   public:
+    /// @param budgetUs Time rx processing may take in each window, 0 to never shed
+    /// @param windowMs Window length, (typically the loop period)
+    void setBudget(const unsigned long& budgetUs, const unsigned long& windowMs);
+
+    /// @brief Sets a microsecond clock (typically micros())
+    void setClock(const etl::delegate<unsigned long()>& micros) { clock = micros; }
+
+    bool measuring() const { return clock.is_valid() && budgetUs; }
+    unsigned long now() const { return clock.is_valid() ? clock() : 0; }
+
+    /// @brief Charges time spent handling a frame to the current window
+    void spent(const unsigned long& ms, const unsigned long& us) {
+      roll(ms);
+      used += us;
+    }
+
+    /// @brief Closes any windows that have ended, stepping the level up or down
+    void roll(const unsigned long& ms);
+
+    LoadLevel getLevel() const { return level; }
+
+    /// @brief If a type's forwards are shed first
+    static bool lowPriority(const PacketType& type) {
+      return type == PacketType::Name || type == PacketType::Service ||
+             type == PacketType::Landmarks || type == PacketType::RemoteConfig;
+    }
+
+    /// @brief Keeps a frame to handle later
+    /// @return false if the oldest kept frame was dropped to make room
+    bool defer(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+               const size_t& size,
+               const float& rssi,
+               const float& snr);
+
+    /// @brief Frames kept, oldest first
+    etl::deque<DeferredFrame, FANET_LOAD_DEFER_DEPTH>& getDeferred() { return deferred; }
+    const etl::deque<DeferredFrame, FANET_LOAD_DEFER_DEPTH>& getDeferred() const {
+      return deferred;
+    }
+
+    void reset();
+
+   private:
+    etl::delegate<unsigned long()> clock;
+    unsigned long budgetUs = FANET_LOAD_BUDGET_US;
+    unsigned long windowMs = FANET_LOAD_WINDOW_MS;
+
+    LoadLevel level = LoadLevel::Normal;
+    bool started = false;
+    unsigned long windowStart = 0;
+    unsigned long used = 0;  // us, in the current window
+    uint32_t calm = 0;       // Windows in a row under the release threshold
+
+    etl::deque<DeferredFrame, FANET_LOAD_DEFER_DEPTH> deferred;
+  };
+}  // namespace Fanet
@@ -1,11 +1,8 @@
 #include "fanetLocation.h"
+#include <math.h>
 
 using namespace Fanet;
 
-
-const float kLatitudeScaling = 93206;
-const float kLongitudeScaling = 46603;
-
 Location Location::fromBitStream(etl::bit_stream_reader &reader)
 {
     auto ret = Location();
@@ -24,3 +21,34 @@ void Location::toBitStream(etl::bit_stream_writer &writer) const
     etl::write_unchecked(writer, lat_i, 24U);
     etl::write_unchecked(writer, lon_i, 24U);
 }
+
+float Location::distanceTo(const Location &other) const
+{
+    float dLat = (other.latitude - latitude) * kMetersPerDegree;
+    float dLng = (other.longitude - longitude) * kMetersPerDegree *
+                 cosf((latitude + other.latitude) * 0.5f * kDegreesToRadians);
+    return sqrtf(dLat * dLat + dLng * dLng);
+}
+
+void Fanet::squaredDistances(const Location &origin,
+                             const float *latitudes,
+                             const float *longitudes,
+                             size_t count,
+                             float *out)
+{
+    const float metersPerLon = kMetersPerDegree * cosf(origin.latitude * kDegreesToRadians);
+    for (size_t i = 0; i < count; i++)
+    {
+        float north = (latitudes[i] - origin.latitude) * kMetersPerDegree;
+        float east = (longitudes[i] - origin.longitude) * metersPerLon;
+        out[i] = north * north + east * east;
+    }
+}
+
+Location Location::offsetBy(float northMeters, float eastMeters) const
+{
+    Location ret;
+    ret.latitude = latitude + northMeters / kMetersPerDegree;
+    ret.longitude = longitude + eastMeters / (kMetersPerDegree * cosf(latitude * kDegreesToRadians));
+    return ret;
+}
@@ -1,8 +1,16 @@
 #pragma once
+#include <stddef.h>
 #include <etl/bit_stream.h>
 
 namespace Fanet
 {
+    // Locations are sent as 24 bit integers, degrees multiplied by these
+    const float kLatitudeScaling = 93206;
+    const float kLongitudeScaling = 46603;
+
+    // Meters per degree of latitude (and of longitude at the equator)
+    const float kMetersPerDegree = 111319.5f;
+    const float kDegreesToRadians = 0.01745329252f;
 
     /*
                                                                    0
@@ -41,9 +49,33 @@ namespace Fanet
         /// @brief Writes 48-bit data structure into Fanet+ bytes
         void toBitStream(etl::bit_stream_writer &writer) const;
 
+        /// @brief Approximate ground distance to another location (equirectangular projection).
+        /// Accurate to well under 1% at the ranges a LoRa radio can hear.
+        /// @return Distance in meters
+        float distanceTo(const Location &other) const;
+
+        /// @brief Moves this location by a local offset
+        /// @param northMeters Meters to move north (negative for south)
+        /// @param eastMeters Meters to move east (negative for west)
+        /// @return The new location
+        Location offsetBy(float northMeters, float eastMeters) const;
+
         bool operator==(const Location &other) const {
             return latitude == other.latitude && longitude == other.longitude;
         }
     };
 
+    /// @brief Squared ground distances from one location to many, (equirectangular, as
+    /// distanceTo but scaling longitude at the origin's latitude).  Written so the compiler can
+    /// vectorize it, and left squared as sqrtf would stop it, so compare against squared ranges.
+    /// @param latitudes Latitudes of the other locations
+    /// @param longitudes Longitudes of the other locations
+    /// @param count Number of other locations
+    /// @param out Squared distances in square meters, count of them
+    void squaredDistances(const Location &origin,
+                          const float *latitudes,
+                          const float *longitudes,
+                          size_t count,
+                          float *out);
+
 }
\ No newline at end of file
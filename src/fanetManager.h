@@ -6,103 +6,105 @@
 #include "etl/optional.h"
 #include "etl/random.h"
 #include "etl/unordered_map.h"
+#include "etl/vector.h"
+#include "fanetCapture.h"
+#include "fanetConfig.h"
+#include "fanetCsma.h"
+#include "fanetDeadReckoning.h"
+#include "fanetEviction.h"
+#include "fanetForwardPolicy.h"
+#include "fanetInstrumentation.h"
+#include "fanetInterest.h"
+#include "fanetLoad.h"
 #include "fanetMac.h"
+#include "fanetNameArena.h"
 #include "fanetNeighbor.h"
 #include "fanetPacket.h"
+#include "fanetPacketPool.h"
+#include "fanetProximity.h"
+#include "fanetTxPacket.h"
 
-// we keep the neighbors around for 5 minutes before timing them out.
-#ifndef FANET_NEIGHBOR_MAX_TIMEOUT
-#define FANET_NEIGHBOR_MAX_TIMEOUT 1000 * 60 * 5
-#endif
-
-#ifndef FANET_MAX_NEIGHBORS
-#define FANET_MAX_NEIGHBORS 120  // How many maximum neighbors we'll keep around
-#endif
-
-#ifndef FANET_TX_QUEUE_DEPTH
-#define FANET_TX_QUEUE_DEPTH 20  // How many packets can be sitting in the egress queue at one time
-#endif
-
-#ifndef FANET_RXMIT_MIN
-#define FANET_RXMIT_MIN 10  // Min time (in ms) we should wait before rxmit'ing a packet
-#endif
-
-#ifndef FANET_RXMIT_MAX
-#define FANET_RXMIT_MAX 500  // Maximum time (in ms) we should wait before rxmit'ing a packet
-#endif
-
-#ifndef FANET_FORWARD_MIN_DB_BOOST
-#define FANET_FORWARD_MIN_DB_BOOST \
-  20.0f  // If a forwarded packet is boosted by this amount, don't rxmit
-#endif
-
-#ifndef FANET_FORWARD_MAX_RSSI_DBM
-#define FANET_FORWARD_MAX_RSSI_DBM -90.0f  // If a packet is received with this RSSI, don't forward
-#endif
-
-#ifndef FANET_CSMA_MIN
-#define FANET_CSMA_MIN \
-  20  // Wait a min of 20ms before trying to transmit again if the channel is busy
-#endif
-
-#ifndef FANET_CSMA_MAX
-#define FANET_CSMA_MAX \
-  40  // Wait a max of ms before trying to transmit again if the channel is busy
-#endif
-
-#ifndef FANET_MAX_SEND_AGE
-#define FANET_MAX_SEND_AGE \
-  800  // If a packet is older than this many ms, don't try and send it.  Assume too old.
-#endif
+#define FANET_STATE_VERSION 1  // Bumped whenever the layout saved by saveState changes
 
 namespace Fanet {
-  /// @brief A packet queued for transmit.
-  struct TxPacket {
-    unsigned long sendAt;  // Time we wish to send (will time)
-    unsigned long rxTime;  // If forwarded, keep track of when this packet was received.
-    float rssi;            // If forwarded, keep track of the rx Rssi
-    Packet packet;
-
-    bool operator<(const TxPacket& other) const { return sendAt < other.sendAt; }
-
-    TxPacket(unsigned long sendAt, Packet packet, float rssi = 0.0f, unsigned long rxTime = 0)
-        : sendAt(sendAt), packet(packet), rssi(rssi) {
-      // Time received defaults to time to send if not sent
-      this->rxTime = rxTime ? rxTime : sendAt;
-    }
+  struct Stats {
+    uint32_t rx = 0;                  // All packets received
+    uint32_t txSuccess = 0;           // All packets transmitted
+    uint32_t txFailed = 0;            // An attempted transmission failed
+    uint32_t processed = 0;           // Packets passed to the application stack to be processed
+    uint32_t forwarded = 0;           // All packets that were forwarded
+    uint32_t fwdMinRssiDrp = 0;       // Packets discarded due to Rssi being too good
+    uint32_t fwdNeighborDrp = 0;      // Unicasts not forwarded as we hear their dst poorly, or not
+    uint32_t fwdEnqueuedDrop = 0;     // Packet was already queued
+    uint32_t fwdSuppressedDrp = 0;    // Forwards not queued, or cancelled, by the forward policy
+    uint32_t fwdQueueFullDrp = 0;     // Forwards dropped as the tx queue was full
+    uint32_t fwdGeoDrp = 0;           // Forwards not queued as they wouldn't extend coverage
+    uint32_t fwdDbBoostDrop = 0;      // Pkts dropped from txQueue with subsequent good rssi
+    uint32_t rxFromUsDrp = 0;         // Dropped packets from our own Mac
+    uint32_t txExpired = 0;           // Frames dropped from the tx queue after FANET_MAX_SEND_AGE
+    uint32_t txAck = 0;               // Number of Acks sent
+    uint32_t trackingSuppressed = 0;  // Position updates not sent as receivers can predict them
+    uint32_t neighborTableSize = 0;   // Number of neighbors currently in our neighbor table
+    uint32_t rxPoolDrp = 0;           // Frames not forwarded or returned as the packet pool was full
+    uint32_t fwdPoolDrp = 0;          // Forwards dropped as the packet pool was full
+    uint32_t txPoolDrp = 0;           // Our own packets not queued as the packet pool was full
+    uint32_t packetPoolPeak = 0;      // Most packets in the pool at once
+    uint32_t rxFiltered = 0;          // Frames no interest filter matched, (not returned)
+    uint32_t neighborsEvicted = 0;    // Neighbors dropped from the full table for a new one
+    uint32_t loadLevel = 0;           // How much load is being shed now, (a LoadLevel)
+    uint32_t shedForwards = 0;        // Low priority frames not forwarded, to shed load
+    uint32_t shedDeferred = 0;        // Names and messages kept to handle once the load eases
+    uint32_t shedDeferDrp = 0;        // Of those, dropped for newer ones before they were handled
+    uint32_t shedTracking = 0;        // Positions not handled, as the neighbor's was recently
+    uint32_t rxRelayed = 0;           // Frames heard through a relay, rather than from their sender
+    uint32_t fwdOneHopDrp = 0;        // Unicasts not forwarded, as their sender reaches their dst
+
+    /// @brief Adds another manager's stats to these, as when totalling a network.  The pool peak
+    /// and load level keep the larger.
+    Stats& operator+=(const Stats& other);
   };
 
-  struct Stats {
-    uint32_t rx = 0;                 // All packets received
-    uint32_t txSuccess = 0;          // All packets transmitted
-    uint32_t txFailed = 0;           // An attempted transmission failed
-    uint32_t processed = 0;          // Packets passed to the application stack to be processed
-    uint32_t forwarded = 0;          // All packets that were forwarded
-    uint32_t fwdMinRssiDrp = 0;      // Packets discarded due to Rssi being too good
-    uint32_t fwdNeighborDrp = 0;     // Packets discarded due to no neighbor in neighbor table
-    uint32_t fwdEnqueuedDrop = 0;    // Packet was already queued
-    uint32_t fwdDbBoostDrop = 0;     // Pkts dropped from txQueue with subsequent good rssi
-    uint32_t rxFromUsDrp = 0;        // Dropped packets from our own Mac
-    uint32_t txAck = 0;              // Number of Acks sent
-    uint32_t neighborTableSize = 0;  // Number of neighbors currently in our neighbor table
+  /// @brief A Stats counter and its name
+  struct StatField {
+    const char* name;
+    uint32_t Stats::*field;
   };
 
+  /// @brief Every Stats counter.  Captures write them in this order, so new ones only ever go on
+  /// the end.
+  const size_t kStatFieldCount = sizeof(Stats) / sizeof(uint32_t);
+  extern const StatField kStatFields[];
+
   /*
   @brief Manages the state and comms of a Fanet Protocol
 
   Fanet will act in a lot of roles, a receiver of packets, a sender, and also as a relay
   when a packet is requested to be forwarded.  This class manages the state of neighbors
   seen and orchestrates the relaying of Fanet packets when received.
+
+  Sized by its Config, (see fanetConfig.h).  FanetManager uses the DefaultConfig.
   */
-  class FanetManager {
+  template <typename Config = DefaultConfig>
+  class BasicFanetManager {
    public:
+    using PacketPayload = typename Config::Payload;
+    using Packet = BasicPacket<PacketPayload>;
+    using Pool = PacketPool<Packet, Config::packetPoolSize>;
+    using PacketRef = typename Pool::Ref;
+    using TxPacket = BasicTxPacket<PacketRef>;
+    using NeighborTable = etl::unordered_map<uint32_t, Neighbor, Config::maxNeighbors>;
+
     /// @brief Creates instance of FanetManager.  Required to Begin before using
-    FanetManager() {}
+    BasicFanetManager() {}
 
     /// @brief Creates an instance of a FanetManager
     /// @param source address of the device you're initializing.
     /// @param ms Current time (used for seeding random number generator).
-    FanetManager(Mac srcAddress, unsigned long ms) { Begin(srcAddress, ms); }
+    BasicFanetManager(Mac srcAddress, unsigned long ms) { Begin(srcAddress, ms); }
+
+    // Queued frames hold Refs into our packet pool, so a copy's would point into ours
+    BasicFanetManager(const BasicFanetManager&) = delete;
+    BasicFanetManager& operator=(const BasicFanetManager&) = delete;
 
     /// @brief Begins or resets the FanetManager
     /// @param srcAddress source address of the device you're initializing
@@ -118,6 +120,30 @@ namespace Fanet {
                                    float rssi,
                                    float snr);
 
+    /// @brief Handles receiving a packet, parsing it into one the caller keeps, (so it isn't
+    /// copied out)
+    /// @param packet Set to the packet, whatever it is.  Can be reused for every frame.
+    /// @return true if the packet is useful to the application, (when the other handleRx would
+    /// return it)
+    bool handleRx(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+                  const size_t& size,
+                  unsigned long ms,
+                  float rssi,
+                  float snr,
+                  Packet& packet);
+
+    /// @brief Handles receiving a packet, parsing it into the packet pool.  If it's forwarded, the
+    /// forward shares it, so it's never copied.
+    /// @param packet Set to the packet, whatever it is.  Can be reused for every frame, (its slot
+    /// is reused unless a forward shares it).  Empty if the pool was full.
+    /// @return true if the packet is useful to the application
+    bool handleRx(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+                  const size_t& size,
+                  unsigned long ms,
+                  float rssi,
+                  float snr,
+                  PacketRef& packet);
+
     /// @brief Handles transmitting a packet from our tx queue
     /// @param ms current time
     /// @param f function pointer to perform the transmit, should return True if sent successfully
@@ -130,20 +156,46 @@ namespace Fanet {
     /// @return the offset of when we next wish to perform a transmit, if set
     etl::optional<unsigned long> nextTxTime(const unsigned long& ms);
 
+    /// @brief Time we next need to be serviced, to send a frame, send our position or time out
+    /// neighbors.  Lets the caller sleep until then, (or until a frame is received).  O(1).
+    /// @param ms current time
+    /// @return when service should next be called, (no earlier than ms), or nothing if there's
+    /// nothing to do until a frame is received or the application calls us
+    etl::optional<unsigned long> nextEventTime(const unsigned long& ms) const;
+
+    /// @brief Does all the work that's due in one call: times out neighbors, queues our position
+    /// if receivers need it, and transmits the next frame if it's time to
+    /// @param ms current time
+    /// @param f function to perform the transmit, as for doTx
+    /// @return nextEventTime
+    etl::optional<unsigned long> service(
+        const unsigned long& ms,
+        etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                           const size_t& size)> f);
+
     /// @brief Requests a packet be sent
     /// @param pkt packet to send
     /// @param pkt time to send (current time)
     /// @param shouldForward if the packet should be forwarded
     /// @param destinationMac
-    bool sendPacket(const PacketPayload payload,
+    /// @param requestAck Anything but None asks for an ack
+    /// @param chooseAck If set, an ack is asked for of the type that will reach us, (in place of
+    /// requestAck and shouldForward): Requested from a destination we hear directly, or else
+    /// Forwarded, with the packet forwarded too, (as it must be when Forwarded)
+    bool sendPacket(const PacketPayload& payload,
                     unsigned long ms,
                     const bool& shouldForward = true,
                     etl::optional<Mac> destinationMac = etl::optional<Mac>(),
-                    const ExtendedHeaderAckType requestAck = ExtendedHeaderAckType::None);
+                    const ExtendedHeaderAckType requestAck = ExtendedHeaderAckType::None,
+                    const bool& chooseAck = false);
 
     /// @brief If set, we'll transmit our position as ground positions
     /// @param type
-    void setGroundType(etl::optional<GroundTrackingType::enum_type> type) { groundType = type; }
+    void setGroundType(etl::optional<GroundTrackingType::enum_type> type) {
+      // Receivers need to hear about the change straight away
+      if (type != groundType) deadReckoning.reset();
+      groundType = type;
+    }
 
     /// @brief Returns the ground tracking type
     /// @return current ground tracking type
@@ -167,9 +219,24 @@ namespace Fanet {
       this->climbRate = climbRate;
       this->heading = heading;
       this->speed = speedKmh;
+      hasPosition = true;
+      if (capture) capturePosition(ms);
+      updateDistances();
+#if FANET_PROXIMITY
+      evaluateProximity(ms);
+#endif
       queueTrackingUpdate(ms);
     }
 
+    /// @brief Sets when position updates are sent.  Updates are only sent when receivers
+    /// extrapolating our last position would be too far off, or we've been quiet for too long.
+    /// @param maxError Max horizontal error in meters (0 to send every allowed update)
+    /// @param maxAltError Max vertical error in meters
+    /// @param maxInterval Max time between position updates (ms)
+    void setDeadReckoningThresholds(float maxError, float maxAltError, unsigned long maxInterval) {
+      deadReckoning.setThresholds(maxError, maxAltError, maxInterval);
+    }
+
     // Public attributes that can be sent for tracking updates
     AircraftType aircraftType;
 
@@ -178,37 +245,330 @@ namespace Fanet {
     Stats getStats() {
       auto ret = stats;
       ret.neighborTableSize = neighborTable.size();
+      ret.packetPoolPeak = packetPool.peak();
+      ret.loadLevel = (uint32_t)load.getLevel();
       return ret;
     }
 
     /// @brief Gets a copy of the neighbor table
-    etl::unordered_map<uint32_t, Neighbor, FANET_MAX_NEIGHBORS> getNeighborTable() {
-      return neighborTable;
+    NeighborTable getNeighborTable() { return neighborTable; }
+
+    /// @brief Called with a neighbor as the table changes: after every frame it's heard, (gone
+    /// false), and as it leaves, (gone true), so consumers can follow the table without copying it
+    using NeighborListener = etl::delegate<void(const Neighbor& neighbor, const bool& gone)>;
+    void setNeighborListener(const NeighborListener& listener) { neighborListener = listener; }
+
+    /// @brief Gets how well we hear a neighbor, (LinkQuality::score sums it up)
+    /// @return nullopt if the neighbor isn't in the table
+    etl::optional<LinkQuality> getLinkQuality(const Mac& address) const {
+      auto it = neighborTable.find(address.toInt32());
+      if (it == neighborTable.end()) return etl::nullopt;
+      return it->second.link;
+    }
+
+    /// @brief Gets how we hear a neighbor, directly or through relays, and who it reaches
+    /// @return nullopt if the neighbor isn't in the table
+    etl::optional<Route> getRoute(const Mac& address) const {
+      auto it = neighborTable.find(address.toInt32());
+      if (it == neighborTable.end()) return etl::nullopt;
+      return it->second.route;
+    }
+
+#if FANET_TRACK_HISTORY
+    using Track = typename TrackHistory<Config::maxNeighbors>::Range;
+
+    /// @brief Gets the recent positions of a neighbor, oldest first.  Decoded as iterated over,
+    /// and only valid until the next call to handleRx.
+    Track getTrack(const Mac& address) const {
+      auto it = neighborTable.find(address.toInt32());
+      return it == neighborTable.end() ? Track() : trackHistory.get(it->second.track);
+    }
+#endif
+
+#if FANET_NAME_CACHE
+    /// @brief Gets a neighbor's name, without copying it.  Valid until the next call to handleRx.
+    /// Frames repeating a name we already have aren't returned by handleRx.
+    /// @return the name, empty if we haven't heard it
+    etl::string_view getName(const Mac& address) const {
+      auto it = neighborTable.find(address.toInt32());
+      return it == neighborTable.end() ? etl::string_view() : names.get(it->second.name);
+    }
+
+    /// @brief Finds the neighbor with a name.  Valid until the next call to handleRx.
+    /// @return the neighbor, or nullptr if no neighbor has sent us the name
+    const Neighbor* findByName(const etl::string_view& name) const {
+      uint32_t owner;
+      if (!names.find(name, owner)) return nullptr;
+      auto it = neighborTable.find(owner);
+      return it == neighborTable.end() ? nullptr : &it->second;
+    }
+#endif
+
+#if FANET_PROXIMITY
+    /// @brief Neighbors we'll pass too close to, most urgent first, as of the last setPos
+    etl::vector<ProximityAlert, FANET_PROXIMITY_MAX_ALERTS> getAlerts() const;
+
+    /// @brief Most urgent alert level as of the last setPos
+    ProximityLevel getProximityLevel() const { return proximityLevel; }
+#endif
+
+    /// @brief Sets the policy ranking which neighbor to drop when the table is full and a new
+    /// one is heard.  Defaults to a RelevanceEvictionPolicy.  The policy must outlive the
+    /// manager.
+    void setEvictionPolicy(EvictionPolicy& policy) {
+      evictionPolicy = &policy;
+      rankNeighbors();
+    }
+
+    EvictionPolicy& getEvictionPolicy() {
+      return evictionPolicy ? *evictionPolicy : defaultEvictionPolicy;
+    }
+
+    /// @brief Adds a filter for the traffic the application wants.  Once any are added,
+    /// frames matching none of them are turned away as soon as their header or position shows
+    /// it: their payload isn't parsed, they don't update the neighbor table, and handleRx
+    /// returns nothing.  Frames to be forwarded are still parsed and update the table, as
+    /// forwarding needs, and frames addressed to us are always handled.
+    /// @return false if FANET_MAX_INTEREST_FILTERS are already set
+    bool addInterest(const InterestFilter& filter) { return interests.add(filter); }
+
+    /// @brief Drops every interest filter, so all traffic is handled again
+    void clearInterests() { interests.clear(); }
+
+    /// @brief Sets a microsecond clock (typically micros()) to measure rx processing against the
+    /// load budget.  Without one, no load is shed.
+    void setLoadClock(etl::delegate<unsigned long()> micros) { load.setClock(micros); }
+
+    /// @brief Sets how long rx processing may take, before load is shed, (see LoadController)
+    /// @param budgetUs Time (us) allowed in each window, 0 to never shed load
+    /// @param windowMs Window (ms), typically the loop period
+    void setLoadBudget(const unsigned long& budgetUs, const unsigned long& windowMs) {
+      load.setBudget(budgetUs, windowMs);
+    }
+
+    /// @brief How much received traffic is being shed
+    LoadLevel getLoadLevel() const { return load.getLevel(); }
+
+    /// @brief Names and messages deferred under load that can be handled now, (none while the
+    /// load is still too high)
+    size_t deferred() const {
+      return load.getLevel() < LoadLevel::DeferParsing ? load.getDeferred().size() : 0;
+    }
+
+    /// @brief Handles the oldest frame deferred under load, as if it had just been received,
+    /// (but it isn't forwarded, it's too late for that).  Call while deferred() is non-zero.
+    /// @param packet Set to the packet, as for handleRx
+    /// @return true if the packet is useful to the application
+    bool handleDeferred(const unsigned long& ms, Packet& packet);
+
+    /// @brief Sets the policy deciding which received frames are forwarded, and when.
+    /// Defaults to a DensityForwardPolicy.  The policy must outlive the manager.
+    void setForwardPolicy(ForwardPolicy& policy) { forwardPolicy = &policy; }
+
+    /// @brief Gets the current forwarding policy (and its counters)
+    ForwardPolicy& getForwardPolicy() {
+      return forwardPolicy ? *forwardPolicy : defaultForwardPolicy;
     }
 
-    /// @brief Flushes old neighbors from the state table
+    /// @brief Sets how we back off after finding the channel busy, (Exponential by default)
+    void setCsmaMode(const CsmaMode& mode) { csma.setMode(mode); }
+
+    /// @brief Gets the carrier sense back-off, with its estimate of how busy the channel is and
+    /// its counters, (the distribution of retries each frame needed)
+    Csma& getCsma() { return csma; }
+
+    /// @brief Records every frame received and transmit attempt, along with the position updates
+    /// and packets the application gives us, so they can be replayed into another manager later.
+    /// Start capturing straight after Begin for a replay to make the same random choices.
+    /// @param writer Capture to write to, must outlive the manager.  nullptr to stop capturing.
+    /// @param ms current time
+    void setCapture(CaptureWriter* writer, const unsigned long& ms);
+
+    /// @brief Records our current stats to the capture, for a replay to be compared against
+    void captureStats(const unsigned long& ms);
+
+    /// @brief Saves the neighbor table and position update timing, so after a reboot or
+    /// brown-out we can carry on where we left off rather than relearning our neighbors.
+    /// @param buffer Where to save to, (flash, RTC RAM...).  kMaxStateSize bytes is always enough
+    /// @param size Size of the buffer
+    /// @param ms current time
+    /// @return Bytes saved, or 0 if the buffer was too small
+    size_t saveState(uint8_t* buffer, const size_t& size, const unsigned long& ms) const;
+
+    /// @brief Restores state saved by saveState, replacing the neighbor table.  Entries are aged
+    /// by the time since they were saved, and any that would have timed out are dropped.
+    /// @param ms current time
+    /// @param elapsedMs Time since the state was saved, (our clock may have restarted since)
+    /// @return false if the state is corrupt or was saved by an incompatible version
+    bool restoreState(const uint8_t* buffer,
+                      const size_t& size,
+                      const unsigned long& ms,
+                      const unsigned long& elapsedMs = 0);
+
+    // Header, our last sent position, each neighbor and a crc
+    static const size_t kMaxStateSize = 10 + 26 + Config::maxNeighbors * 21 + 1;
+
+    /// @brief Flushes neighbors that have timed out from the table, then if it's still full,
+    /// evicts the least relevant, (see setEvictionPolicy)
     void flushOldNeighborEntries(const unsigned long& currentMs);
 
+    /// @brief Drops neighbors that have timed out, and works out when the next one will
+    void expireNeighbors(const unsigned long& ms);
+
+#if FANET_INSTRUMENTATION
+    /// @brief Sets a microsecond clock (typically micros()) used to time rx processing
+    void setInstrumentationClock(etl::delegate<unsigned long()> micros) {
+      instrumentationClock = micros;
+    }
+
+    /// @brief Gets a snapshot of the instrumentation histograms and counters.  Per neighbor
+    /// counters are kept in the neighbor table.
+    Instrumentation getInstrumentation() const { return instrumentation; }
+
+    /// @brief Resets all instrumentation, including the per neighbor counters
+    void resetInstrumentation();
+#endif
+
    protected:
     etl::optional<Mac> src;  // Src address, (ours)
 
     // Neighbor table with key being mac address, value being when we last saw them
-    etl::unordered_map<uint32_t, Neighbor, FANET_MAX_NEIGHBORS> neighborTable;
+    NeighborTable neighborTable;
+    NeighborListener neighborListener;
 
-    // etl:: <Packet, FANET_TX_QUEUE_DEPTH> txQueue;
-    etl::list<TxPacket, FANET_TX_QUEUE_DEPTH> txQueue;
+    // No later than when the next neighbor times out, (plus the expiry slack), if any might
+    etl::optional<unsigned long> nextNeighborExpiry;
 
-    /// @brief Queues a packet for transmission
-    /// @param txPacket packet to queue
+    // Packets the tx queue, (and the application), hold references to.  Declared before the
+    // queue, so it outlives it.
+    Pool packetPool;
+
+    // etl:: <Packet, FANET_TX_QUEUE_DEPTH> txQueue;
+    etl::list<TxPacket, Config::txQueueDepth> txQueue;
+
+    /// @brief Handles a received frame, parsing it into packet
+    /// @param shared packet's slot in the pool, if it's in one, for a forward to share
+    bool receive(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+                 const size_t& size,
+                 unsigned long ms,
+                 float rssi,
+                 float snr,
+                 Packet& packet,
+                 const PacketRef& shared,
+                 const bool& deferred = false);
+
+    /// @brief Sheds a frame if the load's high enough: deferring names and messages, (but not
+    /// messages to forward), and sampling positions.  Frames to us, acks and calls for help are
+    /// kept.
+    /// @param offset Where its payload starts
+    /// @return true if it was shed, (so needs nothing more)
+    bool shed(const Packet& packet,
+              const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+              const size_t& offset,
+              const size_t& size,
+              const unsigned long& ms,
+              const float& rssi,
+              const float& snr);
+
+    /// @brief Queues a received packet to be forwarded, if it's admitted
+    /// @param packet packet to forward, (as received, it's sent with its forward bit cleared)
+    /// @param rssi its rx Rssi
     /// @param ms current ms
-    void queueForwardFrame(TxPacket txPacket, const unsigned long& ms);
+    /// @param shared packet's slot in the pool, to share, or empty to copy it into one
+    void queueForwardFrame(const Packet& packet,
+                           const float& rssi,
+                           const unsigned long& ms,
+                           const PacketRef& shared = PacketRef());
+
+    /// @brief Stable sorts the tx queue by send time, moving its nodes rather than packets
+    void sortTxQueue();
+
+    /// @brief Puts a packet we're sending onto the front of the tx queue
+    bool queuePacket(const PacketPayload& payload,
+                     unsigned long ms,
+                     const bool& shouldForward,
+                     etl::optional<Mac> destinationMac,
+                     const ExtendedHeaderAckType requestAck);
+
+    /// @brief Drops frames from the tx queue that are now too old to send
+    void expireTxQueue(const unsigned long& ms);
+
+    /// @brief Scores a neighbor that's been heard from, and puts it in order for eviction,
+    /// O(log n)
+    void rankNeighbor(Neighbor& neighbor);
+
+    /// @brief Scores every neighbor again, as when our position changes, O(n)
+    void rankNeighbors();
+
+    /// @brief Drops the neighbor the eviction policy scores lowest, O(log n)
+    void evictNeighbor();
+
+    /// @brief Frees what we keep elsewhere for a neighbor that's leaving the table
+    void releaseNeighbor(const Neighbor& neighbor);
+
+    /// @brief Checks if we've heard a neighbor directly lately, and well enough to expect it to
+    /// hear us, (its link score is at least Config::linkMinScore)
+    bool reachable(const Mac& address, const unsigned long& ms) const;
+
+    /// @brief Checks if a unicast's sender reaches its destination itself, (we've heard either
+    /// send straight to the other lately), so forwarding it is pointless
+    bool oneHop(const Mac& source, const Mac& destination, const unsigned long& ms) const;
+
+    /// @brief Checks if forwarding a frame would reach anywhere its sender didn't.  We must be
+    /// far enough from the sender, or nearer than the sender to a unicast's destination.
+    /// @return true if it would, or if we don't know where we, or they, are
+    bool extendsCoverage(const Packet& packet, const unsigned long& ms) const;
+
+    /// @brief Works out how far every neighbor is from our position
+    void updateDistances();
+
+    /// @brief Checks a frame against the interest filters, from its header and, if they need
+    /// it, its position, (or its sender's, if it doesn't carry one)
+    /// @param offset Where its payload starts
+    bool interesting(const Packet& packet,
+                     const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+                     const size_t& offset,
+                     const size_t& size) const;
+
+    /// @brief Checks if we've queued a frame from a sender to forward
+    bool relaying(const Mac& source) const;
+
+    /// @brief Checks if a packet is a copy of one we've queued to forward, and lets the forward
+    /// policy decide what to do with our queued frame
+    /// @param packet Received packet (with the forward bit cleared)
+    /// @param rssi Rssi the copy was heard at
+    /// @param ms current ms
+    /// @return true if this packet was already in our tx queue
+    bool overheardCopy(const Packet& packet, const float& rssi, const unsigned long& ms);
+
+    // Decides which received frames are forwarded, defaultForwardPolicy if not set
+    DensityForwardPolicy defaultForwardPolicy;
+    ForwardPolicy* forwardPolicy = nullptr;
+
+    // Traffic the application wants handed to it, all of it if empty
+    Interests interests;
+
+    // Sheds received traffic when handling it takes too long
+    LoadController load;
+
+    // Ranks neighbors for eviction, defaultEvictionPolicy if not set
+    RelevanceEvictionPolicy defaultEvictionPolicy;
+    EvictionPolicy* evictionPolicy = nullptr;
+    EvictionQueue<Config::maxNeighbors> evictionQueue;
+    unsigned long evictionEpoch = 0;  // When scores count recency from, (EvictionContext::epoch)
 
     /// @brief Random number generator
     etl::random_xorshift random;
+    unsigned long seed = 0;
+
+    // Where we record what we receive and transmit, if anywhere
+    CaptureWriter* capture = nullptr;
+    void capturePosition(const unsigned long& ms);
 
-    // When a transmit has failed, we'll wait a random amount of time before trying
-    // any transmissions again.  This is the time we'll wait for a new tx.
+    // When a transmit has failed, we'll back off before trying any transmissions again.  This is
+    // the time we'll wait for a new tx.
     unsigned long csmaNextTx = 0;
+    Csma csma{Config::csmaMin, Config::csmaMax};
 
     // Our last known location we want to transmit
     float lat;
@@ -218,6 +578,14 @@ namespace Fanet {
     int heading;
     float speed;
     etl::optional<GroundTrackingType::enum_type> groundType;
+    bool hasPosition = false;  // If we've been given a position yet
+
+    Location ownLocation() const {
+      Location location;
+      location.latitude = lat;
+      location.longitude = lng;
+      return location;
+    }
 
     /// @brief Queues a tracking update packet if the internal has been long enough since our last
     /// update
@@ -227,9 +595,50 @@ namespace Fanet {
     // Time which we're allowed to enqueue a tracking packet
     unsigned long nextAllowedTrackingTime = 0;
 
+    /// @brief When receivers will next need our position, even if we haven't moved
+    etl::optional<unsigned long> nextTrackingTime() const;
+
     unsigned long lastLocationSentMs = 0;
 
+    // What receivers think our position is, based on what we last sent
+    DeadReckoning deadReckoning;
+
     // Keep track of statistics
     Stats stats;
+
+#if FANET_TRACK_HISTORY
+    // Recent positions of each neighbor, freed as neighbors leave the table
+    TrackHistory<Config::maxNeighbors> trackHistory;
+#endif
+
+#if FANET_NAME_CACHE
+    // Names of the neighbors that have sent them, freed as neighbors leave the table
+    NameArena<Config::maxNeighbors, FANET_NAME_BYTES> names;
+#endif
+
+#if FANET_PROXIMITY
+    // Motion of each airborne neighbor, re-evaluated against ours on every setPos
+    ProximityEngine<Config::maxNeighbors> proximity;
+    ProximityLevel proximityLevel = ProximityLevel::None;
+    void evaluateProximity(const unsigned long& ms);
+#endif
+
+#if FANET_INSTRUMENTATION
+    Instrumentation instrumentation;
+    etl::delegate<unsigned long()> instrumentationClock;
+
+    /// @brief A frame we've sent requesting an ack
+    struct PendingAck {
+      uint32_t destination;
+      unsigned long sentAt;
+    };
+    etl::vector<PendingAck, FANET_MAX_PENDING_ACKS> pendingAcks;
+#endif
   };
+
+  using FanetManager = BasicFanetManager<DefaultConfig>;
+
+  // FanetManager is built in fanetManager.cpp, managers with other configs need
+  // fanetManagerImpl.h
+  extern template class BasicFanetManager<DefaultConfig>;
 }  // namespace Fanet
@@ -0,0 +1,1381 @@
+#pragma once
+
+/*
+  Definitions of BasicFanetManager.  Only needed by code using a manager with a config other than
+  the DefaultConfig, (FanetManager itself is built in fanetManager.cpp).
+*/
+
+#include <math.h>
+#include <string.h>
+#include "etl/crc8_ccitt.h"
+#include "etl/delegate.h"
+#include "fanetManager.h"
+#include "fanetPacketImpl.h"
+
+namespace Fanet {
+  namespace Detail {
+    /// @brief Little endian writer for saved state, stops writing once the buffer is full
+    struct StateWriter {
+      uint8_t* buffer;
+      size_t size;
+      size_t offset = 0;
+
+      StateWriter(uint8_t* buffer, const size_t& size) : buffer(buffer), size(size) {}
+
+      uint8_t* reserve(const size_t& length) {
+        if (offset + length > size) {
+          offset = size + 1;  // Overflowed
+          return nullptr;
+        }
+        offset += length;
+        return buffer + offset - length;
+      }
+
+      void put(const uint32_t& value, const size_t& length) {
+        auto to = reserve(length);
+        for (size_t i = 0; to && i < length; i++) to[i] = value >> (8 * i);
+      }
+
+      void putFloat(const float& value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        put(bits, 4);
+      }
+
+      void putLocation(const Location& location) {
+        auto to = reserve(6);
+        if (!to) return;
+        etl::bit_stream_writer writer((void*)to, 6, etl::endian::big);
+        location.toBitStream(writer);
+      }
+
+      bool overflowed() const { return offset > size; }
+    };
+
+    /// @brief Reads what StateWriter wrote, returning zeros past the end of the buffer
+    struct StateReader {
+      const uint8_t* buffer;
+      size_t size;
+      size_t offset = 0;
+
+      StateReader(const uint8_t* buffer, const size_t& size) : buffer(buffer), size(size) {}
+
+      const uint8_t* take(const size_t& length) {
+        if (offset + length > size) {
+          offset = size + 1;  // Overflowed
+          return nullptr;
+        }
+        offset += length;
+        return buffer + offset - length;
+      }
+
+      uint32_t get(const size_t& length) {
+        auto from = take(length);
+        uint32_t value = 0;
+        for (size_t i = 0; from && i < length; i++) value |= (uint32_t)from[i] << (8 * i);
+        return value;
+      }
+
+      float getFloat() {
+        uint32_t bits = get(4);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+      }
+
+      Location getLocation() {
+        auto from = take(6);
+        if (!from) return Location();
+        etl::bit_stream_reader reader((void*)from, 6, etl::endian::big);
+        return Location::fromBitStream(reader);
+      }
+
+      bool overflowed() const { return offset > size; }
+    };
+
+    // Saved state flags
+    static const uint8_t kHasLastSent = 0x01;
+    static const uint8_t kHasLocation = 0x01;
+    static const uint8_t kHasAltitude = 0x02;
+    static const uint8_t kHasGroundType = 0x04;
+    static const uint8_t kHeardDirect = 0x08;  // The last frame came from the neighbor itself
+
+    /// @brief Charges the time spent in a scope to the load budget, if we have a clock
+    struct LoadTimer {
+      LoadTimer(LoadController& load, const unsigned long& ms)
+          : load(load), ms(ms), start(load.now()) {}
+      ~LoadTimer() {
+        if (load.measuring()) load.spent(ms, load.now() - start);
+      }
+      LoadController& load;
+      const unsigned long& ms;
+      unsigned long start;
+    };
+
+#if FANET_INSTRUMENTATION
+    /// @brief Records the time spent in a scope to a histogram, if we have a clock
+    struct ScopeTimer {
+      ScopeTimer(Histogram& histogram, const etl::delegate<unsigned long()>& clock)
+          : histogram(histogram), clock(clock), start(clock.is_valid() ? clock() : 0) {}
+      ~ScopeTimer() {
+        if (clock.is_valid()) histogram.record(clock() - start);
+      }
+      Histogram& histogram;
+      const etl::delegate<unsigned long()>& clock;
+      unsigned long start;
+    };
+#endif
+  }  // namespace Detail
+
+  template <typename Config>
+  void BasicFanetManager<Config>::Begin(Mac srcAddress, unsigned long ms) {
+    src = srcAddress;
+    seed = ms;
+    random.initialise(ms);
+  }
+
+  template <typename Config>
+  etl::optional<typename BasicFanetManager<Config>::Packet> BasicFanetManager<Config>::handleRx(
+      const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+      const size_t& size,
+      unsigned long ms,
+      float rssi,
+      float snr) {
+    etl::optional<Packet> packet;
+    packet.emplace();
+    if (!handleRx(bytes, size, ms, rssi, snr, packet.value())) packet.reset();
+    return packet;
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::handleRx(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+                                           const size_t& size,
+                                           unsigned long ms,
+                                           float rssi,
+                                           float snr,
+                                           Packet& packet) {
+    // The caller's packet isn't in the pool, so it's copied into it if it's forwarded
+    return receive(bytes, size, ms, rssi, snr, packet, PacketRef());
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::handleRx(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+                                           const size_t& size,
+                                           unsigned long ms,
+                                           float rssi,
+                                           float snr,
+                                           PacketRef& packet) {
+    // Parse over the caller's last packet, unless a forward still holds it
+    if (packet.useCount() != 1) packet = packetPool.acquire();
+    if (packet) return receive(bytes, size, ms, rssi, snr, packetPool.edit(packet), packet);
+
+    // Every slot is in use.  The frame still updates the neighbor table, but can't be kept.
+    stats.rxPoolDrp++;
+    Packet scratch;
+    receive(bytes, size, ms, rssi, snr, scratch, packet);
+    return false;
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::receive(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+                                          const size_t& size,
+                                          unsigned long ms,
+                                          float rssi,
+                                          float snr,
+                                          Packet& packet,
+                                          const PacketRef& shared,
+                                          const bool& deferred) {
+    if (!deferred) {
+      stats.rx++;
+      csma.heard(ms, size);
+      if (capture) capture->rx(ms, rssi, snr, bytes.data(), size);
+    }
+    Detail::LoadTimer loadTimer(load, ms);
+#if FANET_INSTRUMENTATION
+    Detail::ScopeTimer timer(instrumentation.rxProcessingUs, instrumentationClock);
+#endif
+
+    // A packet has been received.  First parse its headers, in place.
+    size_t payloadOffset = Packet::parseHeaders(bytes, size, packet);
+#if FANET_INSTRUMENTATION
+    instrumentation.rxByType[(uint8_t)packet.header.type & 0x07]++;
+#endif
+
+    if (packet.header.srcMac.toInt32() == 0) {
+      // The packet does not have a SRC.  Throw it away
+      return false;  // should probably have a counter for these
+    }
+
+    // If the packet is from our own mac-address, it's probably a forward and can be dropped
+    if (packet.header.srcMac == src) {
+      stats.rxFromUsDrp++;
+      return false;
+    }
+
+    // Frames the application isn't interested in go no further than forwarding needs
+    bool interested = interesting(packet, bytes, payloadOffset, size);
+    if (!interested) {
+      stats.rxFiltered++;
+      if (!packet.header.shouldForward) {
+        // It may still be another relay's copy of a frame we're waiting to forward
+        if (relaying(packet.header.srcMac)) {
+          Packet::parsePayload(bytes, size, payloadOffset, packet);
+          overheardCopy(packet, rssi, ms);
+        }
+        return false;
+      }
+    }
+
+    // Under load, shed what matters least
+    if (!deferred && load.getLevel() >= LoadLevel::DeferParsing &&
+        shed(packet, bytes, payloadOffset, size, ms, rssi, snr)) {
+      return false;
+    }
+
+    // Then its payload
+#if FANET_NAME_CACHE
+    // Names are repeated every few minutes.  One we already have is recognised from its bytes,
+    // and isn't parsed, (or copied), again.
+    size_t nameOffset = payloadOffset;
+    size_t nameLength = 0;
+    uint32_t nameHash = 0;
+    bool knownName = false;
+    if (packet.header.type == PacketType::Name && nameOffset < size) {
+      auto name = bytes.data() + nameOffset;
+      while (nameOffset + nameLength < size && name[nameLength]) nameLength++;
+      nameHash = hashName(name, nameLength);
+      auto it = neighborTable.find(packet.header.srcMac.toInt32());
+      if (!packet.header.hasExtensionHeader && it != neighborTable.end() &&
+          it->second.nameHash == nameHash) {
+        auto stored = names.get(it->second.name);
+        knownName = stored.size() == nameLength && !memcmp(stored.data(), name, nameLength);
+      }
+    }
+    if (!knownName) Packet::parsePayload(bytes, size, payloadOffset, packet);
+#else
+    Packet::parsePayload(bytes, size, payloadOffset, packet);
+#endif
+
+    // Update our neighbor table based on the source address
+    auto it = neighborTable.find(packet.header.srcMac.toInt32());
+    auto inTable = (it != neighborTable.end());
+    if (inTable) {
+      // Neighbor is in the table, just update the last seen time
+      it->second.lastSeen = ms;
+    } else {
+      // Neighbor is not in the table.  If it's full, make room, dropping any that are due to
+      // time out, or else the least relevant, and add a new one in
+      if (neighborTable.full()) {
+        if (nextNeighborExpiry.has_value() && ms >= nextNeighborExpiry.value()) expireNeighbors(ms);
+        if (neighborTable.full()) evictNeighbor();
+      }
+      Neighbor newEntry;
+      newEntry.address = packet.header.srcMac;
+      newEntry.lastSeen = ms;
+      neighborTable.insert(etl::pair<uint32_t, Neighbor>(packet.header.srcMac.toInt32(), newEntry));
+      // Everyone else was seen earlier, so only the first neighbor changes the next expiry
+      if (!nextNeighborExpiry.has_value()) {
+        nextNeighborExpiry = ms + Config::neighborMaxTimeout + 1 + Config::neighborExpirySlack;
+      }
+    }
+
+    // Update the cached location and ground tracking type for the neighbor
+    auto& neighbor = neighborTable[packet.header.srcMac.toInt32()];
+
+    // A frame a relay forwarded says how well we hear the relay, not its sender
+    bool unicast =
+        packet.extHeader.has_value() && packet.extHeader.value().destinationMac.has_value();
+    bool twoHopAck = packet.extHeader.has_value() &&
+                     packet.extHeader.value().ackType == ExtendedHeaderAckType::Forwarded;
+    bool relayed =
+        neighbor.route.isRelayed(packet.header.type, packet.header.shouldForward, twoHopAck);
+    neighbor.route.heard(ms, relayed, packet.header.type, packet.header.shouldForward, snr);
+    if (relayed) {
+      stats.rxRelayed++;
+    } else {
+      neighbor.rssi = rssi;
+      neighbor.snr = snr;
+      neighbor.link.heard(rssi, snr);
+      // Sent straight to its destination, so it expects to be heard there
+      if (unicast && !packet.header.shouldForward) {
+        neighbor.route.sentTo(packet.extHeader.value().destinationMac.value().toInt32(), ms);
+      }
+    }
+#if FANET_INSTRUMENTATION
+    neighbor.rxCount++;
+#endif
+    // Configs without a payload type don't parse it, so only look at those we carry
+    if constexpr (Packet::template supports<Tracking>()) {
+      if (packet.header.type == PacketType::Tracking) {
+        auto& payload = etl::get<Tracking>(packet.payload);
+        if (!relayed) {
+          auto& beaconMs = neighbor.route.beaconMs;
+          if (beaconMs.has_value()) neighbor.link.beacon(ms - beaconMs.value());
+          beaconMs = ms;
+        }
+        // Clear out any ground tracking status
+        neighbor.groundTrackingType = etl::nullopt;
+        neighbor.location = payload.location;
+        neighbor.altitude = payload.altitude;
+        neighbor.speed = payload.speed;
+        neighbor.climbRate = payload.climbRate;
+        neighbor.heading = payload.heading;
+        neighbor.aircraftType = payload.aircraftType;
+        neighbor.locationMs = ms;
+        neighbor.distance = hasPosition ? ownLocation().distanceTo(payload.location) : -1.0f;
+#if FANET_PROXIMITY
+        if (interested) {
+          MotionState motion;
+          motion.location = payload.location;
+          motion.altitude = payload.altitude;
+          motion.speed = payload.speed;
+          motion.heading = payload.heading;
+          motion.climbRate = payload.climbRate;
+          motion.ms = ms;
+          neighbor.proximity =
+              proximity.update(neighbor.proximity, neighbor.address.toInt32(), motion);
+        }
+#endif
+#if FANET_TRACK_HISTORY
+        if (interested) {
+          TrackFix fix;
+          fix.ms = ms;
+          fix.location = payload.location;
+          fix.altitude = payload.altitude;
+          neighbor.track = trackHistory.add(neighbor.track, neighbor.address.toInt32(), fix);
+        }
+#endif
+      }
+    }
+    if constexpr (Packet::template supports<GroundTracking>()) {
+      if (packet.header.type == PacketType::GroundTracking) {
+        auto& payload = etl::get<GroundTracking>(packet.payload);
+        if (!relayed) {
+          auto& beaconMs = neighbor.route.beaconMs;
+          if (beaconMs.has_value()) neighbor.link.beacon(ms - beaconMs.value());
+          beaconMs = ms;
+        }
+        neighbor.groundTrackingType = payload.type;
+        neighbor.location = payload.location;
+        neighbor.altitude = etl::nullopt;
+        neighbor.speed = 0.0f;
+        neighbor.climbRate = 0.0f;
+        neighbor.locationMs = ms;
+        neighbor.distance = hasPosition ? ownLocation().distanceTo(payload.location) : -1.0f;
+#if FANET_PROXIMITY
+        // Only airborne neighbors are a collision risk
+        proximity.release(neighbor.proximity);
+        neighbor.proximity = kNoProximity;
+#endif
+#if FANET_TRACK_HISTORY
+        if (interested) {
+          TrackFix fix;
+          fix.ms = ms;
+          fix.location = payload.location;
+          neighbor.track = trackHistory.add(neighbor.track, neighbor.address.toInt32(), fix);
+        }
+#endif
+      }
+    }
+
+#if FANET_NAME_CACHE
+    if (interested && packet.header.type == PacketType::Name && !knownName) {
+      neighbor.name = names.add(neighbor.name, neighbor.address.toInt32(), nameHash,
+                                (const char*)bytes.data() + nameOffset, nameLength);
+      neighbor.nameHash = neighbor.name == kNoName ? 0 : nameHash;
+    }
+    // Forwarding is the only time a name we already have is copied
+    if constexpr (Packet::template supports<Name>()) {
+      if (knownName && packet.header.shouldForward) {
+        auto stored = names.get(neighbor.name);
+        packet.payload.template emplace<Name>();
+        etl::get<Name>(packet.payload).name.assign(stored.data(), stored.size());
+      }
+    }
+#endif
+
+    rankNeighbor(neighbor);
+    if (interested && neighborListener.is_valid()) neighborListener(neighbor, false);
+
+    // Destination address, if set.
+    Mac* dst = NULL;
+    bool dstReachable = false;
+    if (packet.extHeader.has_value() && packet.extHeader.value().destinationMac.has_value()) {
+      dst = &packet.extHeader.value().destinationMac.value();
+
+      // If the packet is destined for us, do no further processing
+      if (*dst == src) {
+#if FANET_INSTRUMENTATION
+        // Is this the ack to a frame we sent?
+        if (packet.header.type == PacketType::Ack) {
+          for (auto pending = pendingAcks.begin(); pending != pendingAcks.end(); pending++) {
+            if (pending->destination == packet.header.srcMac.toInt32()) {
+              instrumentation.ackRoundTripMs.record(ms - pending->sentAt);
+              pendingAcks.erase(pending);
+              break;
+            }
+          }
+        }
+#endif
+
+        // If an ack was requested, Let's queue one
+        auto ackType = packet.extHeader.value().ackType;
+        if (ackType == ExtendedHeaderAckType::Forwarded && !packet.header.shouldForward) {
+          // The sender requested a 2-hop Ack on an already forwarded packet.  We'll send the
+          // ack back to the original sender with forward / possibly two hops away
+          queuePacket(Ack(), ms, true, packet.header.srcMac, ExtendedHeaderAckType::None);
+          stats.txAck++;
+        } else if (ackType == ExtendedHeaderAckType::Forwarded ||
+                   ackType == ExtendedHeaderAckType::Requested) {
+          // The sender requested an ack, but either did not request it be forwarded, or did request
+          // the ack be forwarded but we got it directly.  Here we assume that we'll have
+          // bi-directional communication and we'll send the ack directly back to the sender.
+          queuePacket(Ack(), ms, false, packet.header.srcMac, ExtendedHeaderAckType::None);
+          stats.txAck++;
+        }
+        stats.processed++;
+        return true;
+      }
+
+      dstReachable = reachable(*dst, ms);
+    }
+
+    // Frames too old to send shouldn't be mistaken for this one, however often we're polled
+    expireTxQueue(ms);
+
+    // Rules for forwarding:
+    // - Forward bit set, (and it's not been deferred, it's too late by now)
+    // - If unicast, is not destined for us and we hear its destination well enough
+    // - We carry its payload type, (or we'd forward it without its payload)
+    // - Under load, it's not of a low priority type
+    if (deferred) {
+      // Handled when the load eased, long after any relaying
+    } else if (packet.header.shouldForward) {
+      if (dst && !dstReachable) {
+        stats.fwdNeighborDrp++;
+      } else if (load.getLevel() >= LoadLevel::ShedForwards &&
+                 LoadController::lowPriority(packet.header.type)) {
+        stats.shedForwards++;
+      } else if (Packet::carries(packet.header.type)) {
+        queueForwardFrame(packet, rssi, ms, shared);
+      }
+    } else {
+      // This may be another relay forwarding a frame we're waiting to forward ourselves
+      overheardCopy(packet, rssi, ms);
+    }
+
+    // Forwarded, but not wanted by the application
+    if (!interested) return false;
+
+#if FANET_NAME_CACHE
+    // The application can look names it's already been given up with getName
+    if (knownName) return false;
+#endif
+
+    // This packet is not specifically meant for someone else, so, it's probably interesting
+    // to the application layer
+    stats.processed++;
+    return true;
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::doTx(
+      unsigned long ms,
+      etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                         const size_t& size)> f) {
+    expireTxQueue(ms);
+    if (txQueue.empty()) return;
+
+    // Build a tx buffer based on the packet that is due to send, (it stays queued until sent)
+    TxPacket& txPacket = txQueue.front();
+    if (csma.defer(random)) {
+      csmaNextTx = ms + csma.backoff(txPacket.retries, random);
+      if (capture) capture->deferred(ms);
+      return;
+    }
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> txBuffer;
+    auto size = txPacket.packet->encode(txBuffer);
+    // Forwards share the packet as it was received, so its forward bit is cleared here
+    const uint8_t kForwardBit = 0x40;  // In the first byte of the header
+    if (txPacket.relay) txBuffer[0] &= ~kForwardBit;
+
+    // Send the packet on the wire
+    auto txSuccess = f(&txBuffer, size);
+    if (capture) capture->tx(ms, txSuccess, txBuffer.data(), size);
+    csma.attempted(ms, !txSuccess);
+    if (txSuccess) {
+      // 15ms + 2ms per byte before we're allowed to send again.
+      // No idea why these values, they came from the stm32 Fanet implementation.
+      csmaNextTx = ms + 15 + (size * 2);
+      stats.txSuccess++;
+      csma.sent(txPacket.retries);
+
+#if FANET_INSTRUMENTATION
+      instrumentation.txDwellMs.record(ms > txPacket.rxTime ? ms - txPacket.rxTime : 0);
+      instrumentation.txLatenessMs.record(ms > txPacket.sendAt ? ms - txPacket.sendAt : 0);
+      instrumentation.csmaRetries.record(txPacket.retries);
+      instrumentation.txByType[(uint8_t)txPacket.packet->header.type & 0x07]++;
+
+      // Time the round trip of our own frames requesting an ack
+      auto& extHeader = txPacket.packet->extHeader;
+      if (txPacket.packet->header.srcMac == src && extHeader.has_value() &&
+          extHeader.value().ackType != ExtendedHeaderAckType::None &&
+          extHeader.value().destinationMac.has_value()) {
+        for (auto pending = pendingAcks.begin(); pending != pendingAcks.end();) {
+          if (ms - pending->sentAt > FANET_ACK_TIMEOUT) {
+            pending = pendingAcks.erase(pending);
+            instrumentation.ackTimeouts++;
+          } else {
+            pending++;
+          }
+        }
+        if (!pendingAcks.full()) {
+          pendingAcks.push_back({extHeader.value().destinationMac.value().toInt32(), ms});
+        }
+      }
+#endif
+
+      // If this was a location packet sent from us, update the debug variable
+      if (txPacket.packet->header.srcMac == src &&
+          txPacket.packet->header.type == PacketType::Tracking)
+        lastLocationSentMs = ms;
+      txQueue.pop_front();
+    } else {
+      // If the transmit failed, (the channel was busy), back off before trying again
+      csmaNextTx = ms + csma.backoff(txPacket.retries, random);
+      stats.txFailed++;
+      if (txPacket.retries < UINT8_MAX) txPacket.retries++;
+    }
+  }
+
+  template <typename Config>
+  etl::optional<unsigned long> BasicFanetManager<Config>::nextTxTime(const unsigned long& ms) {
+    // Find the first eligible packet to send, removing those that are now too old from
+    // the send queue
+    expireTxQueue(ms);
+    if (!txQueue.empty()) {
+      return etl::max(txQueue.front().sendAt, csmaNextTx);
+    }
+
+    // If we're here, there's nothing to send!  Our send queue is empty!
+    return etl::optional<unsigned long>();
+  }
+
+  template <typename Config>
+  etl::optional<unsigned long> BasicFanetManager<Config>::nextEventTime(
+      const unsigned long& ms) const {
+    etl::optional<unsigned long> next;
+    auto consider = [&next](const unsigned long& at) {
+      if (!next.has_value() || at < next.value()) next = at;
+    };
+
+    // Our next frame, (frames too old to send are dropped when we get to them)
+    if (!txQueue.empty()) consider(etl::max(txQueue.front().sendAt, csmaNextTx));
+
+    auto tracking = nextTrackingTime();
+    if (tracking.has_value()) consider(tracking.value());
+
+    if (nextNeighborExpiry.has_value()) consider(nextNeighborExpiry.value());
+
+    if (next.has_value() && next.value() < ms) next = ms;
+    return next;
+  }
+
+  template <typename Config>
+  etl::optional<unsigned long> BasicFanetManager<Config>::service(
+      const unsigned long& ms,
+      etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                         const size_t& size)> f) {
+    if (nextNeighborExpiry.has_value() && ms >= nextNeighborExpiry.value()) expireNeighbors(ms);
+
+    // Shedding eases even if nothing's received
+    if (load.measuring()) load.roll(ms);
+
+    // Receivers need to hear from us every so often, even if the application hasn't given us a
+    // new position since
+    auto tracking = nextTrackingTime();
+    if (tracking.has_value() && ms >= tracking.value()) queueTrackingUpdate(ms);
+
+    expireTxQueue(ms);
+    if (!txQueue.empty() && ms >= etl::max(txQueue.front().sendAt, csmaNextTx)) doTx(ms, f);
+
+    return nextEventTime(ms);
+  }
+
+  template <typename Config>
+  etl::optional<unsigned long> BasicFanetManager<Config>::nextTrackingTime() const {
+    if (!hasPosition || !src.has_value()) return etl::nullopt;
+
+    // Nothing sent yet, (or our ground type changed), so as soon as we're allowed
+    auto& lastSent = deadReckoning.getLastSent();
+    if (!lastSent.has_value()) return nextAllowedTrackingTime;
+    return etl::max(lastSent.value().ms + deadReckoning.getMaxInterval(), nextAllowedTrackingTime);
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::expireTxQueue(const unsigned long& ms) {
+    for (auto it = txQueue.begin(); it != txQueue.end();) {
+      if (ms > it->rxTime + Config::maxSendAge) {
+        // If this packet has been in the queue for too long, drop it
+        it = txQueue.erase(it);
+        stats.txExpired++;
+      } else {
+        it++;
+      }
+    }
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::sendPacket(const PacketPayload& payload,
+                                             unsigned long ms,
+                                             const bool& shouldForward,
+                                             etl::optional<Mac> destinationMac,
+                                             const ExtendedHeaderAckType requestAck,
+                                             const bool& chooseAck) {
+    // Ask for the ack that will reach us: straight back from a destination we hear directly,
+    // or else forwarded back, (and the packet must be forwarded there too)
+    bool forward = shouldForward;
+    auto ackType = requestAck;
+    if (chooseAck && ackType != ExtendedHeaderAckType::None && destinationMac.has_value()) {
+      if (!forward && reachable(destinationMac.value(), ms)) {
+        ackType = ExtendedHeaderAckType::Requested;
+      } else {
+        ackType = ExtendedHeaderAckType::Forwarded;
+        forward = true;
+      }
+    }
+    if (!queuePacket(payload, ms, forward, destinationMac, ackType)) return false;
+
+    if (capture) {
+      etl::array<uint8_t, FANET_MAX_PACKET_SIZE> buffer;
+      auto size = txQueue.front().packet->encode(buffer);
+      capture->write(CaptureRecordType::Send, ms, 0, 0, buffer.data(), size);
+    }
+    return true;
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::queuePacket(const PacketPayload& payload,
+                                              unsigned long ms,
+                                              const bool& shouldForward,
+                                              etl::optional<Mac> destinationMac,
+                                              const ExtendedHeaderAckType requestAck) {
+    if (requestAck != ExtendedHeaderAckType::None && !destinationMac.has_value()) {
+      // Bad request, cannot request an ack for a broadcast
+      return false;
+    }
+
+    // Not yet initialized
+    if (!src.has_value()) {
+      return false;
+    }
+
+    // Put this onto the front of the send list.  Only forwarded packets have a delay, so, assume
+    // no sorting needed
+    if (txQueue.full()) {
+      // If we're full, remove the latest packet to send
+      txQueue.pop_back();
+    }
+
+    // Craft the packet to send, in place in the pool.  Our own packets take priority, so if it's
+    // full, forwards due last are dropped to make room.
+    auto ref = packetPool.acquire();
+    for (auto it = txQueue.end(); !ref && it != txQueue.begin();) {
+      if (!(--it)->relay) continue;
+      it = txQueue.erase(it);
+      stats.fwdPoolDrp++;
+      ref = packetPool.acquire();
+    }
+    if (!ref) {
+      stats.txPoolDrp++;
+      return false;
+    }
+    txQueue.emplace_front(ms, ref);
+    Packet& txPacket = packetPool.edit(ref);
+    txPacket.header.srcMac = src.value();
+    txPacket.header.hasExtensionHeader = false;
+    txPacket.header.shouldForward = shouldForward;
+    txPacket.payload = payload;
+    txPacket.extHeader.reset();
+
+    if (destinationMac.has_value() || requestAck != ExtendedHeaderAckType::None) {
+      txPacket.header.hasExtensionHeader = true;
+
+      // Populate the extension header fields and add it to the packet.
+      //
+      txPacket.extHeader.emplace();
+      auto& extHeader = txPacket.extHeader.value();
+      extHeader.ackType = requestAck;
+      extHeader.includesSignature = false;  // Also not supported
+      if (destinationMac.has_value()) extHeader.destinationMac = destinationMac.value();
+    }
+
+    txPacket.header.type = ((PacketPayloadBase*)&payload)->getType();
+    return true;
+  }
+
+  template <typename Config>
+  size_t BasicFanetManager<Config>::saveState(uint8_t* buffer,
+                                              const size_t& size,
+                                              const unsigned long& ms) const {
+    Detail::StateWriter writer(buffer, size);
+    auto& lastSent = deadReckoning.getLastSent();
+
+    writer.put('F', 1);
+    writer.put('S', 1);
+    writer.put(FANET_STATE_VERSION, 1);
+    writer.put(lastSent.has_value() ? Detail::kHasLastSent : 0, 1);
+    writer.put(neighborTable.size(), 2);
+    // When we're next allowed to send our position, (relative, as our clock will restart)
+    writer.put(nextAllowedTrackingTime > ms ? nextAllowedTrackingTime - ms : 0, 4);
+
+    // What receivers think our position is
+    if (lastSent.has_value()) {
+      auto& state = lastSent.value();
+      writer.put(ms - state.ms, 4);
+      writer.putFloat(state.location.latitude);
+      writer.putFloat(state.location.longitude);
+      writer.putFloat(state.altitude);
+      writer.putFloat(state.speed);
+      writer.put((uint16_t)state.heading, 2);
+      writer.putFloat(state.climbRate);
+    }
+
+    for (auto& entry : neighborTable) {
+      auto& neighbor = entry.second;
+      writer.put(neighbor.address.toInt32(), 3);
+      writer.put(ms - neighbor.lastSeen, 4);
+      writer.put((uint16_t)CaptureWriter::toHundredths(neighbor.rssi), 2);
+      writer.put((uint16_t)CaptureWriter::toHundredths(neighbor.snr), 2);
+      writer.put((neighbor.location.has_value() ? Detail::kHasLocation : 0) |
+                     (neighbor.altitude.has_value() ? Detail::kHasAltitude : 0) |
+                     (neighbor.groundTrackingType.has_value() ? Detail::kHasGroundType : 0) |
+                     (neighbor.route.direct && neighbor.route.directMs == neighbor.lastSeen
+                          ? Detail::kHeardDirect
+                          : 0),
+                 1);
+      if (neighbor.location.has_value()) writer.putLocation(neighbor.location.value());
+      if (neighbor.altitude.has_value()) {
+        writer.put(etl::min<uint32_t>(neighbor.altitude.value(), UINT16_MAX), 2);
+      }
+      if (neighbor.groundTrackingType.has_value()) {
+        writer.put((uint8_t)neighbor.groundTrackingType.value(), 1);
+      }
+    }
+
+    if (writer.overflowed()) return 0;
+    writer.put(etl::crc8_ccitt(buffer, buffer + writer.offset).value(), 1);
+    return writer.overflowed() ? 0 : writer.offset;
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::restoreState(const uint8_t* buffer,
+                                               const size_t& size,
+                                               const unsigned long& ms,
+                                               const unsigned long& elapsedMs) {
+    if (size < 11 || buffer[0] != 'F' || buffer[1] != 'S' || buffer[2] != FANET_STATE_VERSION) {
+      return false;
+    }
+
+    // Check it's all there before we change anything
+    Detail::StateReader reader(buffer, size);
+    reader.take(3);
+    uint8_t flags = reader.get(1);
+    uint16_t count = reader.get(2);
+    uint32_t trackingDelay = reader.get(4);
+    if (flags & Detail::kHasLastSent) reader.take(26);
+    for (uint16_t i = 0; i < count && !reader.overflowed(); i++) {
+      reader.take(11);
+      uint8_t neighborFlags = reader.get(1);
+      reader.take(((neighborFlags & Detail::kHasLocation) ? 6 : 0) +
+                  ((neighborFlags & Detail::kHasAltitude) ? 2 : 0) +
+                  ((neighborFlags & Detail::kHasGroundType) ? 1 : 0));
+    }
+    auto end = reader.offset;
+    if (reader.overflowed() || end >= size ||
+        etl::crc8_ccitt(buffer, buffer + end).value() != buffer[end]) {
+      return false;
+    }
+
+    // Only wait out what's left of the time until our next position update
+    nextAllowedTrackingTime = ms + (trackingDelay > elapsedMs ? trackingDelay - elapsedMs : 0);
+
+    reader = Detail::StateReader(buffer, end);
+    reader.take(10);
+    deadReckoning.reset();
+    if (flags & Detail::kHasLastSent) {
+      MotionState state;
+      unsigned long age = reader.get(4) + elapsedMs;
+      state.ms = ms - age;
+      state.location.latitude = reader.getFloat();
+      state.location.longitude = reader.getFloat();
+      state.altitude = reader.getFloat();
+      state.speed = reader.getFloat();
+      state.heading = (int16_t)reader.get(2);
+      state.climbRate = reader.getFloat();
+      // Receivers will have stopped extrapolating us if it's been too long
+      if (age < deadReckoning.getMaxInterval()) deadReckoning.sent(state);
+    }
+
+    // Everyone we had is replaced, (and the listener told they're gone)
+    for (auto& entry : neighborTable) releaseNeighbor(entry.second);
+    neighborTable.clear();
+    evictionQueue.clear();
+#if FANET_TRACK_HISTORY
+    trackHistory.clear();
+#endif
+#if FANET_NAME_CACHE
+    names.clear();
+#endif
+#if FANET_PROXIMITY
+    proximity.clear();
+#endif
+    for (uint16_t i = 0; i < count; i++) {
+      Neighbor neighbor;
+      uint32_t mac = reader.get(3);
+      neighbor.address.manufacturer = mac >> 16;
+      neighbor.address.device = mac & 0xFFFF;
+      unsigned long age = reader.get(4) + elapsedMs;
+      neighbor.lastSeen = ms - age;
+      neighbor.rssi = (int16_t)reader.get(2) / 100.0f;
+      neighbor.snr = (int16_t)reader.get(2) / 100.0f;
+      uint8_t neighborFlags = reader.get(1);
+      if (neighborFlags & Detail::kHeardDirect) {
+        neighbor.link.heard(neighbor.rssi, neighbor.snr);
+        neighbor.route.direct = true;
+        neighbor.route.directMs = neighbor.lastSeen;
+      }
+      if (neighborFlags & Detail::kHasLocation) {
+        neighbor.location = reader.getLocation();
+        neighbor.locationMs = neighbor.lastSeen;
+      }
+      if (neighborFlags & Detail::kHasAltitude) neighbor.altitude = reader.get(2);
+      if (neighborFlags & Detail::kHasGroundType) {
+        neighbor.groundTrackingType = (GroundTrackingType::enum_type)reader.get(1);
+      }
+
+      // Drop those that would have timed out while we were away
+      if (age > Config::neighborMaxTimeout || neighborTable.full()) continue;
+      neighborTable.insert(etl::pair<uint32_t, Neighbor>(mac, neighbor));
+    }
+    expireNeighbors(ms);
+    updateDistances();
+    return true;
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::flushOldNeighborEntries(const unsigned long& currentMs) {
+    expireNeighbors(currentMs);
+    if (neighborTable.full()) evictNeighbor();
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::rankNeighbor(Neighbor& neighbor) {
+    // Keep the scores near zero, where a float has the precision to tell them apart
+    if ((int32_t)(neighbor.lastSeen - evictionEpoch) > (int32_t)kEvictionEpochSpan) {
+      rankNeighbors();
+      return;
+    }
+    EvictionContext us;
+    us.hasPosition = hasPosition;
+    us.altitude = hasPosition ? alt : 0.0f;
+    us.epoch = evictionEpoch;
+    neighbor.eviction = evictionQueue.update(neighbor.eviction, neighbor.address.toInt32(),
+                                             getEvictionPolicy().score(neighbor, us));
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::rankNeighbors() {
+    // Neighbors are all seen within a timeout of each other, so count from any of them
+    if (!neighborTable.empty()) evictionEpoch = neighborTable.begin()->second.lastSeen;
+    EvictionContext us;
+    us.hasPosition = hasPosition;
+    us.altitude = hasPosition ? alt : 0.0f;
+    us.epoch = evictionEpoch;
+    auto& policy = getEvictionPolicy();
+    for (auto& entry : neighborTable) {
+      auto& neighbor = entry.second;
+      neighbor.eviction = evictionQueue.set(neighbor.eviction, neighbor.address.toInt32(),
+                                            policy.score(neighbor, us));
+    }
+    evictionQueue.reorder();
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::evictNeighbor() {
+    uint32_t address;
+    if (!evictionQueue.lowest(address)) return;
+    auto it = neighborTable.find(address);
+    if (it == neighborTable.end()) return;
+    releaseNeighbor(it->second);
+    neighborTable.erase(it);
+    stats.neighborsEvicted++;
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::releaseNeighbor(const Neighbor& neighbor) {
+    if (neighborListener.is_valid()) neighborListener(neighbor, true);
+    evictionQueue.release(neighbor.eviction);
+#if FANET_TRACK_HISTORY
+    trackHistory.release(neighbor.track);
+#endif
+#if FANET_NAME_CACHE
+    names.release(neighbor.name);
+#endif
+#if FANET_PROXIMITY
+    proximity.release(neighbor.proximity);
+#endif
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::expireNeighbors(const unsigned long& ms) {
+    nextNeighborExpiry = etl::nullopt;
+    for (auto it = neighborTable.begin(); it != neighborTable.end();) {
+      if (ms - it->second.lastSeen > Config::neighborMaxTimeout) {
+        releaseNeighbor(it->second);
+        it = neighborTable.erase(it);
+        continue;
+      }
+
+      // Wait out the slack before the next expiry, so ones close together are done at once
+      unsigned long expiry =
+          it->second.lastSeen + Config::neighborMaxTimeout + 1 + Config::neighborExpirySlack;
+      if (!nextNeighborExpiry.has_value() || expiry < nextNeighborExpiry.value()) {
+        nextNeighborExpiry = expiry;
+      }
+      it++;
+    }
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::shed(const Packet& packet,
+                                       const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+                                       const size_t& offset,
+                                       const size_t& size,
+                                       const unsigned long& ms,
+                                       const float& rssi,
+                                       const float& snr) {
+    if (packet.extHeader.has_value() && packet.extHeader.value().destinationMac == src) {
+      return false;
+    }
+
+    // Names and messages can wait, unless a message is to be forwarded, which can't.  (Names'
+    // forwards are shed by now anyway.)
+    auto type = packet.header.type;
+    if (type == PacketType::Name ||
+        (type == PacketType::Message && !packet.header.shouldForward)) {
+      stats.shedDeferred++;
+      if (!load.defer(bytes, size, rssi, snr)) stats.shedDeferDrp++;
+      return true;
+    }
+
+    // As can positions from neighbors we've had one from recently, unless they need help
+    if (load.getLevel() < LoadLevel::SampleTracking) return false;
+    if (type != PacketType::Tracking && type != PacketType::GroundTracking) return false;
+    auto it = neighborTable.find(packet.header.srcMac.toInt32());
+    if (it == neighborTable.end() || !it->second.location.has_value() ||
+        ms - it->second.locationMs >= FANET_LOAD_SAMPLE_MS) {
+      return false;
+    }
+    InterestPosition position;
+    if (type == PacketType::GroundTracking && offset < size &&
+        InterestPosition::peek(type, bytes.data() + offset, size - offset, position) &&
+        callsForHelp(position.groundType.value())) {
+      return false;
+    }
+    stats.shedTracking++;
+    return true;
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::handleDeferred(const unsigned long& ms, Packet& packet) {
+    if (!deferred()) return false;
+    auto& frames = load.getDeferred();
+    auto& frame = frames.front();
+    bool useful = receive(frame.bytes, frame.size, ms, frame.rssi, frame.snr, packet, PacketRef(),
+                          true);
+    frames.pop_front();
+    return useful;
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::queueForwardFrame(const Packet& packet,
+                                                     const float& rssi,
+                                                     const unsigned long& ms,
+                                                     const PacketRef& shared) {
+    // Check this packet already in our tx Queue?  (Queued forwards are sent with the forward
+    // flag cleared, so it's ignored)
+    if (overheardCopy(packet, rssi, ms)) {
+      return;
+    }
+
+    // If the packet is destined for a neighbor that's not in our neighbor table, (or that we
+    // hear too poorly), assume we can't deliver it there and drop the packet.
+    if (packet.extHeader.has_value() && packet.extHeader.value().destinationMac.has_value()) {
+      auto& destination = packet.extHeader.value().destinationMac.value();
+      if (!reachable(destination, ms)) {
+        stats.fwdNeighborDrp++;
+        return;
+      }
+
+      // Nor if its sender reaches the destination itself
+      if (oneHop(packet.header.srcMac, destination, ms)) {
+        stats.fwdOneHopDrp++;
+        return;
+      }
+    }
+
+    // Forwarding only helps if it reaches somewhere the sender couldn't
+    if (!extendsCoverage(packet, ms)) {
+      stats.fwdGeoDrp++;
+      return;
+    }
+
+    // Let the forwarding policy decide if, and when, this frame is worth forwarding.  The packet
+    // is only copied, (if it isn't already in the pool), once it's been admitted.
+    TxSchedule schedule(ms, rssi, ms);
+    switch (getForwardPolicy().admit(schedule, neighborTable.size(), random)) {
+      case ForwardVerdict::RssiDrop:
+        stats.fwdMinRssiDrp++;
+        return;
+      case ForwardVerdict::Suppressed:
+        stats.fwdSuppressedDrp++;
+        return;
+      case ForwardVerdict::Forward:
+        break;
+    }
+
+    // Our own packets take priority over forwarding others
+    if (txQueue.full()) {
+      stats.fwdQueueFullDrp++;
+      return;
+    }
+
+    // Share the packet's slot, or copy it into one
+    PacketRef ref = shared;
+    if (!ref) {
+      ref = packetPool.acquire();
+      if (!ref) {
+        stats.fwdPoolDrp++;
+        return;
+      }
+      packetPool.edit(ref) = packet;
+    }
+
+    // put the packet on the back of the tx queue, (it's sent with its forward flag cleared)
+    stats.forwarded++;
+#if FANET_INSTRUMENTATION
+    auto sender = neighborTable.find(packet.header.srcMac.toInt32());
+    if (sender != neighborTable.end()) sender->second.forwardCount++;
+#endif
+    txQueue.emplace_back(schedule, ref);
+
+    // ensure the packet is sorted
+    sortTxQueue();
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::sortTxQueue() {
+    // Insertion sort, splicing each frame back past those due later
+    if (txQueue.empty()) return;
+    auto next = txQueue.begin();
+    for (next++; next != txQueue.end();) {
+      auto it = next++;
+      auto to = it;
+      while (to != txQueue.begin()) {
+        auto previous = to;
+        previous--;
+        if (!(it->sendAt < previous->sendAt)) break;
+        to = previous;
+      }
+      if (to != it) txQueue.splice(to, txQueue, it);
+    }
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::reachable(const Mac& address, const unsigned long& ms) const {
+    auto it = neighborTable.find(address.toInt32());
+    return it != neighborTable.end() && it->second.route.type(ms) == RouteType::Direct &&
+           it->second.link.score() >= Config::linkMinScore;
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::oneHop(const Mac& source,
+                                         const Mac& destination,
+                                         const unsigned long& ms) const {
+    auto from = neighborTable.find(source.toInt32());
+    if (from != neighborTable.end() && from->second.route.reaches(destination.toInt32(), ms)) {
+      return true;
+    }
+    auto to = neighborTable.find(destination.toInt32());
+    return to != neighborTable.end() && to->second.route.reaches(source.toInt32(), ms);
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::interesting(
+      const Packet& packet,
+      const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes,
+      const size_t& offset,
+      const size_t& size) const {
+    if (interests.empty()) return true;
+
+    // Frames addressed to us, (acks among them), are always ours to handle
+    if (packet.extHeader.has_value() && packet.extHeader.value().destinationMac.has_value() &&
+        packet.extHeader.value().destinationMac.value() == src) {
+      return true;
+    }
+
+    // The header rules out most frames, or matches them outright
+    uint8_t candidates = interests.matchHeader(packet.header.type, packet.header.srcMac.toInt32());
+    if (!interests.needPosition(candidates)) return candidates != 0;
+
+    // Then the position, from the location bytes if the frame has them, or where its sender
+    // last was
+    InterestPosition position;
+    if (!InterestPosition::peek(packet.header.type, bytes.data() + offset,
+                                size > offset ? size - offset : 0, position)) {
+      auto sender = neighborTable.find(packet.header.srcMac.toInt32());
+      if (sender != neighborTable.end()) {
+        auto& neighbor = sender->second;
+        position.location = neighbor.location;
+        if (neighbor.altitude.has_value()) position.altitude = neighbor.altitude.value();
+        position.groundType = neighbor.groundTrackingType;
+      }
+    }
+    return interests.matchPosition(candidates, position);
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::relaying(const Mac& source) const {
+    for (auto& txPacket : txQueue) {
+      if (txPacket.relay && txPacket.packet->header.srcMac == source) return true;
+    }
+    return false;
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::extendsCoverage(const Packet& packet,
+                                                  const unsigned long& ms) const {
+    // Without a recent position for the sender, leave it to the forward policy
+    auto sender = neighborTable.find(packet.header.srcMac.toInt32());
+    if (sender == neighborTable.end() || sender->second.distance < 0.0f ||
+        ms - sender->second.locationMs > Config::forwardMaxLocationAge) {
+      return true;
+    }
+    if (sender->second.distance >= Config::forwardMinDistance) return true;
+
+    // We're close to the sender, but may still be nearer a unicast's destination
+    if (!packet.extHeader.has_value() || !packet.extHeader.value().destinationMac.has_value()) {
+      return false;
+    }
+    auto dst = neighborTable.find(packet.extHeader.value().destinationMac.value().toInt32());
+    if (dst == neighborTable.end() || dst->second.distance < 0.0f ||
+        ms - dst->second.locationMs > Config::forwardMaxLocationAge) {
+      return true;
+    }
+    return dst->second.distance <
+           sender->second.location.value().distanceTo(dst->second.location.value());
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::updateDistances() {
+    // Positions are copied out a batch at a time, so the distances can be vectorized
+    const size_t kBatch = 16;
+    float latitudes[kBatch];
+    float longitudes[kBatch];
+    float distances[kBatch];
+    if (!hasPosition) {
+      for (auto& entry : neighborTable) entry.second.distance = -1.0f;
+      rankNeighbors();
+      return;
+    }
+    auto here = ownLocation();
+    auto it = neighborTable.begin();
+    while (it != neighborTable.end()) {
+      auto first = it;
+      size_t count = 0;
+      for (; it != neighborTable.end() && count < kBatch; it++, count++) {
+        auto& location = it->second.location;
+        latitudes[count] = location.has_value() ? location.value().latitude : here.latitude;
+        longitudes[count] = location.has_value() ? location.value().longitude : here.longitude;
+      }
+      squaredDistances(here, latitudes, longitudes, count, distances);
+      for (size_t i = 0; i < count; i++, first++) {
+        first->second.distance =
+            first->second.location.has_value() ? sqrtf(distances[i]) : -1.0f;
+      }
+    }
+
+    // Relevance depends on how far away they are
+    rankNeighbors();
+  }
+
+  template <typename Config>
+  bool BasicFanetManager<Config>::overheardCopy(const Packet& packet,
+                                                const float& rssi,
+                                                const unsigned long& ms) {
+    for (auto it = txQueue.begin(); it != txQueue.end(); it++) {
+      if (!it->packet->sameFrame(packet)) {
+        continue;
+      }
+
+      switch (getForwardPolicy().copyHeard(*it, rssi, ms, random)) {
+        case ForwardVerdict::RssiDrop:
+          txQueue.erase(it);
+          stats.fwdDbBoostDrop++;
+          break;
+        case ForwardVerdict::Suppressed:
+          txQueue.erase(it);
+          stats.fwdSuppressedDrp++;
+          break;
+        case ForwardVerdict::Forward:
+          // The policy may have moved the send time
+          sortTxQueue();
+          stats.fwdEnqueuedDrop++;
+          break;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::queueTrackingUpdate(const unsigned long& ms) {
+    // We have another tracking location that needs to go out.
+
+    // If we're too close to our previous update time, don't do anything with this location update
+    // Or we have not been initialized yet
+    if (!src.has_value() || ms < nextAllowedTrackingTime) {
+      return;
+    }
+
+    // Only send if receivers extrapolating our last sent position would be too far off
+    MotionState current;
+    current.location.latitude = lat;
+    current.location.longitude = lng;
+    current.ms = ms;
+    if (!groundType.has_value()) {
+      current.altitude = alt;
+      current.speed = speed;
+      current.heading = heading;
+      current.climbRate = climbRate;
+    }
+    if (!deadReckoning.shouldSend(current)) {
+      stats.trackingSuppressed++;
+      return;
+    }
+
+    // Add a random 500ms splay to the tracking updates to ensure
+    // if multiple nodes are getting GPS updates all synchronized, we don't
+    // all TX at the same time.
+    auto offset = random.range(75, 500);
+
+    // Insert a location packet
+    if (groundType.has_value()) {
+      // This is a ground tracking update
+      if constexpr (Packet::template supports<GroundTracking>()) {
+        auto payload = GroundTracking();
+        payload.location.latitude = lat;
+        payload.location.longitude = lng;
+        payload.shouldTrackOnline = true;
+        payload.type = groundType.value();
+        queuePacket(payload, ms + offset, true, etl::nullopt, ExtendedHeaderAckType::None);
+      }
+    } else {
+      if constexpr (Packet::template supports<Tracking>()) {
+        auto payload = Tracking();
+        payload.aircraftType = aircraftType;
+        payload.altitude = alt;
+        payload.climbRate = climbRate;
+        payload.heading = heading;
+        payload.location.latitude = lat;
+        payload.location.longitude = lng;
+        payload.onlineTracking = true;
+        payload.speed = speed;
+        queuePacket(payload, ms + offset, true, etl::nullopt, ExtendedHeaderAckType::None);
+      }
+    }
+
+    deadReckoning.sent(current);
+
+    // Location update interval is
+    // recommended interval: floor((#neighbors/10 + 1) * 5s)
+    nextAllowedTrackingTime = ms + offset + floor((neighborTable.size() / 10.0f + 1) + 5000);
+  }
+
+#if FANET_PROXIMITY
+  template <typename Config>
+  void BasicFanetManager<Config>::evaluateProximity(const unsigned long& ms) {
+    // Only while we're flying
+    if (groundType.has_value()) {
+      proximityLevel = ProximityLevel::None;
+      return;
+    }
+
+    MotionState own;
+    own.location.latitude = lat;
+    own.location.longitude = lng;
+    own.altitude = alt;
+    own.speed = speed;
+    own.heading = heading;
+    own.climbRate = climbRate;
+    own.ms = ms;
+    proximityLevel = proximity.evaluate(own, ms);
+  }
+
+  template <typename Config>
+  etl::vector<ProximityAlert, FANET_PROXIMITY_MAX_ALERTS> BasicFanetManager<Config>::getAlerts()
+      const {
+    etl::vector<ProximityAlert, FANET_PROXIMITY_MAX_ALERTS> alerts;
+    if (proximityLevel != ProximityLevel::None) proximity.getAlerts(alerts);
+    return alerts;
+  }
+#endif
+
+  template <typename Config>
+  void BasicFanetManager<Config>::setCapture(CaptureWriter* writer, const unsigned long& ms) {
+    capture = writer;
+    if (!capture) return;
+
+    CaptureBegin begin;
+    begin.mac = src.has_value() ? src.value().toInt32() : 0;
+    begin.seed = seed;
+    capture->begin(ms, begin);
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::captureStats(const unsigned long& ms) {
+    if (!capture) return;
+    auto current = getStats();
+    uint32_t counters[kStatFieldCount];
+    for (size_t i = 0; i < kStatFieldCount; i++) counters[i] = current.*kStatFields[i].field;
+    uint8_t body[kStatFieldCount * 4];
+    CaptureStats::encode(counters, kStatFieldCount, body);
+    capture->write(CaptureRecordType::Stats, ms, 0, 0, body, sizeof(body));
+  }
+
+  template <typename Config>
+  void BasicFanetManager<Config>::capturePosition(const unsigned long& ms) {
+    CapturePosition position;
+    position.lat = lat;
+    position.lng = lng;
+    position.alt = alt;
+    position.heading = heading;
+    position.climbRate = climbRate;
+    position.speed = speed;
+    if (groundType.has_value()) position.groundType = (uint8_t)groundType.value();
+    position.aircraftType = (uint8_t)aircraftType;
+    capture->position(ms, position);
+  }
+
+#if FANET_INSTRUMENTATION
+  template <typename Config>
+  void BasicFanetManager<Config>::resetInstrumentation() {
+    instrumentation = Instrumentation();
+    for (auto& entry : neighborTable) {
+      entry.second.rxCount = 0;
+      entry.second.forwardCount = 0;
+    }
+  }
+#endif
+}  // namespace Fanet
@@ -11,8 +11,10 @@ bool Fanet::Name::operator==(const PacketPayloadBase& other) const {
 size_t Fanet::Name::parse(etl::bit_stream_reader& reader) {
   auto byte = reader.read<uint8_t>(8U);
   int i = 0;
+  name.clear();
   while (byte.has_value() && byte.value() != '\0') {
-    name[i++] = byte.value();
+    if (!name.full()) name.push_back(byte.value());
+    i++;
     byte = reader.read<uint8_t>(8U);
   }
   return i;
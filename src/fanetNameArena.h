@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "etl/array.h"
+#include "etl/string_view.h"
+
+// Set to 1 for the manager to keep the names neighbors send, (see FanetManager::getName)
+#ifndef FANET_NAME_CACHE
+#define FANET_NAME_CACHE 0
+#endif
+
+#ifndef FANET_NAME_BYTES
+#define FANET_NAME_BYTES 2048  // Bytes shared by every neighbor's name
+#endif
+
+namespace Fanet {
+
+  const uint16_t kNoName = 0xFFFF;  // Not a name in a NameArena
+
+  /// @brief FNV-1a hash of a name, up to its terminator or length bytes
+  inline uint32_t hashName(const uint8_t* bytes, const size_t& length) {
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < length && bytes[i]; i++) {
+      hash = (hash ^ bytes[i]) * 16777619UL;
+    }
+    return hash;
+  }
+
+  /*
+  @brief Names of a number of neighbors, packed end to end in a fixed arena
+
+  Names are appended to the arena, and the gaps left by names that are replaced or released are
+  only closed up when there's no room left at the end.  Each name keeps its hash, so repeated
+  names can be recognised, and names looked up, without comparing strings.
+  */
+  template <size_t NAMES, size_t BYTES>
+  class NameArena {
+   public:
+    /// @brief Stores a name, replacing the one already in the slot if it's the owner's
+    /// @param index Slot of the owner's current name, or kNoName
+    /// @param owner Address the name belongs to
+    /// @param hash hashName of the name
+    /// @return The slot, or kNoName if the arena is full, (or the name is empty)
+    uint16_t add(uint16_t index,
+                 const uint32_t& owner,
+                 const uint32_t& hash,
+                 const char* name,
+                 size_t length) {
+      if (index < NAMES && entries[index].used && entries[index].owner == owner) {
+        release(index);
+      } else {
+        for (index = 0; index < NAMES && entries[index].used; index++) {
+        }
+        if (index == NAMES) return kNoName;
+      }
+
+      if (!length) return kNoName;
+      if (length > UINT8_MAX) length = UINT8_MAX;
+      if (end + length > BYTES) compact();
+      if (end + length > BYTES) return kNoName;
+
+      auto& entry = entries[index];
+      memcpy(bytes.data() + end, name, length);
+      entry.owner = owner;
+      entry.hash = hash;
+      entry.offset = end;
+      entry.length = length;
+      entry.used = true;
+      end += length;
+      return index;
+    }
+
+    /// @brief Frees a name
+    void release(const uint16_t& index) {
+      if (index < NAMES) entries[index].used = false;
+    }
+
+    /// @brief Frees every name
+    void clear() {
+      for (auto& entry : entries) entry.used = false;
+      end = 0;
+    }
+
+    /// @brief A name, empty if the slot's not in use.  Valid until the next add.
+    etl::string_view get(const uint16_t& index) const {
+      if (index >= NAMES || !entries[index].used) return etl::string_view();
+      return etl::string_view(bytes.data() + entries[index].offset, entries[index].length);
+    }
+
+    /// @brief Hash of a name, 0 if the slot's not in use
+    uint32_t hash(const uint16_t& index) const {
+      return index < NAMES && entries[index].used ? entries[index].hash : 0;
+    }
+
+    /// @brief Finds the owner of a name
+    /// @return false if no one has it
+    bool find(const etl::string_view& name, uint32_t& owner) const {
+      uint32_t hash = hashName((const uint8_t*)name.data(), name.size());
+      for (auto& entry : entries) {
+        if (entry.used && entry.hash == hash && entry.length == name.size() &&
+            !memcmp(bytes.data() + entry.offset, name.data(), name.size())) {
+          owner = entry.owner;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /// @brief Bytes at the end of the arena not yet used, (gaps are reclaimed when needed)
+    size_t available() const { return BYTES - end; }
+
+   protected:
+    struct Entry {
+      uint32_t owner;
+      uint32_t hash;
+      uint16_t offset;
+      uint8_t length;
+      bool used;
+    };
+
+    /// @brief Moves the names in use down to close up the gaps between them
+    void compact() {
+      uint16_t to = 0;
+      while (true) {
+        // The name nearest the start that hasn't been moved yet
+        Entry* next = nullptr;
+        for (auto& entry : entries) {
+          if (entry.used && entry.offset >= to && (!next || entry.offset < next->offset)) {
+            next = &entry;
+          }
+        }
+        if (!next) break;
+        memmove(bytes.data() + to, bytes.data() + next->offset, next->length);
+        next->offset = to;
+        to += next->length;
+      }
+      end = to;
+    }
+
+    etl::array<Entry, NAMES> entries = {};
+    etl::array<char, BYTES> bytes;
+    uint16_t end = 0;  // Where the next name goes
+  };
+}  // namespace Fanet
@@ -1,9 +1,17 @@
 #pragma once
 
 #include "etl/optional.h"
+#include "fanetEviction.h"
 #include "fanetGroundTracking.h"
+#include "fanetInstrumentation.h"
+#include "fanetLinkQuality.h"
 #include "fanetLocation.h"
 #include "fanetMac.h"
+#include "fanetNameArena.h"
+#include "fanetProximity.h"
+#include "fanetRoute.h"
+#include "fanetTrackHistory.h"
+#include "fanetTracking.h"
 
 namespace Fanet {
 
@@ -12,10 +20,33 @@ namespace Fanet {
     etl::optional<Location> location = etl::nullopt;
     etl::optional<uint32_t> altitude = etl::nullopt;
     etl::optional<GroundTrackingType> groundTrackingType = etl::nullopt;
+    float speed = 0.0f;            // km/h, as last sent in a tracking frame
+    float climbRate = 0.0f;        // m/s
+    int16_t heading = 0;           // degrees
+    AircraftType aircraftType = AircraftType::Other;  // As last sent in a tracking frame
+    unsigned long locationMs = 0;  // When location was received
+    float distance = -1.0f;        // Meters from us, negative if either position is unknown
     Mac address;
-    float rssi = 0.0f;
+    float rssi = 0.0f;  // Of the last frame heard directly, (link has the averages)
     float snr = 0.0f;
+    LinkQuality link;   // How well we hear this neighbor, (directly, not through relays)
+    Route route;        // If we hear it directly or through relays, and who it reaches
     unsigned long lastSeen = 0;
+    uint16_t eviction = kNoEviction;  // Where the manager ranks this neighbor for eviction
+#if FANET_INSTRUMENTATION
+    uint32_t rxCount = 0;       // Frames received from this neighbor
+    uint32_t forwardCount = 0;  // Frames from this neighbor we've queued to forward
+#endif
+#if FANET_TRACK_HISTORY
+    uint16_t track = kNoTrack;  // Where the manager keeps this neighbor's track history
+#endif
+#if FANET_PROXIMITY
+    uint16_t proximity = kNoProximity;  // Where the manager keeps this neighbor's motion
+#endif
+#if FANET_NAME_CACHE
+    uint16_t name = kNoName;  // Where the manager keeps this neighbor's name
+    uint32_t nameHash = 0;    // hashName of the name, 0 if we don't know it
+#endif
   };
 
 }  // namespace Fanet
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include "fanetAck.h"
 
 #include <etl/optional.h>
+#include <etl/type_traits.h>
 #include <etl/variant.h>
 #include <etl/checksum.h>
 #include <etl/bit_stream.h>
@@ -24,6 +25,8 @@
 
 namespace Fanet
 {
+    // Every payload type.  A build that doesn't need them all can list fewer in its config,
+    // (see fanetConfig.h), and only pays for those.  Ack must always be included.
     using PacketPayload = etl::variant<
         Ack,      // Type 0
         Tracking, // Type 1
@@ -33,10 +36,24 @@ namespace Fanet
         GroundTracking // Type 7
         >;
 
+    /// @brief True if a payload type is one of those a variant can hold
+    template <typename T, typename Payload>
+    struct PayloadSupports;
+
+    template <typename T, typename... Ts>
+    struct PayloadSupports<T, etl::variant<Ts...>>
+        : etl::bool_constant<etl::is_one_of<T, Ts...>::value>
+    {
+    };
+
     /*
         A Fanet+ Packet, (typically intended to be sent over LoRa)
+
+        Payload is the variant of payload types this packet can carry.  Frames of other types
+        are parsed for their headers only, leaving the payload as its first type.
     */
-    class Packet
+    template <typename Payload>
+    class BasicPacket
     {
     public:
         Header header;
@@ -45,16 +62,52 @@ namespace Fanet
         // All packet payloads can be treated as a PacketPayloadBase
         // To get a packet of type Tracking for instance, you'd use
         // auto trackingPayload = etl::get<Tracking>(packet.payload)
-        PacketPayload payload;
+        Payload payload;
+
+        /// @brief Whether this packet can carry a payload type
+        template <typename T>
+        static constexpr bool supports() { return PayloadSupports<T, Payload>::value; }
+
+        /// @brief False for frames of a type this packet can't carry, (their payloads are skipped)
+        static constexpr bool carries(const PacketType &type)
+        {
+            return (type != PacketType::Tracking || supports<Tracking>()) &&
+                   (type != PacketType::Name || supports<Name>()) &&
+                   (type != PacketType::Message || supports<Message>()) &&
+                   (type != PacketType::GroundTracking || supports<GroundTracking>());
+        }
 
         // Parses a byte stream, will return a packet
-        static Packet parse(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes, size_t length);
+        static BasicPacket parse(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes, size_t length);
+
+        // Parses a byte stream into an existing packet, in place, (nothing is copied out), returns
+        // the bytes parsed
+        static size_t parseInto(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes, size_t length, BasicPacket &packet);
+
+        // Parses just the header and extended header of a byte stream into a packet, returns the
+        // offset of the payload
+        static size_t parseHeaders(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes, size_t length, BasicPacket &packet);
+
+        // Parses the payload of a byte stream into a packet whose headers parseHeaders has
+        // already parsed, (offset is what it returned), returns the bytes parsed in all
+        static size_t parsePayload(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes, size_t length, size_t offset, BasicPacket &packet);
 
         // Encodes the packet to a byte stream, returns the length of bytes
         // encoded packet
         size_t encode(etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes) const;
 
-        bool operator==(const Packet &other) const;
+        bool operator==(const BasicPacket &other) const;
+
+        // Whether two packets are the same frame, ignoring the forward bit, (so a forward matches
+        // the frame it repeats)
+        bool sameFrame(const BasicPacket &other) const;
+
+        static_assert(PayloadSupports<Ack, Payload>::value, "Packets must support Acks");
     };
 
-}
\ No newline at end of file
+    using Packet = BasicPacket<PacketPayload>;
+
+    // Packets with every payload type are built in fanetPacket.cpp, other packets need
+    // fanetPacketImpl.h
+    extern template class BasicPacket<PacketPayload>;
+}
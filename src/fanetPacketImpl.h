@@ -0,0 +1,165 @@
+#pragma once
+
+/*
+  Definitions of BasicPacket.  Only needed by code using packets with fewer payload types than
+  PacketPayload, (Packet itself is built in fanetPacket.cpp).
+*/
+
+#include "fanetPacket.h"
+#include <etl/optional.h>
+#include <etl/bit_stream.h>
+
+namespace Fanet
+{
+namespace Detail
+{
+  /// @brief Sets a payload to an empty T, if the variant can hold one
+  /// @return false if it can't
+  template <typename T, typename Payload>
+  typename etl::enable_if<PayloadSupports<T, Payload>::value, bool>::type setPayload(Payload &payload)
+  {
+    payload.template emplace<T>();
+    return true;
+  }
+
+  template <typename T, typename Payload>
+  typename etl::enable_if<!PayloadSupports<T, Payload>::value, bool>::type setPayload(Payload &)
+  {
+    return false;
+  }
+}
+
+template <typename Payload>
+size_t BasicPacket<Payload>::parseHeaders(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes, size_t length, BasicPacket &packet)
+{
+  etl::bit_stream_reader reader((void*)(&bytes.data()[0]), length, etl::endian::big);
+
+  // Parse the packet header
+  size_t bytesParsed = packet.header.parse(reader);
+
+  // If there's any extended header attributes, parse them
+  if (packet.header.hasExtensionHeader)
+  {
+    packet.extHeader.emplace();
+    bytesParsed += packet.extHeader.value().parse(reader);
+  }
+  else
+  {
+    packet.extHeader.reset();
+  }
+  return bytesParsed;
+}
+
+template <typename Payload>
+BasicPacket<Payload> BasicPacket<Payload>::parse(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes, size_t length)
+{
+  BasicPacket packet;
+  parseInto(bytes, length, packet);
+  return packet;
+}
+
+template <typename Payload>
+size_t BasicPacket<Payload>::parseInto(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes, size_t length, BasicPacket &packet)
+{
+  return parsePayload(bytes, length, parseHeaders(bytes, length, packet), packet);
+}
+
+template <typename Payload>
+size_t BasicPacket<Payload>::parsePayload(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes, size_t length, size_t bytesParsed, BasicPacket &packet)
+{
+  etl::bit_stream_reader reader((void*)(&bytes.data()[bytesParsed]), length > bytesParsed ? length - bytesParsed : 0, etl::endian::big);
+
+  // Parse the payload of the packet
+  bool supported = false;
+  switch (packet.header.type)
+  {
+  case PacketType::Ack:
+    supported = Detail::setPayload<Ack>(packet.payload);
+    break;
+  case PacketType::Tracking:
+    supported = Detail::setPayload<Tracking>(packet.payload);
+    break;
+  case PacketType::Name:
+    supported = Detail::setPayload<Name>(packet.payload);
+    break;
+  case PacketType::Message:
+    supported = Detail::setPayload<Message>(packet.payload);
+    break;
+  case PacketType::Service:
+    break; // Not Supported
+  case PacketType::Landmarks:
+    break; // Not Supported
+  case PacketType::RemoteConfig:
+    break; // Not Supported
+  case PacketType::GroundTracking:
+    supported = Detail::setPayload<GroundTracking>(packet.payload);
+    break;
+  }
+  if (!supported)
+  {
+    // Not supported, (or not by this build), an empty Ack stands in for the payload
+    Detail::setPayload<Ack>(packet.payload);
+    return bytesParsed;
+  }
+
+  // Parse the payload based on the subtype
+  PacketPayloadBase *payload = (PacketPayloadBase*)&packet.payload;
+  bytesParsed += payload->parse(reader);
+
+  return bytesParsed;
+}
+
+template <typename Payload>
+size_t BasicPacket<Payload>::encode(etl::array<uint8_t, FANET_MAX_PACKET_SIZE> &bytes) const
+{
+  etl::bit_stream_writer writer((void*)(&bytes.data()[0]), FANET_MAX_PACKET_SIZE, etl::endian::big);
+  size_t size = 0;
+
+  // Encode the packet header
+  size += header.encode(writer);
+
+  // If there's an extension header, encode this
+  if (extHeader.has_value())
+  {
+    size += extHeader.value().encode(writer);
+  }
+
+  // Encode the packet payload
+  const PacketPayloadBase *payload = (PacketPayloadBase *)&this->payload;
+  size += payload->encode(writer);
+
+  return size;
+
+}
+
+template <typename Payload>
+bool BasicPacket<Payload>::operator==(const BasicPacket &other) const
+{
+  return header.shouldForward == other.header.shouldForward && sameFrame(other);
+}
+
+template <typename Payload>
+bool BasicPacket<Payload>::sameFrame(const BasicPacket &other) const
+{
+  if (!(header.srcMac == other.header.srcMac &&
+        header.hasExtensionHeader == other.header.hasExtensionHeader &&
+        header.type == other.header.type))
+    return false;
+
+  if (extHeader.has_value() != other.extHeader.has_value())
+    return false;
+  
+  if (extHeader.has_value() && !(extHeader.value() == other.extHeader.value())) {
+    return false;
+  }
+
+  const PacketPayloadBase* payloadBase = (PacketPayloadBase*)&payload;
+  const PacketPayloadBase* otherPayloadBase = (PacketPayloadBase*)&other.payload;
+  if(!payloadBase->operator==(*otherPayloadBase)) {
+    return false;
+  }
+
+  return true;
+}
+
+}
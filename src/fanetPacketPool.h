@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "etl/array.h"
+
+namespace Fanet {
+
+  /*
+  @brief A fixed number of packets, shared through reference counted handles
+
+  Rather than every frame in the tx queue, (and every packet handed to the application), holding
+  a whole packet of its own, they hold a Ref to one of SLOTS packets here.  A frame received and
+  queued to forward is parsed into a slot once, and the forward and the application share it.
+  RAM for packets is then SLOTS * sizeof(PacketT) however deep the queue is.
+
+  A slot is free again once its last Ref is gone.  acquire returns an empty Ref when every slot
+  is in use, which the caller counts and drops the frame.
+
+    auto ref = pool.acquire();
+    if (ref) pool.edit(ref).header.type = PacketType::Tracking;
+
+  Refs only read their packet, so whoever owns the pool can hand them out without the packet
+  changing under a queued frame sharing it.  Refs point into the pool, so it has to outlive
+  them, and can't be copied.
+  */
+  template <typename PacketT, size_t SLOTS>
+  class PacketPool {
+    static_assert(SLOTS > 0 && SLOTS <= UINT8_MAX, "Packet pools have 1 to 255 slots");
+
+   public:
+    /// @brief A reference to a packet in a pool, like a shared_ptr.  Empty if default constructed,
+    /// reset, or the pool was exhausted.
+    class Ref {
+     public:
+      Ref() {}
+      Ref(const Ref& other) : pool(other.pool), index(other.index) {
+        if (pool) pool->counts[index]++;
+      }
+      Ref(Ref&& other) : pool(other.pool), index(other.index) { other.pool = nullptr; }
+      ~Ref() { reset(); }
+
+      Ref& operator=(const Ref& other) {
+        if (other.pool) other.pool->counts[other.index]++;
+        reset();
+        pool = other.pool;
+        index = other.index;
+        return *this;
+      }
+
+      Ref& operator=(Ref&& other) {
+        if (this != &other) {
+          reset();
+          pool = other.pool;
+          index = other.index;
+          other.pool = nullptr;
+        }
+        return *this;
+      }
+
+      /// @brief Lets go of the packet, freeing its slot if this was the last Ref to it
+      void reset() {
+        if (pool) pool->release(index);
+        pool = nullptr;
+      }
+
+      /// @brief The packet, which other Refs may share.  Only valid if not empty.
+      const PacketT& operator*() const { return pool->packets[index]; }
+      const PacketT* operator->() const { return &pool->packets[index]; }
+
+      explicit operator bool() const { return pool != nullptr; }
+
+      /// @brief How many Refs share the packet, 0 if empty
+      size_t useCount() const { return pool ? pool->counts[index] : 0; }
+
+     private:
+      friend class PacketPool;
+      Ref(PacketPool* pool, const uint8_t& index) : pool(pool), index(index) {}
+
+      PacketPool* pool = nullptr;
+      uint8_t index = 0;
+    };
+
+    PacketPool() {
+      for (size_t i = 0; i < SLOTS; i++) free[i] = SLOTS - 1 - i;
+    }
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    /// @brief Takes a free slot, O(1).  Its packet is as the last user left it, so fill it in.
+    /// @return the packet, or an empty Ref if every slot is in use
+    Ref acquire() {
+      if (!freeCount) return Ref();
+      uint8_t index = free[--freeCount];
+      counts[index] = 1;
+      if (inUse() > most) most = inUse();
+      return Ref(this, index);
+    }
+
+    /// @brief The packet a Ref holds, to fill in or change.  The Ref must be from this pool, and
+    /// not empty.
+    PacketT& edit(const Ref& ref) { return packets[ref.index]; }
+
+    size_t capacity() const { return SLOTS; }
+    size_t inUse() const { return SLOTS - freeCount; }
+
+    /// @brief Most slots that have been in use at once
+    size_t peak() const { return most; }
+
+   private:
+    void release(const uint8_t& index) {
+      if (!--counts[index]) free[freeCount++] = index;
+    }
+
+    etl::array<PacketT, SLOTS> packets;
+    etl::array<uint16_t, SLOTS> counts = {};  // Refs to each slot, 0 if free
+    etl::array<uint8_t, SLOTS> free;          // Free slots, the next to use last
+    size_t freeCount = SLOTS;
+    size_t most = 0;
+  };
+}  // namespace Fanet
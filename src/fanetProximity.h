@@ -0,0 +1,230 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "etl/algorithm.h"
+#include "etl/array.h"
+#include "etl/vector.h"
+#include "fanetDeadReckoning.h"
+#include "fanetLocation.h"
+
+// Set to 1 for the manager to warn of neighbors on a collision course, (see getAlerts)
+#ifndef FANET_PROXIMITY
+#define FANET_PROXIMITY 0
+#endif
+
+#ifndef FANET_PROXIMITY_RADIUS_M
+#define FANET_PROXIMITY_RADIUS_M 150.0f  // Alert if we'll pass closer than this horizontally
+#endif
+
+#ifndef FANET_PROXIMITY_VERTICAL_M
+#define FANET_PROXIMITY_VERTICAL_M 75.0f  // ... and closer than this vertically
+#endif
+
+#ifndef FANET_PROXIMITY_LOW_S
+#define FANET_PROXIMITY_LOW_S 18.0f  // Seconds to closest approach for a low level alert
+#endif
+
+#ifndef FANET_PROXIMITY_IMPORTANT_S
+#define FANET_PROXIMITY_IMPORTANT_S 12.0f  // ... for an important alert
+#endif
+
+#ifndef FANET_PROXIMITY_URGENT_S
+#define FANET_PROXIMITY_URGENT_S 8.0f  // ... for an urgent alert
+#endif
+
+#ifndef FANET_PROXIMITY_MAX_AGE
+#define FANET_PROXIMITY_MAX_AGE \
+  25000  // Positions older than this (ms) aren't extrapolated, (senders may wait 20s between)
+#endif
+
+#ifndef FANET_PROXIMITY_MAX_ALERTS
+#define FANET_PROXIMITY_MAX_ALERTS 8  // Most alerts returned by getAlerts
+#endif
+
+namespace Fanet {
+
+  const uint16_t kNoProximity = 0xFFFF;  // Not an aircraft in a ProximityEngine
+
+  /// @brief How soon we'll pass too close to an aircraft, as FLARM's alarm levels
+  enum class ProximityLevel : uint8_t {
+    None = 0,
+    Low = 1,        // FANET_PROXIMITY_LOW_S or less to closest approach
+    Important = 2,  // FANET_PROXIMITY_IMPORTANT_S or less
+    Urgent = 3,     // FANET_PROXIMITY_URGENT_S or less
+  };
+
+  /// @brief An aircraft we'll pass too close to
+  struct ProximityAlert {
+    uint32_t address = 0;
+    ProximityLevel level = ProximityLevel::None;
+    float timeToCpa = 0.0f;    // Seconds to the closest point of approach, 0 if it's now
+    float distanceAtCpa = 0.0f;  // Horizontal distance at closest approach (m)
+    float verticalAtCpa = 0.0f;  // Height above us at closest approach (m), negative if below
+    float distance = 0.0f;     // Horizontal distance now (m)
+  };
+
+  /*
+  @brief Closest point of approach between us and a number of aircraft
+
+  Each aircraft's last position and velocity are kept as a structure of arrays, updated as its
+  tracking frames arrive.  evaluate extrapolates every aircraft to the current time and works out
+  when and how close we'll pass, in branch free loops the compiler can vectorize, so a full
+  table can be re-evaluated on every GPS fix.  Slots are found with a linear search, like
+  TrackHistory, and freed slots are skipped rather than moved so slot numbers stay stable.
+  */
+  template <size_t AIRCRAFT>
+  class ProximityEngine {
+   public:
+    /// @brief Adds or refreshes an aircraft's position and motion
+    /// @param slot The aircraft's slot, or kNoProximity to add it
+    /// @param owner Address of the aircraft
+    /// @return The slot, or kNoProximity if all are in use
+    uint16_t update(uint16_t slot, const uint32_t& owner, const MotionState& state) {
+      if (slot >= AIRCRAFT || !used[slot] || owners[slot] != owner) {
+        for (slot = 0; slot < AIRCRAFT && used[slot]; slot++) {
+        }
+        if (slot == AIRCRAFT) return kNoProximity;
+        if (slot >= end) end = slot + 1;
+      }
+
+      float heading = state.heading * kDegreesToRadians;
+      float speed = state.speed / 3.6f;
+      owners[slot] = owner;
+      used[slot] = 1.0f;
+      lat[slot] = state.location.latitude;
+      lon[slot] = state.location.longitude;
+      alt[slot] = state.altitude;
+      vn[slot] = speed * cosf(heading);
+      ve[slot] = speed * sinf(heading);
+      vz[slot] = state.climbRate;
+      times[slot] = state.ms;
+      levels[slot] = 0.0f;
+      return slot;
+    }
+
+    /// @brief Removes an aircraft
+    void release(const uint16_t& slot) {
+      if (slot >= AIRCRAFT) return;
+      used[slot] = 0.0f;
+      levels[slot] = 0.0f;
+      while (end && !used[end - 1]) end--;
+    }
+
+    /// @brief Removes every aircraft
+    void clear() {
+      used.fill(0.0f);
+      levels.fill(0.0f);
+      end = 0;
+    }
+
+    /// @brief Works out the closest approach to every aircraft from our own position and motion
+    /// @return the highest alert level
+    ProximityLevel evaluate(const MotionState& own, const unsigned long& ms) {
+      const float ownLat = own.location.latitude;
+      const float ownLon = own.location.longitude;
+      const float ownAlt = own.altitude;
+      const float ownHeading = own.heading * kDegreesToRadians;
+      const float ownVn = own.speed / 3.6f * cosf(ownHeading);
+      const float ownVe = own.speed / 3.6f * sinf(ownHeading);
+      const float ownVz = own.climbRate;
+      const float metersPerLon = kMetersPerDegree * cosf(ownLat * kDegreesToRadians);
+      const uint32_t now = ms;
+      const uint16_t count = end;
+
+      // Relative position now, and relative velocity, then when they're closest.  Kept free of
+      // branches and calls the compiler can't inline, so it vectorizes, (GCC needs
+      // -fno-trapping-math to turn the comparisons into selects, and -O3 or -ftree-vectorize).
+      for (uint16_t i = 0; i < count; i++) {
+        float age = (float)(int32_t)(now - times[i]) * 0.001f;
+        float north = (lat[i] - ownLat) * kMetersPerDegree + vn[i] * age;
+        float east = (lon[i] - ownLon) * metersPerLon + ve[i] * age;
+        float up = alt[i] + vz[i] * age - ownAlt;
+        float wn = vn[i] - ownVn;
+        float we = ve[i] - ownVe;
+        float closing = wn * wn + we * we;
+        float t = -(north * wn + east * we) / (closing > 0.01f ? closing : 0.01f);
+        t = t < 0.0f ? 0.0f : (t > kHorizon ? kHorizon : t);
+        float cn = north + wn * t;
+        float ce = east + we * t;
+        float vertical = up + (vz[i] - ownVz) * t;
+        // Distances are kept squared, (sqrtf can set errno, which stops it vectorizing)
+        range2[i] = north * north + east * east;
+        tcpa[i] = t;
+        dcpa2[i] = cn * cn + ce * ce;
+        vcpa[i] = vertical;
+        float close = used[i] * (age <= kMaxAge ? 1.0f : 0.0f) *
+                      (dcpa2[i] < kRadius2 ? 1.0f : 0.0f) *
+                      (fabsf(vertical) < FANET_PROXIMITY_VERTICAL_M ? 1.0f : 0.0f);
+        levels[i] = close * ((t <= FANET_PROXIMITY_LOW_S ? 1.0f : 0.0f) +
+                             (t <= FANET_PROXIMITY_IMPORTANT_S ? 1.0f : 0.0f) +
+                             (t <= FANET_PROXIMITY_URGENT_S ? 1.0f : 0.0f));
+      }
+
+      float highest = 0.0f;
+      for (uint16_t i = 0; i < count; i++) highest = levels[i] > highest ? levels[i] : highest;
+      return (ProximityLevel)highest;
+    }
+
+    /// @brief Gets the alerts from the last evaluate, most urgent first
+    template <size_t MAX>
+    void getAlerts(etl::vector<ProximityAlert, MAX>& alerts) const {
+      alerts.clear();
+      for (uint8_t level = (uint8_t)ProximityLevel::Urgent; level; level--) {
+        auto first = alerts.size();
+        for (uint16_t i = 0; i < end && !alerts.full(); i++) {
+          if (levels[i] != (float)level) continue;
+          ProximityAlert alert;
+          alert.address = owners[i];
+          alert.level = (ProximityLevel)level;
+          alert.timeToCpa = tcpa[i];
+          alert.distanceAtCpa = sqrtf(dcpa2[i]);
+          alert.verticalAtCpa = vcpa[i];
+          alert.distance = sqrtf(range2[i]);
+          alerts.push_back(alert);
+        }
+        // Soonest first within a level
+        etl::sort(alerts.begin() + first, alerts.end(),
+                  [](const ProximityAlert& a, const ProximityAlert& b) {
+                    return a.timeToCpa < b.timeToCpa;
+                  });
+      }
+    }
+
+    /// @brief Aircraft being tracked
+    size_t size() const {
+      size_t count = 0;
+      for (uint16_t i = 0; i < end; i++) count += used[i] > 0.0f;
+      return count;
+    }
+
+    static size_t capacity() { return AIRCRAFT; }
+
+   protected:
+    // Closest approaches further ahead than this (s) aren't interesting
+    static constexpr float kHorizon = 60.0f;
+    static constexpr float kMaxAge = FANET_PROXIMITY_MAX_AGE / 1000.0f;
+    static constexpr float kRadius2 = FANET_PROXIMITY_RADIUS_M * FANET_PROXIMITY_RADIUS_M;
+
+    // Last position and velocity of each aircraft, (north, east and up in m/s)
+    etl::array<float, AIRCRAFT> lat;
+    etl::array<float, AIRCRAFT> lon;
+    etl::array<float, AIRCRAFT> alt;
+    etl::array<float, AIRCRAFT> vn;
+    etl::array<float, AIRCRAFT> ve;
+    etl::array<float, AIRCRAFT> vz;
+    etl::array<uint32_t, AIRCRAFT> times;
+    etl::array<uint32_t, AIRCRAFT> owners;
+    etl::array<float, AIRCRAFT> used = {};  // 1 if the slot's in use, as a float to mask with
+
+    // Results of the last evaluate, (levels as floats, again so it vectorizes)
+    etl::array<float, AIRCRAFT> range2;
+    etl::array<float, AIRCRAFT> tcpa;
+    etl::array<float, AIRCRAFT> dcpa2;
+    etl::array<float, AIRCRAFT> vcpa;
+    etl::array<float, AIRCRAFT> levels = {};
+
+    uint16_t end = 0;  // One past the last slot in use
+  };
+}  // namespace Fanet
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include "etl/optional.h"
+#include "fanetHeader.h"
+
+#ifndef FANET_ROUTE_MAX_AGE
+#define FANET_ROUTE_MAX_AGE \
+  1000 * 60  // How long (ms) after we last heard a neighbor a certain way we still expect to
+#endif
+
+namespace Fanet {
+
+  /// @brief How we hear a neighbor
+  enum class RouteType : uint8_t {
+    None,     // Not within FANET_ROUTE_MAX_AGE
+    Direct,   // Itself
+    Relayed,  // Only through a relay forwarding its frames
+  };
+
+  /*
+  @brief How a neighbor's frames reach us, and who it reaches, learned from what we hear
+
+  Relays forward frames as they were sent but with the forward bit cleared, so a frame with it
+  cleared may be the neighbor's own or a relay's copy.  It's taken to be a copy if its sender
+  asked for a forwarded ack, (and so set the bit), or if it's of a type the sender's been heard
+  asking us to forward.  Acks are sent straight back, so never are.  A neighbor only ever heard
+  through relays can't be told from one that never asks for forwards, so is taken to be heard
+  directly, as every neighbor used to be.  Kept in each Neighbor, so takes no memory beyond the
+  neighbor table.
+  */
+  struct Route {
+    bool direct = false;          // If we've ever heard the neighbor itself
+    bool relayed = false;         // If we've ever heard its frames through a relay
+    uint8_t forwardTypes = 0;     // Packet types it's asked us to forward, (1 << type)
+    unsigned long directMs = 0;   // When we last heard it directly
+    unsigned long relayedMs = 0;  // When we last heard one of its frames through a relay
+    float relaySnr = 0.0f;        // Best SNR of its relayed frames, (how well we hear its relays)
+    uint32_t peer = 0;            // A neighbor it's sent to without asking for a forward, so
+                                  // is one hop from, (Mac::toInt32, 0 for none)
+    unsigned long peerMs = 0;     // When it last did
+    etl::optional<unsigned long> beaconMs;  // When it last sent us its position directly
+
+    /// @brief Works out if a frame came through a relay
+    /// @param twoHopAck If the frame asks for a forwarded ack
+    bool isRelayed(const PacketType& type, const bool& shouldForward, const bool& twoHopAck) const {
+      if (shouldForward || type == PacketType::Ack) return false;
+      return twoHopAck || (forwardTypes & (1 << (uint8_t)type));
+    }
+
+    /// @brief Records a frame from the neighbor
+    /// @param relayed If it came through a relay, (isRelayed)
+    void heard(const unsigned long& ms,
+               const bool& relayed,
+               const PacketType& type,
+               const bool& shouldForward,
+               const float& snr) {
+      if (!relayed) {
+        direct = true;
+        directMs = ms;
+        if (shouldForward) forwardTypes |= 1 << (uint8_t)type;
+        return;
+      }
+      // The best relay we've heard lately
+      if (!this->relayed || ms - relayedMs > FANET_ROUTE_MAX_AGE || snr > relaySnr) {
+        relaySnr = snr;
+      }
+      this->relayed = true;
+      relayedMs = ms;
+    }
+
+    /// @brief Records the neighbor sending a frame straight to another, (without asking for a
+    /// forward, so expecting it to be heard directly)
+    void sentTo(const uint32_t& address, const unsigned long& ms) {
+      peer = address;
+      peerMs = ms;
+    }
+
+    /// @brief If we've heard the neighbor send straight to another lately
+    bool reaches(const uint32_t& address, const unsigned long& ms) const {
+      return peer && peer == address && ms - peerMs <= FANET_ROUTE_MAX_AGE;
+    }
+
+    /// @brief How we hear the neighbor now, directly if we've heard it at all lately
+    RouteType type(const unsigned long& ms) const {
+      if (direct && ms - directMs <= FANET_ROUTE_MAX_AGE) return RouteType::Direct;
+      if (relayed && ms - relayedMs <= FANET_ROUTE_MAX_AGE) return RouteType::Relayed;
+      return RouteType::None;
+    }
+  };
+}  // namespace Fanet
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "etl/array.h"
+#include "fanetLocation.h"
+
+// Set to 1 for the manager to keep a history of recent positions for each neighbor
+#ifndef FANET_TRACK_HISTORY
+#define FANET_TRACK_HISTORY 0
+#endif
+
+#ifndef FANET_TRACK_HISTORY_FIXES
+#define FANET_TRACK_HISTORY_FIXES 32  // Most positions kept per neighbor
+#endif
+
+#ifndef FANET_TRACK_HISTORY_BYTES
+#define FANET_TRACK_HISTORY_BYTES \
+  160  // Bytes per neighbor for positions after the oldest, typically 5 to 7 bytes each
+#endif
+
+namespace Fanet {
+
+  const uint16_t kNoTrack = 0xFFFF;  // Not a track in a TrackHistory
+
+  /// @brief A position in a neighbor's track
+  struct TrackFix {
+    unsigned long ms = 0;  // When it was received
+    Location location = {0, 0};
+    int32_t altitude = 0;  // Meters, 0 if not known (ground tracking)
+  };
+
+  /*
+  @brief Recent positions of a number of neighbors, in a fixed arena
+
+  Each track keeps its oldest position in full, then every later position as the difference to
+  the one before it, (time, latitude and longitude in the units they're sent in, and altitude),
+  each as a variable length integer in a ring of bytes.  A typical position takes 5 to 7 bytes
+  instead of the 40 or so of a Tracking payload, and, as received positions are already rounded
+  to what's sent over the air, nothing is lost.  When a track is full, its oldest positions are
+  folded into the first one to make room.
+  */
+  template <size_t TRACKS>
+  class TrackHistory {
+   protected:
+    struct Packed {
+      uint32_t ms;
+      int32_t lat;  // Units of 1 / kLatitudeScaling degrees
+      int32_t lon;  // Units of 1 / kLongitudeScaling degrees
+      int32_t altitude;
+    };
+
+   public:
+    /// @brief Decodes a track on the fly, oldest position first
+    class Iterator {
+     public:
+      const TrackFix& operator*() const { return fix; }
+      const TrackFix* operator->() const { return &fix; }
+      Iterator& operator++();
+      bool operator!=(const Iterator& other) const { return remaining != other.remaining; }
+      bool operator==(const Iterator& other) const { return remaining == other.remaining; }
+
+     private:
+      friend class TrackHistory;
+      const uint8_t* bytes = nullptr;
+      uint16_t offset = 0;
+      uint8_t remaining = 0;
+      TrackFix fix;
+      Packed packed;
+    };
+
+    /// @brief A track, for use in range based for loops
+    struct Range {
+      Iterator first;
+      Iterator last;
+      Iterator begin() const { return first; }
+      Iterator end() const { return last; }
+      size_t size() const { return first.remaining; }
+    };
+
+    /// @brief Adds a position to a track, starting a new track if needed
+    /// @param track Track to add to, or kNoTrack to start a new one
+    /// @param owner Address the track belongs to
+    /// @return The track, or kNoTrack if all are in use
+    uint16_t add(uint16_t track, const uint32_t& owner, const TrackFix& fix);
+
+    /// @brief Frees a track
+    void release(const uint16_t& track) {
+      if (track < TRACKS) tracks[track].count = 0;
+    }
+
+    /// @brief Frees every track
+    void clear() {
+      for (auto& track : tracks) track.count = 0;
+    }
+
+    /// @brief Gets a track, empty if it's not in use
+    Range get(const uint16_t& track) const;
+
+    /// @brief Address a track belongs to, if in use
+    bool owner(const uint16_t& track, uint32_t& owner) const {
+      if (track >= TRACKS || !tracks[track].count) return false;
+      owner = tracks[track].owner;
+      return true;
+    }
+
+    static size_t capacity() { return TRACKS; }
+
+   protected:
+    struct Track {
+      uint32_t owner;
+      Packed first;   // Oldest position
+      Packed last;    // Newest position
+      uint16_t start;  // Offset of the oldest difference in the ring
+      uint16_t used;   // Bytes of the ring in use
+      uint8_t count;   // Positions, 0 if the track is not in use
+      etl::array<uint8_t, FANET_TRACK_HISTORY_BYTES> ring;
+    };
+
+    static Packed pack(const TrackFix& fix);
+    static TrackFix unpack(const Packed& packed);
+
+    /// @brief Reads the next difference from a ring, and applies it
+    /// @return bytes read
+    static uint16_t readDelta(const uint8_t* ring, uint16_t offset, Packed& packed);
+
+    /// @brief Encodes the difference between two positions
+    /// @return bytes written
+    static uint16_t writeDelta(const Packed& from, const Packed& to, uint8_t* out);
+
+    etl::array<Track, TRACKS> tracks = {};
+  };
+
+  namespace TrackEncoding {
+    inline uint32_t zigzag(const int32_t& value) {
+      return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    }
+
+    inline int32_t unzigzag(const uint32_t& value) {
+      return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+    }
+
+    inline uint16_t writeVarint(uint32_t value, uint8_t* out) {
+      uint16_t length = 0;
+      while (value >= 0x80) {
+        out[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+      }
+      out[length++] = value;
+      return length;
+    }
+
+    // Reads from a ring of FANET_TRACK_HISTORY_BYTES
+    inline uint16_t readVarint(const uint8_t* ring, uint16_t offset, uint32_t& value) {
+      uint16_t length = 0;
+      uint8_t shift = 0;
+      value = 0;
+      uint8_t byte;
+      do {
+        byte = ring[(offset + length++) % FANET_TRACK_HISTORY_BYTES];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+      } while ((byte & 0x80) && shift < 35);
+      return length;
+    }
+  }  // namespace TrackEncoding
+
+  template <size_t TRACKS>
+  typename TrackHistory<TRACKS>::Packed TrackHistory<TRACKS>::pack(const TrackFix& fix) {
+    Packed packed;
+    packed.ms = fix.ms;
+    packed.lat = (int32_t)roundf(fix.location.latitude * kLatitudeScaling);
+    packed.lon = (int32_t)roundf(fix.location.longitude * kLongitudeScaling);
+    packed.altitude = fix.altitude;
+    return packed;
+  }
+
+  template <size_t TRACKS>
+  TrackFix TrackHistory<TRACKS>::unpack(const Packed& packed) {
+    TrackFix fix;
+    fix.ms = packed.ms;
+    fix.location.latitude = packed.lat / kLatitudeScaling;
+    fix.location.longitude = packed.lon / kLongitudeScaling;
+    fix.altitude = packed.altitude;
+    return fix;
+  }
+
+  template <size_t TRACKS>
+  uint16_t TrackHistory<TRACKS>::writeDelta(const Packed& from, const Packed& to, uint8_t* out) {
+    using namespace TrackEncoding;
+    uint16_t length = writeVarint(to.ms - from.ms, out);
+    length += writeVarint(zigzag(to.lat - from.lat), out + length);
+    length += writeVarint(zigzag(to.lon - from.lon), out + length);
+    length += writeVarint(zigzag(to.altitude - from.altitude), out + length);
+    return length;
+  }
+
+  template <size_t TRACKS>
+  uint16_t TrackHistory<TRACKS>::readDelta(const uint8_t* ring, uint16_t offset, Packed& packed) {
+    using namespace TrackEncoding;
+    uint32_t value;
+    uint16_t length = readVarint(ring, offset, value);
+    packed.ms += value;
+    length += readVarint(ring, offset + length, value);
+    packed.lat += unzigzag(value);
+    length += readVarint(ring, offset + length, value);
+    packed.lon += unzigzag(value);
+    length += readVarint(ring, offset + length, value);
+    packed.altitude += unzigzag(value);
+    return length;
+  }
+
+  template <size_t TRACKS>
+  uint16_t TrackHistory<TRACKS>::add(uint16_t index, const uint32_t& owner, const TrackFix& fix) {
+    // Start a new track in the first free slot
+    if (index >= TRACKS || !tracks[index].count || tracks[index].owner != owner) {
+      for (index = 0; index < TRACKS && tracks[index].count; index++) {
+      }
+      if (index == TRACKS) return kNoTrack;
+
+      auto& track = tracks[index];
+      track.owner = owner;
+      track.first = track.last = pack(fix);
+      track.start = track.used = 0;
+      track.count = 1;
+      return index;
+    }
+
+    auto& track = tracks[index];
+    auto packed = pack(fix);
+    uint8_t delta[20];
+    uint16_t length = writeDelta(track.last, packed, delta);
+
+    // Fold the oldest positions into the first until there's room
+    while (track.count > 1 &&
+           (track.count >= FANET_TRACK_HISTORY_FIXES ||
+            track.used + length > FANET_TRACK_HISTORY_BYTES)) {
+      uint16_t dropped = readDelta(track.ring.data(), track.start, track.first);
+      track.start = (track.start + dropped) % FANET_TRACK_HISTORY_BYTES;
+      track.used -= dropped;
+      track.count--;
+    }
+
+    uint16_t end = (track.start + track.used) % FANET_TRACK_HISTORY_BYTES;
+    for (uint16_t i = 0; i < length; i++) {
+      track.ring[(end + i) % FANET_TRACK_HISTORY_BYTES] = delta[i];
+    }
+    track.used += length;
+    track.count++;
+    track.last = packed;
+    return index;
+  }
+
+  template <size_t TRACKS>
+  typename TrackHistory<TRACKS>::Range TrackHistory<TRACKS>::get(const uint16_t& index) const {
+    Range range;
+    if (index >= TRACKS || !tracks[index].count) return range;
+
+    auto& track = tracks[index];
+    range.first.bytes = track.ring.data();
+    range.first.offset = track.start;
+    range.first.remaining = track.count;
+    range.first.fix = unpack(track.first);
+    range.first.packed = track.first;
+    return range;
+  }
+
+  template <size_t TRACKS>
+  typename TrackHistory<TRACKS>::Iterator& TrackHistory<TRACKS>::Iterator::operator++() {
+    if (--remaining) {
+      offset = (offset + readDelta(bytes, offset, packed)) % FANET_TRACK_HISTORY_BYTES;
+      fix = unpack(packed);
+    }
+    return *this;
+  }
+}  // namespace Fanet
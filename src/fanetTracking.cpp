@@ -30,16 +30,20 @@ size_t Fanet::Tracking::parse(etl::bit_stream_reader &reader)
 
   // Speed is in counts of 0.5km/h
   scaling = etl::read_unchecked<char>(reader, 1U);
-  uint8_t speed = etl::read_unchecked<uint8_t>(reader, 7U);
-  speed = speed * 0.5 * (scaling ? kSpeedScalingFactor : 1);
+  uint8_t speedInt = etl::read_unchecked<uint8_t>(reader, 7U);
+  speed = speedInt * 0.5 * (scaling ? kSpeedScalingFactor : 1);
 
-  // Climb rate is in counts of 0.1m/s
+  // Climb rate is in counts of 0.1m/s, 7 bit two's complement
   scaling = etl::read_unchecked<char>(reader, 1U);
-  uint8_t climbRateInt = etl::read_unchecked<uint8_t>(reader, 7U);
+  int climbRateInt = etl::read_unchecked<uint8_t>(reader, 7U);
+  if (climbRateInt & 0x40)
+  {
+    climbRateInt -= 0x80;
+  }
   climbRate = climbRateInt * 0.1 * (scaling ? kClimbRateScalingFactor : 1);
 
   // Heading is per 360/256 deg
-  heading = (360 / 256) * etl::read_unchecked<uint8_t>(reader, 8U);
+  heading = lroundf(etl::read_unchecked<uint8_t>(reader, 8U) * kHeadingScalingFactor);
 
   // Turn rate is Optional!!!
 
@@ -71,18 +75,21 @@ size_t Fanet::Tracking::parse(etl::bit_stream_reader &reader)
 /// @param scalingFactor The factor this unit is scaled by
 /// @param bitCount The number of bits available
 /// @param scaled Reference to store if the number was scaled
+/// @param isSigned If the field is two's complement, (one bit is used for the sign)
 /// @return The scaled number
 template <typename T>
-int toScaled(T number, float unitFactor, float scalingFactor, int bitCount, bool &scaled)
+int toScaled(T number, float unitFactor, float scalingFactor, int bitCount, bool &scaled,
+             bool isSigned = false)
 {
   // Get the number to be represented in the packet.
   T ret = number / unitFactor;
 
   // Works out the largest number we can represent given the number of bits
-  int constrainedMax = pow(2, bitCount) - 1;
+  int constrainedMax = pow(2, isSigned ? bitCount - 1 : bitCount) - 1;
+  int constrainedMin = isSigned ? -constrainedMax - 1 : 0;
 
   // If the return value can fit unscaled, return it
-  if ((int)ret <= constrainedMax)
+  if ((int)ret <= constrainedMax && (int)ret >= constrainedMin)
   {
     scaled = false;
     return ret;
@@ -90,7 +97,7 @@ int toScaled(T number, float unitFactor, float scalingFactor, int bitCount, bool
 
   // return the scaled value.
   scaled = true;
-  return etl::clamp(int(ret / scalingFactor), 0, constrainedMax);
+  return etl::clamp(int(ret / scalingFactor), constrainedMin, constrainedMax);
 }
 
 size_t Fanet::Tracking::encode(etl::bit_stream_writer &writer) const
@@ -112,7 +119,7 @@ size_t Fanet::Tracking::encode(etl::bit_stream_writer &writer) const
   etl::write_unchecked(writer, (int)scaling, 1U);
 
   // Bits 8-10 of the (MSB) of the altitude
-  etl::write_unchecked(writer, alt & 0x700, 3U);
+  etl::write_unchecked(writer, (alt >> 8) & 0x07, 3U);
   size += 2; // 2 byes for the altitude, tracking, aircraft type.
 
   // 1 byte for the speed.
@@ -122,13 +129,13 @@ size_t Fanet::Tracking::encode(etl::bit_stream_writer &writer) const
   size++;
 
   // 1 byte for climbRate
-  int climb2 = toScaled(climbRate, 0.1f, kClimbRateScalingFactor, 7, scaling);
+  int climb2 = toScaled(climbRate, 0.1f, kClimbRateScalingFactor, 7, scaling, true);
   etl::write_unchecked(writer, scaling, 1U);
   etl::write_unchecked(writer, climb2, 7U);
   size++;
 
   // Heading is per 360/256.  One byte
-  etl::write_unchecked<uint8_t>(writer, heading / (360 / 256), 8U);
+  etl::write_unchecked<uint8_t>(writer, lroundf(heading / kHeadingScalingFactor) & 0xFF, 8U);
   size++;
 
   if (!turnRate.has_value())
@@ -26,6 +26,7 @@ namespace Fanet
   const float kClimbRateScalingFactor = 5;
   const float kTurnRateScalingFactor = 4;
   const float kQneOffsetScalingFactor = 4;
+  const float kHeadingScalingFactor = 360.0f / 256.0f;
 
   /*
       Contains tracking information from a flying object.  This class represents
@@ -0,0 +1,284 @@
+#include "fanetTrafficFeed.h"
+#include <math.h>
+#include "etl/algorithm.h"
+
+using namespace Fanet;
+
+namespace {
+  const float kFeetPerMeter = 3.28084f;
+  const float kKnotsPerKmh = 0.539957f;
+  const float kFpmPerMs = 196.850f;
+
+  const uint8_t kFlag = 0x7E;
+  const uint8_t kEscape = 0x7D;
+
+  /// @brief Appends text and numbers to a sentence, as snprintf would without pulling it in
+  class SentenceWriter {
+   public:
+    explicit SentenceWriter(char* out) : out(out) {}
+
+    void put(const char& c) { out[length++] = c; }
+
+    void put(const char* text) {
+      while (*text) put(*text++);
+    }
+
+    void putInt(int32_t value) {
+      if (value < 0) {
+        put('-');
+        value = -value;
+      }
+      char digits[10];
+      size_t count = 0;
+      do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+      } while (value);
+      while (count) put(digits[--count]);
+    }
+
+    void putHex(const uint32_t& value, const uint8_t& digits) {
+      for (int8_t i = digits - 1; i >= 0; i--) put(kHexDigits[(value >> (i * 4)) & 0xF]);
+    }
+
+    /// @brief One decimal place, (climb rates)
+    void putTenths(const float& value) {
+      int32_t tenths = (int32_t)lroundf(value * 10.0f);
+      if (tenths < 0) {
+        put('-');
+        tenths = -tenths;
+      }
+      putInt(tenths / 10);
+      put('.');
+      put('0' + tenths % 10);
+    }
+
+    /// @brief Adds the checksum, (of everything between $ and *), and line ending
+    size_t finish() {
+      uint8_t checksum = 0;
+      for (size_t i = 1; i < length; i++) checksum ^= out[i];
+      put('*');
+      putHex(checksum, 2);
+      put('\r');
+      put('\n');
+      return length;
+    }
+
+    static constexpr const char* kHexDigits = "0123456789ABCDEF";
+
+   private:
+    char* out;
+    size_t length = 0;
+  };
+
+  /// @brief FLARM's aircraft type, (hex digit)
+  uint8_t flarmType(const TrafficTarget& target) {
+    if (target.onGround) return 0xF;  // Static object
+    switch (target.aircraftType) {
+      case AircraftType::Paraglider:
+        return 0x7;
+      case AircraftType::Hangglider:
+        return 0x6;
+      case AircraftType::Balloon:
+        return 0xB;
+      case AircraftType::Glider:
+        return 0x1;
+      case AircraftType::PoweredAircraft:
+        return 0x8;
+      case AircraftType::Helicopter:
+        return 0x3;
+      case AircraftType::UAV:
+        return 0xD;
+      case AircraftType::Other:
+      default:
+        return 0x0;
+    }
+  }
+
+  /// @brief GDL90's emitter category
+  uint8_t emitterCategory(const TrafficTarget& target) {
+    switch (target.aircraftType) {
+      case AircraftType::Paraglider:
+      case AircraftType::Hangglider:
+        return 12;  // Ultralight, hang glider or paraglider
+      case AircraftType::Balloon:
+        return 10;  // Lighter than air
+      case AircraftType::Glider:
+        return 9;
+      case AircraftType::PoweredAircraft:
+        return 1;  // Light
+      case AircraftType::Helicopter:
+        return 7;  // Rotorcraft
+      case AircraftType::UAV:
+        return 14;
+      case AircraftType::Other:
+      default:
+        return 0;  // No information
+    }
+  }
+
+  /// @brief Degrees as a 24 bit GDL90 semicircle count
+  uint32_t semicircles(const float& degrees) {
+    return (uint32_t)(int32_t)lroundf(degrees * (8388608.0f / 180.0f)) & 0xFFFFFF;
+  }
+}  // namespace
+
+void Fanet::TrafficEncoder::relative(const TrafficTarget& target,
+                                     const MotionState& own,
+                                     float& north,
+                                     float& east) {
+  north = (target.state.location.latitude - own.location.latitude) * kMetersPerDegree;
+  east = (target.state.location.longitude - own.location.longitude) * kMetersPerDegree *
+         cosf(own.location.latitude * kDegreesToRadians);
+}
+
+size_t Fanet::TrafficEncoder::pflau(const size_t& count,
+                                    const bool& hasFix,
+                                    const TrafficTarget* urgent,
+                                    const MotionState& own,
+                                    char* out) {
+  // $PFLAU,RX,TX,GPS,Power,AlarmLevel,RelativeBearing,AlarmType,RelativeVertical,
+  // RelativeDistance,ID
+  SentenceWriter writer(out);
+  writer.put("$PFLAU,");
+  writer.putInt(etl::min<size_t>(count, 99));
+  writer.put(hasFix ? ",1,2,1," : ",1,0,1,");
+  if (!urgent || !hasFix) {
+    writer.put("0,,0,,,");
+    return writer.finish();
+  }
+
+  float north, east;
+  relative(*urgent, own, north, east);
+  int32_t bearing = (int32_t)lroundf(atan2f(east, north) / kDegreesToRadians) - own.heading;
+  bearing = ((bearing % 360) + 540) % 360 - 180;
+  writer.putInt(urgent->alarm);
+  writer.put(',');
+  writer.putInt(bearing);
+  writer.put(",2,");
+  if (urgent->hasAltitude) writer.putInt((int32_t)lroundf(urgent->state.altitude - own.altitude));
+  writer.put(',');
+  writer.putInt((int32_t)lroundf(sqrtf(north * north + east * east)));
+  writer.put(',');
+  writer.putHex(urgent->address, 6);
+  return writer.finish();
+}
+
+size_t Fanet::TrafficEncoder::pflaa(const TrafficTarget& target,
+                                    const MotionState& own,
+                                    char* out) {
+  // $PFLAA,AlarmLevel,RelativeNorth,RelativeEast,RelativeVertical,IDType,ID,Track,TurnRate,
+  // GroundSpeed,ClimbRate,AcftType
+  float north, east;
+  relative(target, own, north, east);
+  SentenceWriter writer(out);
+  writer.put("$PFLAA,");
+  writer.putInt(target.alarm);
+  writer.put(',');
+  writer.putInt((int32_t)lroundf(north));
+  writer.put(',');
+  writer.putInt((int32_t)lroundf(east));
+  writer.put(',');
+  if (target.hasAltitude) writer.putInt((int32_t)lroundf(target.state.altitude - own.altitude));
+  writer.put(",2,");  // FLARM ID, (FANET addresses are the same 24 bits)
+  writer.putHex(target.address, 6);
+  writer.put(',');
+  writer.putInt(((target.state.heading % 360) + 360) % 360);
+  writer.put(",,");
+  writer.putInt((int32_t)lroundf(target.state.speed / 3.6f));
+  writer.put(',');
+  writer.putTenths(target.state.climbRate);
+  writer.put(',');
+  writer.putHex(flarmType(target), 1);
+  return writer.finish();
+}
+
+size_t Fanet::TrafficEncoder::gdl90Heartbeat(const bool& hasFix, uint8_t* out) {
+  // We don't know the UTC time of day, so the timestamp's left 0
+  const uint8_t message[7] = {0x00, (uint8_t)(hasFix ? 0x81 : 0x01), 0, 0, 0, 0, 0};
+  return gdl90Frame(message, sizeof(message), out);
+}
+
+size_t Fanet::TrafficEncoder::gdl90Report(const TrafficTarget& target,
+                                          const bool& ownship,
+                                          uint8_t* out) {
+  uint8_t message[28];
+  message[0] = ownship ? 10 : 20;
+  // Alert status, and an ADS-B self assigned address
+  message[1] = (!ownship && target.alarm ? 0x10 : 0x00) | 0x01;
+  message[2] = target.address >> 16;
+  message[3] = target.address >> 8;
+  message[4] = target.address;
+
+  uint32_t latitude = semicircles(target.state.location.latitude);
+  uint32_t longitude = semicircles(target.state.location.longitude);
+  message[5] = latitude >> 16;
+  message[6] = latitude >> 8;
+  message[7] = latitude;
+  message[8] = longitude >> 16;
+  message[9] = longitude >> 8;
+  message[10] = longitude;
+
+  // 25 ft steps from -1000 ft, 0xFFF if unknown
+  uint16_t altitude = 0xFFF;
+  if (target.hasAltitude) {
+    float feet = target.state.altitude * kFeetPerMeter;
+    altitude = (uint16_t)etl::max(0L, etl::min(0xFFEL, lroundf((feet + 1000.0f) / 25.0f)));
+  }
+  uint8_t misc = target.onGround ? 0x1 : 0x9;  // Airborne, and a true track
+  message[11] = altitude >> 4;
+  message[12] = (altitude & 0xF) << 4 | misc;
+  message[13] = 0x88;  // NIC and NACp, (a GPS fix to within about 10 m)
+
+  // Knots, and 64 fpm steps
+  uint16_t speed = (uint16_t)etl::min(0xFFEL, lroundf(target.state.speed * kKnotsPerKmh));
+  int32_t climb = etl::max(-510L, etl::min(510L, lroundf(target.state.climbRate * kFpmPerMs / 64)));
+  uint16_t vertical = (uint16_t)climb & 0xFFF;
+  message[14] = speed >> 4;
+  message[15] = (speed & 0xF) << 4 | vertical >> 8;
+  message[16] = vertical;
+  message[17] = (uint8_t)((((target.state.heading % 360) + 360) % 360) * 256 / 360);
+  message[18] = emitterCategory(target);
+
+  // Call sign, FN and the address
+  message[19] = 'F';
+  message[20] = 'N';
+  for (uint8_t i = 0; i < 6; i++) {
+    message[21 + i] = SentenceWriter::kHexDigits[(target.address >> ((5 - i) * 4)) & 0xF];
+  }
+  message[27] = 0x00;  // No emergency
+  return gdl90Frame(message, sizeof(message), out);
+}
+
+uint16_t Fanet::TrafficEncoder::gdl90Crc(const uint8_t* message, const size_t& length) {
+  // CRC-16-CCITT as the ICD computes it, working each table entry out rather than storing them
+  uint16_t crc = 0;
+  for (size_t i = 0; i < length; i++) {
+    uint16_t entry = crc & 0xFF00;
+    for (uint8_t bit = 0; bit < 8; bit++) entry = entry & 0x8000 ? (entry << 1) ^ 0x1021 : entry << 1;
+    crc = entry ^ (crc << 8) ^ message[i];
+  }
+  return crc;
+}
+
+size_t Fanet::TrafficEncoder::gdl90Frame(const uint8_t* message,
+                                         const size_t& length,
+                                         uint8_t* out) {
+  size_t written = 0;
+  auto put = [&](const uint8_t& byte) {
+    if (byte == kFlag || byte == kEscape) {
+      out[written++] = kEscape;
+      out[written++] = byte ^ 0x20;
+    } else {
+      out[written++] = byte;
+    }
+  };
+
+  uint16_t crc = gdl90Crc(message, length);
+  out[written++] = kFlag;
+  for (size_t i = 0; i < length; i++) put(message[i]);
+  put(crc & 0xFF);
+  put(crc >> 8);
+  out[written++] = kFlag;
+  return written;
+}
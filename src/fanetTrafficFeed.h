@@ -0,0 +1,310 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "etl/algorithm.h"
+#include "etl/unordered_map.h"
+#include "etl/vector.h"
+#include "fanetConfig.h"
+#include "fanetDeadReckoning.h"
+#include "fanetNeighbor.h"
+
+#ifndef FANET_TRAFFIC_REFRESH_MS
+#define FANET_TRAFFIC_REFRESH_MS \
+  1000  // Traffic that hasn't changed is reported again this often (ms), so it isn't timed out
+#endif
+
+#ifndef FANET_TRAFFIC_MAX_AGE_MS
+#define FANET_TRAFFIC_MAX_AGE_MS 20000  // Traffic whose last position is older (ms) isn't reported
+#endif
+
+#ifndef FANET_TRAFFIC_MAX_DISTANCE_M
+#define FANET_TRAFFIC_MAX_DISTANCE_M \
+  30000.0f  // Traffic further away (m) isn't reported, 0 to report it however far
+#endif
+
+#ifndef FANET_TRAFFIC_BAUD
+#define FANET_TRAFFIC_BAUD 115200  // Default serial link speed the feed is limited to
+#endif
+
+namespace Fanet {
+
+  /// @brief What a traffic feed is written as
+  enum class TrafficFormat : uint8_t {
+    Nmea,   // FLARM's $PFLAU and $PFLAA sentences, (XCSoar, LK8000, ...)
+    Gdl90,  // GDL90 heartbeat, ownship and traffic reports
+  };
+
+  /// @brief An aircraft, as a traffic feed reports it
+  struct TrafficTarget {
+    uint32_t address = 0;
+    MotionState state;  // Last position, (its ms is when it was received)
+    bool hasAltitude = false;
+    bool onGround = false;
+    AircraftType aircraftType = AircraftType::Other;
+    uint8_t alarm = 0;  // 0 to 3, as FLARM grades collision risk
+  };
+
+  /// @brief Counters, read with TrafficFeed::getStats
+  struct TrafficFeedStats {
+    uint32_t updates = 0;    // New positions from the neighbor table
+    uint32_t reports = 0;    // Traffic reports written
+    uint32_t refreshes = 0;  // Of those, of traffic that hadn't changed
+    uint32_t deferred = 0;   // Reports due but put off, as the link's bandwidth was used up
+    uint32_t bytes = 0;      // Written, in all
+  };
+
+  /*
+  @brief Formats traffic reports into caller supplied buffers, without using the heap
+
+  Sentence and message layouts follow the FLARM data port specification and the GDL90 public
+  ICD.  Each returns the length written, (at most kMaxLength).
+  */
+  class TrafficEncoder {
+   public:
+    static const size_t kMaxLength = 96;
+
+    /// @brief $PFLAU, our status and the most urgent alarm
+    /// @param count Traffic in range
+    /// @param hasFix If we know where we are
+    /// @param urgent Most urgent traffic, (its alarm level is reported), or nullptr
+    static size_t pflau(const size_t& count,
+                        const bool& hasFix,
+                        const TrafficTarget* urgent,
+                        const MotionState& own,
+                        char* out);
+
+    /// @brief $PFLAA, traffic relative to us
+    static size_t pflaa(const TrafficTarget& target, const MotionState& own, char* out);
+
+    /// @brief GDL90 heartbeat, (once a second)
+    static size_t gdl90Heartbeat(const bool& hasFix, uint8_t* out);
+
+    /// @brief GDL90 traffic report, or ownship report if ownship is set
+    static size_t gdl90Report(const TrafficTarget& target, const bool& ownship, uint8_t* out);
+
+    /// @brief Where a target is, from us
+    static void relative(const TrafficTarget& target,
+                         const MotionState& own,
+                         float& north,
+                         float& east);
+
+    /// @brief The GDL90 frame check sequence of a message
+    static uint16_t gdl90Crc(const uint8_t* message, const size_t& length);
+
+   protected:
+    /// @brief Adds the flags, CRC and escapes to a message, (out may not overlap it)
+    static size_t gdl90Frame(const uint8_t* message, const size_t& length, uint8_t* out);
+  };
+
+  /*
+  @brief Keeps an FLARM NMEA or GDL90 traffic feed up to date from neighbor table changes
+
+  Give it to the manager as its neighbor listener, and it follows the table as it changes rather
+  than copying it:
+
+    Fanet::TrafficFeed<> feed(Fanet::TrafficFormat::Nmea, 115200);
+    manager.setNeighborListener(
+        Fanet::FanetManager::NeighborListener::create<Fanet::TrafficFeed<>,
+                                                      &Fanet::TrafficFeed<>::neighborChanged>(feed));
+
+  Then, as often as the serial link should be written to, (5 times a second, say), poll it for
+  what to send.  Traffic with a new position is reported on the next poll, the rest again every
+  FANET_TRAFFIC_REFRESH_MS so clients don't time it out, and traffic more than
+  FANET_TRAFFIC_MAX_DISTANCE_M away, or with no position in FANET_TRAFFIC_MAX_AGE_MS, not at all.
+  Only as many bytes as the link could have sent since the last poll are written, (up to a
+  second's worth), alarms first and then the closest traffic; the rest waits for the next poll.
+
+    feed.setOwnship(ownPosition);
+    size_t length = feed.poll(millis(), buffer, sizeof(buffer));
+    Serial.write(buffer, length);
+
+  AIRCRAFT should be at least the manager's table size.
+  */
+  template <size_t AIRCRAFT = FANET_MAX_NEIGHBORS>
+  class TrafficFeed {
+   public:
+    /// @param baud Serial link speed, (10 bits to a byte)
+    TrafficFeed(const TrafficFormat& format = TrafficFormat::Nmea,
+                const uint32_t& baud = FANET_TRAFFIC_BAUD)
+        : format(format), bytesPerSecond(baud / 10) {}
+
+    void setFormat(const TrafficFormat& format) { this->format = format; }
+    void setBaud(const uint32_t& baud) { bytesPerSecond = baud / 10; }
+
+    /// @brief Our own position, which NMEA reports traffic relative to
+    void setOwnship(const MotionState& state) {
+      own = state;
+      hasFix = true;
+    }
+
+    /// @brief Our address, for the GDL90 ownship report
+    void setOwnAddress(const Mac& address) { ownAddress = address.toInt32(); }
+
+    /// @brief Follows a neighbor table change, (a FanetManager NeighborListener)
+    /// @param gone If the neighbor has left the table
+    void neighborChanged(const Neighbor& neighbor, const bool& gone) {
+      if (gone) {
+        targets.erase(neighbor.address.toInt32());
+        return;
+      }
+      if (!neighbor.location.has_value()) return;
+
+      // Nothing to report unless it's a new position
+      auto it = targets.find(neighbor.address.toInt32());
+      if (it != targets.end() && it->second.target.state.ms == neighbor.locationMs) return;
+      if (it == targets.end()) {
+        if (targets.full()) return;
+        it = targets.insert(etl::make_pair(neighbor.address.toInt32(), Entry())).first;
+      }
+      auto& target = it->second.target;
+      target.address = neighbor.address.toInt32();
+      target.state.location = neighbor.location.value();
+      target.state.altitude = neighbor.altitude.has_value() ? neighbor.altitude.value() : 0;
+      target.state.speed = neighbor.speed;
+      target.state.heading = neighbor.heading;
+      target.state.climbRate = neighbor.climbRate;
+      target.state.ms = neighbor.locationMs;
+      target.hasAltitude = neighbor.altitude.has_value();
+      target.onGround = neighbor.groundTrackingType.has_value();
+      target.aircraftType = neighbor.aircraftType;
+      it->second.pending = true;
+      stats.updates++;
+    }
+
+    /// @brief Sets a neighbor's collision alarm, (see FanetManager::getAlerts)
+    /// @param level 0 to 3
+    void setAlarm(const Mac& address, const uint8_t& level) {
+      auto it = targets.find(address.toInt32());
+      if (it == targets.end() || it->second.target.alarm == level) return;
+      it->second.target.alarm = level;
+      it->second.pending = true;
+    }
+
+    /// @brief Writes what's due, as much as the link's bandwidth allows
+    /// @param buffer Where to write it, (at least TrafficEncoder::kMaxLength)
+    /// @return bytes written
+    size_t poll(const unsigned long& ms, uint8_t* buffer, const size_t& size) {
+      // Bandwidth earned since the last poll, up to a second's worth
+      if (!polled) {
+        credit = bytesPerSecond;
+        polled = true;
+      } else {
+        credit = etl::min<uint32_t>(bytesPerSecond,
+                                    credit + (uint32_t)(ms - lastPoll) * bytesPerSecond / 1000);
+      }
+      lastPoll = ms;
+      size_t limit = etl::min<size_t>(size, credit);
+
+      // What's due, alarms first and then the closest
+      candidates.clear();
+      const TrafficTarget* urgent = nullptr;
+      float urgentDistance = 0.0f;
+      size_t inRange = 0;
+      for (auto& it : targets) {
+        auto& entry = it.second;
+        if (ms - entry.target.state.ms > FANET_TRAFFIC_MAX_AGE_MS) continue;
+        float north = 0.0f, east = 0.0f;
+        if (hasFix) TrafficEncoder::relative(entry.target, own, north, east);
+        float distance = sqrtf(north * north + east * east);
+        if (FANET_TRAFFIC_MAX_DISTANCE_M > 0 && distance > FANET_TRAFFIC_MAX_DISTANCE_M) continue;
+        inRange++;
+        if (entry.target.alarm &&
+            (!urgent || entry.target.alarm > urgent->alarm ||
+             (entry.target.alarm == urgent->alarm && distance < urgentDistance))) {
+          urgent = &entry.target;
+          urgentDistance = distance;
+        }
+        if (entry.pending || ms - entry.sentMs >= FANET_TRAFFIC_REFRESH_MS) {
+          candidates.push_back({distance - entry.target.alarm * kAlarmPriority, &entry});
+        }
+      }
+      etl::sort(candidates.begin(), candidates.end());
+
+      size_t written = 0;
+      uint8_t line[TrafficEncoder::kMaxLength];
+
+      // Our status, once a second
+      if (!statusSent || ms - statusMs >= 1000) {
+        size_t length = 0;
+        if (format == TrafficFormat::Nmea) {
+          length = TrafficEncoder::pflau(inRange, hasFix, urgent, own, (char*)line);
+        } else {
+          length = TrafficEncoder::gdl90Heartbeat(hasFix, line);
+          if (hasFix) {
+            TrafficTarget ownship;
+            ownship.address = ownAddress;
+            ownship.state = own;
+            ownship.hasAltitude = true;
+            length += TrafficEncoder::gdl90Report(ownship, true, line + length);
+          }
+        }
+        if (length <= limit) {
+          memcpy(buffer, line, length);
+          written += length;
+          statusSent = true;
+          statusMs = ms;
+        }
+      }
+
+      for (size_t i = 0; i < candidates.size(); i++) {
+        auto& entry = *candidates[i].entry;
+        size_t length = format == TrafficFormat::Nmea
+                            ? (hasFix ? TrafficEncoder::pflaa(entry.target, own, (char*)line) : 0)
+                            : TrafficEncoder::gdl90Report(entry.target, false, line);
+        if (!length) continue;
+        if (written + length > limit) {
+          stats.deferred += candidates.size() - i;
+          break;
+        }
+        memcpy(buffer + written, line, length);
+        written += length;
+        stats.reports++;
+        if (!entry.pending) stats.refreshes++;
+        entry.pending = false;
+        entry.sentMs = ms;
+      }
+
+      credit -= written;
+      stats.bytes += written;
+      return written;
+    }
+
+    /// @brief Traffic being followed
+    size_t size() const { return targets.size(); }
+
+    const TrafficFeedStats& getStats() const { return stats; }
+
+   protected:
+    // Meters an alarm level is worth, so alarms come before any traffic without one
+    static constexpr float kAlarmPriority = 1e6f;
+
+    struct Entry {
+      TrafficTarget target;
+      unsigned long sentMs = 0;
+      bool pending = false;  // Changed since it was last reported
+    };
+
+    struct Candidate {
+      float priority;  // Lowest first
+      Entry* entry;
+      bool operator<(const Candidate& other) const { return priority < other.priority; }
+    };
+
+    TrafficFormat format;
+    uint32_t bytesPerSecond;
+    uint32_t credit = 0;
+    unsigned long lastPoll = 0;
+    bool polled = false;
+    MotionState own;
+    bool hasFix = false;
+    uint32_t ownAddress = 0;
+    unsigned long statusMs = 0;
+    bool statusSent = false;
+    etl::unordered_map<uint32_t, Entry, AIRCRAFT> targets;
+    etl::vector<Candidate, AIRCRAFT> candidates;
+    TrafficFeedStats stats;
+  };
+}  // namespace Fanet
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include "fanetPacket.h"
+
+namespace Fanet {
+  /// @brief When a queued packet should be sent, and what we know about it if it's a forward
+  struct TxSchedule {
+    unsigned long sendAt;     // Time we wish to send (will time)
+    unsigned long rxTime;     // If forwarded, keep track of when this packet was received.
+    float rssi;               // If forwarded, keep track of the rx Rssi
+    uint8_t copiesHeard = 0;  // If forwarded, copies overheard from other relays since queued
+    uint8_t retries = 0;      // Transmit attempts that have failed, (channel was busy)
+
+    bool operator<(const TxSchedule& other) const { return sendAt < other.sendAt; }
+
+    TxSchedule(unsigned long sendAt, float rssi = 0.0f, unsigned long rxTime = 0)
+        : sendAt(sendAt), rssi(rssi) {
+      // Time received defaults to time to send if not sent
+      this->rxTime = rxTime ? rxTime : sendAt;
+    }
+  };
+
+  /// @brief A packet queued for transmit.  Holds a reference to it in a PacketPool, (shared with
+  /// the application when it's a forward of a frame it was handed), rather than the packet.
+  template <typename RefT>
+  struct BasicTxPacket : TxSchedule {
+    RefT packet;
+    bool relay = false;  // Someone else's frame, sent with its forward bit cleared
+
+    BasicTxPacket(unsigned long sendAt, const RefT& packet) : TxSchedule(sendAt), packet(packet) {}
+
+    /// @brief A packet to forward, as the forward policy scheduled it
+    BasicTxPacket(const TxSchedule& schedule, const RefT& packet)
+        : TxSchedule(schedule), packet(packet), relay(true) {}
+  };
+}  // namespace Fanet
@@ -1,8 +1,37 @@
 #include "unity.h"
 #include <iostream>
 #include <iomanip>
+#include <string.h>
 #include "fanetPacket.h"
+#include "fanetCapture.h"
+#include "fanetFusion.h"
+#include "fanetInstrumentation.h"
+#include "fanetManager.h"
+#include "fanetManagerImpl.h"
+#include "fanetNameArena.h"
+#include "fanetProximity.h"
+#include "fanetTrackHistory.h"
+#include "fanetTrafficFeed.h"
+#if FANET_TOOL_TESTS
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fanetDecode.h"
+#include "fanetGateway.h"
+#include "fanetReplay.h"
+#include "fanetSimulator.h"
+#endif
 #include "etl/array.h"
+#include "etl/vector.h"
 
 // Fanet+ packet as sent by SoftRF containing a location packet
 etl::array<uint8_t, FANET_MAX_PACKET_SIZE> locationPacket = {
@@ -50,6 +79,43 @@ void test_parses(void) {
     TEST_ASSERT_TRUE(packet.header.hasExtensionHeader == false);
 }
 
+void test_parses_in_place(void) {
+    // A packet reused for every frame only keeps what the latest frame has
+    Fanet::Packet packet;
+    Fanet::Packet ack;
+    ack.header.type = Fanet::PacketType::Ack;
+    ack.header.shouldForward = false;
+    ack.header.srcMac = Fanet::Mac{0x07, 0x0005};
+    ack.header.hasExtensionHeader = true;
+    Fanet::ExtendedHeader ext;
+    ext.ackType = Fanet::ExtendedHeaderAckType::None;
+    ext.includesSignature = false;
+    ext.destinationMac = Fanet::Mac{0x07, 0x3D35};
+    ack.extHeader = ext;
+    ack.payload = Fanet::Ack();
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = ack.encode(bytes);
+
+    TEST_ASSERT_EQUAL(16, Fanet::Packet::parseInto(locationPacket, 16, packet));
+    TEST_ASSERT_TRUE(packet == Fanet::Packet::parse(locationPacket, 16));
+    TEST_ASSERT_EQUAL(size, Fanet::Packet::parseInto(bytes, size, packet));
+    TEST_ASSERT_TRUE(packet == ack);
+    Fanet::Packet::parseInto(locationPacket, 16, packet);
+    TEST_ASSERT_FALSE(packet.extHeader.has_value());
+
+    // A forward is the same frame as the one it repeats, but not equal to it
+    auto forward = packet;
+    forward.header.shouldForward = false;
+    TEST_ASSERT_TRUE(forward.sameFrame(packet));
+    TEST_ASSERT_FALSE(forward == packet);
+
+    // Frames handled into a packet the caller keeps
+    Fanet::FanetManager manager(Fanet::Mac{0xFB, 0x0001}, 1);
+    TEST_ASSERT_TRUE(manager.handleRx(locationPacket, 16, 1000, -110.0f, 4.0f, packet));
+    TEST_ASSERT_TRUE(packet.header.type == Fanet::PacketType::Tracking);
+    TEST_ASSERT_TRUE(manager.nextTxTime(1000).has_value());
+}
+
 void test_encodes(void) {
     // Let's assume that parsing is working
     auto packet = Fanet::Packet::parse(locationPacket, 16);
@@ -88,9 +154,1909 @@ void test_encodes(void) {
     // std::cout << std::endl;
 }
 
+// Tests frames encode to their size in bytes, and parse back to what was encoded
+void test_round_trips(void) {
+    // An ack addressed to whoever it's for, in the extended header, (asking for one in turn)
+    Fanet::Packet ack;
+    ack.header.type = Fanet::PacketType::Ack;
+    ack.header.shouldForward = false;
+    ack.header.srcMac = Fanet::Mac{0x07, 0x0005};
+    ack.header.hasExtensionHeader = true;
+    Fanet::ExtendedHeader ext;
+    ext.ackType = Fanet::ExtendedHeaderAckType::Requested;
+    ext.includesSignature = false;
+    ext.destinationMac = Fanet::Mac{0x08, 0x1234};
+    ack.extHeader = ext;
+    ack.payload = Fanet::Ack();
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    TEST_ASSERT_EQUAL(4 + 4, ack.encode(bytes));
+    auto parsed = Fanet::Packet::parse(bytes, 8);
+    TEST_ASSERT_TRUE(parsed.extHeader.has_value());
+    TEST_ASSERT_TRUE(parsed.extHeader.value().ackType == Fanet::ExtendedHeaderAckType::Requested);
+    TEST_ASSERT_TRUE(parsed.extHeader.value().destinationMac == ext.destinationMac);
+    TEST_ASSERT_TRUE(parsed == ack);
+
+    // Ground tracking
+    Fanet::Packet ground;
+    ground.header.type = Fanet::PacketType::GroundTracking;
+    ground.header.shouldForward = true;
+    ground.header.srcMac = Fanet::Mac{0x07, 0x0006};
+    ground.header.hasExtensionHeader = false;
+    Fanet::GroundTracking tracking;
+    tracking.location.latitude = 46.5f;
+    tracking.location.longitude = -8.25f;
+    tracking.type = Fanet::GroundTrackingType::NeedMedicalHelp;
+    tracking.shouldTrackOnline = true;
+    ground.payload = tracking;
+    TEST_ASSERT_EQUAL(4 + 7, ground.encode(bytes));
+    parsed = Fanet::Packet::parse(bytes, 11);
+    TEST_ASSERT_FALSE(parsed.extHeader.has_value());
+    auto& payload = etl::get<Fanet::GroundTracking>(parsed.payload);
+    TEST_ASSERT_TRUE(payload.type == Fanet::GroundTrackingType::NeedMedicalHelp);
+    TEST_ASSERT_TRUE(payload.shouldTrackOnline);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 46.5f, payload.location.latitude);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, -8.25f, payload.location.longitude);
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> again;
+    TEST_ASSERT_EQUAL(11, parsed.encode(again));
+    TEST_ASSERT_EQUAL_MEMORY(bytes.data(), again.data(), 11);
+}
+
+// Encodes a tracking payload and parses it back
+Fanet::Tracking trackingRoundTrip(float speed, float climbRate, int heading, uint16_t altitude) {
+    Fanet::Packet packet;
+    packet.header.type = Fanet::PacketType::Tracking;
+    packet.header.shouldForward = false;
+    packet.header.srcMac = Fanet::Mac{0x07, 0x0007};
+    packet.header.hasExtensionHeader = false;
+    Fanet::Tracking tracking;
+    tracking.location.latitude = 46.5f;
+    tracking.location.longitude = 8.0f;
+    tracking.altitude = altitude;
+    tracking.aircraftType = Fanet::AircraftType::Paraglider;
+    tracking.onlineTracking = true;
+    tracking.speed = speed;
+    tracking.climbRate = climbRate;
+    tracking.heading = heading;
+    packet.payload = tracking;
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = packet.encode(bytes);
+    return etl::get<Fanet::Tracking>(Fanet::Packet::parse(bytes, size).payload);
+}
+
+// Tests tracking fields survive encoding, scaled when they don't fit
+void test_tracking_codec(void) {
+    // Speed in 0.5 km/h, scaled by 5 past 63.5 km/h
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 35.0f, trackingRoundTrip(35.0f, 0.0f, 0, 1000).speed);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 63.5f, trackingRoundTrip(63.5f, 0.0f, 0, 1000).speed);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100.0f, trackingRoundTrip(100.0f, 0.0f, 0, 1000).speed);
+
+    // Climb rate in signed 0.1 m/s, scaled by 5 outside -6.4 to 6.3 m/s
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -2.3f, trackingRoundTrip(0.0f, -2.3f, 0, 1000).climbRate);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -6.4f, trackingRoundTrip(0.0f, -6.4f, 0, 1000).climbRate);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 6.3f, trackingRoundTrip(0.0f, 6.3f, 0, 1000).climbRate);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -10.0f, trackingRoundTrip(0.0f, -10.0f, 0, 1000).climbRate);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 8.0f, trackingRoundTrip(0.0f, 8.0f, 0, 1000).climbRate);
+
+    // Heading in 360/256 degrees, rounded, so 359 doesn't come back as 358, and 360 wraps to 0
+    TEST_ASSERT_EQUAL(1, trackingRoundTrip(0.0f, 0.0f, 1, 1000).heading);
+    TEST_ASSERT_EQUAL(90, trackingRoundTrip(0.0f, 0.0f, 90, 1000).heading);
+    TEST_ASSERT_EQUAL(359, trackingRoundTrip(0.0f, 0.0f, 359, 1000).heading);
+    TEST_ASSERT_EQUAL(0, trackingRoundTrip(0.0f, 0.0f, 360, 1000).heading);
+
+    // Altitude in 11 bits, the top 3 in the next byte, scaled by 4 past 2047 m
+    TEST_ASSERT_EQUAL(255, trackingRoundTrip(0.0f, 0.0f, 0, 255).altitude);
+    TEST_ASSERT_EQUAL(256, trackingRoundTrip(0.0f, 0.0f, 0, 256).altitude);
+    TEST_ASSERT_EQUAL(1500, trackingRoundTrip(0.0f, 0.0f, 0, 1500).altitude);
+    TEST_ASSERT_EQUAL(2047, trackingRoundTrip(0.0f, 0.0f, 0, 2047).altitude);
+    TEST_ASSERT_EQUAL(3000, trackingRoundTrip(0.0f, 0.0f, 0, 3000).altitude);
+}
+
+// Tests own positions receivers can extrapolate aren't sent
+void test_dead_reckoning(void) {
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    auto transmit = [](const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&) {
+        return true;
+    };
+    etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&)> tx(
+        transmit);
+    auto sent = [&manager, &tx](unsigned long ms) {
+        auto next = manager.nextTxTime(ms);
+        if (next.has_value()) manager.doTx(next.value(), tx);
+        return manager.getStats().txSuccess;
+    };
+
+    // Flying north at 36 km/h, (10 m/s)
+    Fanet::Location origin;
+    origin.latitude = 47.0f;
+    origin.longitude = 8.0f;
+    manager.setPos(origin.latitude, origin.longitude, 1000, 1000, 0, 0.0f, 36.0f);
+    TEST_ASSERT_EQUAL(1, sent(1000));
+
+    // Where receivers expect us 10 s later, nothing's sent
+    auto predicted = origin.offsetBy(100.0f, 0.0f);
+    manager.setPos(predicted.latitude, predicted.longitude, 1000, 11000, 0, 0.0f, 36.0f);
+    TEST_ASSERT_EQUAL(1, sent(11000));
+    TEST_ASSERT_EQUAL(1, manager.getStats().trackingSuppressed);
+
+    // Nor if we've climbed, but not by FANET_DR_MAX_ALT_ERROR_M
+    manager.setPos(predicted.latitude, predicted.longitude, 1010, 11000, 0, 0.0f, 36.0f);
+    TEST_ASSERT_EQUAL(1, sent(11000));
+    TEST_ASSERT_EQUAL(2, manager.getStats().trackingSuppressed);
+
+    // Once we're FANET_DR_MAX_ERROR_M off course, it is
+    auto turned = origin.offsetBy(150.0f, 50.0f);
+    manager.setPos(turned.latitude, turned.longitude, 1000, 12000, 0, 0.0f, 36.0f);
+    TEST_ASSERT_EQUAL(2, sent(12000));
+    TEST_ASSERT_EQUAL(2, manager.getStats().trackingSuppressed);
+
+    // And however well we're predicted, at least every FANET_DR_MAX_INTERVAL
+    predicted = turned.offsetBy(100.0f, 0.0f);
+    manager.setPos(predicted.latitude, predicted.longitude, 1000, 22000, 0, 0.0f, 36.0f);
+    TEST_ASSERT_EQUAL(2, sent(22000));
+    predicted = turned.offsetBy(200.0f, 0.0f);
+    manager.setPos(predicted.latitude, predicted.longitude, 1000, 32000, 0, 0.0f, 36.0f);
+    TEST_ASSERT_EQUAL(3, sent(32000));
+    TEST_ASSERT_EQUAL(3, manager.getStats().trackingSuppressed);
+}
+
+// Tests adding up stats, (as for a network of managers), covers every counter
+void test_stats(void) {
+    static_assert(sizeof(Fanet::Stats) % sizeof(uint32_t) == 0, "Stats are all uint32_t");
+    const size_t kFields = sizeof(Fanet::Stats) / sizeof(uint32_t);
+    uint32_t ones[kFields];
+    for (auto& field : ones) field = 1;
+    Fanet::Stats node;
+    memcpy(&node, ones, sizeof(node));
+
+    Fanet::Stats total;
+    total += node;
+    total += node;
+    uint32_t fields[kFields];
+    memcpy(fields, &total, sizeof(total));
+    for (size_t i = 0; i < kFields; i++) TEST_ASSERT_TRUE(fields[i] != 0);
+    TEST_ASSERT_EQUAL(2, total.rx);
+    TEST_ASSERT_EQUAL(2, total.fwdOneHopDrp);
+    TEST_ASSERT_EQUAL(1, total.packetPoolPeak);
+    TEST_ASSERT_EQUAL(1, total.loadLevel);
+}
+
+// Tests the log-linear histogram buckets and percentiles
+void test_histogram(void) {
+    Fanet::Histogram histogram;
+
+    // Small values get a bucket each, larger values share buckets within a power of two
+    TEST_ASSERT_EQUAL(3, Fanet::Histogram::bucketOf(3));
+    TEST_ASSERT_EQUAL(7, Fanet::Histogram::bucketOf(7));
+    TEST_ASSERT_EQUAL(Fanet::Histogram::bucketOf(1000), Fanet::Histogram::bucketOf(1023));
+    TEST_ASSERT_TRUE(Fanet::Histogram::lowerBound(Fanet::Histogram::bucketOf(1000)) <= 1000);
+    TEST_ASSERT_EQUAL(Fanet::Histogram::kBuckets - 1, Fanet::Histogram::bucketOf(UINT32_MAX));
+
+    for (uint32_t i = 1; i <= 100; i++) {
+        histogram.record(i);
+    }
+    TEST_ASSERT_EQUAL(100, histogram.count);
+    TEST_ASSERT_EQUAL(1, histogram.min);
+    TEST_ASSERT_EQUAL(100, histogram.max);
+    TEST_ASSERT_TRUE(histogram.mean() == 50.5f);
+
+    // Percentiles are upper bounds, within the bucket resolution
+    auto p50 = histogram.percentile(0.5f);
+    TEST_ASSERT_TRUE(p50 >= 50 && p50 <= 63);
+    TEST_ASSERT_EQUAL(100, histogram.percentile(1.0f));
+
+    histogram.reset();
+    TEST_ASSERT_EQUAL(0, histogram.count);
+    TEST_ASSERT_EQUAL(0, histogram.percentile(0.5f));
+
+#if FANET_INSTRUMENTATION
+    // The manager times and counts what it receives, forwards and sends, on a clock that ticks
+    // 50us each time it's read
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    Fanet::LegacyForwardPolicy legacy;
+    manager.setForwardPolicy(legacy);
+    unsigned long micros = 0;
+    auto clock = [&micros]() { return micros += 50; };
+    manager.setInstrumentationClock(etl::delegate<unsigned long()>(clock));
+    uint32_t sent = 0;
+    auto transmit = [&sent](const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&) {
+        sent++;
+        return true;
+    };
+    etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&)> tx(
+        transmit);
+
+    manager.handleRx(locationPacket, 16, 1000, -90.0f, 6.0f);
+    auto instrumentation = manager.getInstrumentation();
+    TEST_ASSERT_EQUAL(1, instrumentation.rxByType[(uint8_t)Fanet::PacketType::Tracking]);
+    TEST_ASSERT_EQUAL(1, instrumentation.rxProcessingUs.count);
+    TEST_ASSERT_EQUAL(50, instrumentation.rxProcessingUs.max);
+    TEST_ASSERT_EQUAL(1, manager.getStats().forwarded);
+    auto table = manager.getNeighborTable();
+    TEST_ASSERT_EQUAL(1, table.begin()->second.rxCount);
+    TEST_ASSERT_EQUAL(1, table.begin()->second.forwardCount);
+
+    // The forward's dwell is timed from when it was received
+    auto forwardAt = manager.nextTxTime(1000).value();
+    manager.doTx(forwardAt, tx);
+    instrumentation = manager.getInstrumentation();
+    TEST_ASSERT_EQUAL(1, instrumentation.txByType[(uint8_t)Fanet::PacketType::Tracking]);
+    TEST_ASSERT_EQUAL(forwardAt - 1000, instrumentation.txDwellMs.max);
+    TEST_ASSERT_EQUAL(1, instrumentation.csmaRetries.count);
+    TEST_ASSERT_EQUAL(0, instrumentation.csmaRetries.max);
+
+    // Our frame to the neighbor asking for an ack, and the ack 300ms later
+    auto neighbor = table.begin()->second.address;
+    Fanet::Message message;
+    strcpy(message.message, "Landed");
+    TEST_ASSERT_TRUE(manager.sendPacket(message, 5000, false, neighbor,
+                                        Fanet::ExtendedHeaderAckType::Requested));
+    manager.doTx(5000, tx);
+    Fanet::Packet ack;
+    ack.header.type = Fanet::PacketType::Ack;
+    ack.header.shouldForward = false;
+    ack.header.hasExtensionHeader = true;
+    ack.header.srcMac = neighbor;
+    Fanet::ExtendedHeader ext;
+    ext.ackType = Fanet::ExtendedHeaderAckType::None;
+    ext.includesSignature = false;
+    ext.destinationMac = us;
+    ack.extHeader = ext;
+    ack.payload = Fanet::Ack();
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = ack.encode(bytes);
+    manager.handleRx(bytes, size, 5300, -90.0f, 6.0f);
+    instrumentation = manager.getInstrumentation();
+    TEST_ASSERT_EQUAL(1, instrumentation.ackRoundTripMs.count);
+    TEST_ASSERT_EQUAL(300, instrumentation.ackRoundTripMs.max);
+    TEST_ASSERT_EQUAL(1, instrumentation.rxByType[(uint8_t)Fanet::PacketType::Ack]);
+
+    // One that's never acked is given up on, once we next send asking for one
+    TEST_ASSERT_TRUE(manager.sendPacket(message, 6000, false, neighbor,
+                                        Fanet::ExtendedHeaderAckType::Requested));
+    manager.doTx(6000, tx);
+    unsigned long later = 6000 + FANET_ACK_TIMEOUT + 1;
+    TEST_ASSERT_TRUE(manager.sendPacket(message, later, false, neighbor,
+                                        Fanet::ExtendedHeaderAckType::Requested));
+    manager.doTx(later, tx);
+    TEST_ASSERT_EQUAL(4, sent);
+    instrumentation = manager.getInstrumentation();
+    TEST_ASSERT_EQUAL(1, instrumentation.ackTimeouts);
+    TEST_ASSERT_EQUAL(1, instrumentation.ackRoundTripMs.count);
+    TEST_ASSERT_EQUAL(3, instrumentation.txByType[(uint8_t)Fanet::PacketType::Message]);
+
+    manager.resetInstrumentation();
+    instrumentation = manager.getInstrumentation();
+    TEST_ASSERT_EQUAL(0, instrumentation.rxProcessingUs.count);
+    TEST_ASSERT_EQUAL(0, instrumentation.rxByType[(uint8_t)Fanet::PacketType::Tracking]);
+    TEST_ASSERT_EQUAL(0, manager.getNeighborTable().begin()->second.rxCount);
+#endif
+}
+
+// Tests capture records can be read back, skipping over corrupt bytes
+void test_capture(void) {
+    etl::vector<uint8_t, 256> capture;
+    auto append = [&capture](const uint8_t* data, const size_t& length) {
+        for (size_t i = 0; i < length; i++) capture.push_back(data[i]);
+    };
+    Fanet::CaptureWriter writer((Fanet::CaptureWriter::Sink(append)));
+
+    writer.rx(1000, -87.25f, 6.5f, locationPacket.data(), 16);
+    capture.push_back(0xFA);  // A partial record
+    capture.push_back(0x02);
+    writer.tx(2000, true, locationPacket.data(), 16);
+    capture[20]++;  // Corrupt the frame in the first record
+    TEST_ASSERT_EQUAL(2, writer.getRecords());
+
+    Fanet::CaptureReader reader(capture.data(), capture.size());
+    Fanet::CaptureRecord record;
+    TEST_ASSERT_TRUE(reader.next(record));
+    TEST_ASSERT_TRUE(record.type == Fanet::CaptureRecordType::Tx);
+    TEST_ASSERT_EQUAL(2000, record.ms);
+    TEST_ASSERT_EQUAL(1, record.a);
+    TEST_ASSERT_EQUAL(16, record.length);
+    TEST_ASSERT_EQUAL(0, memcmp(record.body, locationPacket.data(), 16));
+    TEST_ASSERT_EQUAL(13 + 16 + 2, reader.getSkipped());
+    TEST_ASSERT_FALSE(reader.next(record));
+}
+
+// Tests the neighbor table survives a restart, aged by the time we were off
+void test_warm_start(void) {
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+
+    // Heard at 1s, and (from another address) at 200s
+    auto other = locationPacket;
+    other[2] = 0x36;
+    manager.handleRx(locationPacket, 16, 1000, -90.5f, 4.25f);
+    manager.handleRx(other, 16, 200000, -100.0f, -2.0f);
+
+    uint8_t state[Fanet::FanetManager::kMaxStateSize];
+    TEST_ASSERT_EQUAL(0, manager.saveState(state, 20, 210000));
+    auto size = manager.saveState(state, sizeof(state), 210000);
+    TEST_ASSERT_TRUE(size > 0);
+
+    // Restarted 100s later, the first neighbor would have timed out by now
+    Fanet::FanetManager restored(us, 2);
+    TEST_ASSERT_TRUE(restored.restoreState(state, size, 500, 100000));
+    auto table = restored.getNeighborTable();
+    TEST_ASSERT_EQUAL(1, table.size());
+    auto& neighbor = table.begin()->second;
+    TEST_ASSERT_TRUE(neighbor.rssi == -100.0f);
+    TEST_ASSERT_TRUE(neighbor.location.has_value());
+    TEST_ASSERT_EQUAL(110000, 500 - neighbor.lastSeen);
+
+    // Corrupt state is ignored
+    state[size - 2]++;
+    TEST_ASSERT_FALSE(restored.restoreState(state, size, 500));
+    TEST_ASSERT_EQUAL(1, restored.getNeighborTable().size());
+
+    // Restoring over a table tells the listener its neighbors are gone
+    state[size - 2]--;
+    uint32_t gone = 0;
+    auto listener = [&gone](const Fanet::Neighbor&, const bool& isGone) {
+        if (isGone) gone++;
+    };
+    Fanet::FanetManager::NeighborListener neighborListener(listener);
+    restored.setNeighborListener(neighborListener);
+    TEST_ASSERT_TRUE(restored.restoreState(state, size, 600, 100000));
+    TEST_ASSERT_EQUAL(1, gone);
+    TEST_ASSERT_EQUAL(1, restored.getNeighborTable().size());
+}
+
+// Tests track history keeps the most recent positions exactly, in far less than raw payloads
+void test_track_history(void) {
+    Fanet::TrackHistory<2> history;
+    TEST_ASSERT_TRUE(sizeof(history) / 2 * 4 < FANET_TRACK_HISTORY_FIXES * sizeof(Fanet::Tracking));
+
+    // A glider heading north east at about 70km/h, climbing, a position every 3s
+    Fanet::TrackFix fixes[100];
+    auto track = Fanet::kNoTrack;
+    for (int i = 0; i < 100; i++) {
+        fixes[i].ms = 1000 + i * 3000 + (i % 3) * 7;
+        fixes[i].location.latitude = (4300000 + i * 40) / Fanet::kLatitudeScaling;
+        fixes[i].location.longitude = (370000 + i * 25 - (i % 5)) / Fanet::kLongitudeScaling;
+        fixes[i].altitude = 1500 + i * 2;
+        track = history.add(track, 0x07353D, fixes[i]);
+    }
+    TEST_ASSERT_EQUAL(0, track);
+
+    // The oldest positions made way for the latest, which decode exactly
+    auto range = history.get(track);
+    TEST_ASSERT_TRUE(range.size() >= 20 && range.size() <= FANET_TRACK_HISTORY_FIXES);
+    int i = 100 - range.size();
+    for (auto& fix : range) {
+        TEST_ASSERT_EQUAL(fixes[i].ms, fix.ms);
+        TEST_ASSERT_TRUE(fixes[i].location == fix.location);
+        TEST_ASSERT_EQUAL(fixes[i].altitude, fix.altitude);
+        i++;
+    }
+    TEST_ASSERT_EQUAL(100, i);
+
+    // Another neighbor gets its own track, and released tracks are reused
+    TEST_ASSERT_EQUAL(1, history.add(Fanet::kNoTrack, 0x07353E, fixes[0]));
+    TEST_ASSERT_EQUAL(Fanet::kNoTrack, history.add(Fanet::kNoTrack, 0x07353F, fixes[0]));
+    history.release(0);
+    TEST_ASSERT_EQUAL(0, history.get(0).size());
+    TEST_ASSERT_EQUAL(0, history.add(Fanet::kNoTrack, 0x07353F, fixes[0]));
+
+#if FANET_TRACK_HISTORY
+    // The manager keeps a track of every neighbor's positions, as it parsed them
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    Fanet::Packet packet;
+    packet.header.type = Fanet::PacketType::Tracking;
+    packet.header.shouldForward = false;
+    packet.header.hasExtensionHeader = false;
+    Fanet::Tracking tracking;
+    tracking.aircraftType = Fanet::AircraftType::Paraglider;
+    tracking.onlineTracking = true;
+    tracking.speed = 36;
+    tracking.climbRate = 0;
+    tracking.heading = 0;
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto send = [&](const uint16_t& device, const int& n, const unsigned long& ms) {
+        packet.header.srcMac = Fanet::Mac{0x07, device};
+        tracking.location = {47.0f + n * 0.0003f, 8.0f};
+        tracking.altitude = 1000 + n;
+        packet.payload = tracking;
+        auto size = packet.encode(bytes);
+        return manager.handleRx(bytes, size, ms, -100.0f, 2.0f);
+    };
+    for (int n = 0; n < 3; n++) {
+        auto parsed = send(1, n, 1000 + n * 3000);
+        auto& payload = etl::get<Fanet::Tracking>(parsed.value().payload);
+        fixes[n].ms = 1000 + n * 3000;
+        fixes[n].location = payload.location;
+        fixes[n].altitude = payload.altitude;
+    }
+    auto managed = manager.getTrack(Fanet::Mac{0x07, 1});
+    TEST_ASSERT_EQUAL(3, managed.size());
+    i = 0;
+    for (auto& fix : managed) {
+        TEST_ASSERT_EQUAL(fixes[i].ms, fix.ms);
+        TEST_ASSERT_TRUE(fixes[i].location == fix.location);
+        TEST_ASSERT_EQUAL(fixes[i].altitude, fix.altitude);
+        i++;
+    }
+    TEST_ASSERT_EQUAL(0, manager.getTrack(Fanet::Mac{0x07, 2}).size());
+
+    // Tracks are freed as neighbors time out, so a table's worth of new neighbors each get one
+    for (uint16_t device = 2; device <= FANET_MAX_NEIGHBORS; device++) send(device, 0, 10000);
+    manager.flushOldNeighborEntries(10000 + FANET_NEIGHBOR_MAX_TIMEOUT + 1);
+    TEST_ASSERT_EQUAL(0, manager.getNeighborTable().size());
+    unsigned long later = 20000 + FANET_NEIGHBOR_MAX_TIMEOUT;
+    for (uint16_t device = 1000; device < 1000 + FANET_MAX_NEIGHBORS; device++) {
+        send(device, 0, later);
+        TEST_ASSERT_EQUAL(1, manager.getTrack(Fanet::Mac{0x07, device}).size());
+    }
+#endif
+}
+
+// A tracker only needs positions, and a handful of neighbors
+struct TrackerConfig : Fanet::DefaultConfig {
+    static const size_t maxNeighbors = 16;
+    static const size_t txQueueDepth = 4;
+    static const size_t packetPoolSize = 2;
+    static const unsigned long csmaMax = 60;  // Overridden as fanetConfig.h shows
+    using Payload = etl::variant<Fanet::Ack, Fanet::Tracking, Fanet::GroundTracking>;
+};
+template class Fanet::BasicFanetManager<TrackerConfig>;
+
+void test_tracker_config(void) {
+    using Tracker = Fanet::BasicFanetManager<TrackerConfig>;
+    TEST_ASSERT_TRUE(sizeof(Tracker::Packet) < sizeof(Fanet::Packet));
+
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Tracker tracker(us, 1);
+
+    // Positions are parsed and forwarded as usual
+    auto packet = tracker.handleRx(locationPacket, 16, 1000, -110.0f, 4.0f);
+    TEST_ASSERT_TRUE(packet.has_value());
+    TEST_ASSERT_TRUE(tracker.getNeighborTable().begin()->second.location.has_value());
+    TEST_ASSERT_TRUE(tracker.nextTxTime(1000).has_value());
+
+    // Names aren't carried, only their headers are seen, and they're not forwarded
+    Fanet::Packet name;
+    name.header.type = Fanet::PacketType::Name;
+    name.header.shouldForward = true;
+    name.header.srcMac.manufacturer = 0x07;
+    name.header.srcMac.device = 0x1234;
+    Fanet::Name payload;
+    payload.name = "Tracker";
+    name.payload = payload;
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = name.encode(bytes);
+    packet = tracker.handleRx(bytes, size, 5000, -110.0f, 4.0f);
+    TEST_ASSERT_TRUE(packet.has_value());
+    TEST_ASSERT_EQUAL((int)Fanet::PacketType::Name, (int)packet.value().header.type);
+    TEST_ASSERT_EQUAL(2, tracker.getNeighborTable().size());
+    TEST_ASSERT_FALSE(tracker.nextTxTime(5000).has_value());
+}
+
+void test_packet_pool(void) {
+    // Refs share a slot, which is free again once the last of them is gone
+    Fanet::PacketPool<Fanet::Packet, 2> pool;
+    auto first = pool.acquire();
+    auto shared = first;
+    TEST_ASSERT_EQUAL(2, first.useCount());
+    auto second = pool.acquire();
+    TEST_ASSERT_TRUE(second);
+    TEST_ASSERT_FALSE(pool.acquire());
+    first.reset();
+    TEST_ASSERT_EQUAL(2, pool.inUse());
+    shared.reset();
+    TEST_ASSERT_EQUAL(1, pool.inUse());
+    TEST_ASSERT_TRUE(pool.acquire());
+    TEST_ASSERT_EQUAL(2, pool.peak());
+
+    // A frame received into the pool is shared with its forward, which is sent without its
+    // forward bit
+    Fanet::FanetManager manager(Fanet::Mac{0xFB, 0x0001}, 1);
+    Fanet::LegacyForwardPolicy legacy;
+    manager.setForwardPolicy(legacy);
+    Fanet::FanetManager::PacketRef packet;
+    TEST_ASSERT_TRUE(manager.handleRx(locationPacket, 16, 1000, -110.0f, 4.0f, packet));
+    TEST_ASSERT_EQUAL(2, packet.useCount());
+    TEST_ASSERT_TRUE(packet->header.shouldForward);
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> sent;
+    auto transmit = [&sent](const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                            const size_t&) {
+        sent = *bytes;
+        return true;
+    };
+    etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&)> tx(
+        transmit);
+    manager.doTx(manager.nextTxTime(1000).value(), tx);
+    TEST_ASSERT_EQUAL(locationPacket[0] & ~0x40, sent[0]);
+    TEST_ASSERT_EQUAL_MEMORY(locationPacket.data() + 1, sent.data() + 1, 15);
+    TEST_ASSERT_EQUAL(1, packet.useCount());
+
+    // With every slot held, frames still update the neighbor table but aren't kept, and our own
+    // packets push out queued forwards
+    using Tracker = Fanet::BasicFanetManager<TrackerConfig>;
+    Tracker tracker(Fanet::Mac{0xFB, 0x0001}, 1);
+    tracker.setForwardPolicy(legacy);
+    Tracker::PacketRef held[3];
+    for (int i = 0; i < 3; i++) {
+        auto frame = locationPacket;
+        frame[2] = 0x40 + i;
+        tracker.handleRx(frame, 16, 1000, -110.0f, 4.0f, held[i]);
+    }
+    TEST_ASSERT_FALSE(held[2]);
+    TEST_ASSERT_EQUAL(3, tracker.getNeighborTable().size());
+    TEST_ASSERT_EQUAL(1, tracker.getStats().rxPoolDrp);
+    TEST_ASSERT_EQUAL(1, tracker.getStats().fwdPoolDrp);
+    held[0].reset();
+    held[1].reset();
+    TEST_ASSERT_TRUE(tracker.sendPacket(Fanet::Ack(), 1000, false, Fanet::Mac{0x07, 1}));
+    TEST_ASSERT_TRUE(tracker.sendPacket(Fanet::Ack(), 1000, false, Fanet::Mac{0x07, 2}));
+    TEST_ASSERT_EQUAL(2, tracker.getStats().forwarded);
+    TEST_ASSERT_EQUAL(3, tracker.getStats().fwdPoolDrp);
+    TEST_ASSERT_FALSE(tracker.sendPacket(Fanet::Ack(), 1000, false, Fanet::Mac{0x07, 3}));
+    TEST_ASSERT_EQUAL(1, tracker.getStats().txPoolDrp);
+    TEST_ASSERT_EQUAL(2, tracker.getStats().packetPoolPeak);
+}
+
+void test_csma(void) {
+    // FANET's time on air, SF7 at 250 kHz, for a 16 byte tracking frame
+    TEST_ASSERT_EQUAL(26, Fanet::Csma::airtime(16));
+
+    // With the channel idle, the exponential back-off window doubles with each retry
+    Fanet::Csma csma(20, 40);
+    etl::random_xorshift random(1);
+    unsigned long shortest = 1000, longest[3] = {0, 0, 0};
+    for (int i = 0; i < 500; i++) {
+        for (uint8_t retries = 0; retries < 3; retries++) {
+            auto backoff = csma.backoff(retries, random);
+            shortest = etl::min(shortest, backoff);
+            longest[retries] = etl::max(longest[retries], backoff);
+        }
+    }
+    TEST_ASSERT_TRUE(shortest >= 20);
+    TEST_ASSERT_TRUE(longest[0] <= 40);
+    TEST_ASSERT_TRUE(longest[1] > 40 && longest[1] <= 60);
+    TEST_ASSERT_TRUE(longest[2] > 60 && longest[2] <= 100);
+
+    // Hearing frames half the time, the estimate settles near a half and retries spread out
+    for (unsigned long ms = 0; ms < 20000; ms += 52) csma.heard(ms, 16);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 0.5f, csma.busyRatio());
+    longest[0] = 0;
+    for (int i = 0; i < 500; i++) longest[0] = etl::max(longest[0], csma.backoff(0, random));
+    TEST_ASSERT_TRUE(longest[0] > 40);
+
+    // A quiet minute later it's idle again, and failed channel checks count as busy too
+    csma.attempted(80000, false);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, csma.busyRatio());
+    for (int i = 0; i < 20; i++) csma.attempted(80100 + i, i % 4 != 0);
+    csma.attempted(81000, false);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.25f * 0.75f, csma.busyRatio());
+    TEST_ASSERT_EQUAL(22, csma.getStats().attempts);
+    TEST_ASSERT_EQUAL(15, csma.getStats().busy);
+
+    // How many retries frames needed
+    csma.sent(0);
+    csma.sent(2);
+    csma.sent(200);
+    TEST_ASSERT_EQUAL(1, csma.getStats().retries[0]);
+    TEST_ASSERT_EQUAL(1, csma.getStats().retries[2]);
+    TEST_ASSERT_EQUAL(1, csma.getStats().retries[FANET_CSMA_RETRY_BUCKETS - 1]);
+
+    // Fixed keeps to its window, p-persistent puts attempts off as the channel fills
+    csma.setMode(Fanet::CsmaMode::Fixed);
+    for (int i = 0; i < 100; i++) {
+        auto backoff = csma.backoff(5, random);
+        TEST_ASSERT_TRUE(backoff >= 20 && backoff <= 40);
+        TEST_ASSERT_FALSE(csma.defer(random));
+    }
+    csma.setMode(Fanet::CsmaMode::Persistent);
+    for (int i = 0; i < 100; i++) csma.defer(random);
+    TEST_ASSERT_TRUE(csma.getStats().deferred > 5 && csma.getStats().deferred < 40);
+}
+
+void test_tickless(void) {
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    TEST_ASSERT_FALSE(manager.nextEventTime(0).has_value());
+
+    // Parked, with three neighbors sending their positions every 15s, one leaving after 10 min
+    manager.setPos(47.0f, 8.0f, 500, 0);
+    uint32_t sent = 0;
+    auto transmit = [&sent](const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&) {
+        sent++;
+        return true;
+    };
+    etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&)> tx(
+        transmit);
+
+    // Sleep until the next event or a frame is received, whichever comes first
+    const unsigned long kHour = 1000UL * 60 * 60;
+    unsigned long ms = 0, nextRx = 5000;
+    uint32_t timerWakeups = 0, rxWakeups = 0, neighbor = 0;
+    while (ms < kHour && timerWakeups < 100000) {
+        auto next = manager.nextEventTime(ms);
+        TEST_ASSERT_TRUE(!next.has_value() || next.value() >= ms);
+        if (!next.has_value() || nextRx <= next.value()) {
+            ms = nextRx;
+            auto frame = locationPacket;
+            frame[2] = 0x40 + neighbor;
+            manager.handleRx(frame, 16, ms, -110.0f, 4.0f);
+            neighbor = (neighbor + 1) % (ms < kHour / 6 ? 3 : 2);
+            nextRx += 5000;
+            rxWakeups++;
+        } else {
+            ms = next.value();
+            timerWakeups++;
+        }
+        manager.service(ms, tx);
+    }
+
+    char message[80];
+    snprintf(message, sizeof(message), "%u timer and %u rx wake-ups in an hour, %u frames sent",
+             timerWakeups, rxWakeups, sent);
+    TEST_MESSAGE(message);
+
+    // Queueing our position every 20s, and a wake-up per frame sent, rather than polling
+    const uint32_t positions = kHour / (FANET_DR_MAX_INTERVAL);
+    TEST_ASSERT_TRUE(sent >= positions);
+    TEST_ASSERT_TRUE(timerWakeups <= sent + positions + 10);
+    TEST_ASSERT_EQUAL(2, manager.getNeighborTable().size());
+}
+
+void test_names(void) {
+    // Room for three names, but only 16 bytes
+    Fanet::NameArena<3, 16> arena;
+    auto hash = [](const char* name) { return Fanet::hashName((const uint8_t*)name, strlen(name)); };
+    auto alice = arena.add(Fanet::kNoName, 1, hash("Alice"), "Alice", 5);
+    auto bob = arena.add(Fanet::kNoName, 2, hash("Bob"), "Bob", 3);
+    TEST_ASSERT_TRUE(arena.get(alice) == "Alice");
+    TEST_ASSERT_EQUAL(hash("Bob"), arena.hash(bob));
+    uint32_t owner = 0;
+    TEST_ASSERT_TRUE(arena.find("Bob", owner));
+    TEST_ASSERT_EQUAL(2, owner);
+    TEST_ASSERT_FALSE(arena.find("Carol", owner));
+
+    // Renaming leaves a gap, closed up when there's no room at the end
+    TEST_ASSERT_EQUAL(alice, arena.add(alice, 1, hash("Alicia"), "Alicia", 6));
+    TEST_ASSERT_EQUAL(2, arena.available());
+    auto carol = arena.add(Fanet::kNoName, 3, hash("Carol"), "Carol", 5);
+    TEST_ASSERT_TRUE(carol != Fanet::kNoName);
+    TEST_ASSERT_TRUE(arena.get(alice) == "Alicia");
+    TEST_ASSERT_TRUE(arena.get(bob) == "Bob");
+    TEST_ASSERT_TRUE(arena.get(carol) == "Carol");
+    TEST_ASSERT_EQUAL(Fanet::kNoName, arena.add(Fanet::kNoName, 4, hash("Dave"), "Dave", 4));
+    arena.release(bob);
+    TEST_ASSERT_FALSE(arena.find("Bob", owner));
+
+#if FANET_NAME_CACHE
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+
+    Fanet::LegacyForwardPolicy legacy;
+    manager.setForwardPolicy(legacy);
+
+    Fanet::Packet packet;
+    packet.header.type = Fanet::PacketType::Name;
+    packet.header.shouldForward = false;
+    packet.header.hasExtensionHeader = false;
+    packet.header.srcMac.manufacturer = 0x07;
+    packet.header.srcMac.device = 0x1234;
+    Fanet::Name name;
+    name.name = "Glider Pilot";
+    packet.payload = name;
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = packet.encode(bytes);
+
+    // Handed to the application the first time, then recognised without parsing it again
+    TEST_ASSERT_TRUE(manager.handleRx(bytes, size, 1000, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_FALSE(manager.handleRx(bytes, size, 2000, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_EQUAL(1, manager.getStats().processed);
+    TEST_ASSERT_TRUE(manager.getName(packet.header.srcMac) == "Glider Pilot");
+    auto neighbor = manager.findByName("Glider Pilot");
+    TEST_ASSERT_NOT_NULL(neighbor);
+    TEST_ASSERT_TRUE(neighbor->address == packet.header.srcMac);
+
+    // A name we have that asks to be forwarded is, from the copy we have
+    packet.header.shouldForward = true;
+    size = packet.encode(bytes);
+    TEST_ASSERT_FALSE(manager.handleRx(bytes, size, 2500, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_EQUAL(1, manager.getStats().forwarded);
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> sent;
+    size_t sentSize = 0;
+    auto transmit = [&sent, &sentSize](const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                                       const size_t& size) {
+        sent = *bytes;
+        sentSize = size;
+        return true;
+    };
+    etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&)> tx(
+        transmit);
+    manager.doTx(manager.nextTxTime(2500).value(), tx);
+    auto forwarded = Fanet::Packet::parse(sent, sentSize);
+    TEST_ASSERT_FALSE(forwarded.header.shouldForward);
+    TEST_ASSERT_TRUE(forwarded.header.srcMac == packet.header.srcMac);
+    TEST_ASSERT_TRUE(etl::get<Fanet::Name>(forwarded.payload).name == "Glider Pilot");
+
+    // A new name is passed on again
+    packet.header.shouldForward = false;
+    name.name = "Glider Pilot 2";
+    packet.payload = name;
+    size = packet.encode(bytes);
+    TEST_ASSERT_TRUE(manager.handleRx(bytes, size, 3000, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_TRUE(manager.getName(packet.header.srcMac) == "Glider Pilot 2");
+    TEST_ASSERT_NULL(manager.findByName("Glider Pilot"));
+#endif
+}
+
+void test_proximity(void) {
+    // Flying north at 36km/h
+    Fanet::MotionState own;
+    own.location = {47.0f, 8.0f};
+    own.altitude = 1000;
+    own.speed = 36;
+    own.ms = 100000;
+
+    // Head on from 500m, the same level 200m above us, heading away to the east, and one we
+    // haven't heard from for too long
+    Fanet::MotionState headOn = own;
+    headOn.location = own.location.offsetBy(500, 0);
+    headOn.heading = 180;
+    Fanet::MotionState above = own;
+    above.location = own.location.offsetBy(300, 0);
+    above.altitude = 1200;
+    above.heading = 180;
+    Fanet::MotionState away = own;
+    away.location = own.location.offsetBy(0, 400);
+    away.heading = 90;
+    Fanet::MotionState stale = headOn;
+    stale.ms = own.ms - FANET_PROXIMITY_MAX_AGE - 1000;
+
+    Fanet::ProximityEngine<8> engine;
+    auto slot = engine.update(Fanet::kNoProximity, 1, headOn);
+    engine.update(Fanet::kNoProximity, 2, above);
+    engine.update(Fanet::kNoProximity, 3, away);
+    engine.update(Fanet::kNoProximity, 4, stale);
+    TEST_ASSERT_EQUAL(4, engine.size());
+
+    // Closing at 20m/s, 25s away is too far ahead to worry about
+    TEST_ASSERT_TRUE(engine.evaluate(own, own.ms) == Fanet::ProximityLevel::None);
+
+    // 10s later both have flown 100m, and it's 15s away, (the sender's position is extrapolated)
+    own.location = own.location.offsetBy(100, 0);
+    own.ms += 10000;
+    TEST_ASSERT_TRUE(engine.evaluate(own, own.ms) == Fanet::ProximityLevel::Low);
+
+    // The next frame has it 250m north of where we now are
+    headOn.location = own.location.offsetBy(150, 0);
+    headOn.ms = own.ms;
+    TEST_ASSERT_EQUAL(slot, engine.update(slot, 1, headOn));
+    TEST_ASSERT_TRUE(engine.evaluate(own, own.ms) == Fanet::ProximityLevel::Urgent);
+
+    etl::vector<Fanet::ProximityAlert, 4> alerts;
+    engine.getAlerts(alerts);
+    TEST_ASSERT_EQUAL(1, alerts.size());
+    TEST_ASSERT_EQUAL(1, alerts[0].address);
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, 7.5f, alerts[0].timeToCpa);
+    TEST_ASSERT_FLOAT_WITHIN(2.0f, 0.0f, alerts[0].distanceAtCpa);
+    TEST_ASSERT_FLOAT_WITHIN(2.0f, 150.0f, alerts[0].distance);
+
+    engine.release(slot);
+    TEST_ASSERT_TRUE(engine.evaluate(own, own.ms) == Fanet::ProximityLevel::None);
+    TEST_ASSERT_EQUAL(3, engine.size());
+
+#if FANET_PROXIMITY
+    // The manager re-evaluates its airborne neighbors on every fix
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    Fanet::Packet packet;
+    packet.header.type = Fanet::PacketType::Tracking;
+    packet.header.srcMac.manufacturer = 0x07;
+    packet.header.srcMac.device = 0x1234;
+    Fanet::Tracking tracking;
+    tracking.location = headOn.location;
+    tracking.altitude = 1000;
+    tracking.speed = 36;
+    tracking.heading = 180;
+    packet.payload = tracking;
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = packet.encode(bytes);
+    manager.handleRx(bytes, size, own.ms, -100.0f, 2.0f);
+    manager.setPos(own.location.latitude, own.location.longitude, 1000, own.ms, 0, 0.0f, 36);
+    TEST_ASSERT_TRUE(manager.getProximityLevel() == Fanet::ProximityLevel::Urgent);
+    TEST_ASSERT_EQUAL(1, manager.getAlerts().size());
+    TEST_ASSERT_TRUE(manager.getAlerts()[0].address == packet.header.srcMac.toInt32());
+
+    // Not once it's landed
+    Fanet::GroundTracking ground;
+    ground.location = headOn.location;
+    ground.type = Fanet::GroundTrackingType::LandedWell;
+    packet.header.type = Fanet::PacketType::GroundTracking;
+    packet.payload = ground;
+    size = packet.encode(bytes);
+    manager.handleRx(bytes, size, own.ms + 1000, -100.0f, 2.0f);
+    manager.setPos(own.location.latitude, own.location.longitude, 1000, own.ms + 1000, 0, 0.0f, 36);
+    TEST_ASSERT_TRUE(manager.getProximityLevel() == Fanet::ProximityLevel::None);
+
+    // Neighbors that time out are let go of, so a table's worth of new ones are all watched
+    auto send = [&](const uint16_t& device, const Fanet::Location& location,
+                    const unsigned long& ms) {
+        packet.header.type = Fanet::PacketType::Tracking;
+        packet.header.srcMac.device = device;
+        tracking.location = location;
+        packet.payload = tracking;
+        size = packet.encode(bytes);
+        manager.handleRx(bytes, size, ms, -100.0f, 2.0f);
+    };
+    auto far = own.location.offsetBy(20000, 0);
+    unsigned long ms = own.ms + 2000;
+    for (uint16_t device = 1; device <= FANET_MAX_NEIGHBORS; device++) send(device, far, ms);
+    ms += FANET_NEIGHBOR_MAX_TIMEOUT + 1;
+    manager.flushOldNeighborEntries(ms);
+    TEST_ASSERT_EQUAL(0, manager.getNeighborTable().size());
+    for (uint16_t device = 1000; device < 1000 + FANET_MAX_NEIGHBORS - 1; device++) {
+        send(device, far, ms);
+    }
+    send(0x4321, own.location.offsetBy(150, 0), ms);
+    manager.setPos(own.location.latitude, own.location.longitude, 1000, ms, 0, 0.0f, 36);
+    TEST_ASSERT_TRUE(manager.getProximityLevel() == Fanet::ProximityLevel::Urgent);
+    TEST_ASSERT_EQUAL(1, manager.getAlerts().size());
+    TEST_ASSERT_TRUE(manager.getAlerts()[0].address == 0x074321);
+#endif
+}
+
+// Sends a tracking frame from a neighbor, north and east (m) of 47N 8E
+static void sendPosition(Fanet::FanetManager& manager,
+                         uint16_t device,
+                         float north,
+                         float east,
+                         unsigned long ms,
+                         bool forward,
+                         etl::optional<Fanet::Mac> destination = etl::nullopt,
+                         float rssi = -110.0f) {
+    Fanet::Location origin;
+    origin.latitude = 47.0f;
+    origin.longitude = 8.0f;
+    Fanet::Packet packet;
+    packet.header.type = Fanet::PacketType::Tracking;
+    packet.header.shouldForward = forward;
+    packet.header.srcMac.manufacturer = 0x07;
+    packet.header.srcMac.device = device;
+    packet.header.hasExtensionHeader = destination.has_value();
+    if (destination.has_value()) {
+        Fanet::ExtendedHeader ext;
+        ext.ackType = Fanet::ExtendedHeaderAckType::None;
+        ext.includesSignature = false;
+        ext.destinationMac = destination.value();
+        packet.extHeader = ext;
+    }
+    Fanet::Tracking tracking;
+    tracking.location = origin.offsetBy(north, east);
+    tracking.altitude = 1000;
+    tracking.aircraftType = Fanet::AircraftType::Paraglider;
+    tracking.onlineTracking = true;
+    tracking.speed = 0;
+    tracking.climbRate = 0;
+    tracking.heading = 0;
+    packet.payload = tracking;
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = packet.encode(bytes);
+    manager.handleRx(bytes, size, ms, rssi, 2.0f);
+}
+
+void test_forward_policy(void) {
+    etl::random_xorshift random(1);
+    Fanet::DensityForwardPolicy density;
+
+    // Frames heard strongly aren't forwarded, weak ones always are with few neighbors around,
+    // and soon
+    Fanet::TxSchedule strong(1000, -80.0f);
+    TEST_ASSERT_TRUE(density.admit(strong, 5, random) == Fanet::ForwardVerdict::RssiDrop);
+    TEST_ASSERT_EQUAL(1, density.getStats().rssiDrop);
+    for (int i = 0; i < 100; i++) {
+        Fanet::TxSchedule weak(1000, -125.0f);
+        TEST_ASSERT_TRUE(density.admit(weak, 5, random) == Fanet::ForwardVerdict::Forward);
+        TEST_ASSERT_TRUE(weak.sendAt >= 1000 + FANET_RXMIT_MIN);
+        TEST_ASSERT_TRUE(weak.sendAt <=
+                         1000 + FANET_RXMIT_MIN + (FANET_RXMIT_MAX - FANET_RXMIT_MIN) / 2);
+    }
+    TEST_ASSERT_EQUAL(100, density.getStats().admitted);
+
+    // Crowded, only about FANET_FORWARD_MIN_PROBABILITY of frames heard near the max rssi are,
+    // and they wait longer than they would have, to hear others' copies first
+    density.resetStats();
+    unsigned long latest = 0;
+    for (int i = 0; i < 1000; i++) {
+        Fanet::TxSchedule near(1000, -91.0f);
+        if (density.admit(near, 100, random) == Fanet::ForwardVerdict::Forward) {
+            latest = etl::max(latest, near.sendAt);
+        }
+    }
+    TEST_ASSERT_EQUAL(1000, density.getStats().admitted + density.getStats().randomDrop);
+    TEST_ASSERT_TRUE(density.getStats().admitted > 60 && density.getStats().admitted < 140);
+    TEST_ASSERT_TRUE(latest > 1000 + FANET_RXMIT_MAX);
+    TEST_ASSERT_TRUE(latest <= 1000 + FANET_RXMIT_MIN +
+                                   (FANET_RXMIT_MAX - FANET_RXMIT_MIN) *
+                                       FANET_FORWARD_MAX_BACKOFF_SCALE);
+
+    // A queued forward keeps its slot while copies are heard, until enough have been
+    Fanet::TxSchedule queued(1200, -110.0f, 1000);
+    TEST_ASSERT_TRUE(density.copyHeard(queued, -112.0f, 1100, random) ==
+                     Fanet::ForwardVerdict::Forward);
+    TEST_ASSERT_EQUAL(1200, queued.sendAt);
+    TEST_ASSERT_TRUE(density.copyHeard(queued, -108.0f, 1150, random) ==
+                     Fanet::ForwardVerdict::Suppressed);
+    TEST_ASSERT_EQUAL(1, density.getStats().copiesCancel);
+
+    // Or a much stronger copy is, (someone closer has forwarded it our way)
+    Fanet::TxSchedule boosted(1200, -110.0f, 1000);
+    TEST_ASSERT_TRUE(density.copyHeard(boosted, -85.0f, 1100, random) ==
+                     Fanet::ForwardVerdict::RssiDrop);
+    TEST_ASSERT_EQUAL(1, density.getStats().boostCancel);
+    TEST_ASSERT_EQUAL(3, density.getStats().copiesHeard);
+
+    // The legacy policy only cancels on a much stronger copy, putting the forward off otherwise
+    Fanet::LegacyForwardPolicy legacy;
+    Fanet::TxSchedule rescheduled(1200, -110.0f, 1000);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(legacy.copyHeard(rescheduled, -108.0f, 1100, random) ==
+                         Fanet::ForwardVerdict::Forward);
+    }
+    TEST_ASSERT_TRUE(rescheduled.sendAt >= 1100 + FANET_RXMIT_MIN);
+    TEST_ASSERT_TRUE(legacy.copyHeard(rescheduled, -85.0f, 1150, random) ==
+                     Fanet::ForwardVerdict::RssiDrop);
+    TEST_ASSERT_EQUAL(1, legacy.getStats().boostCancel);
+}
+
+void test_geo_forward(void) {
+    Fanet::Location origin;
+    origin.latitude = 47.0f;
+    origin.longitude = 8.0f;
+    float latitudes[3] = {47.0f, 47.01f, 47.0f};
+    float longitudes[3] = {8.0f, 8.0f, 8.01f};
+    float distances[3];
+    Fanet::squaredDistances(origin, latitudes, longitudes, 3, distances);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 0.0f, distances[0]);
+    TEST_ASSERT_FLOAT_WITHIN(2.0f, 1113.2f, sqrtf(distances[1]));
+    TEST_ASSERT_FLOAT_WITHIN(2.0f, 759.2f, sqrtf(distances[2]));
+
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    Fanet::LegacyForwardPolicy legacy;
+    manager.setForwardPolicy(legacy);
+
+    // Without our position, forwarding is left to the policy
+    sendPosition(manager, 2, -300.0f, 0.0f, 1000, true);
+    TEST_ASSERT_EQUAL(1, manager.getStats().forwarded);
+    manager.setPos(47.0f, 8.0f, 1000, 1000);
+
+    // Neighbors 3km north and south, who aren't asking for forwards
+    sendPosition(manager, 3, 3000.0f, 0.0f, 2000, false);
+    sendPosition(manager, 4, -3000.0f, 0.0f, 2000, false);
+    auto table = manager.getNeighborTable();
+    TEST_ASSERT_FLOAT_WITHIN(10.0f, 3000.0f, table[0x070003].distance);
+
+    // A broadcast from 300m away has already reached almost everyone we could
+    sendPosition(manager, 2, -300.0f, 0.0f, 3000, true);
+    TEST_ASSERT_EQUAL(1, manager.getStats().forwarded);
+    TEST_ASSERT_EQUAL(1, manager.getStats().fwdGeoDrp);
+
+    // One from 5km away hasn't
+    sendPosition(manager, 5, 0.0f, -5000.0f, 4000, true);
+    TEST_ASSERT_EQUAL(2, manager.getStats().forwarded);
+
+    // From nearby to the north, we're closer to the destination than the sender
+    sendPosition(manager, 2, -300.0f, 0.0f, 5000, true, Fanet::Mac{0x07, 3});
+    TEST_ASSERT_EQUAL(3, manager.getStats().forwarded);
+
+    // ... to the south, we're not
+    sendPosition(manager, 2, -300.0f, 0.0f, 6000, true, Fanet::Mac{0x07, 4});
+    TEST_ASSERT_EQUAL(3, manager.getStats().forwarded);
+    TEST_ASSERT_EQUAL(2, manager.getStats().fwdGeoDrp);
+
+    // Distances follow us as we move
+    manager.setPos(47.0f + 3000.0f / Fanet::kMetersPerDegree, 8.0f, 1000, 7000);
+    table = manager.getNeighborTable();
+    TEST_ASSERT_FLOAT_WITHIN(10.0f, 0.0f, table[0x070003].distance);
+    TEST_ASSERT_FLOAT_WITHIN(10.0f, 6000.0f, table[0x070004].distance);
+}
+
+static size_t groundTrackingFrame(uint16_t device,
+                                  Fanet::GroundTrackingType type,
+                                  etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes) {
+    Fanet::Packet packet;
+    packet.header.type = Fanet::PacketType::GroundTracking;
+    packet.header.shouldForward = false;
+    packet.header.hasExtensionHeader = false;
+    packet.header.srcMac = Fanet::Mac{0x07, device};
+    Fanet::GroundTracking ground;
+    ground.location.latitude = 47.5f;
+    ground.location.longitude = 8.0f;
+    ground.type = type;
+    packet.payload = ground;
+    return packet.encode(bytes);
+}
+
+void test_interest_filters(void) {
+    // Positions are read straight from the payload bytes, as parsing would find them
+    auto parsed = Fanet::Packet::parse(locationPacket, 16);
+    auto& tracking = etl::get<Fanet::Tracking>(parsed.payload);
+    Fanet::InterestPosition position;
+    TEST_ASSERT_TRUE(Fanet::InterestPosition::peek(Fanet::PacketType::Tracking,
+                                                   locationPacket.data() + 4, 12, position));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, tracking.location.latitude, position.location->latitude);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, tracking.location.longitude, position.location->longitude);
+    TEST_ASSERT_EQUAL(tracking.altitude, position.altitude.value());
+    TEST_ASSERT_FALSE(Fanet::InterestPosition::peek(Fanet::PacketType::Tracking,
+                                                    locationPacket.data() + 4, 7, position));
+
+    // Only tracking within 5 km and below 2000 m
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    Fanet::Location origin;
+    origin.latitude = 47.0f;
+    origin.longitude = 8.0f;
+    auto nearby = Fanet::InterestFilter::within(origin, 5000.0f);
+    nearby.maxAltitude = 2000;
+    nearby.types = Fanet::InterestFilter::bit(Fanet::PacketType::Tracking);
+    TEST_ASSERT_TRUE(manager.addInterest(nearby));
+    sendPosition(manager, 2, 1000.0f, 0.0f, 1000, false);
+    sendPosition(manager, 3, 20000.0f, 0.0f, 1000, false);
+    TEST_ASSERT_EQUAL(1, manager.getStats().processed);
+    TEST_ASSERT_EQUAL(1, manager.getStats().rxFiltered);
+    TEST_ASSERT_EQUAL(1, manager.getNeighborTable().size());
+
+    // Traffic to forward still updates the table, as forwarding needs, but isn't returned
+    sendPosition(manager, 4, 20000.0f, 0.0f, 2000, true);
+    TEST_ASSERT_EQUAL(1, manager.getStats().processed);
+    TEST_ASSERT_EQUAL(2, manager.getStats().rxFiltered);
+    TEST_ASSERT_EQUAL(2, manager.getNeighborTable().size());
+
+    // Other types are turned away on their header, even from traffic nearby
+    Fanet::Packet packet;
+    packet.header.type = Fanet::PacketType::Name;
+    packet.header.srcMac = Fanet::Mac{0x07, 2};
+    Fanet::Name name;
+    name.name = "Nearby";
+    packet.payload = name;
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = packet.encode(bytes);
+    TEST_ASSERT_FALSE(manager.handleRx(bytes, size, 3000, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_EQUAL(3, manager.getStats().rxFiltered);
+
+    // Anything from a friend, wherever they are
+    Fanet::InterestFilter friends;
+    friends.sources.push_back(Fanet::Mac{0x07, 3}.toInt32());
+    TEST_ASSERT_TRUE(manager.addInterest(friends));
+    sendPosition(manager, 3, 20000.0f, 0.0f, 4000, false);
+    TEST_ASSERT_EQUAL(2, manager.getStats().processed);
+
+    // And distress calls from anyone, but no one else on the ground
+    Fanet::InterestFilter distress;
+    distress.types = Fanet::InterestFilter::bit(Fanet::PacketType::GroundTracking);
+    distress.groundTypes = Fanet::InterestFilter::bit(Fanet::GroundTrackingType::DistressCall);
+    TEST_ASSERT_TRUE(manager.addInterest(distress));
+    size = groundTrackingFrame(5, Fanet::GroundTrackingType::DistressCall, bytes);
+    TEST_ASSERT_TRUE(manager.handleRx(bytes, size, 5000, -100.0f, 2.0f).has_value());
+    size = groundTrackingFrame(6, Fanet::GroundTrackingType::Walking, bytes);
+    TEST_ASSERT_FALSE(manager.handleRx(bytes, size, 5000, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_EQUAL(4, manager.getStats().rxFiltered);
+
+    // Without filters, everything is handled again
+    manager.clearInterests();
+    TEST_ASSERT_TRUE(manager.handleRx(bytes, size, 6000, -100.0f, 2.0f).has_value());
+}
+
+void test_eviction(void) {
+    // Lowest score first, through updates and removals
+    Fanet::EvictionQueue<8> queue;
+    uint16_t handles[8];
+    for (uint32_t i = 0; i < 8; i++) {
+        handles[i] = queue.update(Fanet::kNoEviction, i, (float)((i * 5) % 8));
+    }
+    TEST_ASSERT_EQUAL(Fanet::kNoEviction, queue.update(Fanet::kNoEviction, 8, 0.0f));
+    uint32_t key;
+    TEST_ASSERT_TRUE(queue.lowest(key));
+    TEST_ASSERT_EQUAL(0, key);
+    queue.update(handles[0], 0, 100.0f);
+    queue.lowest(key);
+    TEST_ASSERT_EQUAL(5, key);  // Scored 1
+    queue.release(handles[5]);
+    queue.lowest(key);
+    TEST_ASSERT_EQUAL(2, key);  // Scored 2
+    queue.set(handles[7], 7, -1.0f);
+    queue.reorder();
+    queue.lowest(key);
+    TEST_ASSERT_EQUAL(7, key);
+    TEST_ASSERT_EQUAL(7, queue.size());
+
+    // A full table: a glider 500 m away and a distress call 55 km away, both gone quiet, and
+    // ground stations 30 km away beaconing
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    manager.setPos(47.0f, 8.0f, 1000, 0);
+    sendPosition(manager, 2, 500.0f, 0.0f, 1000, false);
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = groundTrackingFrame(3, Fanet::GroundTrackingType::DistressCall, bytes);
+    manager.handleRx(bytes, size, 2000, -110.0f, 2.0f);
+    for (uint16_t i = 0; i < FANET_MAX_NEIGHBORS - 2; i++) {
+        sendPosition(manager, 100 + i, 30000.0f, 0.0f, 60000 + i * 10, false);
+    }
+    TEST_ASSERT_EQUAL(FANET_MAX_NEIGHBORS, manager.getNeighborTable().size());
+
+    // Someone new turns up, and a station makes way rather than the glider
+    sendPosition(manager, 4, 1000.0f, 0.0f, 62000, false);
+    auto table = manager.getNeighborTable();
+    TEST_ASSERT_EQUAL(FANET_MAX_NEIGHBORS, table.size());
+    TEST_ASSERT_TRUE(table.find(Fanet::Mac{0x07, 2}.toInt32()) != table.end());
+    TEST_ASSERT_TRUE(table.find(Fanet::Mac{0x07, 100}.toInt32()) == table.end());
+    TEST_ASSERT_EQUAL(1, manager.getStats().neighborsEvicted);
+
+    // However many more arrive, the distress call is kept
+    for (uint16_t i = 0; i < FANET_MAX_NEIGHBORS; i++) {
+        sendPosition(manager, 300 + i, 0.0f, 0.0f, 63000, false);
+    }
+    table = manager.getNeighborTable();
+    TEST_ASSERT_TRUE(table.find(Fanet::Mac{0x07, 2}.toInt32()) == table.end());
+    TEST_ASSERT_TRUE(table.find(Fanet::Mac{0x07, 3}.toInt32()) != table.end());
+    TEST_ASSERT_EQUAL(FANET_MAX_NEIGHBORS + 1, manager.getStats().neighborsEvicted);
+
+    // Where by recency alone, it's the first to go
+    Fanet::RecencyEvictionPolicy recency;
+    manager.setEvictionPolicy(recency);
+    sendPosition(manager, 5, 0.0f, 0.0f, 64000, false);
+    table = manager.getNeighborTable();
+    TEST_ASSERT_TRUE(table.find(Fanet::Mac{0x07, 3}.toInt32()) == table.end());
+    TEST_ASSERT_TRUE(table.find(Fanet::Mac{0x07, 5}.toInt32()) != table.end());
+
+    // Restored just after boot, the neighbors were last seen before millis() began, (so their
+    // lastSeen wraps), but still make way for those heard since, the most recent going last
+    uint8_t state[Fanet::FanetManager::kMaxStateSize];
+    auto stateSize = manager.saveState(state, sizeof(state), 65000);
+    Fanet::FanetManager restarted(us, 2);
+    TEST_ASSERT_TRUE(restarted.restoreState(state, stateSize, 1000, 5000));
+    TEST_ASSERT_EQUAL(FANET_MAX_NEIGHBORS, restarted.getNeighborTable().size());
+    for (uint16_t i = 0; i < FANET_MAX_NEIGHBORS - 1; i++) {
+        sendPosition(restarted, 500 + i, 0.0f, 0.0f, 2000 + i * 10, false);
+    }
+    table = restarted.getNeighborTable();
+    TEST_ASSERT_EQUAL(FANET_MAX_NEIGHBORS - 1, restarted.getStats().neighborsEvicted);
+    TEST_ASSERT_TRUE(table.find(Fanet::Mac{0x07, 5}.toInt32()) != table.end());
+    for (uint16_t i = 0; i < FANET_MAX_NEIGHBORS - 1; i++) {
+        auto mac = Fanet::Mac{0x07, (uint16_t)(500 + i)}.toInt32();
+        TEST_ASSERT_TRUE(table.find(mac) != table.end());
+    }
+}
+
+void test_load_shedding(void) {
+    // Each frame takes 150 us to handle, against a budget of 1000 us every 100 ms
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    unsigned long micros = 0;
+    auto clock = [&micros]() { return micros += 150; };
+    etl::delegate<unsigned long()> loadClock(clock);
+    manager.setLoadClock(loadClock);
+    manager.setLoadBudget(1000, 100);
+    Fanet::LegacyForwardPolicy legacy;
+    manager.setForwardPolicy(legacy);
+    auto busy = [&manager](unsigned long ms) {
+        for (uint16_t i = 0; i < 10; i++) sendPosition(manager, 10 + i, 1000.0f, 0.0f, ms, false);
+    };
+    auto name = [](bool forward,
+                   const char* text,
+                   etl::array<uint8_t, FANET_MAX_PACKET_SIZE>& bytes) {
+        Fanet::Packet packet;
+        packet.header.type = Fanet::PacketType::Name;
+        packet.header.shouldForward = forward;
+        packet.header.hasExtensionHeader = false;
+        packet.header.srcMac = Fanet::Mac{0x07, 10};
+        Fanet::Name payload;
+        payload.name = text;
+        packet.payload = payload;
+        return packet.encode(bytes);
+    };
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+
+    // Each window over budget sheds another step, first forwards of low priority types
+    busy(1000);
+    TEST_ASSERT_TRUE(manager.getLoadLevel() == Fanet::LoadLevel::Normal);
+    busy(1100);
+    TEST_ASSERT_TRUE(manager.getLoadLevel() == Fanet::LoadLevel::ShedForwards);
+    auto size = name(true, "Busy", bytes);
+    TEST_ASSERT_TRUE(manager.handleRx(bytes, size, 1150, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_EQUAL(1, manager.getStats().shedForwards);
+    TEST_ASSERT_EQUAL(0, manager.getStats().forwarded);
+
+    // Then names and messages are kept to handle later
+    busy(1200);
+    TEST_ASSERT_EQUAL((uint32_t)Fanet::LoadLevel::DeferParsing, manager.getStats().loadLevel);
+    size = name(false, "Later", bytes);
+    TEST_ASSERT_FALSE(manager.handleRx(bytes, size, 1250, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_EQUAL(1, manager.getStats().shedDeferred);
+    TEST_ASSERT_EQUAL(0, manager.deferred());
+
+    // Unless it's a message to forward, which can't wait
+    Fanet::Packet message;
+    message.header.type = Fanet::PacketType::Message;
+    message.header.shouldForward = true;
+    message.header.hasExtensionHeader = false;
+    message.header.srcMac = Fanet::Mac{0x07, 40};
+    Fanet::Message text;
+    strcpy(text.message, "Landing");
+    message.payload = text;
+    size = message.encode(bytes);
+    TEST_ASSERT_TRUE(manager.handleRx(bytes, size, 1260, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_EQUAL(1, manager.getStats().shedDeferred);
+    TEST_ASSERT_EQUAL(1, manager.getStats().forwarded);
+
+    // Then positions are sampled, (the level rising after the first), but not calls for help
+    busy(1300);
+    TEST_ASSERT_TRUE(manager.getLoadLevel() == Fanet::LoadLevel::SampleTracking);
+    TEST_ASSERT_EQUAL(9, manager.getStats().shedTracking);
+    size = groundTrackingFrame(30, Fanet::GroundTrackingType::DistressCall, bytes);
+    TEST_ASSERT_TRUE(manager.handleRx(bytes, size, 1350, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_TRUE(manager.handleRx(bytes, size, 1360, -100.0f, 2.0f).has_value());
+    TEST_ASSERT_EQUAL(9, manager.getStats().shedTracking);
+
+    // Once it's quiet, shedding eases and what was deferred is handled
+    auto transmit = [](const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&) {
+        return true;
+    };
+    etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&)> tx(
+        transmit);
+    manager.service(2000, tx);
+    TEST_ASSERT_TRUE(manager.getLoadLevel() == Fanet::LoadLevel::DeferParsing);
+    TEST_ASSERT_EQUAL(0, manager.deferred());
+    manager.service(5000, tx);
+    TEST_ASSERT_TRUE(manager.getLoadLevel() == Fanet::LoadLevel::Normal);
+    TEST_ASSERT_EQUAL(1, manager.deferred());
+    Fanet::Packet packet;
+    TEST_ASSERT_TRUE(manager.handleDeferred(5000, packet));
+    TEST_ASSERT_TRUE(etl::get<Fanet::Name>(packet.payload).name == "Later");
+    TEST_ASSERT_EQUAL(0, manager.deferred());
+    TEST_ASSERT_FALSE(manager.handleDeferred(5000, packet));
+}
+
+void test_routes(void) {
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    Fanet::LegacyForwardPolicy legacy;
+    manager.setForwardPolicy(legacy);
+
+    // Heard asking for a forward, then a relay's copy, which says nothing about how we hear it
+    sendPosition(manager, 2, 0.0f, 0.0f, 1000, true);
+    sendPosition(manager, 2, 0.0f, 0.0f, 1300, false, etl::nullopt, -80.0f);
+    auto route = manager.getRoute(Fanet::Mac{0x07, 2}).value();
+    TEST_ASSERT_TRUE(route.type(1300) == Fanet::RouteType::Direct);
+    TEST_ASSERT_TRUE(route.relayed);
+    TEST_ASSERT_EQUAL(1, manager.getStats().rxRelayed);
+    TEST_ASSERT_EQUAL(1, manager.getLinkQuality(Fanet::Mac{0x07, 2}).value().samples);
+    auto table = manager.getNeighborTable();
+    TEST_ASSERT_TRUE(table.find(0x070002)->second.rssi == -110.0f);
+
+    // Out of range, it's only heard through relays, so unicasts to it aren't worth forwarding
+    sendPosition(manager, 2, 0.0f, 0.0f, 70000, false);
+    TEST_ASSERT_TRUE(manager.getRoute(Fanet::Mac{0x07, 2}).value().type(70000) ==
+                     Fanet::RouteType::Relayed);
+    sendPosition(manager, 3, 0.0f, 0.0f, 70000, true, Fanet::Mac{0x07, 2});
+    TEST_ASSERT_EQUAL(1, manager.getStats().fwdNeighborDrp);
+
+    // Nor are unicasts between neighbors heard sending straight to each other
+    sendPosition(manager, 4, 0.0f, 0.0f, 70000, true);
+    sendPosition(manager, 5, 0.0f, 0.0f, 70000, true);
+    Fanet::Packet ack;
+    ack.header.type = Fanet::PacketType::Ack;
+    ack.header.shouldForward = false;
+    ack.header.hasExtensionHeader = true;
+    ack.header.srcMac = Fanet::Mac{0x07, 5};
+    Fanet::ExtendedHeader ext;
+    ext.ackType = Fanet::ExtendedHeaderAckType::None;
+    ext.includesSignature = false;
+    ext.destinationMac = Fanet::Mac{0x07, 4};
+    ack.extHeader = ext;
+    ack.payload = Fanet::Ack();
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = ack.encode(bytes);
+    manager.handleRx(bytes, size, 70100, -100.0f, 2.0f);
+    sendPosition(manager, 4, 0.0f, 0.0f, 70200, true, Fanet::Mac{0x07, 5});
+    TEST_ASSERT_EQUAL(1, manager.getStats().fwdOneHopDrp);
+    auto forwarded = manager.getStats().forwarded;
+    sendPosition(manager, 4, 0.0f, 0.0f, 70300, true, Fanet::Mac{0x07, 3});
+    TEST_ASSERT_EQUAL(forwarded + 1, manager.getStats().forwarded);
+
+    // Acks are asked for directly from neighbors we hear directly, and forwarded from others
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> sent;
+    size_t sentSize = 0;
+    auto transmit = [&sent, &sentSize](const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                                       const size_t& size) {
+        sent = *bytes;
+        sentSize = size;
+        return true;
+    };
+    etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&)> tx(
+        transmit);
+    Fanet::Message message;
+    strcpy(message.message, "Landed");
+    TEST_ASSERT_TRUE(manager.sendPacket(message, 80000, false, Fanet::Mac{0x07, 3},
+                                        Fanet::ExtendedHeaderAckType::Requested, true));
+    manager.doTx(80000, tx);
+    auto packet = Fanet::Packet::parse(sent, sentSize);
+    TEST_ASSERT_FALSE(packet.header.shouldForward);
+    TEST_ASSERT_TRUE(packet.extHeader.value().ackType == Fanet::ExtendedHeaderAckType::Requested);
+    TEST_ASSERT_TRUE(manager.sendPacket(message, 90000, false, Fanet::Mac{0x07, 2},
+                                        Fanet::ExtendedHeaderAckType::Requested, true));
+    manager.doTx(90000, tx);
+    packet = Fanet::Packet::parse(sent, sentSize);
+    TEST_ASSERT_TRUE(packet.header.shouldForward);
+    TEST_ASSERT_TRUE(packet.extHeader.value().ackType == Fanet::ExtendedHeaderAckType::Forwarded);
+
+    // Unless asked to choose, what the caller asked for is sent as is
+    TEST_ASSERT_TRUE(manager.sendPacket(message, 91000, false, Fanet::Mac{0x07, 2},
+                                        Fanet::ExtendedHeaderAckType::Requested));
+    manager.doTx(91000, tx);
+    packet = Fanet::Packet::parse(sent, sentSize);
+    TEST_ASSERT_FALSE(packet.header.shouldForward);
+    TEST_ASSERT_TRUE(packet.extHeader.value().ackType == Fanet::ExtendedHeaderAckType::Requested);
+}
+
+void test_link_quality(void) {
+    // One noisy frame barely moves the averages
+    Fanet::LinkQuality link;
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.0f, link.score());
+    for (int i = 0; i < 10; i++) link.heard(-100.0f, 5.0f);
+    link.heard(-120.0f, -15.0f);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -105.0f, link.rssi);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, link.snr);
+
+    // Beacons every 2s learn the interval, then every other one is missed
+    for (int i = 0; i < 10; i++) link.beacon(2000);
+    TEST_ASSERT_EQUAL(2000, link.beaconInterval);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, link.loss);
+    float clean = link.score();
+    for (int i = 0; i < 20; i++) link.beacon(4000);
+    TEST_ASSERT_EQUAL(2000, link.beaconInterval);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 0.43f, link.loss);
+    TEST_ASSERT_TRUE(link.score() < clean);
+
+    // A long silence is only counted as a few losses
+    link = Fanet::LinkQuality();
+    link.heard(-100.0f, 5.0f);
+    link.beacon(1000);
+    link.beacon(60000);
+    TEST_ASSERT_TRUE(link.loss < 0.7f);
+
+    // Unicasts are only forwarded to destinations we hear well
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    Fanet::LegacyForwardPolicy legacy;
+    manager.setForwardPolicy(legacy);
+    auto strong = locationPacket;
+    strong[2] = 0x01;
+    manager.handleRx(strong, 16, 1000, -100.0f, 8.0f);
+    auto weak = locationPacket;
+    weak[2] = 0x02;
+    manager.handleRx(weak, 16, 1000, -125.0f, -9.0f);
+    TEST_ASSERT_TRUE(manager.getLinkQuality(Fanet::Mac{0x07, 0x3D01}).value().score() > 0.8f);
+    TEST_ASSERT_TRUE(manager.getLinkQuality(Fanet::Mac{0x07, 0x3D02}).value().score() < 0.1f);
+    TEST_ASSERT_FALSE(manager.getLinkQuality(Fanet::Mac{0x07, 0x3D03}).has_value());
+
+    Fanet::Packet unicast;
+    unicast.header.type = Fanet::PacketType::Ack;
+    unicast.header.shouldForward = true;
+    unicast.header.srcMac = Fanet::Mac{0x07, 0x0005};
+    unicast.header.hasExtensionHeader = true;
+    Fanet::ExtendedHeader ext;
+    ext.ackType = Fanet::ExtendedHeaderAckType::None;
+    ext.includesSignature = false;
+    ext.destinationMac = Fanet::Mac{0x07, 0x3D01};
+    unicast.extHeader = ext;
+    unicast.payload = Fanet::Ack();
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = unicast.encode(bytes);
+    auto forwarded = manager.getStats().forwarded;
+    manager.handleRx(bytes, size, 2000, -110.0f, 2.0f);
+    TEST_ASSERT_EQUAL(forwarded + 1, manager.getStats().forwarded);
+    ext.destinationMac = Fanet::Mac{0x07, 0x3D02};
+    unicast.extHeader = ext;
+    size = unicast.encode(bytes);
+    manager.handleRx(bytes, size, 3000, -110.0f, 2.0f);
+    TEST_ASSERT_EQUAL(forwarded + 1, manager.getStats().forwarded);
+    TEST_ASSERT_EQUAL(1, manager.getStats().fwdNeighborDrp);
+}
+
+void test_frame_fusion(void) {
+    // Three receivers hear a frame, the best signal is kept
+    Fanet::FrameFusion<4> fusion;
+    Fanet::FusedFrame frame;
+    TEST_ASSERT_TRUE(fusion.add(0, locationPacket.data(), 16, 1000, -110.0f, 3.0f));
+    TEST_ASSERT_FALSE(fusion.add(2, locationPacket.data(), 16, 1020, -95.0f, 1.0f));
+    auto repeated = locationPacket;
+    repeated[0] &= ~0x40;  // Repeats clear the forward bit
+    TEST_ASSERT_FALSE(fusion.add(5, repeated.data(), 16, 1050, -120.0f, 6.0f));
+    auto other = locationPacket;
+    other[2] = 0x01;
+    TEST_ASSERT_TRUE(fusion.add(1, other.data(), 16, 1100, -100.0f, 2.0f));
+
+    // Popped in order once their windows close
+    TEST_ASSERT_FALSE(fusion.pop(1000 + FANET_FUSION_WINDOW_MS - 1, frame));
+    unsigned long next;
+    TEST_ASSERT_TRUE(fusion.nextPopTime(next));
+    TEST_ASSERT_EQUAL(1000 + FANET_FUSION_WINDOW_MS, next);
+    TEST_ASSERT_TRUE(fusion.pop(1000 + FANET_FUSION_WINDOW_MS, frame));
+    TEST_ASSERT_EQUAL(16, frame.size);
+    TEST_ASSERT_EQUAL_MEMORY(locationPacket.data(), frame.bytes.data(), 16);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, -95.0f, frame.rssi);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 6.0f, frame.snr);
+    TEST_ASSERT_EQUAL(2, frame.bestReceiver);
+    TEST_ASSERT_EQUAL(3, frame.copies);
+    TEST_ASSERT_EQUAL(0x25, frame.receivers);
+    TEST_ASSERT_FALSE(fusion.pop(1000 + FANET_FUSION_WINDOW_MS, frame));
+    TEST_ASSERT_TRUE(fusion.pop(1100 + FANET_FUSION_WINDOW_MS, frame));
+    TEST_ASSERT_EQUAL(0x02, frame.receivers);
+
+    // Copies after a frame is popped are dropped, until it's forgotten
+    TEST_ASSERT_FALSE(fusion.add(3, locationPacket.data(), 16, 1500, -90.0f, 9.0f));
+    TEST_ASSERT_EQUAL(1, fusion.getStats().late);
+    TEST_ASSERT_TRUE(fusion.add(3, locationPacket.data(), 16, 1000 + FANET_FUSION_HOLD_MS, -90.0f,
+                                9.0f));
+
+    // Full of frames still in their window, the oldest are popped early rather than dropped
+    for (uint8_t i = 2; i < 8; i++) {
+        other[2] = i;
+        fusion.add(0, other.data(), 16, 4000, -100.0f, 2.0f);
+        while (fusion.pop(4000, frame)) {
+        }
+    }
+    TEST_ASSERT_EQUAL(0, fusion.getStats().overflows);
+    TEST_ASSERT_EQUAL(3, fusion.getStats().duplicates + fusion.getStats().late);
+    TEST_ASSERT_EQUAL(12, fusion.getStats().frames);
+}
+
+// Traffic within range of a feed, reported to the north of it
+Fanet::Neighbor trafficNeighbor(uint16_t device, float north, unsigned long ms) {
+    Fanet::Neighbor neighbor;
+    neighbor.address.manufacturer = 0x0B;
+    neighbor.address.device = device;
+    Fanet::Location location;
+    location.latitude = north / Fanet::kMetersPerDegree;
+    location.longitude = 0.0f;
+    neighbor.location = location;
+    neighbor.altitude = 1000;
+    neighbor.locationMs = ms;
+    return neighbor;
+}
+
+// Alarm level and relative north of each $PFLAA sentence in a feed
+size_t trafficReports(const uint8_t* buffer, size_t length, int* alarms, int* norths) {
+    size_t count = 0;
+    const char* text = (const char*)buffer;
+    for (size_t i = 0; i + 7 <= length; i++) {
+        if (strncmp(text + i, "$PFLAA,", 7) != 0) continue;
+        sscanf(text + i + 7, "%d,%d", &alarms[count], &norths[count]);
+        count++;
+    }
+    return count;
+}
+
+void test_traffic_feed(void) {
+    // Sentences and messages, against hand worked checksums and the GDL90 ICD's CRC example
+    Fanet::MotionState own;
+    own.location.latitude = 0.0f;
+    own.location.longitude = 0.0f;
+    own.altitude = 1000.0f;
+    Fanet::TrafficTarget target;
+    target.address = 0x0B1234;
+    target.state.location.latitude = 0.01f;
+    target.state.location.longitude = 0.0f;
+    target.state.altitude = 1500.0f;
+    target.state.heading = 90;
+    target.state.speed = 36.0f;
+    target.state.climbRate = 1.5f;
+    target.hasAltitude = true;
+    target.aircraftType = Fanet::AircraftType::Paraglider;
+    char line[Fanet::TrafficEncoder::kMaxLength + 1] = {};
+    Fanet::TrafficEncoder::pflaa(target, own, line);
+    TEST_ASSERT_EQUAL_STRING("$PFLAA,0,1113,0,500,2,0B1234,90,,10,1.5,7*10\r\n", line);
+    const uint8_t heartbeat[] = {0x00, 0x81, 0x41, 0xDB, 0xD0, 0x08, 0x02};
+    TEST_ASSERT_EQUAL(0x8BB3, Fanet::TrafficEncoder::gdl90Crc(heartbeat, sizeof(heartbeat)));
+    uint8_t frame[Fanet::TrafficEncoder::kMaxLength];
+    size_t length = Fanet::TrafficEncoder::gdl90Report(target, false, frame);
+    TEST_ASSERT_EQUAL(0x7E, frame[0]);
+    TEST_ASSERT_EQUAL(0x7E, frame[length - 1]);
+    TEST_ASSERT_EQUAL(20, frame[1]);
+
+    // Following the manager's neighbor table
+    Fanet::Mac us;
+    us.manufacturer = 0xFB;
+    us.device = 1;
+    Fanet::FanetManager manager(us, 1);
+    Fanet::TrafficFeed<> feed;
+    manager.setNeighborListener(
+        Fanet::FanetManager::NeighborListener::create<Fanet::TrafficFeed<>,
+                                                      &Fanet::TrafficFeed<>::neighborChanged>(feed));
+    manager.handleRx(locationPacket, 16, 1000, -110.0f, 4.0f);
+    TEST_ASSERT_EQUAL(1, feed.size());
+    auto neighbor = manager.getNeighborTable().begin()->second;
+    own.location = neighbor.location.value().offsetBy(1000.0f, 0.0f);
+    feed.setOwnship(own);
+    uint8_t buffer[4096];
+    length = feed.poll(1000, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL(0, strncmp((const char*)buffer, "$PFLAU,1,1,2,1,", 15));
+    TEST_ASSERT_NOT_NULL(strstr((const char*)buffer, ",2,073D35,"));
+    TEST_ASSERT_EQUAL(0, feed.poll(1200, buffer, sizeof(buffer)));
+    manager.expireNeighbors(1000 + FANET_NEIGHBOR_MAX_TIMEOUT + 1);
+    TEST_ASSERT_EQUAL(0, feed.size());
+
+    // 120 aircraft at 4800 baud, the closest go first and the rest wait for bandwidth
+    Fanet::TrafficFeed<120> slow(Fanet::TrafficFormat::Nmea, 4800);
+    own.location.latitude = 0.0f;
+    own.location.longitude = 0.0f;
+    slow.setOwnship(own);
+    for (uint16_t i = 0; i < 120; i++) {
+        uint16_t device = (i * 37) % 120;
+        slow.neighborChanged(trafficNeighbor(device, 100.0f * (device + 1), 0), false);
+    }
+    int alarms[120], norths[120];
+    length = slow.poll(0, buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(length <= 480);
+    size_t count = trafficReports(buffer, length, alarms, norths);
+    TEST_ASSERT_TRUE(count >= 5);
+    for (size_t i = 0; i < count; i++) TEST_ASSERT_EQUAL(100 * (i + 1), norths[i]);
+    TEST_ASSERT_EQUAL(120 - count, slow.getStats().deferred);
+
+    // An alarm jumps the queue, however far away
+    Fanet::Mac far;
+    far.manufacturer = 0x0B;
+    far.device = 119;
+    slow.setAlarm(far, 2);
+    size_t first = length;
+    length = slow.poll(200, buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(first + length <= 480 + 96);
+    TEST_ASSERT_TRUE(trafficReports(buffer, length, alarms, norths) >= 1);
+    TEST_ASSERT_EQUAL(2, alarms[0]);
+    TEST_ASSERT_EQUAL(12000, norths[0]);
+
+    // Polled at 5 Hz over 115200 baud, 120 aircraft sending positions every second are kept up
+    // with, each reported as soon as it moves
+    Fanet::TrafficFeed<120> fast;
+    fast.setOwnship(own);
+    for (unsigned long ms = 0; ms <= 10000; ms += 200) {
+        for (uint16_t i = ms / 200 % 5; i < 120; i += 5) {
+            fast.neighborChanged(trafficNeighbor(i, 100.0f * (i + 1), ms), false);
+        }
+        fast.poll(ms, buffer, sizeof(buffer));
+    }
+    TEST_ASSERT_EQUAL(0, fast.getStats().deferred);
+    TEST_ASSERT_EQUAL(0, fast.getStats().refreshes);
+    TEST_ASSERT_EQUAL(fast.getStats().updates, fast.getStats().reports);
+}
+
+#if FANET_TOOL_TESTS
+// Tests a simulator run is determined by its scenario
+void test_sim_determinism(void) {
+    Fanet::Sim::Scenario scenario;
+    scenario.seed = 7;
+    scenario.nodes = 20;
+    scenario.durationMs = 1000UL * 60;
+    scenario.areaMeters = 5000.0f;
+    auto first = Fanet::Sim::Simulator(scenario).run();
+    auto second = Fanet::Sim::Simulator(scenario).run();
+    TEST_ASSERT_TRUE(first.transmissions > 0);
+    TEST_ASSERT_TRUE(first.events == second.events);
+    TEST_ASSERT_TRUE(first.transmissions == second.transmissions);
+    TEST_ASSERT_TRUE(first.originated == second.originated);
+    TEST_ASSERT_TRUE(first.receptions == second.receptions);
+    TEST_ASSERT_TRUE(first.collisions == second.collisions);
+    TEST_ASSERT_TRUE(first.halfDuplexLosses == second.halfDuplexLosses);
+    TEST_ASSERT_TRUE(first.intended == second.intended);
+    TEST_ASSERT_TRUE(first.delivered == second.delivered);
+    TEST_ASSERT_TRUE(first.extended == second.extended);
+    TEST_ASSERT_TRUE(first.airtimeMs == second.airtimeMs);
+    TEST_ASSERT_TRUE(first.latencyMeanMs == second.latencyMeanMs);
+    TEST_ASSERT_TRUE(first.latencyP99Ms == second.latencyP99Ms);
+    TEST_ASSERT_EQUAL_MEMORY(&first.totals, &second.totals, sizeof(Fanet::Stats));
+
+    // While another seed flies another run
+    scenario.seed = 8;
+    auto other = Fanet::Sim::Simulator(scenario).run();
+    TEST_ASSERT_TRUE(other.events != first.events || other.receptions != first.receptions);
+}
+
+// Tests a p-persistent node's capture replays exactly, attempts it put off and all
+void test_replay(void) {
+    auto path = "/tmp/fanet-test-" + std::to_string(getpid()) + ".bin";
+    Fanet::Sim::Scenario scenario;
+    scenario.seed = 3;
+    scenario.nodes = 100;
+    scenario.durationMs = 1000UL * 120;
+    scenario.policy = Fanet::Sim::PolicyKind::Legacy;
+    scenario.csma = Fanet::CsmaMode::Persistent;
+    scenario.capturePath = path.c_str();
+    Fanet::Sim::Simulator(scenario).run();
+
+    std::vector<uint8_t> capture;
+    FILE* file = fopen(path.c_str(), "rb");
+    TEST_ASSERT_TRUE(file != nullptr);
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        capture.insert(capture.end(), buffer, buffer + read);
+    }
+    fclose(file);
+    remove(path.c_str());
+
+    Fanet::Replay::Options options;
+    options.legacy = true;
+    options.csma = Fanet::CsmaMode::Persistent;
+    Fanet::Replay::Replayer replayer(options);
+    Fanet::CaptureReader reader(capture.data(), capture.size());
+    Fanet::CaptureRecord record;
+    uint32_t deferred = 0;
+    while (reader.next(record)) {
+        if (record.type == Fanet::CaptureRecordType::Tx &&
+            record.a == Fanet::CaptureWriter::kTxDeferred)
+            deferred++;
+        TEST_ASSERT_TRUE(replayer.replay(record));
+    }
+    auto& totals = replayer.getTotals();
+    TEST_ASSERT_TRUE(deferred > 0);
+    TEST_ASSERT_TRUE(totals.txMatched > deferred);
+    TEST_ASSERT_EQUAL(0, totals.txMismatched);
+    TEST_ASSERT_EQUAL(0, totals.txMissing);
+    TEST_ASSERT_EQUAL(1, totals.statsCompared);
+    TEST_ASSERT_FALSE(replayer.differed());
+
+    // Stats from versions with fewer or more counters compare those both have
+    Fanet::Replay::Replayer fresh(options);
+    uint32_t counters[Fanet::kStatFieldCount + 2] = {};
+    uint8_t body[sizeof(counters)];
+    Fanet::CaptureRecord stats = {Fanet::CaptureRecordType::Stats, 0, 0, 0, body, 0};
+    Fanet::CaptureStats::encode(counters, Fanet::kStatFieldCount + 2, body);
+    stats.length = sizeof(body);
+    TEST_ASSERT_TRUE(fresh.replay(stats));
+    counters[0] = 1;
+    Fanet::CaptureStats::encode(counters, 2, body);
+    stats.length = 4;
+    TEST_ASSERT_TRUE(fresh.replay(stats));
+    TEST_ASSERT_EQUAL(2, fresh.getTotals().statsCompared);
+    TEST_ASSERT_EQUAL(1, fresh.getTotals().statsDiffering);
+}
+
+// Tests the bulk decoder turns received frames into rows, and finds records after corrupt bytes
+void test_decode(void) {
+    etl::vector<uint8_t, 256> capture;
+    auto append = [&capture](const uint8_t* data, const size_t& length) {
+        for (size_t i = 0; i < length; i++) capture.push_back(data[i]);
+    };
+    Fanet::CaptureWriter writer((Fanet::CaptureWriter::Sink(append)));
+
+    Fanet::Packet ground;
+    ground.header.type = Fanet::PacketType::GroundTracking;
+    ground.header.shouldForward = false;
+    ground.header.srcMac = Fanet::Mac{0x07, 0x0006};
+    ground.header.hasExtensionHeader = false;
+    Fanet::GroundTracking tracking;
+    tracking.location.latitude = 46.5f;
+    tracking.location.longitude = -8.25f;
+    ground.payload = tracking;
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> groundPacket;
+    auto groundSize = ground.encode(groundPacket);
+
+    writer.rx(1000, -87.25f, 6.5f, locationPacket.data(), 16);
+    writer.tx(2000, true, locationPacket.data(), 16);
+    capture.push_back(0xFA);  // A partial record
+    capture.push_back(0x02);
+    auto second = capture.size();
+    writer.rx(3000, -95.0f, 2.0f, groundPacket.data(), groundSize);
+
+    Fanet::Decode::Archive archive;
+    archive.data = capture.data();
+    archive.size = capture.size();
+    TEST_ASSERT_EQUAL(0, Fanet::Decode::boundary(archive, 0));
+    TEST_ASSERT_EQUAL(second, Fanet::Decode::boundary(archive, second - 2));
+    TEST_ASSERT_EQUAL(capture.size(), Fanet::Decode::boundary(archive, second + 1));
+
+    Fanet::Decode::Columns columns;
+    Fanet::Decode::decode(archive, Fanet::Decode::Chunk{0, 0, capture.size()}, columns);
+    TEST_ASSERT_EQUAL(3, columns.records);
+    TEST_ASSERT_EQUAL(2, columns.skipped);
+    TEST_ASSERT_EQUAL(2, columns.src.size());
+
+    // The tracking frame, as the packet parser reads it
+    auto packet = Fanet::Packet::parse(locationPacket, 16);
+    auto& location = etl::get<Fanet::Tracking>(packet.payload);
+    TEST_ASSERT_EQUAL(packet.header.srcMac.toInt32(), columns.src[0]);
+    TEST_ASSERT_EQUAL(1000, columns.time[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, location.location.latitude, columns.lat[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, location.location.longitude, columns.lon[0]);
+    TEST_ASSERT_EQUAL(location.altitude, columns.alt[0]);
+    TEST_ASSERT_EQUAL((uint8_t)Fanet::PacketType::Tracking, columns.type[0]);
+
+    // The ground tracking frame, which has no altitude
+    TEST_ASSERT_EQUAL(0x070006, columns.src[1]);
+    TEST_ASSERT_EQUAL(3000, columns.time[1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 46.5f, columns.lat[1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, -8.25f, columns.lon[1]);
+    TEST_ASSERT_EQUAL(INT32_MIN, columns.alt[1]);
+    TEST_ASSERT_EQUAL((uint8_t)Fanet::PacketType::GroundTracking, columns.type[1]);
+}
+
+// Reads a line from a gateway subscriber socket, giving up after a couple of seconds
+std::string readLine(const int& fd, std::string& pending) {
+    for (int tries = 0; tries < 200; tries++) {
+        auto newline = pending.find('\n');
+        if (newline != std::string::npos) {
+            auto line = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            return line;
+        }
+        struct pollfd ready = {fd, POLLIN, 0};
+        if (poll(&ready, 1, 10) <= 0) continue;
+        char buffer[512];
+        auto count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0) break;
+        pending.append(buffer, count);
+    }
+    return "";
+}
+
+// Tests the gateway parses module lines, and streams a frame it's sent to its subscribers
+void test_gateway(void) {
+    Fanet::Gateway::Frame frame;
+    TEST_ASSERT_TRUE(Fanet::Gateway::SerialFrameSource::parseLine("RX -98.5 4.25 410735", frame));
+    TEST_ASSERT_EQUAL(3, frame.size);
+    TEST_ASSERT_EQUAL_MEMORY(locationPacket.data(), frame.bytes.data(), 3);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, -98.5f, frame.rssi);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 4.25f, frame.snr);
+    TEST_ASSERT_FALSE(Fanet::Gateway::SerialFrameSource::parseLine("TX 410735", frame));
+    TEST_ASSERT_FALSE(Fanet::Gateway::SerialFrameSource::parseLine("RX -98.5 4.25 4107x", frame));
+    TEST_ASSERT_FALSE(Fanet::Gateway::SerialFrameSource::parseLine("RX -98.5", frame));
+
+    // A module that's stopped reading has frames given up on, rather than stalling us
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    TEST_ASSERT_TRUE(master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0);
+    {
+        Fanet::Gateway::SerialFrameSource serial;
+        TEST_ASSERT_TRUE(serial.open(ptsname(master), 115200));
+        int sent = 0;
+        while (sent < 100000 && serial.transmit(locationPacket.data(), 3)) sent++;
+        TEST_ASSERT_TRUE(sent > 0);
+        TEST_ASSERT_TRUE(sent < 100000);
+    }
+    close(master);
+
+    Fanet::Gateway::UdpFrameSource source;
+    TEST_ASSERT_TRUE(source.open(0));
+    Fanet::Gateway::Options options;
+    options.socketPath = "/tmp/fanet-test-" + std::to_string(getpid()) + ".sock";
+    options.batchMs = 10;
+    Fanet::Gateway::Daemon daemon(source, options);
+    TEST_ASSERT_TRUE(daemon.open());
+    std::thread loop([&daemon]() { daemon.run(); });
+
+    // A subscriber is sent the (empty) table when it connects
+    int subscriber = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un path = {};
+    path.sun_family = AF_UNIX;
+    strncpy(path.sun_path, options.socketPath.c_str(), sizeof(path.sun_path) - 1);
+    TEST_ASSERT_EQUAL(0, connect(subscriber, (struct sockaddr*)&path, sizeof(path)));
+    std::string pending;
+    TEST_ASSERT_EQUAL_STRING("{\"snapshot\":0}", readLine(subscriber, pending).c_str());
+
+    // Then the neighbor, once the radio hears it
+    int radio = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(source.port());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    uint8_t datagram[4 + FANET_MAX_PACKET_SIZE];
+    auto length = Fanet::Gateway::UdpFrameSource::encode(locationPacket.data(), 16, -98.5f,
+                                                         4.25f, datagram);
+    TEST_ASSERT_EQUAL(4 + 16, length);
+    sendto(radio, datagram, length, 0, (struct sockaddr*)&address, sizeof(address));
+
+    auto packet = Fanet::Packet::parse(locationPacket, 16);
+    auto& tracking = etl::get<Fanet::Tracking>(packet.payload);
+    char expected[128];
+    snprintf(expected, sizeof(expected),
+             "{\"addr\":\"07:3d35\",\"lat\":%.5f,\"lon\":%.5f,\"alt\":%u,",
+             tracking.location.latitude, tracking.location.longitude,
+             (unsigned)tracking.altitude);
+    auto line = readLine(subscriber, pending);
+    TEST_ASSERT_EQUAL(0, line.compare(0, strlen(expected), expected));
+    TEST_ASSERT_TRUE(line.find("\"rssi\":-98.5,\"snr\":4.25,") != std::string::npos);
+    uint64_t frames = 1;
+
+#if FANET_NAME_CACHE
+    // And its name, once it's sent it, escaped for JSON
+    Fanet::Packet name;
+    name.header.type = Fanet::PacketType::Name;
+    name.header.shouldForward = false;
+    name.header.hasExtensionHeader = false;
+    name.header.srcMac = packet.header.srcMac;
+    Fanet::Name payload;
+    payload.name = "Ann \"A\"";
+    name.payload = payload;
+    etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+    auto size = name.encode(bytes);
+    length = Fanet::Gateway::UdpFrameSource::encode(bytes.data(), size, -98.5f, 4.25f, datagram);
+    sendto(radio, datagram, length, 0, (struct sockaddr*)&address, sizeof(address));
+    frames++;
+    line = readLine(subscriber, pending);
+    TEST_ASSERT_EQUAL(0, line.compare(0, 18, "{\"addr\":\"07:3d35\","));
+    TEST_ASSERT_TRUE(line.find(",\"name\":\"Ann \\\"A\\\"\"}") != std::string::npos);
+#endif
+
+    daemon.stop();
+    loop.join();
+    close(radio);
+    close(subscriber);
+    TEST_ASSERT_EQUAL(frames, daemon.getStats().frames);
+    TEST_ASSERT_EQUAL(1, daemon.getStats().connects);
+}
+#endif
+
 int main(int argc, char **argv) {
     UNITY_BEGIN();
     RUN_TEST(test_parses);
+    RUN_TEST(test_parses_in_place);
     RUN_TEST(test_encodes);
+    RUN_TEST(test_round_trips);
+    RUN_TEST(test_tracking_codec);
+    RUN_TEST(test_dead_reckoning);
+    RUN_TEST(test_stats);
+    RUN_TEST(test_histogram);
+    RUN_TEST(test_capture);
+    RUN_TEST(test_warm_start);
+    RUN_TEST(test_track_history);
+    RUN_TEST(test_tracker_config);
+    RUN_TEST(test_tickless);
+    RUN_TEST(test_names);
+    RUN_TEST(test_proximity);
+    RUN_TEST(test_forward_policy);
+    RUN_TEST(test_geo_forward);
+    RUN_TEST(test_interest_filters);
+    RUN_TEST(test_eviction);
+    RUN_TEST(test_load_shedding);
+    RUN_TEST(test_routes);
+    RUN_TEST(test_link_quality);
+    RUN_TEST(test_frame_fusion);
+    RUN_TEST(test_packet_pool);
+    RUN_TEST(test_csma);
+    RUN_TEST(test_traffic_feed);
+#if FANET_TOOL_TESTS
+    RUN_TEST(test_sim_determinism);
+    RUN_TEST(test_replay);
+    RUN_TEST(test_decode);
+    RUN_TEST(test_gateway);
+#endif
     UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "fanetDecode.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "fanetCapture.h"
+#include "fanetPacket.h"
+
+using namespace Fanet;
+using namespace Fanet::Decode;
+
+void Fanet::Decode::Columns::reserve(const size_t& frames) {
+  src.reserve(frames);
+  time.reserve(frames);
+  lat.reserve(frames);
+  lon.reserve(frames);
+  alt.reserve(frames);
+  type.reserve(frames);
+}
+
+size_t Fanet::Decode::boundary(const Archive& archive, size_t from) {
+  while (true) {
+    from = CaptureReader::find(archive.data, archive.size, from);
+    if (from >= archive.size) return archive.size;
+    size_t next = from + CaptureReader::validAt(archive.data, archive.size, from);
+    if (next == archive.size || CaptureReader::validAt(archive.data, archive.size, next)) {
+      return from;
+    }
+    from++;
+  }
+}
+
+void Fanet::Decode::decode(const Archive& archive, const Chunk& chunk, Columns& columns) {
+  // Records are at least a header and a few bytes of frame
+  columns.reserve((chunk.end - chunk.start) / (FANET_CAPTURE_HEADER_SIZE + 12));
+
+  CaptureReader reader(archive.data + chunk.start, chunk.end - chunk.start);
+  CaptureRecord record;
+  etl::array<uint8_t, FANET_MAX_PACKET_SIZE> frame;
+  Packet packet;
+  while (reader.next(record)) {
+    columns.records++;
+    if (record.type != CaptureRecordType::Rx || !record.length) continue;
+
+    size_t length = etl::min<size_t>(record.length, frame.size());
+    memcpy(frame.data(), record.body, length);
+    Packet::parseInto(frame, length, packet);
+
+    float lat = NAN, lon = NAN;
+    int32_t alt = INT32_MIN;
+    if (packet.header.type == PacketType::Tracking) {
+      auto& payload = etl::get<Tracking>(packet.payload);
+      lat = payload.location.latitude;
+      lon = payload.location.longitude;
+      alt = payload.altitude;
+    } else if (packet.header.type == PacketType::GroundTracking) {
+      auto& payload = etl::get<GroundTracking>(packet.payload);
+      lat = payload.location.latitude;
+      lon = payload.location.longitude;
+    }
+
+    columns.src.push_back(packet.header.srcMac.toInt32());
+    columns.time.push_back(record.ms);
+    columns.lat.push_back(lat);
+    columns.lon.push_back(lon);
+    columns.alt.push_back(alt);
+    columns.type.push_back((uint8_t)packet.header.type);
+  }
+  columns.skipped = reader.getSkipped();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+  Decodes capture archives, (see src/fanetCapture.h), into columns for track analysis.
+
+  An archive is split into chunks on record boundaries, so each can be decoded on its own, (and
+  on its own core).  Decoding a chunk appends a row to every column for each frame received:
+  its source, the time it was received, its position and altitude if it has them, and its type.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace Fanet {
+  namespace Decode {
+
+    /// @brief An archive, mapped into memory
+    struct Archive {
+      std::string path;
+      const uint8_t* data = nullptr;
+      size_t size = 0;
+    };
+
+    /// @brief A piece of an archive starting and ending on record boundaries
+    struct Chunk {
+      size_t archive;
+      size_t start;
+      size_t end;
+    };
+
+    /// @brief Decoded frames of a chunk, a vector per column
+    struct Columns {
+      std::vector<uint32_t> src;   // Source address, (manufacturer << 16 | device)
+      std::vector<uint32_t> time;  // ms the frame was received at
+      std::vector<float> lat;      // NaN if the frame has no position
+      std::vector<float> lon;      // NaN if the frame has no position
+      std::vector<int32_t> alt;    // Meters, INT32_MIN if the frame has no altitude
+      std::vector<uint8_t> type;   // Packet type
+      uint64_t records = 0;        // Records read, of any type
+      uint64_t skipped = 0;        // Bytes skipped that weren't valid records
+
+      void reserve(const size_t& frames);
+    };
+
+    /// @brief Start of the first record at or after from that's followed by another valid
+    /// record, (or the end of the archive).  Checking two in a row makes it very unlikely we'll
+    /// lock on to bytes inside a frame that happen to look like a record.
+    size_t boundary(const Archive& archive, size_t from);
+
+    /// @brief Decodes the frames received in a chunk, appending them to the columns
+    void decode(const Archive& archive, const Chunk& chunk, Columns& columns);
+
+  }  // namespace Decode
+}  // namespace Fanet
@@ -0,0 +1,216 @@
+/*
+  Bulk decodes capture archives, (see src/fanetCapture.h), into columns for track analysis.
+
+  pio run -e decode && .pio/build/decode/program --out columns/ archive1.bin archive2.bin ...
+
+  Options:
+    --out DIR      Directory the columns are written to (default .)
+    --threads T    Threads to decode with (default one per core)
+    --chunk MB     Size of the pieces archives are split into (default 64)
+
+  Archives are memory mapped and split into chunks on record boundaries.  Chunks are decoded in
+  parallel, and their columns written out in archive order, so row n of every column is the
+  same frame.  Each column is a flat little endian array:
+
+    src.u32   Source address, (manufacturer << 16 | device)
+    time.u32  ms the frame was received at
+    lat.f32   Latitude, NaN if the frame has no position
+    lon.f32   Longitude, NaN if the frame has no position
+    alt.i32   Altitude in meters, INT32_MIN if the frame has no altitude
+    type.u8   Packet type
+
+  Only received frames are decoded.  Unlike the library itself, this is host tooling and uses
+  the standard library freely.
+*/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fanetDecode.h"
+
+using namespace Fanet::Decode;
+
+namespace {
+  struct Worker {
+    uint64_t frames = 0;
+    double busySeconds = 0;
+  };
+
+  template <typename T>
+  void write(FILE* file, const std::vector<T>& column) {
+    fwrite(column.data(), sizeof(T), column.size(), file);
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string out = ".";
+  unsigned threads = std::thread::hardware_concurrency();
+  size_t chunkSize = 64UL << 20;
+  std::vector<Archive> archives;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (!strcmp(arg, "--out")) {
+      out = value;
+      i++;
+    } else if (!strcmp(arg, "--threads")) {
+      threads = strtoul(value, NULL, 10);
+      i++;
+    } else if (!strcmp(arg, "--chunk")) {
+      chunkSize = strtoull(value, NULL, 10) << 20;
+      i++;
+    } else if (arg[0] != '-') {
+      archives.push_back(Archive());
+      archives.back().path = arg;
+    } else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+  if (archives.empty()) {
+    fprintf(stderr, "Usage: %s [--out DIR] [--threads T] [--chunk MB] archive...\n", argv[0]);
+    return 1;
+  }
+  if (!threads) threads = 1;
+  if (!chunkSize) chunkSize = 1UL << 20;
+
+  // Map the archives, and split them up on record boundaries
+  std::vector<Chunk> chunks;
+  uint64_t totalBytes = 0;
+  for (size_t a = 0; a < archives.size(); a++) {
+    auto& archive = archives[a];
+    int fd = open(archive.path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+      perror(archive.path.c_str());
+      return 1;
+    }
+    archive.size = st.st_size;
+    if (archive.size) {
+      void* mapped = mmap(NULL, archive.size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+      }
+      madvise(mapped, archive.size, MADV_SEQUENTIAL);
+      archive.data = (const uint8_t*)mapped;
+    }
+    close(fd);
+    totalBytes += archive.size;
+
+    size_t start = 0;
+    while (start < archive.size) {
+      size_t end = start + chunkSize < archive.size ? boundary(archive, start + chunkSize)
+                                                     : archive.size;
+      chunks.push_back({a, start, end});
+      start = end;
+    }
+  }
+
+  const char* names[] = {"src.u32", "time.u32", "lat.f32", "lon.f32", "alt.i32", "type.u8"};
+  FILE* files[6];
+  for (size_t i = 0; i < 6; i++) {
+    auto path = out + "/" + names[i];
+    files[i] = fopen(path.c_str(), "wb");
+    if (!files[i]) {
+      perror(path.c_str());
+      return 1;
+    }
+  }
+
+  // Workers take chunks in order, the main thread writes them out in order.  Workers don't
+  // get too far ahead of the writer, so memory stays bounded however large the archives are.
+  const size_t window = threads * 2;
+  std::vector<std::unique_ptr<Columns>> done(chunks.size());
+  std::atomic<size_t> nextChunk(0);
+  size_t written = 0;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<Worker> workers(threads);
+
+  auto started = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; t++) {
+    pool.emplace_back([&, t]() {
+      while (true) {
+        size_t i = nextChunk++;
+        if (i >= chunks.size()) return;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          changed.wait(lock, [&]() { return i < written + window; });
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        std::unique_ptr<Columns> columns(new Columns());
+        decode(archives[chunks[i].archive], chunks[i], *columns);
+        workers[t].frames += columns->src.size();
+        workers[t].busySeconds +=
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        done[i] = std::move(columns);
+        changed.notify_all();
+      }
+    });
+  }
+
+  uint64_t frames = 0, records = 0, skipped = 0;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    std::unique_ptr<Columns> columns;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() { return done[i] != nullptr; });
+      columns = std::move(done[i]);
+    }
+    write(files[0], columns->src);
+    write(files[1], columns->time);
+    write(files[2], columns->lat);
+    write(files[3], columns->lon);
+    write(files[4], columns->alt);
+    write(files[5], columns->type);
+    frames += columns->src.size();
+    records += columns->records;
+    skipped += columns->skipped;
+    columns.reset();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    written = i + 1;
+    changed.notify_all();
+  }
+  for (auto& thread : pool) thread.join();
+  for (auto& file : files) fclose(file);
+
+  double wall =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  printf("%zu archives, %.1f MB in %zu chunks, %u threads\n", archives.size(),
+         totalBytes / 1e6, chunks.size(), threads);
+  printf("%llu records, %llu frames decoded, %llu bytes skipped\n", (unsigned long long)records,
+         (unsigned long long)frames, (unsigned long long)skipped);
+  printf("%.3f s, %.0f frames/s, %.0f frames/s/core, %.1f MB/s\n", wall,
+         wall > 0 ? frames / wall : 0, wall > 0 ? frames / wall / threads : 0,
+         wall > 0 ? totalBytes / 1e6 / wall : 0);
+  for (unsigned t = 0; t < threads; t++) {
+    printf("  thread %2u %12llu frames %10.0f frames/s busy\n", t,
+           (unsigned long long)workers[t].frames,
+           workers[t].busySeconds > 0 ? workers[t].frames / workers[t].busySeconds : 0);
+  }
+
+  for (auto& archive : archives) {
+    if (archive.size) munmap((void*)archive.data, archive.size);
+  }
+  return 0;
+}
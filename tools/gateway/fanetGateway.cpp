@@ -0,0 +1,711 @@
+#include "fanetGateway.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace Fanet;
+using Fanet::Gateway::Daemon;
+using Fanet::Gateway::Frame;
+using Fanet::Gateway::SerialFrameSource;
+using Fanet::Gateway::UdpFrameSource;
+
+namespace {
+  const size_t kMaxIovecs = 16;   // Queued chunks written to a subscriber per call
+  const size_t kRecvBatch = 64;   // Datagrams read per recvmmsg
+  const size_t kMaxLine = 4096;   // Longest line we'll wait for from a serial module
+
+  uint64_t monotonicNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+  }
+
+  int16_t toHundredths(const float& value) {
+    float scaled = value * 100.0f;
+    if (scaled > INT16_MAX) return INT16_MAX;
+    if (scaled < INT16_MIN) return INT16_MIN;
+    return (int16_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+  }
+
+  int hexValue(const char& c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  speed_t baudConstant(const unsigned& baud) {
+    switch (baud) {
+      case 9600: return B9600;
+      case 19200: return B19200;
+      case 38400: return B38400;
+      case 57600: return B57600;
+      case 230400: return B230400;
+      case 460800: return B460800;
+      case 921600: return B921600;
+      default: return B115200;
+    }
+  }
+
+#if FANET_NAME_CACHE
+  /// @brief Appends a string as a JSON string, escaping what needs it
+  void appendJsonString(std::string& out, const etl::string_view& value) {
+    out += '"';
+    for (char c : value) {
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += c;
+      } else if ((uint8_t)c < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", (uint8_t)c);
+        out += escaped;
+      } else {
+        out += c;
+      }
+    }
+    out += '"';
+  }
+#endif
+}  // namespace
+
+UdpFrameSource::~UdpFrameSource() {
+  if (socket >= 0) ::close(socket);
+}
+
+bool UdpFrameSource::open(const uint16_t& port) {
+  socket = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (socket < 0) return false;
+
+  // Room for bursts while the loop is busy with subscribers
+  int size = 4 << 20;
+  setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(socket, (struct sockaddr*)&address, sizeof(address)) < 0) return false;
+  socklen_t length = sizeof(address);
+  getsockname(socket, (struct sockaddr*)&address, &length);
+  boundPort = ntohs(address.sin_port);
+  return true;
+}
+
+bool UdpFrameSource::read(std::vector<Frame>& frames) {
+  static_assert(sizeof(peer) >= sizeof(struct sockaddr_storage), "peer too small");
+  uint8_t buffers[kRecvBatch][4 + FANET_MAX_PACKET_SIZE];
+  struct sockaddr_storage addresses[kRecvBatch];
+  struct iovec iovecs[kRecvBatch];
+  struct mmsghdr messages[kRecvBatch];
+
+  while (true) {
+    for (size_t i = 0; i < kRecvBatch; i++) {
+      iovecs[i].iov_base = buffers[i];
+      iovecs[i].iov_len = sizeof(buffers[i]);
+      messages[i] = {};
+      messages[i].msg_hdr.msg_iov = &iovecs[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+      messages[i].msg_hdr.msg_name = &addresses[i];
+      messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+    }
+    int count = recvmmsg(socket, messages, kRecvBatch, MSG_DONTWAIT, NULL);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    for (int i = 0; i < count; i++) {
+      size_t length = messages[i].msg_len;
+      if (length <= 4 || (messages[i].msg_hdr.msg_flags & MSG_TRUNC)) continue;
+      Frame frame;
+      frame.rssi = (int16_t)(buffers[i][0] | buffers[i][1] << 8) / 100.0f;
+      frame.snr = (int16_t)(buffers[i][2] | buffers[i][3] << 8) / 100.0f;
+      frame.size = length - 4;
+      memcpy(frame.bytes.data(), buffers[i] + 4, frame.size);
+      frames.push_back(frame);
+
+      memcpy(peer, &addresses[i], messages[i].msg_hdr.msg_namelen);
+      peerLength = messages[i].msg_hdr.msg_namelen;
+      hasPeer = true;
+    }
+    if ((size_t)count < kRecvBatch) return true;
+  }
+}
+
+bool UdpFrameSource::transmit(const uint8_t* bytes, const size_t& size) {
+  // With no one listening, the frame goes nowhere, as it would from a radio
+  if (!hasPeer) return true;
+  uint8_t datagram[4 + FANET_MAX_PACKET_SIZE];
+  size_t length = encode(bytes, size, 0.0f, 0.0f, datagram);
+  return sendto(socket, datagram, length, MSG_DONTWAIT, (struct sockaddr*)peer, peerLength) ==
+         (ssize_t)length;
+}
+
+size_t UdpFrameSource::encode(const uint8_t* frame,
+                              const size_t& size,
+                              const float& rssi,
+                              const float& snr,
+                              uint8_t* datagram) {
+  int16_t r = toHundredths(rssi);
+  int16_t s = toHundredths(snr);
+  datagram[0] = r & 0xFF;
+  datagram[1] = (r >> 8) & 0xFF;
+  datagram[2] = s & 0xFF;
+  datagram[3] = (s >> 8) & 0xFF;
+  memcpy(datagram + 4, frame, size);
+  return size + 4;
+}
+
+SerialFrameSource::~SerialFrameSource() {
+  if (port >= 0) ::close(port);
+}
+
+bool SerialFrameSource::open(const char* path, const unsigned& baud) {
+  port = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (port < 0) return false;
+  if (isatty(port)) {
+    struct termios settings;
+    if (tcgetattr(port, &settings) < 0) return false;
+    cfmakeraw(&settings);
+    cfsetispeed(&settings, baudConstant(baud));
+    cfsetospeed(&settings, baudConstant(baud));
+    if (tcsetattr(port, TCSANOW, &settings) < 0) return false;
+  }
+  return true;
+}
+
+bool SerialFrameSource::read(std::vector<Frame>& frames) {
+  char buffer[4096];
+  while (true) {
+    ssize_t count = ::read(port, buffer, sizeof(buffer));
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      return false;  // (A pty whose other end has closed gives EIO)
+    }
+    if (count == 0) return false;
+    pending.append(buffer, count);
+  }
+
+  size_t start = 0;
+  while (true) {
+    size_t end = pending.find('\n', start);
+    if (end == std::string::npos) break;
+    pending[end] = 0;
+    if (end > start && pending[end - 1] == '\r') pending[end - 1] = 0;
+    Frame frame;
+    if (parseLine(pending.c_str() + start, frame)) frames.push_back(frame);
+    start = end + 1;
+  }
+  pending.erase(0, start);
+  if (pending.size() > kMaxLine) pending.clear();  // Not a module talking our protocol
+  return true;
+}
+
+bool SerialFrameSource::parseLine(const char* line, Frame& frame) {
+  if (strncmp(line, "RX ", 3)) return false;
+  char* end;
+  frame.rssi = strtof(line + 3, &end);
+  if (end == line + 3) return false;
+  const char* from = end;
+  frame.snr = strtof(from, &end);
+  if (end == from) return false;
+  while (*end == ' ') end++;
+
+  frame.size = 0;
+  for (const char* hex = end; *hex && *hex != ' '; hex += 2) {
+    int high = hexValue(hex[0]);
+    int low = hex[1] ? hexValue(hex[1]) : -1;
+    if (high < 0 || low < 0 || frame.size == frame.bytes.size()) return false;
+    frame.bytes[frame.size++] = high << 4 | low;
+  }
+  return frame.size > 0;
+}
+
+bool SerialFrameSource::transmit(const uint8_t* bytes, const size_t& size) {
+  static const char kHex[] = "0123456789ABCDEF";
+  char line[4 + FANET_MAX_PACKET_SIZE * 2 + 1];
+  size_t length = 0;
+  memcpy(line, "TX ", 3);
+  length = 3;
+  for (size_t i = 0; i < size; i++) {
+    line[length++] = kHex[bytes[i] >> 4];
+    line[length++] = kHex[bytes[i] & 0x0F];
+  }
+  line[length++] = '\n';
+
+  // Once part of a line is written, the rest must follow, (waiting a little if need be)
+  size_t written = 0;
+  int polls = 0;
+  while (written < length) {
+    ssize_t count = ::write(port, line + written, length - written);
+    if (count > 0) {
+      written += count;
+      continue;
+    }
+    if (count < 0 && errno == EINTR) continue;
+    if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return false;
+    struct pollfd writable = {port, POLLOUT, 0};
+    if (poll(&writable, 1, kWritePollMs) <= 0 && !written) return false;
+    if (++polls > kWritePolls) return false;
+  }
+  return true;
+}
+
+Daemon::Daemon(FrameSource& source, const Options& options)
+    : sources(1, &source), options(options) {}
+
+Daemon::Daemon(const std::vector<FrameSource*>& sources, const Options& options)
+    : sources(sources), options(options) {
+  if (sources.size() > 1) fusion.reset(new FrameFusion<kFusionFrames>());
+}
+
+Daemon::~Daemon() {
+  for (auto& entry : clients) ::close(entry.first);
+  for (int fd : {epoll, listener, managerTimer, flushTimer, stopEvent}) {
+    if (fd >= 0) ::close(fd);
+  }
+  if (listener >= 0) unlink(options.socketPath.c_str());
+}
+
+unsigned long Daemon::now() const {
+  return (monotonicNs() - startNs) / 1000000ULL;
+}
+
+bool Daemon::open() {
+  startNs = monotonicNs();
+  epoll = epoll_create1(EPOLL_CLOEXEC);
+  managerTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  flushTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  stopEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epoll < 0 || managerTimer < 0 || flushTimer < 0 || stopEvent < 0) return false;
+
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (options.socketPath.size() >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    return false;
+  }
+  strcpy(address.sun_path, options.socketPath.c_str());
+  listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listener < 0) return false;
+  unlink(address.sun_path);
+  if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+      listen(listener, SOMAXCONN) < 0) {
+    return false;
+  }
+
+  std::vector<int> fds = {listener, managerTimer, flushTimer, stopEvent};
+  for (auto source : sources) fds.push_back(source->fd());
+  for (int fd : fds) {
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) < 0) return false;
+  }
+
+  manager.Begin(options.mac, now());
+  if (options.hasPosition) {
+    manager.setGroundType(GroundTrackingType::Other);
+    manager.setPos(options.lat, options.lng, options.alt, now());
+  }
+  schedule(manager.nextEventTime(now()));
+  return true;
+}
+
+int Daemon::run() {
+  struct epoll_event events[64];
+  while (!stopping) {
+    int count = epoll_wait(epoll, events, 64, -1);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      return 1;
+    }
+    stats.wakeups++;
+
+    for (int i = 0; i < count; i++) {
+      int fd = events[i].data.fd;
+      uint64_t expirations;
+      size_t source = 0;
+      while (source < sources.size() && sources[source]->fd() != fd) source++;
+      if (source < sources.size()) {
+        readSource(source);
+      } else if (fd == listener) {
+        accept();
+      } else if (fd == managerTimer) {
+        while (::read(managerTimer, &expirations, sizeof(expirations)) > 0) {
+        }
+        scheduled = etl::nullopt;
+        if (fusion) popFused();
+        service();
+      } else if (fd == flushTimer) {
+        while (::read(flushTimer, &expirations, sizeof(expirations)) > 0) {
+        }
+        flushArmed = false;
+        flush();
+      } else if (fd == stopEvent) {
+        while (::read(stopEvent, &expirations, sizeof(expirations)) > 0) {
+        }
+      } else {
+        auto it = clients.find(fd);
+        if (it == clients.end()) continue;
+        auto& client = it->second;
+        if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+          close(client);
+          continue;
+        }
+        if (events[i].events & EPOLLIN) {
+          // Subscribers have nothing to say, anything they send is thrown away
+          char discard[256];
+          ssize_t read = ::read(fd, discard, sizeof(discard));
+          if (read == 0 || (read < 0 && errno != EAGAIN && errno != EINTR)) {
+            close(client);
+            continue;
+          }
+        }
+        if ((events[i].events & EPOLLOUT) && !write(client)) close(client);
+      }
+    }
+    if (sourceClosed) return 1;
+  }
+  return 0;
+}
+
+void Daemon::stop() {
+  stopping = true;
+  uint64_t one = 1;
+  if (stopEvent >= 0 && ::write(stopEvent, &one, sizeof(one)) < 0) {
+    // Already signalled
+  }
+}
+
+void Daemon::readSource(const uint8_t& receiver) {
+  frames.clear();
+  if (!sources[receiver]->read(frames)) sourceClosed = true;
+
+  auto ms = now();
+  for (auto& frame : frames) {
+    stats.frames++;
+    if (fusion) {
+      fusion->add(receiver, frame.bytes.data(), frame.size, ms, frame.rssi, frame.snr);
+      continue;
+    }
+    manager.handleRx(frame.bytes, frame.size, ms, frame.rssi, frame.snr, packet);
+    heard(frame.bytes.data(), frame.size);
+  }
+  if (fusion) {
+    stats.duplicates = fusion->getStats().duplicates + fusion->getStats().late;
+    // Fusion may have filled up, and have frames to pop early
+    popFused();
+  }
+  // Frames may have been queued to forward, or acks to send
+  schedule(manager.nextEventTime(ms));
+  if (!dirty.empty()) armFlush();
+}
+
+void Daemon::popFused() {
+  auto ms = now();
+  FusedFrame frame;
+  while (fusion->pop(ms, frame)) {
+    manager.handleRx(frame.bytes, frame.size, ms, frame.rssi, frame.snr, packet);
+    heard(frame.bytes.data(), frame.size);
+    if (frame.size >= 4) {
+      receivers[(uint32_t)frame.bytes[1] << 16 | frame.bytes[3] << 8 | frame.bytes[2]] =
+          frame.receivers;
+    }
+  }
+  if (!dirty.empty()) armFlush();
+}
+
+void Daemon::heard(const uint8_t* bytes, const size_t& size) {
+  // The source address follows the first byte of the header
+  if (size >= 4) dirty.insert((uint32_t)bytes[1] << 16 | bytes[3] << 8 | bytes[2]);
+}
+
+void Daemon::service() {
+  auto transmit = etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*,
+                                     const size_t&)>::create<Daemon,
+                                                             &Daemon::transmitFrame>(*this);
+  schedule(manager.service(now(), transmit));
+  // Neighbors may have timed out
+  if (manager.getStats().neighborTableSize != known.size()) armFlush();
+}
+
+bool Daemon::transmitFrame(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                           const size_t& size) {
+  bool sent = sources[0]->transmit(bytes->data(), size);
+  sent ? stats.transmitted++ : stats.transmitFailed++;
+  return sent;
+}
+
+void Daemon::schedule(etl::optional<unsigned long> next) {
+  unsigned long pop;
+  if (fusion && fusion->nextPopTime(pop) && (!next.has_value() || pop < next.value())) {
+    next = pop;
+  }
+  if (next == scheduled) return;
+  scheduled = next;
+  struct itimerspec timer = {};
+  if (next.has_value()) {
+    uint64_t at = startNs + (uint64_t)next.value() * 1000000ULL;
+    timer.it_value.tv_sec = at / 1000000000ULL;
+    timer.it_value.tv_nsec = at % 1000000000ULL;
+  }
+  timerfd_settime(managerTimer, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+void Daemon::armFlush() {
+  if (flushArmed) return;
+  flushArmed = true;
+  // At most one batch every batchMs, the first straight away
+  uint64_t at = startNs + (uint64_t)(lastFlush + options.batchMs) * 1000000ULL;
+  uint64_t soonest = monotonicNs() + 1;
+  if (!lastFlush || at < soonest) at = soonest;
+  struct itimerspec timer = {};
+  timer.it_value.tv_sec = at / 1000000000ULL;
+  timer.it_value.tv_nsec = at % 1000000000ULL;
+  timerfd_settime(flushTimer, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+void Daemon::flush() {
+  auto ms = now();
+  lastFlush = ms ? ms : 1;
+  auto table = manager.getNeighborTable();
+
+  // Neighbors heard since the last batch, then any that have gone
+  std::string batch;
+  uint64_t lines = 0;
+  for (auto address : dirty) {
+    auto it = table.find(address);
+    if (it != table.end()) {
+      appendNeighbor(batch, it->second, ms);
+      known.insert(address);
+      lines++;
+    }
+  }
+  dirty.clear();
+  for (auto it = known.begin(); it != known.end();) {
+    if (table.find(*it) != table.end()) {
+      it++;
+      continue;
+    }
+    char line[64];
+    snprintf(line, sizeof(line), "{\"addr\":\"%02x:%04x\",\"gone\":true}\n", *it >> 16,
+             *it & 0xFFFF);
+    batch += line;
+    lines++;
+    receivers.erase(*it);
+    it = known.erase(it);
+  }
+
+  std::shared_ptr<const std::string> shared;
+  if (!batch.empty()) {
+    shared = std::make_shared<const std::string>(std::move(batch));
+    stats.batches++;
+    stats.updates += lines;
+  }
+
+  std::shared_ptr<const std::string> resync;
+  std::vector<int> slow, failed;
+  for (auto& entry : clients) {
+    auto& client = entry.second;
+    if (client.behind) {
+      if (!client.queued) {
+        // Caught up, start it again from the whole table
+        if (!resync) resync = snapshot(table);
+        client.behind = false;
+        stats.resyncs++;
+        if (!enqueue(client, resync)) {
+          failed.push_back(entry.first);
+          continue;
+        }
+      } else if (ms - client.behindSince > options.slowClientMs) {
+        slow.push_back(entry.first);
+        continue;
+      } else {
+        if (shared) stats.batchesSkipped++;
+        continue;
+      }
+    }
+    if (!shared) continue;
+    if (client.queued + shared->size() > options.clientBufferBytes) {
+      client.behind = true;
+      client.behindSince = ms;
+      stats.batchesSkipped++;
+      continue;
+    }
+    if (!enqueue(client, shared)) failed.push_back(entry.first);
+  }
+  for (int fd : slow) {
+    stats.slowDisconnects++;
+    close(clients[fd]);
+  }
+  for (int fd : failed) close(clients[fd]);
+}
+
+void Daemon::accept() {
+  std::shared_ptr<const std::string> initial;
+  while (true) {
+    int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      return;  // EAGAIN, or out of descriptors until someone leaves
+    }
+    if (clients.size() >= options.maxClients) {
+      ::close(fd);
+      continue;
+    }
+
+    auto& client = clients[fd];
+    client.fd = fd;
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = fd;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    stats.connects++;
+    stats.clients++;
+
+    // Everyone connecting together gets the same snapshot
+    if (!initial) initial = snapshot(manager.getNeighborTable());
+    if (!enqueue(client, initial)) close(client);
+  }
+}
+
+bool Daemon::enqueue(Client& client, const std::shared_ptr<const std::string>& data) {
+  client.queue.push_back(data);
+  client.queued += data->size();
+  return !client.writable || write(client);
+}
+
+bool Daemon::write(Client& client) {
+  while (!client.queue.empty()) {
+    struct iovec iovecs[kMaxIovecs];
+    size_t count = 0;
+    for (auto it = client.queue.begin(); it != client.queue.end() && count < kMaxIovecs; it++) {
+      size_t skip = count ? 0 : client.offset;
+      iovecs[count].iov_base = (void*)((*it)->data() + skip);
+      iovecs[count].iov_len = (*it)->size() - skip;
+      count++;
+    }
+    struct msghdr message = {};
+    message.msg_iov = iovecs;
+    message.msg_iovlen = count;
+    ssize_t sent = sendmsg(client.fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+      // Full, wait until the subscriber has read some
+      if (client.writable) watch(client, true);
+      return true;
+    }
+
+    stats.bytesSent += sent;
+    client.queued -= sent;
+    size_t left = sent;
+    while (left) {
+      size_t front = client.queue.front()->size() - client.offset;
+      if (left < front) {
+        client.offset += left;
+        break;
+      }
+      left -= front;
+      client.offset = 0;
+      client.queue.pop_front();
+    }
+  }
+
+  if (!client.writable) watch(client, false);
+  // Once a subscriber that had fallen behind has caught up, it needs a snapshot
+  if (client.behind) armFlush();
+  return true;
+}
+
+void Daemon::watch(Client& client, const bool& out) {
+  struct epoll_event event = {};
+  event.events = EPOLLIN | EPOLLRDHUP | (out ? (uint32_t)EPOLLOUT : 0);
+  event.data.fd = client.fd;
+  epoll_ctl(epoll, EPOLL_CTL_MOD, client.fd, &event);
+  client.writable = !out;
+}
+
+void Daemon::close(Client& client) {
+  int fd = client.fd;
+  epoll_ctl(epoll, EPOLL_CTL_DEL, fd, NULL);
+  ::close(fd);
+  stats.clients--;
+  clients.erase(fd);
+}
+
+std::shared_ptr<const std::string> Daemon::snapshot(const FanetManager::NeighborTable& table) {
+  std::string out;
+  char header[32];
+  snprintf(header, sizeof(header), "{\"snapshot\":%zu}\n", table.size());
+  out += header;
+  auto ms = now();
+  for (auto& entry : table) {
+    appendNeighbor(out, entry.second, ms);
+    known.insert(entry.first);
+  }
+  return std::make_shared<const std::string>(std::move(out));
+}
+
+void Daemon::appendNeighbor(std::string& out,
+                            const Neighbor& neighbor,
+                            const unsigned long& ms) const {
+  char line[384];
+  int length = snprintf(line, sizeof(line), "{\"addr\":\"%02x:%04x\"",
+                        neighbor.address.manufacturer, neighbor.address.device);
+  if (neighbor.location.has_value()) {
+    length += snprintf(line + length, sizeof(line) - length, ",\"lat\":%.5f,\"lon\":%.5f",
+                       neighbor.location.value().latitude, neighbor.location.value().longitude);
+  }
+  if (neighbor.altitude.has_value()) {
+    length += snprintf(line + length, sizeof(line) - length, ",\"alt\":%u",
+                       (unsigned)neighbor.altitude.value());
+  }
+  if (neighbor.groundTrackingType.has_value()) {
+    length += snprintf(line + length, sizeof(line) - length, ",\"ground\":%d",
+                       (int)neighbor.groundTrackingType.value());
+  } else if (neighbor.location.has_value()) {
+    length += snprintf(line + length, sizeof(line) - length,
+                       ",\"speed\":%.1f,\"heading\":%d,\"climb\":%.1f", neighbor.speed,
+                       neighbor.heading, neighbor.climbRate);
+  }
+  length += snprintf(line + length, sizeof(line) - length,
+                     ",\"rssi\":%.1f,\"snr\":%.2f,\"score\":%.2f,\"age\":%lu", neighbor.link.rssi,
+                     neighbor.link.snr, neighbor.link.score(), ms - neighbor.lastSeen);
+  out.append(line, length);
+  auto heardBy = receivers.find(neighbor.address.toInt32());
+  if (heardBy != receivers.end()) {
+    out += ",\"receivers\":[";
+    for (uint32_t receiver = 0, first = 1; receiver < 32; receiver++) {
+      if (!(heardBy->second & 1UL << receiver)) continue;
+      if (!first) out += ',';
+      out += std::to_string(receiver);
+      first = 0;
+    }
+    out += ']';
+  }
+#if FANET_NAME_CACHE
+  auto name = manager.getName(neighbor.address);
+  if (name.size()) {
+    out += ",\"name\":";
+    appendJsonString(out, name);
+  }
+#endif
+  out += "}\n";
+}
@@ -0,0 +1,301 @@
+#pragma once
+
+/*
+  Ground station daemon for Linux gateways.
+
+  A single threaded epoll loop takes frames from a FrameSource, (a serial radio module, a pty,
+  or UDP on localhost standing in for one), feeds them to a FanetManager, sleeps on a timerfd
+  until the manager's next event, and streams the neighbor table to any number of local
+  subscribers over a Unix stream socket.
+
+  Given several sources, (receive only stations around a valley), the frames they report are
+  merged by a FrameFusion first, so the manager sees each frame once with its best RSSI and SNR,
+  and each neighbor's line lists the sources, (numbered in the order given), that heard it last.
+  Frames we send go out through the first source.
+
+  Subscribers get newline delimited JSON.  On connecting, (and after falling behind), a
+  snapshot of the whole table:
+
+    {"snapshot":2}
+    {"addr":"07:3d35","lat":47.1234,"lon":8.5678,"alt":1200,"speed":36.0,"heading":180,
+     "climb":1.5,"rssi":-98.5,"snr":4.25,"score":0.72,"age":1250}
+    {"addr":"fb:0002","lat":47.2,"lon":8.6,"ground":9,"rssi":-110.0,"snr":-2.0,...}
+    {"addr":"07:3d36",...,"age":250,"receivers":[0,2,3]}
+
+  then each neighbor again whenever it's heard, and {"addr":"07:3d35","gone":true} when it
+  times out.  Updates are batched, at most one batch every batchMs, and each batch is encoded
+  once and shared by every subscriber.  A subscriber with more than clientBufferBytes waiting
+  is skipped until it has caught up, then sent a fresh snapshot, so slow readers cost memory
+  only up to their limit and never hold up the others.  One that stays behind for
+  slowClientMs is disconnected.
+
+  Unlike the library itself, this is host tooling and uses the standard library freely.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "fanetFusion.h"
+#include "fanetManager.h"
+
+namespace Fanet {
+  namespace Gateway {
+
+    /// @brief A frame received by the radio
+    struct Frame {
+      etl::array<uint8_t, FANET_MAX_PACKET_SIZE> bytes;
+      size_t size = 0;
+      float rssi = 0.0f;
+      float snr = 0.0f;
+    };
+
+    /// @brief Where frames come from, and go to
+    class FrameSource {
+     public:
+      virtual ~FrameSource() {}
+
+      /// @brief Descriptor the gateway waits on, readable when frames may have arrived
+      virtual int fd() const = 0;
+
+      /// @brief Reads every frame that's arrived, without blocking
+      /// @param frames Frames read are appended to this
+      /// @return false if the source has closed or failed
+      virtual bool read(std::vector<Frame>& frames) = 0;
+
+      /// @brief Sends a frame, without blocking
+      /// @return false if it couldn't be sent, (the manager will back off and retry)
+      virtual bool transmit(const uint8_t* bytes, const size_t& size) = 0;
+    };
+
+    /*
+    @brief UDP on localhost standing in for a radio, for testing and load generation
+
+    Each datagram is one frame, preceded by its RSSI and SNR in hundredths of a dB, (int16_t,
+    little endian).  Frames we transmit are sent back the same way, (with 0 for both), to
+    wherever the last frame came from.
+    */
+    class UdpFrameSource : public FrameSource {
+     public:
+      ~UdpFrameSource() override;
+
+      /// @brief Binds to a port on 127.0.0.1, 0 for any free port
+      bool open(const uint16_t& port);
+
+      /// @brief Port we're bound to
+      uint16_t port() const { return boundPort; }
+
+      int fd() const override { return socket; }
+      bool read(std::vector<Frame>& frames) override;
+      bool transmit(const uint8_t* bytes, const size_t& size) override;
+
+      /// @brief Builds a datagram in the format read expects
+      static size_t encode(const uint8_t* frame,
+                           const size_t& size,
+                           const float& rssi,
+                           const float& snr,
+                           uint8_t* datagram);
+
+     protected:
+      int socket = -1;
+      uint16_t boundPort = 0;
+      bool hasPeer = false;
+      uint8_t peer[128];  // sockaddr of whoever sent the last frame
+      uint32_t peerLength = 0;
+    };
+
+    /*
+    @brief A radio module on a serial port, (or anything that looks like one, such as a pty)
+
+    Frames are exchanged as lines of text, the frame itself in hex:
+
+      RX <rssi> <snr> <hex>    from the module, for each frame received
+      TX <hex>                 to the module, for each frame to send
+
+    Other lines from the module are ignored.
+    */
+    class SerialFrameSource : public FrameSource {
+     public:
+      ~SerialFrameSource() override;
+
+      /// @brief Opens a serial port or pty, setting it to raw mode at a baud rate if it's a tty
+      bool open(const char* path, const unsigned& baud);
+
+      int fd() const override { return port; }
+      bool read(std::vector<Frame>& frames) override;
+      bool transmit(const uint8_t* bytes, const size_t& size) override;
+
+      /// @brief Parses an RX line
+      /// @return false if it isn't one
+      static bool parseLine(const char* line, Frame& frame);
+
+      /// @brief Polls of kWritePollMs waited for the rest of a part written line, before the
+      /// frame is given up on, (a module that's stopped reading mustn't stall the gateway)
+      static const int kWritePolls = 20;
+      static const int kWritePollMs = 50;
+
+     protected:
+      int port = -1;
+      std::string pending;  // Part of a line read so far
+    };
+
+    /// @brief How the gateway runs
+    struct Options {
+      std::string socketPath = "/tmp/fanet.sock";
+      Mac mac = {0xFB, 0x0001};
+      bool hasPosition = false;  // Send our position as a ground station
+      float lat = 0.0f;
+      float lng = 0.0f;
+      uint32_t alt = 0;
+      unsigned long batchMs = 100;                // Most often updates are sent to subscribers
+      size_t clientBufferBytes = 256 * 1024;      // Most a subscriber may have waiting
+      unsigned long slowClientMs = 30 * 1000;     // Disconnect subscribers behind this long
+      size_t maxClients = 4096;
+    };
+
+    // Distinct frames the daemon can hold for fusion, enough for FANET_FUSION_HOLD_MS at over
+    // 10 000 frames a second
+    const size_t kFusionFrames = 32768;
+
+    /// @brief Counters, read with Daemon::getStats
+    struct Stats {
+      uint64_t frames = 0;          // Frames received from the source
+      uint64_t transmitted = 0;     // Frames the source accepted to send
+      uint64_t transmitFailed = 0;  // Frames the source couldn't send
+      uint64_t duplicates = 0;      // Copies of frames another source had already reported
+      uint64_t wakeups = 0;         // Times epoll_wait returned
+      uint64_t batches = 0;         // Batches of updates sent to subscribers
+      uint64_t updates = 0;         // Neighbor lines in those batches
+      uint64_t connects = 0;        // Subscribers that have connected
+      uint64_t clients = 0;         // Subscribers connected now
+      uint64_t batchesSkipped = 0;  // Batches a subscriber missed while behind
+      uint64_t resyncs = 0;         // Snapshots sent to subscribers that had fallen behind
+      uint64_t slowDisconnects = 0; // Subscribers dropped for staying behind too long
+      uint64_t bytesSent = 0;       // Bytes written to subscribers
+    };
+
+    /*
+    @brief The daemon's event loop
+
+    Everything runs on the thread that calls run, apart from stop.
+    */
+    class Daemon {
+     public:
+      Daemon(FrameSource& source, const Options& options);
+
+      /// @brief A daemon fusing the frames from several sources, (up to 32)
+      Daemon(const std::vector<FrameSource*>& sources, const Options& options);
+      ~Daemon();
+
+      /// @brief Creates the subscriber socket and timers, and starts the manager
+      /// @return false, with errno set, if something couldn't be created
+      bool open();
+
+      /// @brief Runs the event loop until stop is called, or the source closes
+      /// @return 0 if stopped, 1 if the source closed or failed
+      int run();
+
+      /// @brief Makes run return, from any thread or a signal handler
+      void stop();
+
+      /// @brief Gets the counters.  Only consistent once run has returned
+      Stats getStats() const { return stats; }
+
+      /// @brief Milliseconds since open, the manager's clock
+      unsigned long now() const;
+
+     protected:
+      /// @brief A subscriber, and what it has waiting
+      struct Client {
+        int fd = -1;
+        std::deque<std::shared_ptr<const std::string>> queue;  // Shared with other clients
+        size_t offset = 0;             // Bytes of the front of the queue already written
+        size_t queued = 0;             // Bytes waiting
+        bool behind = false;           // Skipping batches until it catches up
+        unsigned long behindSince = 0;
+        bool writable = true;          // Not waiting on EPOLLOUT
+      };
+
+      /// @brief Hands every frame that's arrived to the manager, (or fusion)
+      void readSource(const uint8_t& receiver);
+
+      /// @brief Hands the manager every fused frame whose window has closed
+      void popFused();
+
+      /// @brief Accepts every waiting subscriber, sending each a snapshot
+      void accept();
+
+      /// @brief Lets the manager do what's due, and sets the timer for its next event
+      void service();
+
+      /// @brief Sends subscribers the neighbors heard, and gone, since the last batch
+      void flush();
+
+      /// @brief Sets the manager timer, if it's changed, (or sooner, for the next fused frame)
+      void schedule(etl::optional<unsigned long> next);
+
+      /// @brief Makes sure a flush is coming, no sooner than batchMs after the last
+      void armFlush();
+
+      /// @brief Queues data for a subscriber, writing what it'll take straight away
+      /// @return false if the subscriber has gone and should be closed
+      bool enqueue(Client& client, const std::shared_ptr<const std::string>& data);
+
+      /// @brief Writes as much of a subscriber's queue as it'll take
+      /// @return false if the subscriber has gone and should be closed
+      bool write(Client& client);
+
+      void close(Client& client);
+
+      /// @brief Sets whether we wait for a subscriber to be writable
+      void watch(Client& client, const bool& out);
+
+      bool transmitFrame(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                         const size_t& size);
+
+      /// @brief Encodes the whole table, marking every neighbor in it as known
+      std::shared_ptr<const std::string> snapshot(const FanetManager::NeighborTable& table);
+
+      /// @brief Appends a neighbor's JSON line
+      void appendNeighbor(std::string& out,
+                          const Neighbor& neighbor,
+                          const unsigned long& ms) const;
+
+      /// @brief Marks a neighbor to be sent with the next batch
+      void heard(const uint8_t* bytes, const size_t& size);
+
+      std::vector<FrameSource*> sources;
+      Options options;
+      FanetManager manager;
+      std::unique_ptr<FrameFusion<kFusionFrames>> fusion;  // With more than one source
+      Stats stats;
+
+      int epoll = -1;
+      int listener = -1;
+      int managerTimer = -1;  // Wakes us for the manager's next event
+      int flushTimer = -1;    // Wakes us to send the next batch
+      int stopEvent = -1;
+      std::atomic<bool> stopping{false};
+      bool sourceClosed = false;
+      uint64_t startNs = 0;
+
+      etl::optional<unsigned long> scheduled;  // When the manager timer is set for
+      bool flushArmed = false;
+      unsigned long lastFlush = 0;
+
+      std::unordered_map<int, Client> clients;
+      std::unordered_set<uint32_t> dirty;  // Neighbors heard since the last batch
+      std::unordered_set<uint32_t> known;  // Neighbors subscribers have been told about
+      std::unordered_map<uint32_t, uint32_t> receivers;  // Sources that heard each, when fusing
+      std::vector<Frame> frames;
+      Packet packet;  // Every frame is parsed into this
+    };
+  }  // namespace Gateway
+}  // namespace Fanet
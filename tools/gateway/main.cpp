@@ -0,0 +1,149 @@
+/*
+  Ground station daemon, serving the live neighbor table to local clients, (see fanetGateway.h
+  for the protocol).
+
+  pio run -e gateway && .pio/build/gateway/program --serial /dev/ttyUSB0 --socket /run/fanet.sock
+
+  Options:
+    --serial PATH      Radio module on a serial port or pty, (RX/TX lines)
+    --baud B           Serial speed (default 115200)
+    --udp PORT         Frames over UDP on 127.0.0.1 instead of a radio, for testing
+
+  --serial and --udp may be given several times, (up to 32 in all), for receivers around a
+  valley: the frames they report are fused, each one handled once with its best signal.
+
+    --socket PATH      Unix socket subscribers connect to (default /tmp/fanet.sock)
+    --mac MM:DDDD      Our address, in hex (default FB:0001)
+    --pos LAT,LON,ALT  Send our position as a ground station
+    --batch MS         Most often subscribers are sent updates (default 100)
+    --client-kb KB     Most a subscriber may have waiting before it's skipped (default 256)
+
+  Stops on SIGINT or SIGTERM, printing its counters.
+*/
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "fanetGateway.h"
+
+using namespace Fanet;
+
+namespace {
+  Gateway::Daemon* running = nullptr;
+
+  void onSignal(int) {
+    if (running) running->stop();
+  }
+
+  void printStats(const Gateway::Stats& stats) {
+    fprintf(stderr,
+            "frames %llu, transmitted %llu (%llu failed), wakeups %llu, batches %llu, "
+            "updates %llu, duplicates %llu\nsubscribers %llu (%llu connected), skipped %llu, resyncs %llu, "
+            "slow %llu, sent %.1f MB\n",
+            (unsigned long long)stats.frames, (unsigned long long)stats.transmitted,
+            (unsigned long long)stats.transmitFailed, (unsigned long long)stats.wakeups,
+            (unsigned long long)stats.batches, (unsigned long long)stats.updates,
+            (unsigned long long)stats.duplicates,
+            (unsigned long long)stats.clients, (unsigned long long)stats.connects,
+            (unsigned long long)stats.batchesSkipped, (unsigned long long)stats.resyncs,
+            (unsigned long long)stats.slowDisconnects, stats.bytesSent / 1e6);
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  Gateway::Options options;
+  std::vector<const char*> serials;
+  std::vector<long> udpPorts;
+  unsigned baud = 115200;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (!strcmp(arg, "--serial")) {
+      serials.push_back(value);
+    } else if (!strcmp(arg, "--baud")) {
+      baud = strtoul(value, NULL, 10);
+    } else if (!strcmp(arg, "--udp")) {
+      udpPorts.push_back(strtol(value, NULL, 10));
+    } else if (!strcmp(arg, "--socket")) {
+      options.socketPath = value;
+    } else if (!strcmp(arg, "--mac")) {
+      unsigned manufacturer, device;
+      if (sscanf(value, "%x:%x", &manufacturer, &device) != 2) {
+        fprintf(stderr, "Bad --mac %s\n", value);
+        return 1;
+      }
+      options.mac.manufacturer = manufacturer;
+      options.mac.device = device;
+    } else if (!strcmp(arg, "--pos")) {
+      unsigned alt = 0;
+      if (sscanf(value, "%f,%f,%u", &options.lat, &options.lng, &alt) < 2) {
+        fprintf(stderr, "Bad --pos %s\n", value);
+        return 1;
+      }
+      options.alt = alt;
+      options.hasPosition = true;
+    } else if (!strcmp(arg, "--batch")) {
+      options.batchMs = strtoul(value, NULL, 10);
+    } else if (!strcmp(arg, "--client-kb")) {
+      options.clientBufferBytes = strtoul(value, NULL, 10) * 1024;
+    } else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+    i++;
+  }
+
+  std::vector<std::unique_ptr<Gateway::FrameSource>> owned;
+  std::vector<Gateway::FrameSource*> sources;
+  for (auto serial : serials) {
+    auto port = new Gateway::SerialFrameSource();
+    owned.emplace_back(port);
+    if (!port->open(serial, baud)) {
+      perror(serial);
+      return 1;
+    }
+    sources.push_back(port);
+  }
+  for (auto udpPort : udpPorts) {
+    auto udp = new Gateway::UdpFrameSource();
+    owned.emplace_back(udp);
+    if (!udp->open(udpPort)) {
+      perror("udp");
+      return 1;
+    }
+    fprintf(stderr, "Listening for frames on 127.0.0.1:%u\n", udp->port());
+    sources.push_back(udp);
+  }
+  if (sources.empty() || sources.size() > 32) {
+    fprintf(stderr,
+            "Usage: %s (--serial PATH [--baud B] | --udp PORT)... [--socket PATH] [--mac MM:DDDD] "
+            "[--pos LAT,LON,ALT] [--batch MS] [--client-kb KB]\n",
+            argv[0]);
+    return 1;
+  }
+
+  Gateway::Daemon daemon(sources, options);
+  if (!daemon.open()) {
+    perror("gateway");
+    return 1;
+  }
+  fprintf(stderr, "Serving neighbors on %s\n", options.socketPath.c_str());
+
+  running = &daemon;
+  struct sigaction action = {};
+  action.sa_handler = onSignal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  int result = daemon.run();
+  running = nullptr;
+  if (result) fprintf(stderr, "Radio closed\n");
+  printStats(daemon.getStats());
+  return result;
+}
@@ -0,0 +1,164 @@
+#include "fanetReplay.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace Fanet;
+using namespace Fanet::Replay;
+
+namespace {
+  Mac toMac(const uint32_t& value) {
+    Mac mac;
+    mac.manufacturer = value >> 16;
+    mac.device = value & 0xFFFF;
+    return mac;
+  }
+
+  void printFrame(const char* label, const uint8_t* bytes, const size_t& length) {
+    printf("  %-9s", label);
+    for (size_t i = 0; i < length; i++) printf(" %02X", bytes[i]);
+    printf("\n");
+  }
+}  // namespace
+
+Fanet::Replay::Replayer::Replayer(const Options& options) : options(options) {
+  if (options.legacy) manager.setForwardPolicy(legacyPolicy);
+  manager.setCsmaMode(options.csma);
+}
+
+bool Fanet::Replay::Replayer::replay(const CaptureRecord& record) {
+  totals.records++;
+
+  // A capture started mid way through only has our address in its Begin record
+  if (!begun && record.type != CaptureRecordType::Begin) {
+    manager.Begin(toMac(0), 0);
+    begun = true;
+  }
+
+  switch (record.type) {
+    case CaptureRecordType::Begin: {
+      CaptureBegin begin;
+      if (!CaptureBegin::parse(record.body, record.length, begin)) break;
+      if (begin.version != FANET_CAPTURE_VERSION) {
+        fprintf(stderr, "Capture version %u, expected %u\n", begin.version,
+                FANET_CAPTURE_VERSION);
+        return false;
+      }
+      manager.Begin(toMac(begin.mac), begin.seed);
+      begun = true;
+      break;
+    }
+
+    case CaptureRecordType::Rx:
+      totals.rx++;
+      memcpy(frame.data(), record.body, etl::min<size_t>(record.length, frame.size()));
+      manager.handleRx(frame, record.length, record.ms, record.a / 100.0f, record.b / 100.0f);
+      break;
+
+    case CaptureRecordType::Tx:
+      replayTx(record);
+      break;
+
+    case CaptureRecordType::Position: {
+      CapturePosition position;
+      if (!CapturePosition::parse(record.body, record.length, position)) break;
+      totals.positions++;
+      manager.aircraftType = (AircraftType)position.aircraftType;
+      if (position.groundType == CapturePosition::kNotGround) {
+        manager.setGroundType(etl::nullopt);
+      } else {
+        manager.setGroundType((GroundTrackingType::enum_type)position.groundType);
+      }
+      manager.setPos(position.lat, position.lng, position.alt, record.ms, position.heading,
+                     position.climbRate, position.speed);
+      break;
+    }
+
+    case CaptureRecordType::Send: {
+      totals.sends++;
+      memcpy(frame.data(), record.body, etl::min<size_t>(record.length, frame.size()));
+      auto packet = Packet::parse(frame, record.length);
+      etl::optional<Mac> destination;
+      auto ackType = ExtendedHeaderAckType::None;
+      if (packet.extHeader.has_value()) {
+        destination = packet.extHeader.value().destinationMac;
+        ackType = packet.extHeader.value().ackType;
+      }
+      manager.sendPacket(packet.payload, record.ms, packet.header.shouldForward, destination,
+                         ackType);
+      break;
+    }
+
+    case CaptureRecordType::Stats:
+      compareStats(record);
+      break;
+
+    default:
+      break;
+  }
+
+  // The application polls the tx queue between everything else it does
+  manager.nextTxTime(record.ms);
+  return true;
+}
+
+void Fanet::Replay::Replayer::replayTx(const CaptureRecord& record) {
+  bool deferred = record.a == CaptureWriter::kTxDeferred;
+  bool queued = manager.nextTxTime(record.ms).has_value();
+  bool called = false;
+  auto transmit = [&](const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>* bytes,
+                      const size_t& length) {
+    called = true;
+    if (deferred) {
+      totals.txMismatched++;
+      if (printed++ < options.maxPrinted) {
+        printf("Frame sent at %u ms, where the recording put it off\n", record.ms);
+        printFrame("replayed", bytes->data(), length);
+      }
+      return false;
+    }
+    if (length == record.length && !memcmp(bytes->data(), record.body, length)) {
+      totals.txMatched++;
+    } else {
+      totals.txMismatched++;
+      if (printed++ < options.maxPrinted) {
+        printf("Frame differs at %u ms\n", record.ms);
+        printFrame("recorded", record.body, record.length);
+        printFrame("replayed", bytes->data(), length);
+      }
+    }
+    // The channel is as busy as it was when recorded
+    return record.a != 0;
+  };
+  etl::delegate<bool(const etl::array<uint8_t, FANET_MAX_PACKET_SIZE>*, const size_t&)> tx(
+      transmit);
+  manager.doTx(record.ms, tx);
+  if (called) return;
+
+  if (deferred && queued) {
+    totals.txMatched++;
+    return;
+  }
+  totals.txMissing++;
+  if (printed++ < options.maxPrinted) {
+    printf("Nothing to send at %u ms\n", record.ms);
+    if (!deferred) printFrame("recorded", record.body, record.length);
+  }
+}
+
+void Fanet::Replay::Replayer::compareStats(const CaptureRecord& record) {
+  // Counters added since the recording, (or since this version), aren't compared
+  size_t count = etl::min<size_t>(record.length / 4, kStatFieldCount);
+  auto replayed = manager.getStats();
+  totals.statsCompared++;
+  bool differs = false;
+  for (size_t i = 0; i < count; i++) {
+    auto& field = kStatFields[i];
+    uint32_t recorded = CaptureStats::counter(record.body, i);
+    if (recorded == replayed.*field.field) continue;
+    if (!differs) printf("Stats differ at %u ms\n", record.ms);
+    differs = true;
+    printf("  %-20s recorded %10u replayed %10u\n", field.name, recorded, replayed.*field.field);
+  }
+  if (differs) totals.statsDiffering++;
+}
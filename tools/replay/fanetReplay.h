@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+  Replays capture records, (see src/fanetCapture.h), into a fresh FanetManager, comparing what it
+  transmits and its stats against what was recorded.
+
+  Frames and random choices only match when the capture was started straight after Begin,
+  (see FanetManager::setCapture), and the manager is set up as the recording's was.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fanetCapture.h"
+#include "fanetManager.h"
+
+namespace Fanet {
+  namespace Replay {
+
+    /// @brief How the recording's manager was set up
+    struct Options {
+      bool legacy = false;  // Forwarded with the LegacyForwardPolicy
+      CsmaMode csma = CsmaMode::Exponential;
+      size_t maxPrinted = 5;  // Differences printed, the rest are only counted
+    };
+
+    /// @brief What's been replayed, and how it compared
+    struct Totals {
+      uint64_t records = 0;
+      uint64_t rx = 0;
+      uint64_t sends = 0;
+      uint64_t positions = 0;
+      uint64_t txMatched = 0;     // Replay sent the same frame, (or put it off too)
+      uint64_t txMismatched = 0;  // Replay sent a different frame, (or didn't put it off)
+      uint64_t txMissing = 0;     // Replay had nothing to send
+      uint64_t statsCompared = 0;
+      uint64_t statsDiffering = 0;
+    };
+
+    class Replayer {
+     public:
+      explicit Replayer(const Options& options);
+
+      /// @brief Replays a record
+      /// @return false if the capture was written by an incompatible version
+      bool replay(const CaptureRecord& record);
+
+      const Totals& getTotals() const { return totals; }
+
+      /// @brief If anything replayed differently to the recording
+      bool differed() const {
+        return totals.txMismatched || totals.txMissing || totals.statsDiffering;
+      }
+
+     protected:
+      void replayTx(const CaptureRecord& record);
+      void compareStats(const CaptureRecord& record);
+
+      Options options;
+      FanetManager manager;
+      LegacyForwardPolicy legacyPolicy;
+      Totals totals;
+      size_t printed = 0;
+      bool begun = false;
+      etl::array<uint8_t, FANET_MAX_PACKET_SIZE> frame;
+    };
+  }  // namespace Replay
+}  // namespace Fanet
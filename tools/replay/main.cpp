@@ -0,0 +1,127 @@
+/*
+  Replays a capture into a fresh FanetManager, and compares what it transmits and its stats
+  against what was recorded.  Use it to reproduce field issues, and to check a change to the
+  manager against real traffic.
+
+  pio run -e replay && .pio/build/replay/program capture.bin
+
+  Options:
+    --speed X      Replay at X times the recorded pace, 0 for as fast as possible (default 0)
+    --policy P     Forwarding policy the recording used, density or legacy (default density)
+    --csma C       Back-off the recording used, exponential, persistent or fixed (default
+                   exponential)
+    --verbose      Print every difference, not just the first few
+
+  Frames and random choices only match when the capture was started straight after Begin,
+  (see FanetManager::setCapture).  Exits with 2 if the replay differed from the recording.
+
+  Unlike the library itself, this is host tooling and uses the standard library freely.
+*/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+#include "fanetReplay.h"
+
+using namespace Fanet;
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  double speed = 0;
+  bool verbose = false;
+  Replay::Options options;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (!strcmp(arg, "--verbose")) {
+      verbose = true;
+    } else if (!strcmp(arg, "--speed")) {
+      speed = strtod(value, NULL);
+      i++;
+    } else if (!strcmp(arg, "--policy")) {
+      options.legacy = !strcmp(value, "legacy");
+      i++;
+    } else if (!strcmp(arg, "--csma")) {
+      options.csma = !strcmp(value, "fixed")        ? CsmaMode::Fixed
+                     : !strcmp(value, "persistent") ? CsmaMode::Persistent
+                                                    : CsmaMode::Exponential;
+      i++;
+    } else if (arg[0] != '-' && !path) {
+      path = arg;
+    } else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+  if (!path) {
+    fprintf(stderr, "Usage: %s capture.bin [--speed X] [--policy P] [--csma C] [--verbose]\n", argv[0]);
+    return 1;
+  }
+  if (verbose) options.maxPrinted = SIZE_MAX;
+
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    perror(path);
+    return 1;
+  }
+  size_t size = st.st_size;
+  const uint8_t* data = (const uint8_t*)"";
+  if (size) {
+    void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    data = (const uint8_t*)mapped;
+  }
+
+  Replay::Replayer replayer(options);
+  uint32_t firstMs = 0, lastMs = 0;
+  auto started = std::chrono::steady_clock::now();
+
+  CaptureReader reader(data, size);
+  CaptureRecord record;
+  while (reader.next(record)) {
+    if (!replayer.getTotals().records) firstMs = record.ms;
+    lastMs = record.ms;
+
+    // Replaying at the recorded pace, (or a multiple of)
+    if (speed > 0) {
+      std::this_thread::sleep_until(
+          started + std::chrono::microseconds((int64_t)((record.ms - firstMs) * 1000.0 / speed)));
+    }
+    if (!replayer.replay(record)) return 1;
+  }
+
+  double wall =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  double recorded = (lastMs - firstMs) / 1000.0;
+  auto& totals = replayer.getTotals();
+
+  printf("\n%-24s %llu (%zu bytes skipped)\n", "records", (unsigned long long)totals.records,
+         reader.getSkipped());
+  printf("%-24s %llu\n", "frames received", (unsigned long long)totals.rx);
+  printf("%-24s %llu\n", "position updates", (unsigned long long)totals.positions);
+  printf("%-24s %llu\n", "application sends", (unsigned long long)totals.sends);
+  printf("%-24s %llu matched, %llu differed, %llu missing\n", "transmit attempts",
+         (unsigned long long)totals.txMatched, (unsigned long long)totals.txMismatched,
+         (unsigned long long)totals.txMissing);
+  printf("%-24s %llu compared, %llu differed\n", "stats snapshots",
+         (unsigned long long)totals.statsCompared, (unsigned long long)totals.statsDiffering);
+  printf("%-24s %.1f s recorded in %.3f s, %.0fx, %.0f records/s\n", "replay", recorded, wall,
+         wall > 0 ? recorded / wall : 0, wall > 0 ? totals.records / wall : 0);
+
+  if (size) munmap((void*)data, size);
+  close(fd);
+  return replayer.differed() ? 2 : 0;
+}